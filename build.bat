@@ -36,10 +36,10 @@ set "SRCS=%SRCS% %SRCDIR%\PascalFile.c %SRCDIR%\PascalRepl.c"
 set "SRCS=%SRCS% %SRCDIR%\Tokenizer.c %SRCDIR%\Vartab.c"
 set "SRCS=%SRCS% %SRCDIR%\Compiler\Compiler.c %SRCDIR%\Compiler\Emitter.c "
 set "SRCS=%SRCS% %SRCDIR%\Compiler\Data.c %SRCDIR%\Compiler\Error.c %SRCDIR%\Compiler\Builtins.c"
-set "SRCS=%SRCS% %SRCDIR%\Compiler\Expr.c %SRCDIR%\Compiler\VarList.c"
+set "SRCS=%SRCS% %SRCDIR%\Compiler\Expr.c %SRCDIR%\Compiler\VarList.c %SRCDIR%\Compiler\Ir.c %SRCDIR%\Compiler\ConstProp.c %SRCDIR%\Compiler\Peephole.c %SRCDIR%\Compiler\RegAlloc.c %SRCDIR%\Compiler\Promote.c %SRCDIR%\Compiler\Link.c %SRCDIR%\Compiler\Inline.c"
 
 set "SRCS=%SRCS% %SRCDIR%\PVM\Chunk.c %SRCDIR%\PVM\Disassembler.c %SRCDIR%\PVM\PVM.c"
-set "SRCS=%SRCS% %SRCDIR%\PVM\Debugger.c"
+set "SRCS=%SRCS% %SRCDIR%\PVM\Debugger.c %SRCDIR%\PVM\Decoder.c %SRCDIR%\PVM\Jit.c %SRCDIR%\PVM\CBackend.c %SRCDIR%\PVM\Elf.c %SRCDIR%\PVM\Guard.c %SRCDIR%\PVM\Output.c %SRCDIR%\PVM\Input.c %SRCDIR%\PVM\File.c"
 
 
 set "UNITY=%SRCDIR%\UnityBuild.c"
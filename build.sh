@@ -12,15 +12,27 @@ CCFLAGS="-DPVM_DEBUGGER \
     -Wno-missing-braces -Wno-format\
     -Wall -Wextra -Wpedantic -I${INCPATH}"
 LDFLAGS="-flto"
-LIBS=""
+# how the interpreter dispatches instructions: SWITCH, THREADED or TAILCALL
+# e.g. PVM_DISPATCH=SWITCH ./build.sh gcc
+if [ -n "${PVM_DISPATCH}" ];
+then
+    CCFLAGS="${CCFLAGS} -DPVM_DISPATCH=PVM_DISPATCH_${PVM_DISPATCH}"
+fi
+# count how often each pair of opcodes is executed, see test/benchmark/pairs.sh
+if [ -n "${PVM_PROFILE}" ];
+then
+    CCFLAGS="${CCFLAGS} -DPVM_PROFILE"
+fi
+LIBS="-ldl -lpthread"
 
 SRCS="${SRCDIR}/main.c ${SRCDIR}/Pascal.c ${SRCDIR}/PascalFile.c ${SRCDIR}/PascalRepl.c \
     ${SRCDIR}/PascalString.c ${SRCDIR}/Memory.c ${SRCDIR}/Vartab.c \
     ${SRCDIR}/Tokenizer.c \
     ${SRCDIR}/Compiler/Compiler.c ${SRCDIR}/Compiler/Data.c ${SRCDIR}/Compiler/Builtins.c \
     ${SRCDIR}/Compiler/Expr.c ${SRCDIR}/Compiler/Emitter.c ${SRCDIR}/Compiler/VarList.c \
-    ${SRCDIR}/Compiler/Error.c \
-    ${SRCDIR}/PVM/Chunk.c ${SRCDIR}/PVM/Debugger.c ${SRCDIR}/PVM/Disassembler.c ${SRCDIR}/PVM/PVM.c"
+    ${SRCDIR}/Compiler/Error.c ${SRCDIR}/Compiler/Ir.c ${SRCDIR}/Compiler/ConstProp.c ${SRCDIR}/Compiler/Peephole.c ${SRCDIR}/Compiler/RegAlloc.c ${SRCDIR}/Compiler/Promote.c ${SRCDIR}/Compiler/Link.c ${SRCDIR}/Compiler/Inline.c \
+    ${SRCDIR}/PVM/Chunk.c ${SRCDIR}/PVM/Debugger.c ${SRCDIR}/PVM/Decoder.c ${SRCDIR}/PVM/Disassembler.c ${SRCDIR}/PVM/PVM.c \
+    ${SRCDIR}/PVM/Jit.c ${SRCDIR}/PVM/CBackend.c ${SRCDIR}/PVM/Elf.c ${SRCDIR}/PVM/Guard.c ${SRCDIR}/PVM/Output.c ${SRCDIR}/PVM/Input.c ${SRCDIR}/PVM/File.c"
 UNITY="${SRCDIR}/UnityBuild.c"
 OUTPUT="./bin/pascal"
 
@@ -32,26 +32,119 @@ static U32 sNewlineConstHash = 0;
 
 
 
+typedef enum FileArgKind 
+{
+    FILE_ARG_ANY,
+    FILE_ARG_TEXT,
+    FILE_ARG_TYPED,
+} FileArgKind;
+
+/* a file variable as the argument of FnName */
+static bool CompileFileArg(PascalCompiler *Compiler, const char *FnName, FileArgKind Kind, VarLocation *File)
+{
+    static const char *const KindName[] = {
+        [FILE_ARG_ANY] = "a file",
+        [FILE_ARG_TEXT] = "a text",
+        [FILE_ARG_TYPED] = "a typed file",
+    };
+    Token ArgToken = Compiler->Next;
+    *File = CompileExpr(Compiler);
+    bool Typed = TYPE_FILE == File->Type.Integral && NULL != File->Type.As.File.ElementType;
+    if (VAR_MEM != File->LocationType || TYPE_FILE != File->Type.Integral
+    || (FILE_ARG_TEXT == Kind && Typed) || (FILE_ARG_TYPED == Kind && !Typed))
+    {
+        ErrorAt(Compiler, &ArgToken, "%s expects %s variable.", FnName, KindName[Kind]);
+        FreeExpr(Compiler, *File);
+        return false;
+    }
+    return true;
+}
+
+/* the records after the file of write(f, ...) and read(f, ...) on a typed file, pushed by address */
+static UInt CompileRecordArgs(PascalCompiler *Compiler, const VarType *FileType, const char *FnName)
+{
+    const VarType *ElementType = FileType->As.File.ElementType;
+    UInt ArgCount = 0;
+    while (ConsumeIfNextTokenIs(Compiler, TOKEN_COMMA))
+    {
+        Token ArgToken = Compiler->Next;
+        VarLocation Arg = CompileExpr(Compiler);
+        if (VAR_MEM != Arg.LocationType)
+        {
+            ErrorAt(Compiler, &ArgToken, "%s expects a variable.", FnName);
+        }
+        else if (!VarTypeEqual(&Arg.Type, ElementType))
+        {
+            StringView ArgumentType = VarTypeToStringView(Arg.Type);
+            StringView RecordType = VarTypeToStringView(*ElementType);
+            ErrorAt(Compiler, &ArgToken, "%s expects a variable of type "STRVIEW_FMT", got "STRVIEW_FMT".", 
+                FnName, 
+                STRVIEW_FMT_ARG(RecordType),
+                STRVIEW_FMT_ARG(ArgumentType)
+            );
+        }
+        else
+        {
+            /* the VM copies the whole record between the file and the variable */
+            VarLocation Addr = PVMAllocateRegisterLocation(EMITTER(), VarTypePtr(NULL));
+            PVMEmitLoadAddr(EMITTER(), Addr.As.Register, Arg.As.Memory);
+            PVMEmitPush(EMITTER(), &Addr);
+            FreeExpr(Compiler, Addr);
+        }
+        FreeExpr(Compiler, Arg);
+        ArgCount++;
+    }
+    return ArgCount;
+}
+
+/* the file sys ops want the address of the text variable in R1 */
+static void EmitFileArg(PascalCompiler *Compiler, VarLocation File)
+{
+    VarRegister FilePtr = {
+        .ID = 1,
+    };
+    PVMEmitLoadAddr(EMITTER(), FilePtr, File.As.Memory);
+    FreeExpr(Compiler, File);
+}
+
+
 static void CompileSysWrite(PascalCompiler *Compiler, bool Newline)
 {
     PASCAL_NONNULL(Compiler);
     SaveRegInfo SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), NO_RETURN_REG);
     UInt ArgCount = 0;
+    VarLocation File = { 0 };
+    bool ToFile = false, ToRecords = false;
+    const char *FnName = Newline? "Writeln" : "Write";
 
     if (ConsumeIfNextTokenIs(Compiler, TOKEN_LEFT_PAREN))
     {
         if (!NextTokenIs(Compiler, TOKEN_RIGHT_PAREN))
         {
-            /* TODO: file argument */
             do {
+                Token ArgToken = Compiler->Next;
                 VarLocation Arg = CompileExpr(Compiler);
+                /* write(f, ...) */
+                if (0 == ArgCount && !ToFile && TYPE_FILE == Arg.Type.Integral && VAR_MEM == Arg.LocationType)
+                {
+                    File = Arg;
+                    ToFile = true;
+                    if (NULL != File.Type.As.File.ElementType)
+                    {
+                        if (Newline)
+                            ErrorAt(Compiler, &ArgToken, "%s expects a text variable.", FnName);
+                        ToRecords = true;
+                        ArgCount = CompileRecordArgs(Compiler, &File.Type, FnName);
+                        break;
+                    }
+                    continue;
+                }
                 VarLocation ArgType = VAR_LOCATION_LIT(.Int = Arg.Type.Integral, TYPE_U32);
 
                 if (!IntegralTypeIsOrdinal(Arg.Type.Integral)
                 && !IntegralTypeIsFloat(Arg.Type.Integral) 
                 && TYPE_STRING != Arg.Type.Integral)
                 {
-                    const char *FnName = Newline? "Writeln" : "Write";
                     StringView ArgumentType = VarTypeToStringView(Arg.Type);
                     Error(Compiler, "%s does accept value of type "STRVIEW_FMT".", 
                         FnName, 
@@ -69,7 +162,7 @@ static void CompileSysWrite(PascalCompiler *Compiler, bool Newline)
     }
 
     /* newline arg */
-    if (Newline)
+    if (Newline && !ToRecords)
     {
         PascalVar *NewlineLiteral = VartabFindWithHash(&Compiler->Global, 
             sNewlineConstName, sizeof(sNewlineConstName) - 1, sNewlineConstHash
@@ -80,24 +173,239 @@ static void CompileSysWrite(PascalCompiler *Compiler, bool Newline)
         ArgCount++;
     }
 
+    /* file ptr reg, before R0 in case the text variable is addressed through it,
+     * TODO: define this as a constant in memory instead */
+    if (ToFile)
+    {
+        EmitFileArg(Compiler, File);
+    }
+    else
+    {
+        VarRegister FilePtr = {
+            .ID = 1,
+        };
+        PVMEmitMoveImm(EMITTER(), FilePtr, (I64)stdout);
+    }
+
     /* arg count reg */
     VarRegister ArgCountReg = {
         .ID = 0
     };
     PVMEmitMoveImm(EMITTER(), ArgCountReg, ArgCount);
 
-    /* file ptr reg, 
-     * TODO: define this as a constant in memory instead */
-    VarRegister FilePtr = {
-        .ID = 1,
+    /* syscall */
+    if (ToRecords)
+        PVMEmitFileOp(EMITTER(), OP_SYS_WRITE_RECORD);
+    else if (ToFile)
+        PVMEmitFileOp(EMITTER(), OP_SYS_WRITE_FILE);
+    else PVMEmitWrite(EMITTER());
+    PVMEmitUnsaveCallerRegs(EMITTER(), NO_RETURN_REG, SaveRegs);
+}
+
+static void CompileSysRead(PascalCompiler *Compiler, bool Newline)
+{
+    PASCAL_NONNULL(Compiler);
+    SaveRegInfo SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), NO_RETURN_REG);
+    UInt ArgCount = 0;
+    VarLocation File = { 0 };
+    bool FromFile = false, FromRecords = false;
+    const char *FnName = Newline? "Readln" : "Read";
+
+    if (ConsumeIfNextTokenIs(Compiler, TOKEN_LEFT_PAREN))
+    {
+        if (!NextTokenIs(Compiler, TOKEN_RIGHT_PAREN))
+        {
+            do {
+                Token ArgToken = Compiler->Next;
+                VarLocation Arg = CompileExpr(Compiler);
+                /* read(f, ...) */
+                if (0 == ArgCount && !FromFile && TYPE_FILE == Arg.Type.Integral && VAR_MEM == Arg.LocationType)
+                {
+                    File = Arg;
+                    FromFile = true;
+                    if (NULL != File.Type.As.File.ElementType)
+                    {
+                        if (Newline)
+                            ErrorAt(Compiler, &ArgToken, "%s expects a text variable.", FnName);
+                        FromRecords = true;
+                        ArgCount = CompileRecordArgs(Compiler, &File.Type, FnName);
+                        break;
+                    }
+                    continue;
+                }
+                if (VAR_MEM != Arg.LocationType)
+                {
+                    ErrorAt(Compiler, &ArgToken, "%s expects a variable.", FnName);
+                }
+                else if (!IntegralTypeIsInteger(Arg.Type.Integral)
+                && !IntegralTypeIsFloat(Arg.Type.Integral) 
+                && TYPE_CHAR != Arg.Type.Integral
+                && TYPE_STRING != Arg.Type.Integral)
+                {
+                    StringView ArgumentType = VarTypeToStringView(Arg.Type);
+                    ErrorAt(Compiler, &ArgToken, "%s does not accept variable of type "STRVIEW_FMT".", 
+                        FnName, 
+                        STRVIEW_FMT_ARG(ArgumentType)
+                    );
+                }
+                else
+                {
+                    /* the VM stores straight into the variable */
+                    VarLocation Addr = PVMAllocateRegisterLocation(EMITTER(), VarTypePtr(NULL));
+                    VarLocation ArgType = VAR_LOCATION_LIT(.Int = Arg.Type.Integral, TYPE_U32);
+                    PVMEmitLoadAddr(EMITTER(), Addr.As.Register, Arg.As.Memory);
+                    PVMEmitPush(EMITTER(), &Addr);
+                    PVMEmitPush(EMITTER(), &ArgType);
+                    FreeExpr(Compiler, Addr);
+                }
+                FreeExpr(Compiler, Arg);
+
+                ArgCount++;
+            } while (ConsumeIfNextTokenIs(Compiler, TOKEN_COMMA));
+        }
+        ConsumeOrError(Compiler, TOKEN_RIGHT_PAREN, "Expected ')' after argument list.");
+    }
+
+    /* file ptr reg */
+    if (FromFile)
+    {
+        EmitFileArg(Compiler, File);
+    }
+    else
+    {
+        VarRegister FilePtr = {
+            .ID = 1,
+        };
+        PVMEmitMoveImm(EMITTER(), FilePtr, (I64)stdin);
+    }
+
+    /* arg count reg */
+    VarRegister ArgCountReg = {
+        .ID = 0
     };
-    PVMEmitMoveImm(EMITTER(), FilePtr, (I64)stdout);
+    PVMEmitMoveImm(EMITTER(), ArgCountReg, ArgCount);
 
     /* syscall */
-    PVMEmitWrite(EMITTER());
+    if (FromRecords)
+        PVMEmitFileOp(EMITTER(), OP_SYS_READ_RECORD);
+    else if (FromFile)
+        PVMEmitFileOp(EMITTER(), Newline? OP_SYS_READLN_FILE : OP_SYS_READ_FILE);
+    else PVMEmitRead(EMITTER(), Newline);
     PVMEmitUnsaveCallerRegs(EMITTER(), NO_RETURN_REG, SaveRegs);
 }
 
+/* assign(f, Name), reset(f), rewrite(f), close(f) and seek(f, Record) */
+static void CompileSysFileOp(PascalCompiler *Compiler, PVMSysOp Op, const char *FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    SaveRegInfo SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), NO_RETURN_REG);
+    UInt ArgCount = 0;
+    VarLocation File;
+
+    ConsumeOrError(Compiler, TOKEN_LEFT_PAREN, "Expected '(' after %s.", FnName);
+    bool HasFile = CompileFileArg(Compiler, FnName, 
+        OP_SYS_SEEK == Op? FILE_ARG_TYPED : FILE_ARG_ANY, &File
+    );
+    if (OP_SYS_SEEK == Op)
+    {
+        ConsumeOrError(Compiler, TOKEN_COMMA, "Expected record number after file variable.");
+        Token RecordToken = Compiler->Next;
+        VarLocation Record = PVMAllocateRegisterLocation(EMITTER(), VarTypeInit(TYPE_I64, 8));
+        CompileExprInto(Compiler, &RecordToken, &Record);
+        PVMEmitPush(EMITTER(), &Record);
+        PVMEmitPush(EMITTER(), &VAR_LOCATION_LIT(.Int = TYPE_I64, TYPE_U32));
+        FreeExpr(Compiler, Record);
+        ArgCount++;
+    }
+    else if (OP_SYS_ASSIGN == Op)
+    {
+        /* the name goes on the stack like an argument of write */
+        ConsumeOrError(Compiler, TOKEN_COMMA, "Expected file name after text variable.");
+        Token NameToken = Compiler->Next;
+        VarLocation Name = CompileExpr(Compiler);
+        if (TYPE_STRING != Name.Type.Integral)
+        {
+            StringView NameType = VarTypeToStringView(Name.Type);
+            ErrorAt(Compiler, &NameToken, "%s expects a string as the file name, got "STRVIEW_FMT".", 
+                FnName, 
+                STRVIEW_FMT_ARG(NameType)
+            );
+        }
+        else
+        {
+            PVMEmitPush(EMITTER(), &Name);
+            PVMEmitPush(EMITTER(), &VAR_LOCATION_LIT(.Int = TYPE_STRING, TYPE_U32));
+            ArgCount++;
+        }
+        FreeExpr(Compiler, Name);
+    }
+    ConsumeOrError(Compiler, TOKEN_RIGHT_PAREN, "Expected ')' after argument list.");
+
+    if (HasFile)
+    {
+        /* reset and rewrite take the record size instead */
+        const VarType *ElementType = File.Type.As.File.ElementType;
+        if ((OP_SYS_RESET == Op || OP_SYS_REWRITE == Op) && NULL != ElementType)
+            ArgCount = ElementType->Size;
+
+        EmitFileArg(Compiler, File);
+        VarRegister ArgCountReg = {
+            .ID = 0
+        };
+        PVMEmitMoveImm(EMITTER(), ArgCountReg, ArgCount);
+        PVMEmitFileOp(EMITTER(), Op);
+    }
+    PVMEmitUnsaveCallerRegs(EMITTER(), NO_RETURN_REG, SaveRegs);
+}
+
+/* 
+ * eof and eoln, of the standard input without an argument, 
+ * and filesize and filepos of a typed file 
+ */
+static OptionalReturnValue CompileSysFileStatus(PascalCompiler *Compiler, PVMSysOp Op, const char *FnName, 
+        FileArgKind Kind, IntegralType ResultType)
+{
+    PASCAL_NONNULL(Compiler);
+    VarType Type = VarTypeInit(ResultType, IntegralTypeSize(ResultType));
+    OptionalReturnValue Status = {
+        .HasReturnValue = true,
+        .ReturnValue = PVMAllocateRegisterLocation(EMITTER(), Type),
+    };
+    UInt ReturnReg = Status.ReturnValue.As.Register.ID;
+    SaveRegInfo SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), ReturnReg);
+
+    VarLocation File;
+    bool HasFile = false;
+    if (FILE_ARG_TYPED == Kind)
+    {
+        ConsumeOrError(Compiler, TOKEN_LEFT_PAREN, "Expected '(' after %s.", FnName);
+        HasFile = CompileFileArg(Compiler, FnName, Kind, &File);
+        ConsumeOrError(Compiler, TOKEN_RIGHT_PAREN, "Expected ')' after argument.");
+    }
+    else if (ConsumeIfNextTokenIs(Compiler, TOKEN_LEFT_PAREN))
+    {
+        HasFile = CompileFileArg(Compiler, FnName, Kind, &File);
+        ConsumeOrError(Compiler, TOKEN_RIGHT_PAREN, "Expected ')' after argument.");
+    }
+    if (HasFile)
+    {
+        EmitFileArg(Compiler, File);
+    }
+    else
+    {
+        VarRegister FilePtr = {
+            .ID = 1,
+        };
+        PVMEmitMoveImm(EMITTER(), FilePtr, 0);
+    }
+    PVMEmitFileOp(EMITTER(), Op);
+
+    VarLocation Result = VAR_LOCATION_REG(PVM_RETREG, false, Type);
+    PVMEmitMove(EMITTER(), &Status.ReturnValue, &Result);
+    PVMEmitUnsaveCallerRegs(EMITTER(), ReturnReg, SaveRegs);
+    return Status;
+}
+
 PASCAL_BUILTIN(Writeln, Compiler, FnName)
 {
     PASCAL_NONNULL(Compiler);
@@ -116,6 +424,97 @@ PASCAL_BUILTIN(Write, Compiler, FnName)
     return None;
 }
 
+PASCAL_BUILTIN(Readln, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysRead(Compiler, true);
+    return None;
+}
+
+PASCAL_BUILTIN(Read, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysRead(Compiler, false);
+    return None;
+}
+
+PASCAL_BUILTIN(Assign, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysFileOp(Compiler, OP_SYS_ASSIGN, "Assign");
+    return None;
+}
+
+PASCAL_BUILTIN(Reset, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysFileOp(Compiler, OP_SYS_RESET, "Reset");
+    return None;
+}
+
+PASCAL_BUILTIN(Rewrite, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysFileOp(Compiler, OP_SYS_REWRITE, "Rewrite");
+    return None;
+}
+
+PASCAL_BUILTIN(Close, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysFileOp(Compiler, OP_SYS_CLOSE, "Close");
+    return None;
+}
+
+PASCAL_BUILTIN(Eof, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    return CompileSysFileStatus(Compiler, OP_SYS_EOF, "Eof", FILE_ARG_ANY, TYPE_BOOLEAN);
+}
+
+PASCAL_BUILTIN(Eoln, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    return CompileSysFileStatus(Compiler, OP_SYS_EOLN, "Eoln", FILE_ARG_TEXT, TYPE_BOOLEAN);
+}
+
+PASCAL_BUILTIN(Seek, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    OptionalReturnValue None = {.HasReturnValue = false};
+    CompileSysFileOp(Compiler, OP_SYS_SEEK, "Seek");
+    return None;
+}
+
+PASCAL_BUILTIN(FileSize, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    return CompileSysFileStatus(Compiler, OP_SYS_FILESIZE, "FileSize", FILE_ARG_TYPED, TYPE_I64);
+}
+
+PASCAL_BUILTIN(FilePos, Compiler, FnName)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(FnName);
+    return CompileSysFileStatus(Compiler, OP_SYS_FILEPOS, "FilePos", FILE_ARG_TYPED, TYPE_I64);
+}
+
 PASCAL_BUILTIN(SizeOf, Compiler, FnName)
 {
     PASCAL_NONNULL(Compiler);
@@ -237,8 +636,17 @@ void DefineSystemSubroutines(PascalCompiler *Compiler)
     DEFINE_BUILTIN_FN(Scope, "WRITE", sWrite);
     DEFINE_BUILTIN_FN(Scope, "SIZEOF", sSizeOf);
     DEFINE_BUILTIN_FN(Scope, "ORD", sOrd);
-    //DEFINE_BUILTIN_FN(Scope, "READLN", sReadln);
-    //DEFINE_BUILTIN_FN(Scope, "READ", sRead);
+    DEFINE_BUILTIN_FN(Scope, "READLN", sReadln);
+    DEFINE_BUILTIN_FN(Scope, "READ", sRead);
+    DEFINE_BUILTIN_FN(Scope, "ASSIGN", sAssign);
+    DEFINE_BUILTIN_FN(Scope, "RESET", sReset);
+    DEFINE_BUILTIN_FN(Scope, "REWRITE", sRewrite);
+    DEFINE_BUILTIN_FN(Scope, "CLOSE", sClose);
+    DEFINE_BUILTIN_FN(Scope, "EOF", sEof);
+    DEFINE_BUILTIN_FN(Scope, "EOLN", sEoln);
+    DEFINE_BUILTIN_FN(Scope, "SEEK", sSeek);
+    DEFINE_BUILTIN_FN(Scope, "FILESIZE", sFileSize);
+    DEFINE_BUILTIN_FN(Scope, "FILEPOS", sFilePos);
 
 }
 
@@ -17,6 +17,8 @@
 #include "Compiler/Error.h"
 #include "Compiler/Emitter.h"
 #include "Compiler/Expr.h"
+#include "Compiler/Ir.h"
+#include "Compiler/Link.h"
 #include "Compiler/VarList.h"
 
 
@@ -315,7 +317,7 @@ static void CompileForStmt(PascalCompiler *Compiler)
     VarLocation CounterSave = *Counter->Location;
     VarLocation *i = Counter->Location;
     *i = PVMAllocateRegisterLocation(EMITTER(), CounterSave.Type);
-    i->As.Register.Persistent = true;
+    PVMPinRegister(EMITTER(), &i->As.Register);
 
     /* init expression */
     ConsumeOrError(Compiler, TOKEN_COLON_EQUAL, "Expected ':=' after variable name.");
@@ -333,7 +335,7 @@ static void CompileForStmt(PascalCompiler *Compiler)
     }
 
     /* stop condition expr */
-    U32 LoopExit = 0;
+    U32 LoopExit = 0, LoopDone = 0;
     VarLocation StopCondition = CompileExprIntoReg(Compiler); 
     if (TYPE_INVALID == CoerceTypes(i->Type.Integral, StopCondition.Type.Integral))
     {
@@ -350,11 +352,11 @@ static void CompileForStmt(PascalCompiler *Compiler)
     {
         PASCAL_ASSERT(ConvertTypeImplicitly(Compiler, i->Type.Integral, &StopCondition), "");
 
-        LoopHead = PVMGetCurrentLocation(EMITTER());
         VarLocation Flag = (TOKEN_TO == OpToken.Type) 
             ? PVMEmitSetIfLessOrEqual(EMITTER(), i->As.Register, StopCondition.As.Register, i->Type.Integral)
             : PVMEmitSetIfGreaterOrEqual(EMITTER(), i->As.Register, StopCondition.As.Register, i->Type.Integral);
         LoopExit = PVMEmitBranchIfFalse(EMITTER(), &Flag);
+        LoopHead = PVMGetCurrentLocation(EMITTER());
     }
     /* do */
     ConsumeOrError(Compiler, TOKEN_DO, "Expected 'do' after expression.");
@@ -364,12 +366,17 @@ static void CompileForStmt(PascalCompiler *Compiler)
     /* NOTE: writing to the loop counter variable is ok here but not FPC */
     UInt BreakCountBeforeBody = CompileLoopBody(Compiler);
 
-    /* loop increment */
+    /* loop increment, the counter stays at the stop value once it is reached */
+    VarLocation Flag = (TOKEN_TO == OpToken.Type)
+        ? PVMEmitSetIfLess(EMITTER(), i->As.Register, StopCondition.As.Register, i->Type.Integral)
+        : PVMEmitSetIfGreater(EMITTER(), i->As.Register, StopCondition.As.Register, i->Type.Integral);
+    LoopDone = PVMEmitBranchIfFalse(EMITTER(), &Flag);
     PVMEmitBranchAndInc(EMITTER(), i->As.Register, Inc, LoopHead);
 
     /* loop end */
     PVMEmitDebugInfo(EMITTER(), Compiler->Curr.Lexeme.Str, Compiler->Curr.Lexeme.Len, Compiler->Curr.Line);
     PVMPatchBranchToCurrent(EMITTER(), LoopExit);
+    PVMPatchBranchToCurrent(EMITTER(), LoopDone);
     CompilerPatchBreaks(Compiler, BreakCountBeforeBody);
 
     /* move the result of the counter variable */
@@ -527,7 +534,8 @@ static void CompileCallWithoutReturnValue(PascalCompiler *Compiler,
 
     /* save caller registers asnd start args */
     VarLocation ReturnValue;
-    SaveRegInfo SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), NO_RETURN_REG);
+    InlineSite Inline = InlinePlanCall(Compiler, Location);
+    SaveRegInfo SaveRegs = PVMEmitSaveClobberedRegs(EMITTER(), NO_RETURN_REG, Inline.Clobbers);
     I32 Base = PVMStartArg(EMITTER(), Subroutine->StackArgSize);
     if (NULL != ReturnType && !VarTypeIsTriviallyCopiable(*ReturnType))
     {
@@ -543,7 +551,7 @@ static void CompileCallWithoutReturnValue(PascalCompiler *Compiler,
 
 
     CompileArgumentList(Compiler, Callee, Subroutine, &Base, Subroutine->HiddenParamCount);
-    CompilerEmitCall(Compiler, Location, SaveRegs);
+    CompilerEmitCall(Compiler, Location, SaveRegs, &Inline);
 
 
     if (Subroutine->StackArgSize)
@@ -973,6 +981,8 @@ static void CompileBeginBlock(PascalCompiler *Compiler)
         Compiler->EntryPoint = PVMEmitEnter(EMITTER());
         CompileBeginStmt(Compiler);
         PVMPatchEnter(EMITTER(), Compiler->EntryPoint, Compiler->StackSize);
+        if (Compiler->Flags.OptLevel)
+            IrOptimizeSubroutine(Compiler, Compiler->EntryPoint);
     }
     else
     {
@@ -1218,6 +1228,13 @@ static void CompileSubroutineBlock(PascalCompiler *Compiler, const char *Subrout
     );
     CompilerEmitDebugInfo(Compiler, &Keyword);
 
+    /* inline directive */
+    if (ConsumeIfNextTokenIs(Compiler, TOKEN_INLINE))
+    {
+        ConsumeOrError(Compiler, TOKEN_SEMICOLON, "Expected ';' after 'inline'.");
+        Subroutine.Info->IsInline = true;
+    }
+
 
     /* forward decl */
     if (ConsumeIfNextTokenIs(Compiler, TOKEN_FORWARD))
@@ -1249,8 +1266,12 @@ static void CompileSubroutineBlock(PascalCompiler *Compiler, const char *Subrout
         PVMEmitExit(EMITTER());
         ConsumeOrError(Compiler, TOKEN_SEMICOLON, "Expected ';' after %s block.", SubroutineType);
         CompilerEmitDebugInfo(Compiler, &End);
+        U64 Clobbers = UINT64_MAX;
+        if (Compiler->Flags.OptLevel)
+            Clobbers = IrOptimizeSubroutine(Compiler, *Subroutine.Location);
 
         CompilerPopSubroutine(Compiler);
+        PushSubroutineBody(Compiler, Subroutine.Location, !IsAtGlobalScope(Compiler), Clobbers);
     }
     PVMEmitterEndScope(EMITTER(), PrevScope);
 }
@@ -1572,6 +1593,8 @@ PascalCompiler PascalCompilerInit(
         .InLoop = false,
 
         .SubroutineReferences = { 0 },
+        .SubroutineBodies = { 0 },
+        .Peephole = { 0 },
         .EntryPoint = 0,
 
         .Error = false,
@@ -1608,6 +1631,7 @@ void PascalCompilerDeinit(PascalCompiler *Compiler)
 void PascalCompilerReset(PascalCompiler *Compiler, bool PreserveFunctions)
 {
     Compiler->SubroutineReferences.Count = 0;
+    Compiler->SubroutineBodies.Count = 0;
     Compiler->Curr = (Token) { 0 };
     Compiler->Next = (Token) { 0 };
     Compiler->Panic = false;
@@ -1657,6 +1681,8 @@ bool PascalCompileProgram(PascalCompiler *Compiler, const U8 *Source)
     if (ConsumeIfNextTokenIs(Compiler, TOKEN_PROGRAM))
     {
         NoError = CompileProgram(Compiler);
+        if (NoError && Compiler->Flags.OptLevel)
+            LinkRemoveDeadSubroutines(Compiler);
         ResolveSubroutineReferences(Compiler);
         PVMSetEntryPoint(EMITTER(), Compiler->EntryPoint);
         PVMEmitExit(EMITTER());
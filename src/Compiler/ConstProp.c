@@ -0,0 +1,675 @@
+
+#include <string.h>
+
+#include "Compiler/ConstProp.h"
+
+
+
+/* memory is only tracked when blocks * slots is below this */
+#define CONST_MAX_MEMORY_CELLS (256 * 1024)
+
+
+typedef enum ConstState
+{
+    CONST_UNKNOWN = 0,  /* nothing reached it yet */
+    CONST_KNOWN,
+    CONST_VARYING,
+} ConstState;
+
+typedef struct ConstLattice
+{
+    U64 Value;
+    U8 State;   /* ConstState */
+} ConstLattice;
+
+/* an integer in the frame or in globals */
+typedef struct ConstSlot
+{
+    I32 Offset;
+    U8 Base;    /* PVM_REG_FP or PVM_REG_GP */
+    U8 Width;   /* in bytes */
+} ConstSlot;
+
+typedef struct ConstAccess
+{
+    U8 Width;
+    bool Signed, IsStore, IsFloat;
+} ConstAccess;
+
+typedef struct ConstProp
+{
+    IrFunction *Fn;
+    ConstLattice *Values;
+
+    ConstSlot *Slots;
+    U32 SlotCount;
+    U32 *SlotOf;            /* per instruction, the slot it loads or stores, IR_NONE for any other */
+    ConstLattice *MemOut;   /* [Block*SlotCount + Slot], the slots when Block ends */
+    ConstLattice *Mem;      /* the slots at the instruction being looked at */
+
+    bool *Executable;       /* per block */
+    U8 *EdgeLive;           /* per block, bit n for Succ[n] */
+    bool Changed;
+} ConstProp;
+
+
+static const ConstLattice sVarying = { .State = CONST_VARYING };
+static const ConstLattice sUnknown = { .State = CONST_UNKNOWN };
+
+
+
+
+static ConstLattice ConstKnown(U64 Value)
+{
+    return (ConstLattice) { .Value = Value, .State = CONST_KNOWN };
+}
+
+static ConstLattice ConstMeet(ConstLattice A, ConstLattice B)
+{
+    if (CONST_UNKNOWN == A.State)
+        return B;
+    if (CONST_UNKNOWN == B.State || (CONST_KNOWN == A.State && CONST_KNOWN == B.State && A.Value == B.Value))
+        return A;
+    return sVarying;
+}
+
+/* values only ever go down the lattice, so that the iteration ends */
+static void ConstLower(ConstProp *P, ConstLattice *Old, ConstLattice New)
+{
+    ConstLattice Met = ConstMeet(*Old, New);
+    if (Met.State != Old->State || Met.Value != Old->Value)
+    {
+        *Old = Met;
+        P->Changed = true;
+    }
+}
+
+static ConstLattice ConstOf(ConstProp *P, IrOperand *Operand)
+{
+    Operand->Value = IrResolve(P->Fn, Operand->Value);
+    if (IR_NONE == Operand->Value)
+        return sVarying;
+    return P->Values[Operand->Value];
+}
+
+static bool ConstEdgeLive(const ConstProp *P, U32 From, U32 To)
+{
+    const IrBlock *B = &P->Fn->Blocks[From];
+    return (B->Succ[0] == To && (P->EdgeLive[From] & 1))
+        || (B->Succ[1] == To && (P->EdgeLive[From] & 2));
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   MEMORY
+ */
+/*===============================================================================*/
+
+
+static bool ConstMemAccess(PVMOp Op, ConstAccess *Access)
+{
+    ConstAccess A = { 0 };
+    switch (Op)
+    {
+    case OP_LDZEX32_8: case OP_LDZEX32_8L:
+    case OP_LDZEX64_8: case OP_LDZEX64_8L:      A.Width = 1; break;
+    case OP_LDZEX32_16: case OP_LDZEX32_16L:
+    case OP_LDZEX64_16: case OP_LDZEX64_16L:    A.Width = 2; break;
+    case OP_LD32: case OP_LD32L:
+    case OP_LDZEX64_32: case OP_LDZEX64_32L:    A.Width = 4; break;
+    case OP_LD64: case OP_LD64L:                A.Width = 8; break;
+    case OP_LDSEX32_8: case OP_LDSEX32_8L:
+    case OP_LDSEX64_8: case OP_LDSEX64_8L:      A.Width = 1; A.Signed = true; break;
+    case OP_LDSEX32_16: case OP_LDSEX32_16L:
+    case OP_LDSEX64_16L:                        A.Width = 2; A.Signed = true; break;
+    case OP_LDSEX64_32: case OP_LDSEX64_32L:    A.Width = 4; A.Signed = true; break;
+    /* the interpreter zero extends it, what it loads is left unknown */
+    case OP_LDSEX64_16:                         A.Width = 2; A.IsFloat = true; break;
+
+    case OP_ST8: case OP_ST8L:                  A.Width = 1; A.IsStore = true; break;
+    case OP_ST16: case OP_ST16L:                A.Width = 2; A.IsStore = true; break;
+    case OP_ST32: case OP_ST32L:                A.Width = 4; A.IsStore = true; break;
+    case OP_ST64: case OP_ST64L:                A.Width = 8; A.IsStore = true; break;
+
+    case OP_LDF32: case OP_LDF32L:              A.Width = 4; A.IsFloat = true; break;
+    case OP_LDF64: case OP_LDF64L:              A.Width = 8; A.IsFloat = true; break;
+    case OP_STF32: case OP_STF32L:              A.Width = 4; A.IsFloat = true; A.IsStore = true; break;
+    case OP_STF64: case OP_STF64L:              A.Width = 8; A.IsFloat = true; A.IsStore = true; break;
+    default: return false;
+    }
+    *Access = A;
+    return true;
+}
+
+/* the base register of a load or store, IR_NONE if it is not a memory access */
+static UInt ConstMemBase(const IrIns *Ins)
+{
+    ConstAccess Access;
+    if (Ins->Op > 0xFF || !ConstMemAccess(Ins->Op, &Access))
+        return IR_NONE;
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        if (IR_SLOT_RS == Ins->Use[i].Slot)
+            return Ins->Use[i].Reg;
+    }
+    return IR_NONE;
+}
+
+/* pushes go above SP, past the frame and never to globals */
+static bool ConstIsPush(U16 Op)
+{
+    return OP_PSHL == Op || OP_PSHH == Op || OP_FPSHL == Op || OP_FPSHH == Op;
+}
+
+static I32 ConstMemOffset(const IrIns *Ins)
+{
+    if (2 == Ins->Size)
+        return (I16)Ins->Code[1];
+    return (I32)((U32)Ins->Code[1] | (U32)Ins->Code[2] << 16);
+}
+
+/* every FP and GP relative slot the function touches */
+static void ConstFindSlots(ConstProp *P)
+{
+    IrFunction *Fn = P->Fn;
+    P->SlotOf = ArenaAllocate(Fn->Arena, Fn->InsCount * sizeof *P->SlotOf);
+    P->Slots = ArenaAllocate(Fn->Arena, Fn->InsCount * sizeof *P->Slots);
+    P->SlotCount = 0;
+
+    /* open addressing, keyed by the slot itself */
+    U32 Cap = 64;
+    while (Cap < Fn->InsCount * 2)
+        Cap *= 2;
+    U32 *Table = ArenaAllocate(Fn->Arena, Cap * sizeof *Table);
+    memset(Table, 0xFF, Cap * sizeof *Table);
+
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        P->SlotOf[i] = IR_NONE;
+        UInt Base = ConstMemBase(Ins);
+        if (IR_NONE == Ins->Block || (PVM_REG_FP != Base && PVM_REG_GP != Base))
+            continue;
+
+        ConstAccess Access;
+        ConstMemAccess(Ins->Op, &Access);
+        ConstSlot Slot = {
+            .Offset = ConstMemOffset(Ins),
+            .Base = Base,
+            .Width = Access.Width,
+        };
+        U32 Hash = ((U32)Slot.Offset * 2654435761u) ^ (Slot.Base << 4) ^ Slot.Width;
+        U32 k = Hash & (Cap - 1);
+        while (IR_NONE != Table[k])
+        {
+            const ConstSlot *Other = &P->Slots[Table[k]];
+            if (Other->Offset == Slot.Offset && Other->Base == Slot.Base && Other->Width == Slot.Width)
+                break;
+            k = (k + 1) & (Cap - 1);
+        }
+        if (IR_NONE == Table[k])
+        {
+            Table[k] = P->SlotCount;
+            P->Slots[P->SlotCount++] = Slot;
+        }
+        P->SlotOf[i] = Table[k];
+    }
+}
+
+static void ConstForgetMemory(ConstProp *P)
+{
+    for (U32 i = 0; i < P->SlotCount; i++)
+        P->Mem[i] = sVarying;
+}
+
+static void ConstStore(ConstProp *P, U32 Slot, ConstLattice Value)
+{
+    /* what overlaps it is now only partly known */
+    const ConstSlot *S = &P->Slots[Slot];
+    for (U32 i = 0; i < P->SlotCount; i++)
+    {
+        const ConstSlot *Other = &P->Slots[i];
+        if (Other->Base == S->Base
+        && (I64)Other->Offset < (I64)S->Offset + S->Width
+        && (I64)S->Offset < (I64)Other->Offset + Other->Width)
+        {
+            P->Mem[i] = sVarying;
+        }
+    }
+    if (CONST_KNOWN == Value.State && S->Width < 8)
+        Value.Value &= ((U64)1 << S->Width*8) - 1;
+    P->Mem[Slot] = Value;
+}
+
+static ConstLattice ConstLoad(ConstProp *P, U32 Index, IrType Type)
+{
+    const IrIns *Ins = &P->Fn->Ins[Index];
+    U32 Slot = P->SlotOf[Index];
+    ConstAccess Access;
+    if (IR_NONE == Slot || !ConstMemAccess(Ins->Op, &Access) || Access.IsFloat)
+        return sVarying;
+
+    ConstLattice Loaded = P->Mem[Slot];
+    if (CONST_KNOWN != Loaded.State)
+        return Loaded;
+    if (Access.Signed)
+        Loaded.Value = BitSex64(Loaded.Value, Access.Width*8 - 1);
+    if (IR_TYPE_I32 == Type)
+        Loaded.Value = (U32)Loaded.Value;
+    return Loaded;
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   FOLDING
+ */
+/*===============================================================================*/
+
+
+static U64 ConstImm(const IrIns *Ins)
+{
+    U64 Imm = 0;
+    for (UInt i = 1; i < Ins->Size; i++)
+        Imm |= (U64)Ins->Code[i] << (i - 1)*16;
+    switch (PVM_GET_IMMTYPE(Ins->Code[0]))
+    {
+    case IMMTYPE_I16: return BitSex64(Imm, 15);
+    case IMMTYPE_I32: return BitSex64(Imm, 31);
+    case IMMTYPE_I48: return BitSex64(Imm, 47);
+    default: return Imm;
+    }
+}
+
+/* the 4 bit immediate of movqi, addqi and the compare and branch QI versions */
+static U64 ConstQuickImm(const IrIns *Ins)
+{
+    return BitSex64(PVM_GET_RS(Ins->Code[0]), 3);
+}
+
+/* shift amount of the qsh ops, which may need the prefix */
+static UInt ConstShiftImm(const IrIns *Ins)
+{
+    return PVM_GET_RS(Ins->Code[0]) + ((Ins->Ext & PVM_EXT_S)? PVM_EXT_REG : 0);
+}
+
+/* the integer the instruction's only definition always has */
+static ConstLattice ConstFold(ConstProp *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    IrIns *Ins = &Fn->Ins[Index];
+    if (1 != Ins->DefCount || IR_NONE == Ins->Def[0].Value
+    || (Ins->Flags & (IR_INS_CALL | IR_INS_SIDE_EFFECT)))
+    {
+        return sVarying;
+    }
+    IrType Type = Fn->Values[Ins->Def[0].Value].Type;
+    if (IR_TYPE_F32 == Type || IR_TYPE_F64 == Type)
+        return sVarying;
+    if (Ins->Flags & IR_INS_LOAD)
+        return ConstLoad(P, Index, Type);
+
+    ConstLattice In[2] = { ConstKnown(0), ConstKnown(0) };
+    bool Unknown = false;
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        ConstLattice Operand = ConstOf(P, &Ins->Use[i]);
+        if (CONST_VARYING == Operand.State)
+            return sVarying;
+        Unknown = Unknown || CONST_UNKNOWN == Operand.State;
+        if (i < 2)
+            In[i] = Operand;
+    }
+    if (Unknown)
+        return sUnknown;
+
+    /* Rd op Rs for two operands, Rs op Rt for three */
+    U64 A = In[0].Value, B = In[1].Value;
+    U64 R;
+    switch ((PVMOp)Ins->Op)
+    {
+    case OP_ADD: case OP_ADD3:      R = (U32)(A + B); break;
+    case OP_SUB: case OP_SUB3:      R = (U32)(A - B); break;
+    case OP_MUL: case OP_MUL3:
+    case OP_IMUL: case OP_IMUL3:    R = (U32)(A * B); break;
+    case OP_AND: case OP_AND3:      R = (U32)(A & B); break;
+    case OP_OR: case OP_OR3:        R = (U32)(A | B); break;
+    case OP_XOR: case OP_XOR3:      R = (U32)(A ^ B); break;
+    case OP_VSHL: case OP_VSHL3:    R = (U32)((U32)A << (B & 0x1F)); break;
+    case OP_VSHR: case OP_VSHR3:    R = (U32)A >> (B & 0x1F); break;
+    case OP_VASR: case OP_VASR3:    R = (U32)((I32)A >> (B & 0x1F)); break;
+    case OP_NEG:                    R = (U32)-A; break;
+    case OP_NOT:                    R = (U32)~A; break;
+    case OP_SETEZ:                  R = 0 == (U32)A; break;
+    case OP_ADDI:                   R = (U32)(A + ConstImm(Ins)); break;
+    case OP_ADDQI:                  R = (U32)(A + ConstQuickImm(Ins)); break;
+    case OP_QSHL:                   R = (U32)((U32)A << (ConstShiftImm(Ins) & 0x1F)); break;
+    case OP_QSHR:                   R = (U32)A >> (ConstShiftImm(Ins) & 0x1F); break;
+    case OP_QASR:                   R = (U32)((I32)A >> (ConstShiftImm(Ins) & 0x1F)); break;
+
+    case OP_ADD64: case OP_ADD3_64:     R = A + B; break;
+    case OP_SUB64: case OP_SUB3_64:     R = A - B; break;
+    case OP_MUL64: case OP_MUL3_64:
+    case OP_IMUL64: case OP_IMUL3_64:   R = A * B; break;
+    case OP_AND64: case OP_AND3_64:     R = A & B; break;
+    case OP_OR64: case OP_OR3_64:       R = A | B; break;
+    case OP_XOR64: case OP_XOR3_64:     R = A ^ B; break;
+    case OP_VSHL64: case OP_VSHL3_64:   R = A << (B & 0x3F); break;
+    case OP_VSHR64: case OP_VSHR3_64:   R = A >> (B & 0x3F); break;
+    case OP_VASR64: case OP_VASR3_64:   R = (I64)A >> (B & 0x3F); break;
+    case OP_NEG64:                      R = -A; break;
+    case OP_NOT64:                      R = ~A; break;
+    case OP_SETEZ64:                    R = 0 == A; break;
+    case OP_ADDI64:                     R = A + ConstImm(Ins); break;
+    case OP_ADDQI64:                    R = A + ConstQuickImm(Ins); break;
+    case OP_QSHL64:                     R = A << (ConstShiftImm(Ins) & 0x3F); break;
+    case OP_QSHR64:                     R = A >> (ConstShiftImm(Ins) & 0x3F); break;
+    case OP_QASR64:                     R = (I64)A >> (ConstShiftImm(Ins) & 0x3F); break;
+
+    case OP_SEQ:    R = (U32)A == (U32)B; break;
+    case OP_SLT:    R = (U32)A < (U32)B; break;
+    case OP_ISLT:   R = (I32)A < (I32)B; break;
+    case OP_SEQ64:  R = A == B; break;
+    case OP_SLT64:  R = A < B; break;
+    case OP_ISLT64: R = (I64)A < (I64)B; break;
+    case OP_GETFLAG:    R = A; break;
+    case OP_SETFLAG:    R = 0 != (U32)A; break;
+    case OP_SETNFLAG:   R = 0 == (U32)A; break;
+    case OP_NEGFLAG:    R = !A; break;
+
+    case OP_MOV32:          R = (U32)A; break;
+    case OP_MOVZEX32_8:     R = (U8)A; break;
+    case OP_MOVZEX32_16:    R = (U16)A; break;
+    case OP_MOV64:          R = A; break;
+    case OP_MOVZEX64_8:     R = (U8)A; break;
+    case OP_MOVZEX64_16:    R = (U16)A; break;
+    case OP_MOVZEX64_32:    R = (U32)A; break;
+    case OP_MOVSEX64_32:    R = (I64)(I32)A; break;
+    case OP_MOVI:           R = ConstImm(Ins); break;
+    case OP_MOVQI:          R = ConstQuickImm(Ins); break;
+    default: return sVarying;
+    }
+    return ConstKnown(R);
+}
+
+/* whether a conditional branch is taken, as a known 0 or 1 */
+static ConstLattice ConstBranch(ConstProp *P, IrIns *Ins)
+{
+    PVMOp Op = Ins->Op;
+    bool IsQuick = OP_BEQQI <= Op && Op <= OP_IBGEQI64;
+    bool IsCompare = OP_BEQ <= Op && Op <= OP_IBGE64;
+    if (OP_BEZ != Op && OP_BNZ != Op && OP_BCT != Op && OP_BCF != Op && !IsQuick && !IsCompare)
+        return sVarying;
+
+    ConstLattice A = ConstOf(P, &Ins->Use[0]);
+    ConstLattice B = IsCompare
+        ? ConstOf(P, &Ins->Use[1])
+        : ConstKnown(ConstQuickImm(Ins));
+    if (CONST_VARYING == A.State || CONST_VARYING == B.State)
+        return sVarying;
+    if (CONST_UNKNOWN == A.State || CONST_UNKNOWN == B.State)
+        return sUnknown;
+
+    switch (Op)
+    {
+    case OP_BEZ: return ConstKnown(0 == (U32)A.Value);
+    case OP_BNZ: return ConstKnown(0 != (U32)A.Value);
+    case OP_BCT: return ConstKnown(0 != A.Value);
+    case OP_BCF: return ConstKnown(0 == A.Value);
+    default: break;
+    }
+
+    /* beq, bne, blt, bge, iblt, ibge, then the same for 64 bits */
+    UInt Index = IsQuick? Op - OP_BEQQI : Op - OP_BEQ;
+    bool Is64 = Index >= 6;
+    U64 X = A.Value, Y = B.Value;
+    if (!Is64)
+    {
+        X = (U32)X;
+        Y = (U32)Y;
+    }
+    I64 SX = Is64? (I64)X : (I32)X;
+    I64 SY = Is64? (I64)Y : (I32)Y;
+    bool Taken = false;
+    switch (Index % 6)
+    {
+    case 0: Taken = X == Y; break;
+    case 1: Taken = X != Y; break;
+    case 2: Taken = X < Y; break;
+    case 3: Taken = X >= Y; break;
+    case 4: Taken = SX < SY; break;
+    case 5: Taken = SX >= SY; break;
+    }
+    return ConstKnown(Taken);
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   PROPAGATION
+ */
+/*===============================================================================*/
+
+
+static void ConstMarkEdge(ConstProp *P, U32 Block, UInt Which)
+{
+    U32 To = P->Fn->Blocks[Block].Succ[Which];
+    if (IR_NONE == To || (P->EdgeLive[Block] & (1 << Which)))
+        return;
+    P->EdgeLive[Block] |= 1 << Which;
+    P->Executable[To] = true;
+    P->Changed = true;
+}
+
+static void ConstVisitBlock(ConstProp *P, U32 Block)
+{
+    IrFunction *Fn = P->Fn;
+    const IrBlock *B = &Fn->Blocks[Block];
+
+    /* memory at the start, from the edges that can be taken */
+    if (0 == Block)
+        ConstForgetMemory(P);
+    else
+    {
+        for (U32 i = 0; i < P->SlotCount; i++)
+            P->Mem[i] = sUnknown;
+        for (U32 i = 0; i < B->PredCount; i++)
+        {
+            U32 Pred = B->Pred[i];
+            if (!ConstEdgeLive(P, Pred, Block))
+                continue;
+            const ConstLattice *Out = &P->MemOut[Pred*P->SlotCount];
+            for (U32 k = 0; k < P->SlotCount; k++)
+                P->Mem[k] = ConstMeet(P->Mem[k], Out[k]);
+        }
+    }
+
+    for (U32 i = B->First; IR_NONE != i; i = Fn->Ins[i].Next)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_OP_PHI == Ins->Op)
+        {
+            ConstLattice Merged = sUnknown;
+            for (U32 k = 0; k < Ins->UseCount; k++)
+            {
+                if (ConstEdgeLive(P, B->Pred[k], Block))
+                    Merged = ConstMeet(Merged, ConstOf(P, &Ins->Use[k]));
+            }
+            ConstLower(P, &P->Values[Ins->Def[0].Value], Merged);
+            continue;
+        }
+
+        ConstLattice Result = IR_OP_ENTRY == Ins->Op
+            ? sVarying
+            : ConstFold(P, i);
+        for (U32 k = 0; k < Ins->DefCount; k++)
+        {
+            if (IR_NONE != Ins->Def[k].Value)
+                ConstLower(P, &P->Values[Ins->Def[k].Value], 0 == k? Result : sVarying);
+        }
+
+        /* memory after it */
+        if (IR_NONE != P->SlotOf[i])
+        {
+            ConstAccess Access;
+            ConstMemAccess(Ins->Op, &Access);
+            if (Access.IsStore)
+            {
+                ConstLattice Stored = sVarying;
+                for (U32 k = 0; k < Ins->UseCount && !Access.IsFloat; k++)
+                {
+                    if (IR_SLOT_RD == Ins->Use[k].Slot)
+                        Stored = ConstOf(P, &Ins->Use[k]);
+                }
+                ConstStore(P, P->SlotOf[i], Stored);
+            }
+        }
+        else if ((Ins->Flags & IR_INS_STORE) && !ConstIsPush(Ins->Op))
+        {
+            /* through a pointer or a call */
+            ConstForgetMemory(P);
+        }
+    }
+
+    /* where it goes */
+    if (IR_NONE == B->Last)
+    {
+        ConstMarkEdge(P, Block, 0);
+    }
+    else
+    {
+        IrIns *Last = &Fn->Ins[B->Last];
+        if ((Last->Flags & IR_INS_BRANCH) && (Last->Flags & IR_INS_JUMP))
+            ConstMarkEdge(P, Block, 1);
+        else if (Last->Flags & IR_INS_BRANCH)
+        {
+            ConstLattice Taken = ConstBranch(P, Last);
+            if (CONST_VARYING == Taken.State || (CONST_KNOWN == Taken.State && !Taken.Value))
+                ConstMarkEdge(P, Block, 0);
+            if (CONST_VARYING == Taken.State || (CONST_KNOWN == Taken.State && Taken.Value))
+                ConstMarkEdge(P, Block, 1);
+        }
+        else if (0 == (Last->Flags & IR_INS_JUMP))
+            ConstMarkEdge(P, Block, 0);
+    }
+
+    ConstLattice *Out = &P->MemOut[Block*P->SlotCount];
+    for (U32 k = 0; k < P->SlotCount; k++)
+        ConstLower(P, &Out[k], P->Mem[k]);
+}
+
+
+static bool ConstRewrite(ConstProp *P)
+{
+    IrFunction *Fn = P->Fn;
+    bool Changed = false;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        if (!P->Executable[b])
+            continue;
+
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; )
+        {
+            IrIns *Ins = &Fn->Ins[i];
+            U32 Next = Ins->Next;
+            if (IR_OP_PHI == Ins->Op || IR_OP_ENTRY == Ins->Op
+            || OP_MOVI == Ins->Op || OP_MOVQI == Ins->Op
+            || 1 != Ins->DefCount || IR_SLOT_RD != Ins->Def[0].Slot || IR_NONE == Ins->Def[0].Value
+            || (Ins->Flags & (IR_INS_CALL | IR_INS_SIDE_EFFECT | IR_INS_STORE | IR_INS_BRANCH)))
+            {
+                i = Next;
+                continue;
+            }
+
+            const IrValue *Value = &Fn->Values[Ins->Def[0].Value];
+            ConstLattice Const = P->Values[Ins->Def[0].Value];
+            if (CONST_KNOWN == Const.State && (IR_TYPE_I32 == Value->Type || IR_TYPE_I64 == Value->Type))
+            {
+                /* the upper half of a 32 bit register is never relied on, the shorter encoding is used */
+                U64 Imm = IR_TYPE_I32 == Value->Type
+                    ? (U64)(I64)(I32)Const.Value
+                    : Const.Value;
+                IrSetMoveImm(Fn, i, Imm);
+                Changed = true;
+            }
+            i = Next;
+        }
+
+        U32 Last = Fn->Blocks[b].Last;
+        if (IR_NONE == Last)
+            continue;
+        IrIns *Ins = &Fn->Ins[Last];
+        if (0 == (Ins->Flags & IR_INS_BRANCH) || (Ins->Flags & IR_INS_JUMP))
+            continue;
+        ConstLattice Taken = ConstBranch(P, Ins);
+        if (CONST_KNOWN != Taken.State)
+            continue;
+        if (Taken.Value)
+            IrSetJump(Fn, Last);
+        else
+        {
+            IrRemoveIns(Fn, Last);
+            IrRemoveEdge(Fn, b, 1);
+        }
+        Changed = true;
+    }
+
+    /* the end block stays, nothing can be removed from it */
+    for (U32 b = 0; b + 1 < Fn->BlockCount; b++)
+    {
+        const IrBlock *B = &Fn->Blocks[b];
+        if (P->Executable[b] || (IR_NONE == B->First && IR_NONE == B->Succ[0] && IR_NONE == B->Succ[1]))
+            continue;
+        IrClearBlock(Fn, b);
+        Changed = true;
+    }
+    if (Changed)
+        IrSimplifyPhis(Fn);
+    return Changed;
+}
+
+
+bool IrPropagateConstants(IrFunction *Fn)
+{
+    PASCAL_NONNULL(Fn);
+
+    ConstProp P = {
+        .Fn = Fn,
+        .Values = ArenaAllocateZero(Fn->Arena, (Fn->ValueCount + 1) * sizeof *P.Values),
+        .Executable = ArenaAllocateZero(Fn->Arena, Fn->BlockCount * sizeof *P.Executable),
+        .EdgeLive = ArenaAllocateZero(Fn->Arena, Fn->BlockCount * sizeof *P.EdgeLive),
+    };
+    ConstFindSlots(&P);
+    if ((U64)P.SlotCount * Fn->BlockCount > CONST_MAX_MEMORY_CELLS)
+    {
+        /* too big to follow, loads are left as they are */
+        for (U32 i = 0; i < Fn->InsCount; i++)
+            P.SlotOf[i] = IR_NONE;
+        P.SlotCount = 0;
+    }
+    P.Mem = ArenaAllocateZero(Fn->Arena, (P.SlotCount + 1) * sizeof *P.Mem);
+    P.MemOut = ArenaAllocateZero(Fn->Arena, ((U64)P.SlotCount * Fn->BlockCount + 1) * sizeof *P.MemOut);
+
+    P.Executable[0] = true;
+    do {
+        P.Changed = false;
+        for (U32 b = 0; b < Fn->BlockCount; b++)
+        {
+            if (P.Executable[b])
+                ConstVisitBlock(&P, b);
+        }
+    } while (P.Changed);
+
+    return ConstRewrite(&P);
+}
+
+
+#undef CONST_MAX_MEMORY_CELLS
+
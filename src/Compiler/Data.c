@@ -136,6 +136,43 @@ void PushSubroutineReference(PascalCompiler *Compiler,
     Compiler->SubroutineReferences.Count = Count + 1;
 }
 
+void PushSubroutineBody(PascalCompiler *Compiler, U32 *Location, bool IsNested, U64 Clobbers)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Location);
+
+    U32 Count = Compiler->SubroutineBodies.Count;
+    if (Count >= Compiler->SubroutineBodies.Cap)
+    {
+        U32 NewCap = Compiler->SubroutineBodies.Cap * 2 + 8;
+        Compiler->SubroutineBodies.Data = GPAReallocateArray(
+                &Compiler->InternalAlloc, 
+                Compiler->SubroutineBodies.Data, 
+                *Compiler->SubroutineBodies.Data, 
+                NewCap
+        );
+        Compiler->SubroutineBodies.Cap = NewCap;
+    }
+    Compiler->SubroutineBodies.Data[Count].Location = Location;
+    Compiler->SubroutineBodies.Data[Count].End = EMITTER()->Chunk->Count;
+    Compiler->SubroutineBodies.Data[Count].Clobbers = Clobbers;
+    Compiler->SubroutineBodies.Data[Count].IsNested = IsNested;
+    Compiler->SubroutineBodies.Count = Count + 1;
+}
+
+U64 SubroutineClobbers(const PascalCompiler *Compiler, const U32 *Location)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Location);
+
+    for (U32 i = 0; i < Compiler->SubroutineBodies.Count; i++)
+    {
+        if (Compiler->SubroutineBodies.Data[i].Location == Location)
+            return Compiler->SubroutineBodies.Data[i].Clobbers;
+    }
+    return UINT64_MAX;
+}
+
 void ResolveSubroutineReferences(PascalCompiler *Compiler)
 {
     PASCAL_NONNULL(Compiler);
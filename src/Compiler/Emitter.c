@@ -1,5 +1,6 @@
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "Compiler/Emitter.h"
 #include "Compiler/Data.h"
@@ -14,13 +15,13 @@
 PASCAL_STATIC_ASSERT(IS_POW2(sizeof(PVMGPR)), "Unreachable");
 
 #if UINTPTR_MAX == UINT32_MAX
-#  define CASE_PTR32(Colon) case TYPE_POINTER Colon case TYPE_FUNCTION Colon
+#  define CASE_PTR32(Colon) case TYPE_POINTER Colon case TYPE_FUNCTION Colon case TYPE_FILE Colon
 #  define CASE_PTR64(Colon)
 #  define CASE_OBJREF32(Colon) case TYPE_STRING Colon case TYPE_RECORD Colon case TYPE_STATIC_ARRAY Colon
 #  define CASE_OBJREF64(Colon)
 #else
 #  define CASE_PTR32(Colon)
-#  define CASE_PTR64(Colon) case TYPE_POINTER Colon case TYPE_FUNCTION Colon
+#  define CASE_PTR64(Colon) case TYPE_POINTER Colon case TYPE_FUNCTION Colon case TYPE_FILE Colon
 #  define CASE_OBJREF32(Colon)
 #  define CASE_OBJREF64(Colon) case TYPE_STRING Colon case TYPE_RECORD Colon case TYPE_STATIC_ARRAY Colon
 #endif
@@ -44,8 +45,9 @@ PVMEmitter PVMEmitterInit(PVMChunk *Chunk)
     PVMEmitter Emitter = {
         .Chunk = Chunk,
         .Reglist = EMPTY_REGLIST,
-        .SpilledIntRegs = 0,
-        .SpilledFltRegs = 0,
+        .Spills = NULL,
+        .SpillCount = 0,
+        .SpillCap = 0,
         .Reg = {
             .SP = VAR_LOCATION_REG(
                 PVM_REG_SP, true, 
@@ -70,6 +72,8 @@ PVMEmitter PVMEmitterInit(PVMChunk *Chunk)
             VarTypeInit(TYPE_INVALID, 0)
         ),
         .ShouldEmit = true,
+        .LastCompare = UINT32_MAX,
+        .LastLiteral = UINT32_MAX,
     };
     return Emitter;
 }
@@ -80,6 +84,9 @@ void PVMEmitterDeinit(PVMEmitter *Emitter)
     PVMEmitExit(Emitter);
     bool ShouldPreserveFunctions = false;
     PVMEmitterReset(Emitter, ShouldPreserveFunctions);
+    MemDeallocateArray(Emitter->Spills);
+    Emitter->Spills = NULL;
+    Emitter->SpillCap = 0;
 }
 
 static PVMChunk *PVMCurrentChunk(PVMEmitter *Emitter)
@@ -93,9 +100,12 @@ void PVMEmitterReset(PVMEmitter *Emitter, bool PreserveFunctions)
     ChunkReset(PVMCurrentChunk(Emitter), PreserveFunctions);
     Emitter->Reglist = EMPTY_REGLIST;
     Emitter->StackSpace = 0;
-    Emitter->SpilledIntRegs = 0;
-    Emitter->SpilledFltRegs = 0;
+    Emitter->AllocationCount = 0;
+    Emitter->Pinned = 0;
+    Emitter->SpillCount = 0;
     Emitter->SpilledRegSpace = 0;
+    Emitter->LastCompare = UINT32_MAX;
+    Emitter->LastLiteral = UINT32_MAX;
 }
 
 
@@ -103,15 +113,16 @@ void PVMEmitterReset(PVMEmitter *Emitter, bool PreserveFunctions)
 
 
 
-static U32 WriteOp16(PVMEmitter *Emitter, U16 Opcode)
+/* Opcode may carry extension bits from PVM_OP and friends, the prefix is written first and its location returned */
+static U32 WriteOp16(PVMEmitter *Emitter, U32 Opcode)
 {
     PASCAL_NONNULL(Emitter);
     if (!Emitter->ShouldEmit) 
         return PVMCurrentChunk(Emitter)->Count;
-    return ChunkWriteCode(PVMCurrentChunk(Emitter), Opcode);
+    return ChunkWriteOp(PVMCurrentChunk(Emitter), Opcode);
 }
 
-static U32 WriteOp32(PVMEmitter *Emitter, U16 Opcode, U16 SecondHalf)
+static U32 WriteOp32(PVMEmitter *Emitter, U32 Opcode, U16 SecondHalf)
 {
     PASCAL_NONNULL(Emitter);
     U32 Location = WriteOp16(Emitter, Opcode);
@@ -121,7 +132,7 @@ static U32 WriteOp32(PVMEmitter *Emitter, U16 Opcode, U16 SecondHalf)
 
 static U32 Write32(PVMEmitter *Emitter, U32 DWord)
 {
-    return WriteOp32(Emitter, DWord, DWord >> 16);
+    return WriteOp32(Emitter, (U16)DWord, DWord >> 16);
 }
 
 void PVMEmitMoveImm(PVMEmitter *Emitter, VarRegister Reg, I64 Imm)
@@ -142,16 +153,16 @@ bool PVMRegisterIsFree(PVMEmitter *Emitter, UInt Reg)
 static void PVMMarkRegisterAsAllocated(PVMEmitter *Emitter, UInt Reg)
 {
     PASCAL_NONNULL(Emitter);
-    if (PVM_REG_COUNT + PVM_FREG_COUNT >= Reg)
+    if (PVM_REG_COUNT + PVM_FREG_COUNT > Reg)
     {
-        Emitter->Reglist |= (U32)1 << Reg;
+        Emitter->Reglist |= (U64)1 << Reg;
     }
 }
 
 static void PVMMarkRegisterAsFreed(PVMEmitter *Emitter, UInt Reg)
 {
     PASCAL_NONNULL(Emitter);
-    Emitter->Reglist &= ~((U32)1 << Reg);
+    Emitter->Reglist &= ~((U64)1 << Reg);
 }
 
 
@@ -159,18 +170,16 @@ static U32 PVMCreateRegListLocation(PVMEmitter *Emitter,
         SaveRegInfo Info, U32 Location[PVM_REG_COUNT + PVM_FREG_COUNT])
 {
     U32 Size = 0;
-    for (int i = STATIC_ARRAY_SIZE(Info.RegLocation) - 1; i >= 0; i--)
+    /* in the order they are pushed */
+    for (UInt i = 0; i < STATIC_ARRAY_SIZE(Info.RegLocation); i++)
     {
         if ((Info.Regs >> i) & 0x1)
         {
             /* free registers that are not in EMPTY_REGLIST */
-            /* freeing bc those regs now live on the stack */
+            /* freeing bc those regs now live on the stack, 
+             * what was spilled from them stays in its slot until they are popped */
             Location[i] = Emitter->StackSpace;
-            VarRegister Register = {
-                .ID = i,
-                .Persistent = EMPTY_REGLIST & ((U32)1 << i),
-            };
-            PVMFreeRegister(Emitter, Register);
+            PVMMarkRegisterAsFreed(Emitter, i);
             Emitter->StackSpace += sizeof(PVMGPR);
             Size += sizeof(PVMGPR);
         }
@@ -179,28 +188,34 @@ static U32 PVMCreateRegListLocation(PVMEmitter *Emitter,
 }
 
 
-static SaveRegInfo PVMEmitPushRegList(PVMEmitter *Emitter, U32 RegList)
+/* Bank is a group of 8 registers in a register list: 
+ * 0: R0-R7, 1: R8-R15, 2: R16-R23, 3: R24-R31, then 4-7 are the same for F, 
+ * banks 2, 3, 6 and 7 need the extension prefix */
+static void PVMEmitRegListBank(PVMEmitter *Emitter, U64 RegList, UInt Bank, bool Push)
+{
+    static const PVMOp PushOps[] = { OP_PSHL, OP_PSHH, OP_FPSHL, OP_FPSHH };
+    static const PVMOp PopOps[] = { OP_POPL, OP_POPH, OP_FPOPL, OP_FPOPH };
+    U32 List = (RegList >> Bank*8) & 0xFF;
+    if (0 == List)
+        return;
+
+    UInt Index = (Bank & 1) | (Bank >> 2) << 1;
+    U32 Ext = (Bank & 2)? (U32)PVM_EXT_S << 16 : 0;
+    PVMOp Op = Push? PushOps[Index] : PopOps[Index];
+    WriteOp16(Emitter, BIT_POS32(Op, 8, 8) | BIT_POS32(List, 8, 0) | Ext);
+}
+
+static SaveRegInfo PVMEmitPushRegList(PVMEmitter *Emitter, U64 RegList)
 {
     SaveRegInfo Info = {
         .Regs = RegList,
         .Size = sizeof(PVMGPR) * BitCount(RegList),
+        .StackSpace = Emitter->StackSpace,
         .RegLocation = { 0 },
     };
-    if (Info.Regs & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(PSHL, Info.Regs & 0xFF));
-    }
-    if ((Info.Regs >> 8) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(PSHH, Info.Regs >> 8));
-    }
-    if ((Info.Regs >> 16) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPSHL, Info.Regs >> 16));
-    }
-    if ((Info.Regs >> 24) & 0xFF)
+    for (UInt Bank = 0; Bank < 8; Bank++)
     {
-        WriteOp16(Emitter, PVM_REGLIST(FPSHH, Info.Regs >> 24));
+        PVMEmitRegListBank(Emitter, Info.Regs, Bank, true);
     }
 
     PVMCreateRegListLocation(Emitter, Info, Info.RegLocation);
@@ -210,48 +225,14 @@ static SaveRegInfo PVMEmitPushRegList(PVMEmitter *Emitter, U32 RegList)
 static void PVMEmitPushReg(PVMEmitter *Emitter, UInt Reg)
 {
     PASCAL_NONNULL(Emitter);
-    U32 RegIndex = 1 << Reg;
-    if ((RegIndex & 0xFF))
-    {
-        WriteOp16(Emitter, PVM_REGLIST(PSHL, RegIndex));
-    }
-    else if ((RegIndex >> 8) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(PSHH, RegIndex >> 8));
-    }
-    /* floating point reg */
-    else if ((RegIndex >> 16) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPSHL, RegIndex >> 16));
-    }
-    else 
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPSHH, RegIndex >> 24));
-    }
+    PVMEmitRegListBank(Emitter, (U64)1 << Reg, Reg / 8, true);
     Emitter->StackSpace += sizeof(PVMGPR);
 }
 
 static void PVMEmitPopReg(PVMEmitter *Emitter, UInt Reg)
 {
     PASCAL_NONNULL(Emitter);
-    U32 RegIndex = 1 << Reg;
-    if (RegIndex & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(POPL, RegIndex));
-    }
-    else if ((RegIndex >> 8) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(POPH, RegIndex >> 8));
-    }
-    /* floating point reg */
-    else if ((RegIndex >> 16) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPOPL, RegIndex >> 16));
-    }
-    else 
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPOPH, RegIndex >> 24));
-    }
+    PVMEmitRegListBank(Emitter, (U64)1 << Reg, Reg / 8, false);
     Emitter->StackSpace -= sizeof(PVMGPR);
 }
 
@@ -398,7 +379,7 @@ static void MoveMemToReg(PVMEmitter *Emitter,
     case TYPE_BOOLEAN:
     case TYPE_CHAR:
     case TYPE_U8: OP(LDZEX32_8); break;
-    case TYPE_U16: OP(LDZEX32_8); break;
+    case TYPE_U16: OP(LDZEX32_16); break;
     case TYPE_F32: OP(LDF32); break;
     case TYPE_F64: OP(LDF64); break;
 
@@ -618,7 +599,10 @@ bool PVMEmitIntoReg(PVMEmitter *Emitter, VarRegister *Reg, bool ReadOnly, const
         return false;
     }
     VarRegister Tmp = PVMAllocateRegister(Emitter, Src->Type.Integral);
+    U32 Location = PVMCurrentChunk(Emitter)->Count;
     MoveLocationToReg(Emitter, Tmp, Src->Type, Src);
+    if (VAR_LIT == Src->LocationType && Emitter->ShouldEmit)
+        Emitter->LastLiteral = Location;
     *Reg = Tmp;
     return true;
 }
@@ -679,6 +663,9 @@ void PVMUpdateDebugInfo(PVMEmitter *Emitter, U32 LineLen, bool IsSubroutine)
 U32 PVMGetCurrentLocation(PVMEmitter *Emitter)
 {
     PASCAL_NONNULL(Emitter);
+    /* might become a branch target, nothing before it can be merged with what comes after */
+    Emitter->LastCompare = UINT32_MAX;
+    Emitter->LastLiteral = UINT32_MAX;
     return PVMCurrentChunk(Emitter)->Count;
 }
 
@@ -687,84 +674,125 @@ U32 PVMGetCurrentLocation(PVMEmitter *Emitter)
 
 
 
-static UInt AllocateRegister(PVMEmitter *Emitter, UInt Base, I32 *SpilledCount, 
-    I32 *SpilledLocation, USize SpilledLocationSize)
+/* spill slots are counted down from the top of the frame, SP has moved on since by what was pushed */
+static VarMemory SpillSlot(PVMEmitter *Emitter, U32 Slot)
 {
-    for (UInt i = Base; i < Base + PVM_REG_COUNT; i++)
+    VarMemory Memory = {
+        .RegPtr = Emitter->Reg.SP.As.Register,
+        .Location = -(I32)(Slot * sizeof(PVMGPR)) - (I32)Emitter->StackSpace,
+    };
+    return Memory;
+}
+
+static VarType SpillType(UInt Reg)
+{
+    return Reg < PVM_REG_COUNT
+        ? VarTypeInit(TYPE_U64, sizeof(PVMGPR))
+        : VarTypeInit(TYPE_F64, sizeof(PVMGPR));
+}
+
+/* the lowest slot no spill is using */
+static U32 FreeSpillSlot(const PVMEmitter *Emitter)
+{
+    U32 Slot = 0;
+    bool Taken = true;
+    while (Taken)
     {
-        if (PVMRegisterIsFree(Emitter, i))
+        Taken = false;
+        for (U32 i = 0; i < Emitter->SpillCount && !Taken; i++)
+            Taken = Emitter->Spills[i].Slot == Slot;
+        Slot += Taken;
+    }
+    return Slot;
+}
+
+/* a pushed register that is waiting to get its spilled content back once it is popped and freed */
+static bool IsWaitingForSpill(const PVMEmitter *Emitter, UInt Reg)
+{
+    if (0 == (Emitter->Reglist >> Reg & 1))
+    {
+        for (U32 i = 0; i < Emitter->SpillCount; i++)
         {
-            PVMMarkRegisterAsAllocated(Emitter, i);
-            printf("Alloc  : %d, spill: %d, list: %04x\n", i, *SpilledCount, Emitter->Reglist);
-            return i;
+            if (Emitter->Spills[i].Reg == Reg)
+                return true;
         }
     }
+    return false;
+}
 
-    I32 Offset = sizeof(PVMGPR)*(Emitter->SpilledIntRegs + Emitter->SpilledFltRegs + 1);
-    U32 Reg = *SpilledCount % PVM_REG_COUNT;
-
-    PASCAL_ASSERT(*SpilledCount < (int)SpilledLocationSize, "dynamic register spilling table?");
-
-    /* offset directly from SP, negative */
-    SpilledLocation[*SpilledCount] = -Offset;
-    (*SpilledCount) += 1;
+static UInt SpillRegister(PVMEmitter *Emitter, UInt Base)
+{
+    /* expressions are evaluated inside out, 
+     * so the register handed out the longest ago is the one needed the furthest from now */
+    UInt Reg = UINT32_MAX;
+    for (UInt i = Base; i < Base + PVM_REG_COUNT; i++)
+    {
+        bool CanSpill = 0 == (((U64)EMPTY_REGLIST | Emitter->Pinned) >> i & 1) 
+            && !IsWaitingForSpill(Emitter, i);
+        if (CanSpill && (UINT32_MAX == Reg || Emitter->AllocatedAt[i] < Emitter->AllocatedAt[Reg]))
+            Reg = i;
+    }
+    PASCAL_ASSERT(UINT32_MAX != Reg, "Every register holds a variable");
 
-    /* update space for spilled registers */
-    Emitter->SpilledRegSpace = uMax(Offset, Emitter->SpilledRegSpace);
+    if (Emitter->SpillCount == Emitter->SpillCap)
+    {
+        Emitter->SpillCap = Emitter->SpillCap? Emitter->SpillCap * 2 : PVM_REG_COUNT;
+        Emitter->Spills = MemReallocateArray(*Emitter->Spills, Emitter->Spills, Emitter->SpillCap);
+    }
+    U32 Slot = FreeSpillSlot(Emitter);
+    PVMSpill *Spill = &Emitter->Spills[Emitter->SpillCount++];
+    *Spill = (PVMSpill) {
+        .Reg = Reg,
+        .Slot = Slot,
+        .AllocatedAt = Emitter->AllocatedAt[Reg],
+    };
+    Emitter->SpilledRegSpace = uMax((Spill->Slot + 1) * sizeof(PVMGPR), Emitter->SpilledRegSpace);
 
-    /* 'push' the content of the register being spilled onto the stack */
-    VarType Type = VarTypeInit(TYPE_U64, 8);
-    MoveRegToMem(Emitter, 
-        (VarMemory) { 
-            .RegPtr = Emitter->Reg.SP.As.Register, 
-            .Location = -Offset
-        }, Type,
-        (VarRegister) { 
-            .ID = Reg 
-        }, Type
-    );
-    printf("Alloc  : %d, spill: %d (spilling), list: %04x\n", Reg, *SpilledCount, Emitter->Reglist);
+    VarType Type = SpillType(Reg);
+    MoveRegToMem(Emitter, SpillSlot(Emitter, Spill->Slot), Type, (VarRegister) { .ID = Reg }, Type);
     return Reg;
 }
 
-static void FreeRegister(PVMEmitter *Emitter, I32 *SpilledCount, I32 *SpilledLocation, int Reg)
+static UInt AllocateRegister(PVMEmitter *Emitter, UInt Base)
 {
-    /* NOTE: registers are allocated linearly, so it's fine to check the topmost register */
-    if (*SpilledCount > 0 && Reg == ((*SpilledCount - 1) % PVM_REG_COUNT)) 
+    UInt Reg = UINT32_MAX;
+    for (UInt i = Base; i < Base + PVM_REG_COUNT && UINT32_MAX == Reg; i++)
     {
-        printf("dealloc: %d, spill: %d (unspilling), list: %04x\n", Reg, *SpilledCount, Emitter->Reglist);
-        /* freeing a spilled register, get its location first */
-        int Index = --(*SpilledCount);
-        PASCAL_ASSERT(Index > -1, "Unreachable");
-
-        /* load the old content of the freed register */
-        MoveMemToReg(Emitter, 
-            (VarRegister) { 
-                .ID = Reg 
-            }, (VarMemory) {   
-                .RegPtr = Emitter->Reg.SP.As.Register, 
-                .Location = SpilledLocation[Index]
-            }, VarTypeInit(TYPE_U64, 8)
-        );
-        /* TODO: what if the caller intended to use the old content? */
-        /* NOTE: the register is still marked as allocated because it now contains 
-         * whatever content it has before being spilled */
+        if (PVMRegisterIsFree(Emitter, i) && !IsWaitingForSpill(Emitter, i))
+            Reg = i;
     }
+    if (UINT32_MAX == Reg)
+        Reg = SpillRegister(Emitter, Base);
+
+    PVMMarkRegisterAsAllocated(Emitter, Reg);
+    Emitter->AllocatedAt[Reg] = Emitter->AllocationCount++;
+    return Reg;
+}
 
-    if (Reg - PVM_REG_COUNT < *SpilledCount)
+static void FreeRegister(PVMEmitter *Emitter, UInt Reg)
+{
+    U32 i = Emitter->SpillCount;
+    while (i > 0 && Emitter->Spills[i - 1].Reg != Reg)
+        i--;
+    if (0 == i)
     {
-        printf("dealloc: %d, spill: %d, list: %04x\n", Reg, *SpilledCount, Emitter->Reglist);
         PVMMarkRegisterAsFreed(Emitter, Reg);
+        return;
     }
+
+    /* the register goes back to what it held before, and stays allocated */
+    PVMSpill Spill = Emitter->Spills[i - 1];
+    memmove(&Emitter->Spills[i - 1], &Emitter->Spills[i], (Emitter->SpillCount - i) * sizeof Spill);
+    Emitter->SpillCount--;
+    Emitter->AllocatedAt[Reg] = Spill.AllocatedAt;
+    MoveMemToReg(Emitter, (VarRegister) { .ID = Reg }, SpillSlot(Emitter, Spill.Slot), SpillType(Reg));
 }
 
 VarRegister PVMAllocateIntReg(PVMEmitter *Emitter)
 {
     PASCAL_NONNULL(Emitter);
     VarRegister Reg = {
-        .ID = AllocateRegister(Emitter, 0, &Emitter->SpilledIntRegs, 
-            Emitter->SpilledIntRegLocation, STATIC_ARRAY_SIZE(Emitter->SpilledIntRegLocation)
-        ),
+        .ID = AllocateRegister(Emitter, 0),
         .Persistent = false,
     };
     return Reg;
@@ -774,14 +802,20 @@ VarRegister PVMAllocateFltReg(PVMEmitter *Emitter)
 {
     PASCAL_NONNULL(Emitter);
     VarRegister Reg = { 
-        .ID = AllocateRegister(Emitter, PVM_REG_COUNT, &Emitter->SpilledFltRegs, 
-            Emitter->SpilledFltRegLocation, STATIC_ARRAY_SIZE(Emitter->SpilledFltRegLocation)
-        ),
+        .ID = AllocateRegister(Emitter, PVM_REG_COUNT),
         .Persistent = false,
     };
     return Reg;
 }
 
+void PVMPinRegister(PVMEmitter *Emitter, VarRegister *Reg)
+{
+    PASCAL_NONNULL(Emitter);
+    PASCAL_NONNULL(Reg);
+    Reg->Persistent = true;
+    Emitter->Pinned |= (U64)1 << Reg->ID;
+}
+
 
 VarLocation PVMAllocateRegisterLocation(PVMEmitter *Emitter, VarType Type)
 {
@@ -796,14 +830,13 @@ VarLocation PVMAllocateRegisterLocation(PVMEmitter *Emitter, VarType Type)
 void PVMFreeRegister(PVMEmitter *Emitter, VarRegister Reg)
 {
     PASCAL_NONNULL(Emitter);
-    if (Reg.ID < PVM_REG_COUNT) /* int reg */
-    {
-        FreeRegister(Emitter, &Emitter->SpilledIntRegs, Emitter->SpilledIntRegLocation, Reg.ID);
-    }
-    else /* float reg */
-    {
-        FreeRegister(Emitter, &Emitter->SpilledFltRegs, Emitter->SpilledFltRegLocation, Reg.ID - PVM_REG_COUNT);
-    }
+    PASCAL_ASSERT(Reg.ID < PVM_REG_COUNT + PVM_FREG_COUNT, "Invalid register");
+    /* SP, FP and GP stay allocated */
+    if ((U64)EMPTY_REGLIST >> Reg.ID & 1)
+        return;
+    if (Reg.Persistent)
+        Emitter->Pinned &= ~((U64)1 << Reg.ID);
+    FreeRegister(Emitter, Reg.ID);
 }
 
 
@@ -827,15 +860,160 @@ static U32 PVMEmitBranchOnTrueFlag(PVMEmitter *Emitter)
 }
 
 
+/* compare -> compare and branch, depending on whether the branch is taken when the compare sets the flag */
+static const struct {
+    U8 Compare, IfSet, IfClear;
+    bool Swap; /* of the operands */
+} sCompareAndBranch[] = {
+    { OP_SEQ, OP_BEQ, OP_BNE, false },
+    { OP_SLT, OP_BLT, OP_BGE, false },
+    { OP_ISLT, OP_IBLT, OP_IBGE, false },
+    { OP_SEQ64, OP_BEQ64, OP_BNE64, false },
+    { OP_SLT64, OP_BLT64, OP_BGE64, false },
+    { OP_ISLT64, OP_IBLT64, OP_IBGE64, false },
+
+    /* not (a < b) is not (a >= b) when either is NaN */
+    { OP_FSEQ, OP_FBEQ, OP_FBNE, false },
+    { OP_FSNE, OP_FBNE, OP_FBEQ, false },
+    { OP_FSLT, OP_FBLT, OP_FBNLT, false },
+    { OP_FSLE, OP_FBLE, OP_FBNLE, false },
+    { OP_FSGT, OP_FBLT, OP_FBNLT, true },
+    { OP_FSGE, OP_FBLE, OP_FBNLE, true },
+    { OP_FSEQ64, OP_FBEQ64, OP_FBNE64, false },
+    { OP_FSNE64, OP_FBNE64, OP_FBEQ64, false },
+    { OP_FSLT64, OP_FBLT64, OP_FBNLT64, false },
+    { OP_FSLE64, OP_FBLE64, OP_FBNLE64, false },
+    { OP_FSGT64, OP_FBLT64, OP_FBNLT64, true },
+    { OP_FSGE64, OP_FBLE64, OP_FBNLE64, true },
+};
+
+/* location of the instruction itself, Ext gets the bits of its OP_EXT prefix if it has one */
+static U32 SkipExtPrefix(const PVMChunk *Chunk, U32 Location, UInt *Ext)
+{
+    *Ext = 0;
+    if (Location < Chunk->Count && OP_EXT == PVM_GET_OP(Chunk->Code[Location]))
+    {
+        *Ext = PVM_GET_EXT(Chunk->Code[Location]);
+        return Location + 1;
+    }
+    return Location;
+}
+
+static bool DebugInfoStartsAfter(PVMChunk *Chunk, U32 Location)
+{
+    const LineDebugInfo *Info = ChunkGetDebugInfo(Chunk, UINT32_MAX);
+    return NULL != Info && Info->StreamOffset > Location;
+}
+
+/* 
+ * rewrites the compare right before the current location into a compare and branch, 
+ * a literal that was loaded into a now free register just for the compare becomes its immediate. 
+ * Returns UINT32_MAX if there was nothing to rewrite 
+ */
+static U32 PVMEmitCompareAndBranch(PVMEmitter *Emitter, bool BranchIfSet)
+{
+    PVMChunk *Chunk = PVMCurrentChunk(Emitter);
+    U32 At = Emitter->LastCompare;
+    UInt Ext;
+    if (!Emitter->ShouldEmit || UINT32_MAX == At 
+    || SkipExtPrefix(Chunk, At, &Ext) + 1 != Chunk->Count)
+        return UINT32_MAX;
+
+    U16 Compare = Chunk->Code[Chunk->Count - 1];
+    UInt Entry = 0;
+    while (Entry < STATIC_ARRAY_SIZE(sCompareAndBranch) 
+    && sCompareAndBranch[Entry].Compare != PVM_GET_OP(Compare))
+    {
+        Entry++;
+    }
+    if (Entry == STATIC_ARRAY_SIZE(sCompareAndBranch))
+        return UINT32_MAX;
+
+    UInt Rd = PVM_GET_RD(Compare) + ((Ext & PVM_EXT_D)? PVM_EXT_REG : 0);
+    UInt Rs = PVM_GET_RS(Compare) + ((Ext & PVM_EXT_S)? PVM_EXT_REG : 0);
+    if (sCompareAndBranch[Entry].Swap)
+    {
+        UInt Tmp = Rd;
+        Rd = Rs;
+        Rs = Tmp;
+    }
+    PVMOp Op = BranchIfSet 
+        ? sCompareAndBranch[Entry].IfSet 
+        : sCompareAndBranch[Entry].IfClear;
+
+    U32 Start = At;
+    bool Fold = false;
+    U32 Literal = Emitter->LastLiteral;
+    UInt LiteralExt = 0;
+    bool HasLiteral = UINT32_MAX != Literal 
+        && SkipExtPrefix(Chunk, Literal, &LiteralExt) + 1 == At
+        && OP_MOVQI == PVM_GET_OP(Chunk->Code[At - 1]);
+    UInt LiteralReg = HasLiteral
+        ? PVM_GET_RD(Chunk->Code[At - 1]) + ((LiteralExt & PVM_EXT_D)? PVM_EXT_REG : 0)
+        : 0;
+    if (HasLiteral && Rd != Rs
+    && OP_BEQ <= Op && Op <= OP_IBGE64
+    && PVMRegisterIsFree(Emitter, LiteralReg))
+    {
+        I32 Imm = BIT_SEX32(PVM_GET_RS(Chunk->Code[At - 1]), 3);
+        bool IsEquality = OP_BEQ == Op || OP_BNE == Op || OP_BEQ64 == Op || OP_BNE64 == Op;
+        bool IsSigned = OP_IBLT == Op || OP_IBGE == Op || OP_IBLT64 == Op || OP_IBGE64 == Op;
+        Fold = LiteralReg == Rs;
+        if (LiteralReg == Rd && IsEquality)
+        {
+            Rd = Rs;
+            Fold = true;
+        }
+        else if (LiteralReg == Rd && Imm < 7 && (IsSigned || -1 != Imm))
+        {
+            /* Imm < Rs is not (Rs < Imm + 1) */
+            Rd = Rs;
+            Imm += 1;
+            Op = BranchIfSet 
+                ? sCompareAndBranch[Entry].IfClear 
+                : sCompareAndBranch[Entry].IfSet;
+            Fold = true;
+        }
+
+        if (Fold)
+        {
+            Start = Literal;
+            Rs = Imm & 0xF;
+            Op += OP_BEQQI - OP_BEQ;
+        }
+    }
+
+    /* a line starting in the middle of the new instruction */
+    if (DebugInfoStartsAfter(Chunk, Start))
+        return UINT32_MAX;
+
+    Chunk->Count = Start;
+    Emitter->LastCompare = UINT32_MAX;
+    Emitter->LastLiteral = UINT32_MAX;
+    U32 RegExt = PVM_EXT(Rd, PVM_EXT_D) | (Fold? 0 : PVM_EXT(Rs, PVM_EXT_S));
+    U32 Location = WriteOp16(Emitter, BIT_POS32(Op, 8, 8) | BIT_POS32(Rd, 4, 4) | BIT_POS32(Rs, 4, 0) | RegExt);
+    Write32(Emitter, 0);
+    return Location;
+}
+
+static U32 PVMEmitBranchOnFlag(PVMEmitter *Emitter, bool BranchIfSet)
+{
+    U32 Location = PVMEmitCompareAndBranch(Emitter, BranchIfSet);
+    if (UINT32_MAX != Location)
+        return Location;
+    return BranchIfSet
+        ? PVMEmitBranchOnTrueFlag(Emitter)
+        : PVMEmitBranchOnFalseFlag(Emitter);
+}
+
+
 U32 PVMEmitBranchIfFalse(PVMEmitter *Emitter, const VarLocation *Condition)
 {
     PASCAL_NONNULL(Emitter);
     PASCAL_NONNULL(Condition);
     if (VAR_FLAG == Condition->LocationType)
     {
-        return Condition->As.FlagValueAsIs? 
-            PVMEmitBranchOnFalseFlag(Emitter) 
-            : PVMEmitBranchOnTrueFlag(Emitter);
+        return PVMEmitBranchOnFlag(Emitter, !Condition->As.FlagValueAsIs);
     }
 
     VarRegister Test;
@@ -854,9 +1032,7 @@ U32 PVMEmitBranchIfTrue(PVMEmitter *Emitter, const VarLocation *Condition)
     PASCAL_NONNULL(Condition);
     if (VAR_FLAG == Condition->LocationType)
     {
-        return Condition->As.FlagValueAsIs? 
-            PVMEmitBranchOnTrueFlag(Emitter)
-            : PVMEmitBranchOnFalseFlag(Emitter);
+        return PVMEmitBranchOnFlag(Emitter, Condition->As.FlagValueAsIs);
     }
 
     VarRegister Test;
@@ -870,11 +1046,28 @@ U32 PVMEmitBranchIfTrue(PVMEmitter *Emitter, const VarLocation *Condition)
 }
 
 
+U32 PVMEmitBranchIfFalseKeepFlag(PVMEmitter *Emitter, const VarLocation *Condition)
+{
+    PASCAL_NONNULL(Emitter);
+    Emitter->LastCompare = UINT32_MAX;
+    return PVMEmitBranchIfFalse(Emitter, Condition);
+}
+
+U32 PVMEmitBranchIfTrueKeepFlag(PVMEmitter *Emitter, const VarLocation *Condition)
+{
+    PASCAL_NONNULL(Emitter);
+    Emitter->LastCompare = UINT32_MAX;
+    return PVMEmitBranchIfTrue(Emitter, Condition);
+}
+
+
 U32 PVMEmitBranchAndInc(PVMEmitter *Emitter, VarRegister Reg, I8 Imm, U32 To)
 {
     PASCAL_NONNULL(Emitter);
-    I32 Offset = To - PVMCurrentChunk(Emitter)->Count - PVM_BRANCH_INS_SIZE;
-    return WriteOp32(Emitter, PVM_OP(BRI, Reg.ID, Imm), Offset);
+    U32 Opcode = PVM_OP(BRI, Reg.ID, Imm);
+    /* the offset is from the end of the instruction, prefix included */
+    I32 Offset = To - PVMCurrentChunk(Emitter)->Count - PVM_BRANCH_INS_SIZE - (PVM_EXT_OF(Opcode)? 1 : 0);
+    return WriteOp32(Emitter, Opcode, Offset);
 }
 
 
@@ -893,7 +1086,27 @@ void PVMPatchBranch(PVMEmitter *Emitter, U32 From, U32 To)
         return;
 
     U16 *Code = &PVMCurrentChunk(Emitter)->Code[From];
+    if (OP_EXT == PVM_GET_OP(*Code))
+    {
+        /* offsets are from the end of the instruction, the prefix does not change them */
+        Code++;
+        From++;
+    }
     I32 Offset = To - From;
+    if (To > Emitter->LastCompare)
+        Emitter->LastCompare = UINT32_MAX;
+    if (To > Emitter->LastLiteral)
+        Emitter->LastLiteral = UINT32_MAX;
+
+    /* compare and branch */
+    if (OP_BEQ <= PVM_GET_OP(*Code) && PVM_GET_OP(*Code) <= OP_FBNLE64)
+    {
+        /* 0xCCRR 0xIIII 0xIIII */
+        Offset -= PVM_CMP_BRANCH_INS_SIZE;
+        Code[1] = Offset;
+        Code[2] = Offset >> 16;
+        return;
+    }
 
     /*
      *  C: opcode
@@ -906,7 +1119,7 @@ void PVMPatchBranch(PVMEmitter *Emitter, U32 From, U32 To)
     {
         /* i: increment immediate */
         /* 0xCCRi 0xIIII */
-        Offset -= 1;
+        Offset -= 2;
         Code[1] = Offset;
     } break;
     
@@ -1032,8 +1245,9 @@ U32 PVMEmitLoadSubroutineAddr(PVMEmitter *Emitter, VarRegister Dst, U32 Subrouti
 {
     PASCAL_NONNULL(Emitter);
     const PVMImmType ImmType = IMMTYPE_I32;
-    I32 Offset = SubroutineAddr - (PVMGetCurrentLocation(Emitter) + 3);
-    U32 Location = WriteOp16(Emitter, PVM_IMM_OP(LDRIP, Dst.ID, ImmType));
+    U32 Opcode = PVM_IMM_OP(LDRIP, Dst.ID, ImmType);
+    I32 Offset = SubroutineAddr - (PVMGetCurrentLocation(Emitter) + 3 + (PVM_EXT_OF(Opcode)? 1 : 0));
+    U32 Location = WriteOp16(Emitter, Opcode);
     Write32(Emitter, Offset);
     return Location;
 }
@@ -1064,7 +1278,7 @@ VarLocation PVMEmitLoadArrayElement(PVMEmitter *Emitter, const VarLocation *Arra
 
     /* Add the base register from array */
     UInt ArrayBasePtr = Array->As.Memory.RegPtr.ID;
-    U16 AddOpcode = (UINTPTR_MAX == UINT16_MAX)
+    U32 AddOpcode = (UINTPTR_MAX == UINT16_MAX)
         ? PVM_OP(ADD64, ScaledIndex.ID, ArrayBasePtr)
         : PVM_OP(ADD, ScaledIndex.ID, ArrayBasePtr);
     WriteOp16(Emitter, AddOpcode);
@@ -1350,7 +1564,7 @@ void PVMEmitAddImm(PVMEmitter *Emitter, VarRegister Dst, IntegralType DstType, I
     {
         if (IS_SMALL_IMM(Imm))
         {
-            OP32_OR_OP64(Emitter, ADDI, Oper64, Dst.ID, Imm);
+            OP32_OR_OP64(Emitter, ADDQI, Oper64, Dst.ID, Imm & 0xF);
         }
         else if (IN_I16(Imm))
         {
@@ -1366,7 +1580,7 @@ void PVMEmitAddImm(PVMEmitter *Emitter, VarRegister Dst, IntegralType DstType, I
         {
             OP32_OR_OP64(Emitter, ADDI, Oper64, Dst.ID, IMMTYPE_I48);
             Write32(Emitter, (U32)Imm);
-            WriteOp16(Emitter, (U64)Imm >> 32);
+            WriteOp16(Emitter, (U16)((U64)Imm >> 32));
         }
         else 
         {
@@ -1391,7 +1605,7 @@ void PVMEmitAddImm(PVMEmitter *Emitter, VarRegister Dst, IntegralType DstType, I
         {
             OP32_OR_OP64(Emitter, ADDI, Oper64, Dst.ID, IMMTYPE_U48);
             Write32(Emitter, (U32)Imm);
-            WriteOp16(Emitter, (U64)Imm >> 32);
+            WriteOp16(Emitter, (U16)((U64)Imm >> 32));
         }
         else 
         {
@@ -1429,7 +1643,7 @@ void PVMEmitAdd(PVMEmitter *Emitter, VarRegister Dst, const VarLocation *Src)
     if (VAR_LIT == Src->LocationType && IntegralTypeIsOrdinal(SrcType))
     {
         PVMEmitAddImm(Emitter, Dst, SrcType,
-            -OrdinalLiteralToI64(Src->As.Literal, SrcType)
+            OrdinalLiteralToI64(Src->As.Literal, SrcType)
         );
         return;
     }
@@ -1698,18 +1912,100 @@ DEFINE_INTEGER_BINARY_OP(PVMEmitXor, XOR);
 DEFINE_INTEGER_BINARY_OP(PVMEmitMod, MOD);
 
 
+/* returns OP_SYS if Operator has no three-operand instruction for Type */
+static PVMOp ThreeOperandOp(TokenType Operator, IntegralType Type)
+{
+#define SELECT(Op32, Op64) (Oper64? OP_ ## Op64 : OP_ ## Op32)
+    bool Oper64 = OperandIs64(Type);
+    if (IntegralTypeIsFloat(Type))
+    {
+        switch (Operator)
+        {
+        case TOKEN_PLUS:    return SELECT(FADD3, FADD3_64);
+        case TOKEN_MINUS:   return SELECT(FSUB3, FSUB3_64);
+        case TOKEN_STAR:    return SELECT(FMUL3, FMUL3_64);
+        case TOKEN_SLASH:   return SELECT(FDIV3, FDIV3_64);
+        default:            return OP_SYS;
+        }
+    }
+    if (!IntegralTypeIsOrdinal(Type))
+        return OP_SYS;
+
+    bool Signed = IntegralTypeIsSigned(Type);
+    switch (Operator)
+    {
+    case TOKEN_PLUS:    return SELECT(ADD3, ADD3_64);
+    case TOKEN_MINUS:   return SELECT(SUB3, SUB3_64);
+    case TOKEN_STAR:    return Signed? SELECT(IMUL3, IMUL3_64) : SELECT(MUL3, MUL3_64);
+    case TOKEN_SLASH:
+    case TOKEN_DIV:     return Signed? SELECT(IDIV3, IDIV3_64) : SELECT(DIV3, DIV3_64);
+    case TOKEN_MOD:     return SELECT(MOD3, MOD3_64);
+    case TOKEN_AND:     return SELECT(AND3, AND3_64);
+    case TOKEN_OR:      return SELECT(OR3, OR3_64);
+    case TOKEN_XOR:     return SELECT(XOR3, XOR3_64);
+    case TOKEN_SHL:
+    case TOKEN_LESS_LESS:       return SELECT(VSHL3, VSHL3_64);
+    case TOKEN_SHR:
+    case TOKEN_GREATER_GREATER: return SELECT(VSHR3, VSHR3_64);
+    case TOKEN_ASR:     return SELECT(VASR3, VASR3_64);
+    default:            return OP_SYS;
+    }
+#undef SELECT
+}
+
+bool PVMEmitBinaryOp3(PVMEmitter *Emitter, TokenType Operator,
+        VarLocation *Dst, const VarLocation *Lhs, const VarLocation *Src)
+{
+    PASCAL_NONNULL(Emitter);
+    PASCAL_NONNULL(Dst);
+    PASCAL_NONNULL(Lhs);
+    PASCAL_NONNULL(Src);
+
+    /* any other Lhs is loaded into a register of its own anyway */
+    if (VAR_REG != Lhs->LocationType || !Lhs->As.Register.Persistent)
+        return false;
+    /* the immediate and strength reduced versions are better */
+    IntegralType Type = Src->Type.Integral;
+    if (VAR_LIT == Src->LocationType && IntegralTypeIsOrdinal(Type))
+        return false;
+    PVMOp Op = ThreeOperandOp(Operator, Type);
+    if (OP_SYS == Op)
+        return false;
+
+    *Dst = PVMAllocateRegisterLocation(Emitter, Lhs->Type);
+    VarRegister Rt;
+    bool OwningRt = PVMEmitIntoReg(Emitter, &Rt, true, Src);
+    WriteOp32(Emitter,
+        BIT_POS32(Op, 8, 8) | BIT_POS32(Dst->As.Register.ID, 4, 4) | BIT_POS32(Lhs->As.Register.ID, 4, 0)
+        | PVM_EXT(Dst->As.Register.ID, PVM_EXT_D) | PVM_EXT(Lhs->As.Register.ID, PVM_EXT_S) | PVM_OP_RT(Rt.ID),
+        PVM_RT(Rt.ID)
+    );
+    if (OwningRt)
+        PVMFreeRegister(Emitter, Rt);
+    return true;
+}
+
+
 #undef DEFINE_CONST_OP
 #undef DEFINE_INTEGER_BINARY_OP
 
 
 
+/* the next PVMEmitBranchIf* may merge the compare into the branch */
+static void PVMEmitCompare(PVMEmitter *Emitter, U32 Opcode)
+{
+    U32 Location = WriteOp16(Emitter, Opcode);
+    if (Emitter->ShouldEmit)
+        Emitter->LastCompare = Location;
+}
+
 VarLocation PVMEmitSetIfLessOrEqual(PVMEmitter *Emitter, 
         VarRegister A, VarRegister B, IntegralType CommonType
 )
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1718,8 +2014,8 @@ VarLocation PVMEmitSetIfLessOrEqual(PVMEmitter *Emitter,
     else if (IntegralTypeIsOrdinal(CommonType))
     {
         Opcode = IntegralTypeIsSigned(CommonType)
-            ? PVM_OP_ALT(SLT, Oper64, B.ID, A.ID) 
-            : PVM_OP_ALT(ISLT, Oper64, B.ID, A.ID);
+            ? PVM_OP_ALT(ISLT, Oper64, B.ID, A.ID) 
+            : PVM_OP_ALT(SLT, Oper64, B.ID, A.ID);
         Flag.As.FlagValueAsIs = false;
     }
     else if (TYPE_STRING == CommonType)
@@ -1727,7 +2023,7 @@ VarLocation PVMEmitSetIfLessOrEqual(PVMEmitter *Emitter,
         Opcode = PVM_OP(STRLT, B.ID, A.ID);
         Flag.As.FlagValueAsIs = false;
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1737,7 +2033,7 @@ VarLocation PVMEmitSetIfGreaterOrEqual(PVMEmitter *Emitter,
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1746,8 +2042,8 @@ VarLocation PVMEmitSetIfGreaterOrEqual(PVMEmitter *Emitter,
     else if (IntegralTypeIsOrdinal(CommonType))
     {
         Opcode = IntegralTypeIsSigned(CommonType)
-            ? PVM_OP_ALT(SLT, Oper64, A.ID, B.ID) 
-            : PVM_OP_ALT(ISLT, Oper64, A.ID, B.ID);
+            ? PVM_OP_ALT(ISLT, Oper64, A.ID, B.ID) 
+            : PVM_OP_ALT(SLT, Oper64, A.ID, B.ID);
         Flag.As.FlagValueAsIs = false;
     }
     else if (TYPE_STRING == CommonType)
@@ -1755,7 +2051,7 @@ VarLocation PVMEmitSetIfGreaterOrEqual(PVMEmitter *Emitter,
         Opcode = PVM_OP(STRLT, A.ID, B.ID);
         Flag.As.FlagValueAsIs = false;
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1765,7 +2061,7 @@ VarLocation PVMEmitSetIfLess(PVMEmitter *Emitter,
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1774,14 +2070,14 @@ VarLocation PVMEmitSetIfLess(PVMEmitter *Emitter,
     else if (IntegralTypeIsOrdinal(CommonType))
     {
         Opcode = IntegralTypeIsSigned(CommonType)
-            ? PVM_OP_ALT(SLT, Oper64, A.ID, B.ID) 
-            : PVM_OP_ALT(ISLT, Oper64, A.ID, B.ID);
+            ? PVM_OP_ALT(ISLT, Oper64, A.ID, B.ID) 
+            : PVM_OP_ALT(SLT, Oper64, A.ID, B.ID);
     }
     else if (TYPE_STRING == CommonType)
     {
         Opcode = PVM_OP(STRLT, A.ID, B.ID);
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1791,7 +2087,7 @@ VarLocation PVMEmitSetIfGreater(PVMEmitter *Emitter,
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1800,14 +2096,14 @@ VarLocation PVMEmitSetIfGreater(PVMEmitter *Emitter,
     else if (IntegralTypeIsOrdinal(CommonType))
     {
         Opcode = IntegralTypeIsSigned(CommonType)
-            ? PVM_OP_ALT(SLT, Oper64, B.ID, A.ID) 
-            : PVM_OP_ALT(ISLT, Oper64, B.ID, A.ID);
+            ? PVM_OP_ALT(ISLT, Oper64, B.ID, A.ID) 
+            : PVM_OP_ALT(SLT, Oper64, B.ID, A.ID);
     }
     else if (TYPE_STRING == CommonType)
     {
         Opcode = PVM_OP(STRLT, B.ID, A.ID);
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1817,7 +2113,7 @@ VarLocation PVMEmitSetIfEqual(PVMEmitter *Emitter,
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1831,7 +2127,7 @@ VarLocation PVMEmitSetIfEqual(PVMEmitter *Emitter,
     {
         Opcode = PVM_OP(STREQ, A.ID, B.ID);
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1841,7 +2137,7 @@ VarLocation PVMEmitSetIfNotEqual(PVMEmitter *Emitter,
 {
     PASCAL_NONNULL(Emitter);
     bool Oper64 = OperandIs64(CommonType);
-    U16 Opcode = 0;
+    U32 Opcode = 0;
     VarLocation Flag = Emitter->Reg.Flag;
     if (IntegralTypeIsFloat(CommonType))
     {
@@ -1857,7 +2153,7 @@ VarLocation PVMEmitSetIfNotEqual(PVMEmitter *Emitter,
         Opcode = PVM_OP(STREQ, A.ID, B.ID);
         Flag.As.FlagValueAsIs = false;
     }
-    WriteOp16(Emitter, Opcode);
+    PVMEmitCompare(Emitter, Opcode);
     return Flag;
 }
 
@@ -1865,7 +2161,7 @@ VarLocation PVMEmitSetIfNotEqual(PVMEmitter *Emitter,
 VarLocation PVMEmitMemcmp(PVMEmitter *Emitter, VarRegister PtrA, VarRegister PtrB, VarRegister Size)
 {
     PASCAL_NONNULL(Emitter);
-    WriteOp32(Emitter, PVM_OP(VMEMEQU, PtrA.ID, PtrB.ID), Size.ID << 4);
+    WriteOp32(Emitter, PVM_OP(VMEMEQU, PtrA.ID, PtrB.ID) | PVM_OP_RT(Size.ID), PVM_RT(Size.ID));
     return Emitter->Reg.Flag;
 }
 
@@ -2076,6 +2372,7 @@ void PVMInitializeGlobal(PVMEmitter *Emitter, VarMemory Global, const VarLiteral
     } break;
 
     case TYPE_FUNCTION:
+    case TYPE_FILE:
     case TYPE_INVALID:
     case TYPE_RECORD:
     case TYPE_COUNT:
@@ -2108,18 +2405,26 @@ VarMemory PVMEmitGlobalSpace(PVMEmitter *Emitter, U32 Size)
 
 /* subroutine */
 SaveRegInfo PVMEmitSaveCallerRegs(PVMEmitter *Emitter, UInt ReturnRegID)
+{
+    return PVMEmitSaveClobberedRegs(Emitter, ReturnRegID, UINT64_MAX);
+}
+
+SaveRegInfo PVMEmitSaveClobberedRegs(PVMEmitter *Emitter, UInt ReturnRegID, U64 Clobbered)
 {
     PASCAL_NONNULL(Emitter);
-    if (NO_RETURN_REG == ReturnRegID)
+    U64 Allocated = Emitter->Reglist & ~EMPTY_REGLIST;
+    if (NO_RETURN_REG != ReturnRegID)
     {
-        return PVMEmitPushRegList(Emitter, Emitter->Reglist & ~EMPTY_REGLIST);
+        Allocated &= ~((U64)1 << ReturnRegID);
     }
-    return PVMEmitPushRegList(Emitter, Emitter->Reglist & ~(((U32)1 << ReturnRegID) | EMPTY_REGLIST));
+    SaveRegInfo Info = PVMEmitPushRegList(Emitter, Allocated & Clobbered);
+    Info.Kept = Allocated & ~Clobbered;
+    return Info;
 }
 
 bool PVMRegIsSaved(SaveRegInfo Saved, UInt RegID)
 {
-    return (Saved.Regs & (1 << RegID)) != 0;
+    return (Saved.Regs & ((U64)1 << RegID)) != 0;
 }
 
 VarLocation PVMRetreiveSavedCallerReg(PVMEmitter *Emitter, SaveRegInfo Saved, UInt RegID, VarType Type)
@@ -2127,12 +2432,14 @@ VarLocation PVMRetreiveSavedCallerReg(PVMEmitter *Emitter, SaveRegInfo Saved, UI
     PASCAL_NONNULL(Emitter);
     PASCAL_ASSERT(RegID < STATIC_ARRAY_SIZE(Saved.RegLocation), "Invalid index");
 
+    /* a push goes right above SP, which has moved on since by what was pushed after it,
+     * the frame is not patched yet so FP would not do */
     VarLocation RegLocation = {
         .LocationType = VAR_MEM,
         .Type = Type,
         .As.Memory = {
-            .Location = Saved.RegLocation[RegID],
-            .RegPtr = Emitter->Reg.FP.As.Register,
+            .Location = (I32)(Saved.RegLocation[RegID] + sizeof(PVMGPR)) - (I32)Emitter->StackSpace,
+            .RegPtr = Emitter->Reg.SP.As.Register,
         },
     };
     return RegLocation;
@@ -2166,25 +2473,15 @@ void PVMEmitCallPtr(PVMEmitter *Emitter, const VarLocation *Ptr)
 void PVMEmitUnsaveCallerRegs(PVMEmitter *Emitter, UInt ReturnRegID, SaveRegInfo Save)
 {
     PASCAL_NONNULL(Emitter);
-    U32 Restorelist = Save.Regs;
-    if (Restorelist & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(POPL, Restorelist & 0xFF));
-    }
-    if ((Restorelist >> 8) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(POPH, Restorelist >> 8));
-    }
-    if ((Restorelist >> 16) & 0xFF) 
+    U64 Restorelist = Save.Regs;
+    /* the last bank pushed is on top */
+    for (UInt Bank = 8; Bank > 0; Bank--)
     {
-        WriteOp16(Emitter, PVM_REGLIST(FPOPL, Restorelist >> 16));
+        PVMEmitRegListBank(Emitter, Restorelist, Bank - 1, false);
     }
-    if ((Restorelist >> 24) & 0xFF)
-    {
-        WriteOp16(Emitter, PVM_REGLIST(FPOPH, Restorelist >> 24));
-    }
-    Emitter->Reglist = Restorelist | EMPTY_REGLIST;
-    Emitter->StackSpace -= Save.Size;
+    Emitter->Reglist = Restorelist | Save.Kept | EMPTY_REGLIST;
+    /* the arguments a sys op was given are popped by it */
+    Emitter->StackSpace = Save.StackSpace;
     if (NO_RETURN_REG != ReturnRegID)
     {
         PVMMarkRegisterAsAllocated(Emitter, ReturnRegID);
@@ -2234,6 +2531,18 @@ void PVMEmitWrite(PVMEmitter *Emitter)
     WriteOp16(Emitter, PVM_SYS(WRITE));
 }
 
+void PVMEmitRead(PVMEmitter *Emitter, bool Newline)
+{
+    PASCAL_NONNULL(Emitter);
+    WriteOp16(Emitter, Newline? PVM_SYS(READLN) : PVM_SYS(READ));
+}
+
+void PVMEmitFileOp(PVMEmitter *Emitter, PVMSysOp Op)
+{
+    PASCAL_NONNULL(Emitter);
+    WriteOp16(Emitter, BIT_POS32(OP_SYS, 8, 8) | BIT_POS32(Op, 8, 0));
+}
+
 
 
 
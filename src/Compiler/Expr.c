@@ -13,24 +13,25 @@
 
 static const IntegralType sCoercionRules[TYPE_COUNT][TYPE_COUNT] = {
     /*Invalid       I8            I16           I32           I64           U8            U16           U32           U64           F32           F64           Function      Boolean       Pointer       string       record */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* Invalid */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* I8 */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* I16 */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* I32 */
-    { TYPE_INVALID, TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* I64 */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* U8 */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* U16 */
-    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* U32 */
-    { TYPE_INVALID, TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* U64 */
-    { TYPE_INVALID, TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* F32 */
-    { TYPE_INVALID, TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* F64 */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* Function */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_BOOLEAN, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* Boolean */
-    { TYPE_INVALID, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* Pointer */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_STRING, TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* String */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_RECORD ,TYPE_INVALID, TYPE_INVALID},         /* Record */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_CHAR, TYPE_INVALID},            /* Char */
-    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID},         /* Array */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Invalid */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* I8 */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* I16 */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* I32 */
+    { TYPE_INVALID, TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_I64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* I64 */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* U8 */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* U16 */
+    { TYPE_INVALID, TYPE_I32,     TYPE_I32,     TYPE_I32,     TYPE_I64,     TYPE_U32,     TYPE_U32,     TYPE_U32,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* U32 */
+    { TYPE_INVALID, TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_U64,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* U64 */
+    { TYPE_INVALID, TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F32,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* F32 */
+    { TYPE_INVALID, TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_F64,     TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* F64 */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Function */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_BOOLEAN, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Boolean */
+    { TYPE_INVALID, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_POINTER, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_POINTER, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Pointer */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_STRING, TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* String */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_RECORD ,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Record */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_CHAR, TYPE_INVALID, TYPE_INVALID},            /* Char */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID,TYPE_INVALID,TYPE_INVALID, TYPE_INVALID, TYPE_INVALID},         /* Array */
+    { TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_INVALID, TYPE_FILE   },         /* File */
 };
 
 
@@ -88,7 +89,7 @@ void FreeExpr(PascalCompiler *Compiler, VarLocation Expr)
 {
     PASCAL_NONNULL(Compiler);
 
-    if (VAR_REG == Expr.LocationType)
+    if (VAR_REG == Expr.LocationType && !Expr.As.Register.Persistent)
     {
         PVMFreeRegister(EMITTER(), Expr.As.Register);
     }
@@ -98,6 +99,25 @@ void FreeExpr(PascalCompiler *Compiler, VarLocation Expr)
     }
 }
 
+/* the register Expr is in or points to, UINT32_MAX if there is none */
+static UInt ExprRegister(const VarLocation *Expr)
+{
+    if (VAR_REG == Expr->LocationType)
+        return Expr->As.Register.ID;
+    if (VAR_MEM == Expr->LocationType)
+        return Expr->As.Memory.RegPtr.ID;
+    return UINT32_MAX;
+}
+
+/* an operand is often turned into the result in place, it must not be freed then */
+static void FreeOperand(PascalCompiler *Compiler, VarLocation Operand, const VarLocation *Result)
+{
+    UInt Reg = ExprRegister(&Operand);
+    if (UINT32_MAX != Reg && ExprRegister(Result) == Reg)
+        return;
+    FreeExpr(Compiler, Operand);
+}
+
 
 VarLocation CompileExpr(PascalCompiler *Compiler)
 {
@@ -137,7 +157,7 @@ void CompileExprInto(PascalCompiler *Compiler, const Token *ErrorSpot, VarLocati
     {
         PVMEmitMove(EMITTER(), Location, &Expr);
     }
-    else if (TYPE_POINTER == Location->Type.Integral)
+    else if (TYPE_POINTER == Location->Type.Integral || TYPE_FILE == Location->Type.Integral)
     {
         if (!VarTypeEqual(&Location->Type, &Expr.Type))
             goto InvalidTypeCombination;
@@ -266,10 +286,11 @@ static VarLocation CompileCallWithReturnValue(PascalCompiler *Compiler,
     VarLocation ReturnValue;
     UInt ReturnReg = NO_RETURN_REG;
     I32 Base = PVMStartArg(EMITTER(), Subroutine->StackArgSize);
+    InlineSite Inline = InlinePlanCall(Compiler, Location);
     SaveRegInfo SaveRegs;
     if (!VarTypeIsTriviallyCopiable(*ReturnType))
     {
-        SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), NO_RETURN_REG);
+        SaveRegs = PVMEmitSaveClobberedRegs(EMITTER(), NO_RETURN_REG, Inline.Clobbers);
 
         /* then first argument will contain return value */
         VarLocation FirstArg = PVMSetArg(EMITTER(), 0, *ReturnType, &Base);
@@ -294,12 +315,12 @@ static VarLocation CompileCallWithReturnValue(PascalCompiler *Compiler,
         ReturnValue = PVMAllocateRegisterLocation(EMITTER(), *ReturnType);
         ReturnReg = ReturnValue.As.Register.ID;
 
-        SaveRegs = PVMEmitSaveCallerRegs(EMITTER(), ReturnReg);
+        SaveRegs = PVMEmitSaveClobberedRegs(EMITTER(), ReturnReg, Inline.Clobbers);
     }
 
 
     CompileArgumentList(Compiler, Callee, Subroutine, &Base, Subroutine->HiddenParamCount);
-    CompilerEmitCall(Compiler, Location, SaveRegs);
+    CompilerEmitCall(Compiler, Location, SaveRegs, &Inline);
 
 
     if (VarTypeIsTriviallyCopiable(*ReturnType))
@@ -741,7 +762,7 @@ static VarLocation VariableAddrOf(PascalCompiler *Compiler, bool ShouldCallFunct
     VarLocation Variable = ParsePrecedence(Compiler, PREC_VARIABLE, false);
 
 
-    if (Variable.LocationType != VAR_MEM)
+    if (Variable.LocationType != VAR_MEM && Variable.LocationType != VAR_SUBROUTINE)
     {
         ErrorAt(Compiler, &AtSign, "Address cannot be taken.");
         return (VarLocation) { 0 };
@@ -901,6 +922,21 @@ InvalidStorage:
 
 
 
+/* a literal that is not negative compares with an unsigned integer as an unsigned one */
+static void UnsignLiteralOperand(VarLocation *Literal, IntegralType Other)
+{
+    if (VAR_LIT != Literal->LocationType 
+    || !IntegralTypeIsInteger(Literal->Type.Integral) || !IntegralTypeIsSigned(Literal->Type.Integral)
+    || !IntegralTypeIsInteger(Other) || IntegralTypeIsSigned(Other)
+    || (I64)Literal->As.Literal.Int < 0)
+    {
+        return;
+    }
+    IntegralType Type = Literal->As.Literal.Int > UINT32_MAX? TYPE_U64 : TYPE_U32;
+    Literal->Type = VarTypeInit(Type, IntegralTypeSize(Type));
+}
+
+
 static IntegralType TryCoercingTypes(TokenType Operation, IntegralType Left, IntegralType Right)
 {
     switch (Operation)
@@ -1050,9 +1086,9 @@ static VarLocation LiteralExprBinary(PascalCompiler *Compiler,
 
 #define INT_AND_FLT_OP(Op, A, B) do {\
     if (IntegralTypeIsFloat(LeftType)) {\
-        Dst.As.Literal.Flt = Left->Flt + Right->Flt;\
-    } else if (IntegralTypeIsSigned(LeftType)) {\
-        Dst.As.Literal.Int = Left->Int + Right->Int;\
+        Dst.As.Literal.Flt = (A)->Flt Op (B)->Flt;\
+    } else {\
+        Dst.As.Literal.Int = (A)->Int Op (B)->Int;\
     }\
 } while (0)
 
@@ -1158,6 +1194,8 @@ static VarLocation RuntimeExprBinary(PascalCompiler *Compiler,
 } while (0)
 
 #define BIN_OP(OpName, Operand1, Operand2) do {\
+    if (!Compiler->Flags.NoThreeOperand && PVMEmitBinaryOp3(EMITTER(), Operator, &Dst, Operand1, Operand2))\
+        break;\
     PVMEmitIntoRegLocation(EMITTER(), &Dst, false, Operand1);\
     PVMEmit ## OpName (EMITTER(), Dst.As.Register, Operand2);\
 } while (0)
@@ -1238,6 +1276,11 @@ static VarLocation ExprBinary(PascalCompiler *Compiler, VarLocation *Left, bool
 
 
     /* type conversion */
+    if (PREC_EXPR == Prec)
+    {
+        UnsignLiteralOperand(Left, Right.Type.Integral);
+        UnsignLiteralOperand(&Right, Left->Type.Integral);
+    }
     IntegralType ResultingType = TryCoercingTypes(OpToken.Type, 
         Left->Type.Integral, Right.Type.Integral
     );
@@ -1280,7 +1323,9 @@ static VarLocation ExprBinary(PascalCompiler *Compiler, VarLocation *Left, bool
     }
     else
     {
-        return RuntimeExprBinary(Compiler, &OpToken, ResultingType, Left, &Right);
+        VarLocation Result = RuntimeExprBinary(Compiler, &OpToken, ResultingType, Left, &Right);
+        FreeOperand(Compiler, Right, &Result);
+        return Result;
     }
 }
 
@@ -1301,7 +1346,7 @@ static VarLocation ExprAnd(PascalCompiler *Compiler, VarLocation *Left, bool Sho
             EMITTER()->ShouldEmit = false;
         }
 
-        U32 FromLeft = PVMEmitBranchIfFalse(EMITTER(), Left);
+        U32 FromLeft = PVMEmitBranchIfFalseKeepFlag(EMITTER(), Left);
 
         Right = ParsePrecedence(Compiler, GetPrecedenceRule(OpToken.Type)->Prec + 1, true);
         IntegralType ResultType = CoerceTypes(Left->Type.Integral, Right.Type.Integral);
@@ -1350,7 +1395,7 @@ static VarLocation ExprOr(PascalCompiler *Compiler, VarLocation *Left, bool Shou
             EMITTER()->ShouldEmit = false;
         }
 
-        U32 FromTrue = PVMEmitBranchIfTrue(EMITTER(), Left);
+        U32 FromTrue = PVMEmitBranchIfTrueKeepFlag(EMITTER(), Left);
 
         Right = ParsePrecedence(Compiler, GetPrecedenceRule(OpToken.Type)->Prec + 1, true);
         IntegralType ResultType = CoerceTypes(Left->Type.Integral, Right.Type.Integral);
@@ -1460,7 +1505,7 @@ static VarLocation ParseAssignmentLhs(PascalCompiler *Compiler, Precedence Prec,
         PASCAL_NONNULL(InfixRoutine);
 
         VarLocation Result = InfixRoutine(Compiler, &Left, ShouldCallFunction);
-        FreeExpr(Compiler, Left);
+        FreeOperand(Compiler, Left, &Result);
         Left = Result;
     }
     return Left;
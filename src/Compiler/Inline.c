@@ -0,0 +1,258 @@
+
+#include "Compiler/Inline.h"
+#include "Compiler/Compiler.h"
+#include "Compiler/Ir.h"
+
+
+
+/* the callee's code as it is about to be copied */
+typedef struct InlineBody
+{
+    IrFunction Fn;
+    U32 Enter;      /* the instruction */
+    U32 FrameSize;
+    U64 Clobbers;
+    bool HasCall;
+} InlineBody;
+
+
+
+
+/* the ones that address memory with Rs + offset */
+static bool InlineHasOffset(PVMOp Op)
+{
+    switch (Op)
+    {
+    case OP_LD32: case OP_LDZEX32_8: case OP_LDZEX32_16: case OP_LDSEX32_8: case OP_LDSEX32_16:
+    case OP_LD32L: case OP_LDZEX32_8L: case OP_LDZEX32_16L: case OP_LDSEX32_8L: case OP_LDSEX32_16L:
+    case OP_LD64: case OP_LDZEX64_8: case OP_LDZEX64_16: case OP_LDZEX64_32:
+    case OP_LDSEX64_8: case OP_LDSEX64_16: case OP_LDSEX64_32:
+    case OP_LD64L: case OP_LDZEX64_8L: case OP_LDZEX64_16L: case OP_LDZEX64_32L:
+    case OP_LDSEX64_8L: case OP_LDSEX64_16L: case OP_LDSEX64_32L:
+    case OP_LDF32: case OP_LDF32L: case OP_LDF64: case OP_LDF64L:
+    case OP_ST8: case OP_ST16: case OP_ST32: case OP_ST64:
+    case OP_ST8L: case OP_ST16L: case OP_ST32L: case OP_ST64L:
+    case OP_STF32: case OP_STF32L: case OP_STF64: case OP_STF64L:
+    case OP_LEA: case OP_LEAL:
+        return true;
+    default: return false;
+    }
+}
+
+static I32 InlineOffsetOf(const IrIns *Ins)
+{
+    return 2 == Ins->Size
+        ? (I16)Ins->Code[1]
+        : (I32)((U32)Ins->Code[1] | (U32)Ins->Code[2] << 16);
+}
+
+static void InlineSetOffset(IrIns *Ins, I32 Offset)
+{
+    Ins->Code[1] = Offset;
+    if (2 != Ins->Size)
+        Ins->Code[2] = (U32)Offset >> 16;
+}
+
+static bool InlineIsSys(const IrIns *Ins, PVMSysOp SysOp)
+{
+    return OP_SYS == Ins->Op && SysOp == PVM_GET_SYS_OP(Ins->Code[0]);
+}
+
+
+/* lifts the callee and checks that its code still works with its frame at FrameBase */
+static bool InlineLift(PascalCompiler *Compiler, InlineBody *Body, PascalArena *Arena,
+        const U32 *Callee, U32 End, U32 FrameBase)
+{
+    *Body = (InlineBody) {
+        .Enter = IR_NONE,
+    };
+    IrFunction *Fn = &Body->Fn;
+    if (!IrLift(Fn, Arena, EMITTER()->Chunk, *Callee, End) || !IrFindReferences(Compiler, Fn))
+        return false;
+
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block || IR_OP_ENTRY == Ins->Op)
+            continue;
+        if (InlineIsSys(Ins, OP_SYS_ENTER))
+        {
+            Body->Enter = i;
+            Body->FrameSize = (U32)Ins->Code[1] | (U32)Ins->Code[2] << 16;
+            continue;
+        }
+        /* the pointer could be among the saved registers, which are addressed from FP */
+        if (OP_CALLPTR == Ins->Op)
+            return false;
+        Body->HasCall = Body->HasCall || OP_CALL == Ins->Op;
+
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            const IrOperand *Use = &Ins->Use[k];
+            /* spills and stack arguments are addressed from SP, they would land in the caller's */
+            if (PVM_REG_SP == Use->Reg)
+                return false;
+            if (PVM_REG_FP != Use->Reg)
+                continue;
+            if (IR_SLOT_RS != Use->Slot || !InlineHasOffset(Ins->Op))
+                return false;
+
+            I32 Offset = InlineOffsetOf(Ins);
+            if (Offset < 0 || (2 == Ins->Size && !IN_I16((I64)Offset + FrameBase)))
+                return false;
+        }
+        for (U32 k = 0; k < Ins->DefCount; k++)
+        {
+            UInt Reg = Ins->Def[k].Reg;
+            if (PVM_REG_SP == Reg || PVM_REG_FP == Reg)
+                return false;
+            if (Reg < IR_REG_FLAG)
+                Body->Clobbers |= (U64)1 << Reg;
+        }
+    }
+
+    /* the arguments are written before it starts */
+    for (UInt i = 0; i < PVM_ARGREG_COUNT; i++)
+    {
+        Body->Clobbers |= (U64)1 << (PVM_ARGREG_0 + i);
+        Body->Clobbers |= (U64)1 << (PVM_ARGREG_F0 + i);
+    }
+    if (Body->HasCall)
+        Body->Clobbers = UINT64_MAX;
+    return IR_NONE != Body->Enter;
+}
+
+
+static bool InlineOnlyEmptyAfter(const IrFunction *Fn, U32 Block)
+{
+    for (U32 b = Block + 1; b < Fn->BlockCount; b++)
+    {
+        if (IR_NONE != Fn->Blocks[b].First)
+            return false;
+    }
+    return true;
+}
+
+/* moves the frame and turns enter and exits into nothing and jumps to the end */
+static void InlineRewrite(InlineBody *Body, U32 FrameBase)
+{
+    IrFunction *Fn = &Body->Fn;
+    IrRemoveIns(Fn, Body->Enter);
+
+    /* backward, an exit right before the last one is also the end */
+    for (U32 i = Fn->InsCount; i-- > 0;)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block || IR_OP_ENTRY == Ins->Op || IR_OP_PHI == Ins->Op)
+            continue;
+
+        if (InlineIsSys(Ins, OP_SYS_EXIT))
+        {
+            if (InlineOnlyEmptyAfter(Fn, Ins->Block))
+            {
+                IrRemoveIns(Fn, i);
+                continue;
+            }
+            /* the offset is patched when lowered */
+            Ins->Op = OP_BR;
+            Ins->Code[0] = PVM_BR(0);
+            Ins->Code[1] = 0;
+            Ins->Size = 2;
+            Ins->Ext = 0;
+            Ins->Flags = IR_INS_BRANCH | IR_INS_JUMP;
+            Ins->UseCount = 0;
+            Ins->DefCount = 0;
+            Ins->Target = Fn->BlockCount - 1;
+            continue;
+        }
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            if (PVM_REG_FP == Ins->Use[k].Reg)
+            {
+                InlineSetOffset(Ins, InlineOffsetOf(Ins) + FrameBase);
+                break;
+            }
+        }
+    }
+}
+
+
+
+
+InlineSite InlinePlanCall(PascalCompiler *Compiler, const VarLocation *Location)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Location);
+
+    InlineSite Site = {
+        .Callee = NULL,
+        .Clobbers = UINT64_MAX,
+    };
+    if (TYPE_FUNCTION != Location->Type.Integral || Compiler->Error || !EMITTER()->ShouldEmit)
+        return Site;
+    const SubroutineData *Subroutine = &Location->Type.As.Subroutine;
+    if (!Subroutine->IsInline && Compiler->Flags.OptLevel < 2)
+        return Site;
+    if (0 != Subroutine->StackArgSize)
+        return Site;
+
+    /* a subroutine that is not done yet calls itself, or was declared forward */
+    const U32 *Callee = Location->As.SubroutineLocation;
+    U32 End = 0;
+    for (U32 i = 0; i < Compiler->SubroutineBodies.Count && 0 == End; i++)
+    {
+        if (Compiler->SubroutineBodies.Data[i].Location == Callee && !Compiler->SubroutineBodies.Data[i].IsNested)
+            End = Compiler->SubroutineBodies.Data[i].End;
+    }
+    U32 MaxSize = Subroutine->IsInline? INLINE_MAX_SIZE : INLINE_MAX_AUTO_SIZE;
+    if (End <= *Callee || End - *Callee > MaxSize)
+        return Site;
+
+    U32 FrameBase = uRoundUpToMultipleOfPow2(Compiler->StackSize + Compiler->TemporarySize, PVM_STACK_ALIGNMENT);
+    PascalArena Arena = ArenaInit(IR_ARENA_SIZE, 4);
+    InlineBody Body;
+    if (InlineLift(Compiler, &Body, &Arena, Callee, End, FrameBase)
+    && (Subroutine->IsInline || !Body.HasCall))
+    {
+        Site = (InlineSite) {
+            .Callee = Callee,
+            .End = End,
+            .FrameBase = FrameBase,
+            .Clobbers = Body.Clobbers,
+        };
+        /* temporaries of the caller are below it, the ones it makes from now on are above */
+        Compiler->StackSize = FrameBase + Body.FrameSize;
+    }
+    ArenaDeinit(&Arena);
+    return Site;
+}
+
+
+void InlineEmitCall(PascalCompiler *Compiler, const InlineSite *Site)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Site);
+    PASCAL_NONNULL(Site->Callee);
+
+    PVMEmitter *Emitter = EMITTER();
+    PascalArena Arena = ArenaInit(IR_ARENA_SIZE, 4);
+    InlineBody Body;
+    bool Lifted = InlineLift(Compiler, &Body, &Arena, Site->Callee, Site->End, Site->FrameBase);
+    PASCAL_ASSERT(Lifted, "Inlined call was planned for a callee that cannot be inlined");
+
+    IrFunction *Fn = &Body.Fn;
+    InlineRewrite(&Body, Site->FrameBase);
+    Fn->Start = PVMGetCurrentLocation(Emitter);
+    IrLower(Fn, Emitter);
+
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block || IR_NONE == Ins->Reference)
+            continue;
+        const U32 *Subroutine = Compiler->SubroutineReferences.Data[Ins->Reference].SubroutineLocation;
+        PushSubroutineReference(Compiler, Subroutine, Ins->Location);
+    }
+    ArenaDeinit(&Arena);
+}
+
@@ -0,0 +1,1578 @@
+
+#include <string.h>
+
+#include "Compiler/Ir.h"
+#include "Compiler/ConstProp.h"
+#include "Compiler/Peephole.h"
+#include "Compiler/RegAlloc.h"
+#include "Compiler/Promote.h"
+#include "Compiler/Compiler.h"
+#include "PVM/Decoder.h"
+#include "PVM/Disassembler.h"
+
+
+
+/* one byte per halfword of the lifted code */
+#define IR_MARK_INS 0x1
+#define IR_MARK_LEADER 0x2
+
+/* push multiple takes 8 registers, a call takes the argument registers and its callee */
+#define IR_MAX_USES 16
+#define IR_MAX_DEFS 8
+
+#define IR_F(Reg) (PVM_REG_COUNT + (Reg))
+
+
+typedef struct IrDecoded
+{
+    PVMOp Op;
+    U16 Opcode;         /* after the prefix */
+    UInt Ext, Rd, Rs, Rt;
+    U32 Size, Next;     /* Size without the prefix */
+    bool HasTarget;
+    U32 Target;
+} IrDecoded;
+
+typedef struct IrLifter
+{
+    IrOperand Use[IR_MAX_USES], Def[IR_MAX_DEFS];
+    IrType DefType[IR_MAX_DEFS];
+    UInt UseCount, DefCount;
+    U16 Flags;
+} IrLifter;
+
+/* what building the SSA form needs on top of the function */
+typedef struct IrBuilder
+{
+    IrFunction *Fn;
+    U32 *LastDef;   /* [Block*IR_REG_COUNT + Reg], the last value of Reg defined in Block */
+    U32 *EntryDef;  /* [Block*IR_REG_COUNT + Reg], the value of Reg when Block starts */
+    U32 EntryValue[IR_REG_COUNT];
+    bool *Reachable;
+} IrBuilder;
+
+
+
+
+static U32 IrNewValue(IrFunction *Fn, U32 Ins, UInt Reg, IrType Type)
+{
+    if (Fn->ValueCount == Fn->ValueCap)
+    {
+        U32 NewCap = Fn->ValueCap*2 + 64;
+        IrValue *Values = ArenaAllocate(Fn->Arena, NewCap * sizeof *Values);
+        if (Fn->ValueCount)
+            memcpy(Values, Fn->Values, Fn->ValueCount * sizeof *Values);
+        Fn->Values = Values;
+        Fn->ValueCap = NewCap;
+    }
+    Fn->Values[Fn->ValueCount] = (IrValue) {
+        .Ins = Ins,
+        .Forward = IR_NONE,
+        .Reg = Reg,
+        .Type = Type,
+    };
+    return Fn->ValueCount++;
+}
+
+/* pointers into Fn->Ins do not survive this */
+static U32 IrNewIns(IrFunction *Fn, U16 Op)
+{
+    if (Fn->InsCount == Fn->InsCap)
+    {
+        U32 NewCap = Fn->InsCap*2 + 64;
+        IrIns *Ins = ArenaAllocate(Fn->Arena, NewCap * sizeof *Ins);
+        if (Fn->InsCount)
+            memcpy(Ins, Fn->Ins, Fn->InsCount * sizeof *Ins);
+        Fn->Ins = Ins;
+        Fn->InsCap = NewCap;
+    }
+    Fn->Ins[Fn->InsCount] = (IrIns) {
+        .Op = Op,
+        .Block = IR_NONE,
+        .Prev = IR_NONE,
+        .Next = IR_NONE,
+        .Target = IR_NONE,
+        .StreamOffset = IR_NONE,
+        .Location = IR_NONE,
+        .Reference = IR_NONE,
+    };
+    return Fn->InsCount++;
+}
+
+static void IrAppend(IrFunction *Fn, U32 Block, U32 Index)
+{
+    IrBlock *B = &Fn->Blocks[Block];
+    IrIns *Ins = &Fn->Ins[Index];
+    Ins->Block = Block;
+    Ins->Prev = B->Last;
+    Ins->Next = IR_NONE;
+    if (IR_NONE == B->Last)
+        B->First = Index;
+    else Fn->Ins[B->Last].Next = Index;
+    B->Last = Index;
+}
+
+static void IrPrepend(IrFunction *Fn, U32 Block, U32 Index)
+{
+    IrBlock *B = &Fn->Blocks[Block];
+    IrIns *Ins = &Fn->Ins[Index];
+    Ins->Block = Block;
+    Ins->Prev = IR_NONE;
+    Ins->Next = B->First;
+    if (IR_NONE == B->First)
+        B->Last = Index;
+    else Fn->Ins[B->First].Prev = Index;
+    B->First = Index;
+}
+
+void IrRemoveIns(IrFunction *Fn, U32 Index)
+{
+    PASCAL_NONNULL(Fn);
+    IrIns *Ins = &Fn->Ins[Index];
+    PASCAL_ASSERT(IR_NONE != Ins->Block, "Instruction was already removed");
+    IrBlock *B = &Fn->Blocks[Ins->Block];
+    if (IR_NONE == Ins->Prev)
+        B->First = Ins->Next;
+    else Fn->Ins[Ins->Prev].Next = Ins->Next;
+    if (IR_NONE == Ins->Next)
+        B->Last = Ins->Prev;
+    else Fn->Ins[Ins->Next].Prev = Ins->Prev;
+    Ins->Block = IR_NONE;
+    Ins->Prev = IR_NONE;
+    Ins->Next = IR_NONE;
+}
+
+U32 IrInsertBefore(IrFunction *Fn, U32 Index, U16 Op)
+{
+    PASCAL_NONNULL(Fn);
+    U32 New = IrNewIns(Fn, Op);
+    IrIns *Ins = &Fn->Ins[New];
+    IrIns *At = &Fn->Ins[Index];
+    PASCAL_ASSERT(IR_NONE != At->Block, "Cannot insert next to a removed instruction");
+    Ins->Block = At->Block;
+    Ins->Prev = At->Prev;
+    Ins->Next = Index;
+    if (IR_NONE == At->Prev)
+        Fn->Blocks[At->Block].First = New;
+    else Fn->Ins[At->Prev].Next = New;
+    At->Prev = New;
+    return New;
+}
+
+U32 IrInsertAfter(IrFunction *Fn, U32 Index, U16 Op)
+{
+    PASCAL_NONNULL(Fn);
+    U32 New = IrNewIns(Fn, Op);
+    IrIns *Ins = &Fn->Ins[New];
+    IrIns *At = &Fn->Ins[Index];
+    PASCAL_ASSERT(IR_NONE != At->Block, "Cannot insert next to a removed instruction");
+    Ins->Block = At->Block;
+    Ins->Prev = Index;
+    Ins->Next = At->Next;
+    if (IR_NONE == At->Next)
+        Fn->Blocks[At->Block].Last = New;
+    else Fn->Ins[At->Next].Prev = New;
+    At->Next = New;
+    return New;
+}
+
+U32 IrResolve(IrFunction *Fn, U32 Value)
+{
+    PASCAL_NONNULL(Fn);
+    U32 Resolved = Value;
+    while (IR_NONE != Resolved && IR_NONE != Fn->Values[Resolved].Forward)
+        Resolved = Fn->Values[Resolved].Forward;
+
+    /* so that the next one does not walk the chain again */
+    while (IR_NONE != Value && IR_NONE != Fn->Values[Value].Forward)
+    {
+        U32 Next = Fn->Values[Value].Forward;
+        Fn->Values[Value].Forward = Resolved;
+        Value = Next;
+    }
+    return Resolved;
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   EDITING
+ */
+/*===============================================================================*/
+
+
+void IrSetMoveImm(IrFunction *Fn, U32 Index, U64 Imm)
+{
+    PASCAL_NONNULL(Fn);
+    IrIns *Ins = &Fn->Ins[Index];
+    PASCAL_ASSERT(Ins->DefCount >= 1 && IR_SLOT_RD == Ins->Def[0].Slot, "Move needs a destination register");
+
+    /* same encoding as ChunkWriteMovImm, Rd is filled in when lowered */
+    UInt Count = 0;
+    PVMImmType ImmType = IMMTYPE_U64;
+    if (IS_SMALL_IMM(Imm))
+        Ins->Op = OP_MOVQI;
+    else
+    {
+        Ins->Op = OP_MOVI;
+        if (IN_I16(Imm))        ImmType = IMMTYPE_I16, Count = 1;
+        else if (IN_U16(Imm))   ImmType = IMMTYPE_U16, Count = 1;
+        else if (IN_I32(Imm))   ImmType = IMMTYPE_I32, Count = 2;
+        else if (IN_U32(Imm))   ImmType = IMMTYPE_U32, Count = 2;
+        else if (IN_I48(Imm))   ImmType = IMMTYPE_I48, Count = 3;
+        else if (IN_U48(Imm))   ImmType = IMMTYPE_U48, Count = 3;
+        else                    ImmType = IMMTYPE_U64, Count = 4;
+    }
+    Ins->Code[0] = OP_MOVQI == Ins->Op
+        ? PVM_OP(MOVQI, 0, Imm)
+        : PVM_OP(MOVI, 0, ImmType);
+    for (UInt i = 0; i < Count; i++)
+        Ins->Code[1 + i] = Imm >> i*16;
+
+    Ins->Size = 1 + Count;
+    Ins->Ext = 0;
+    Ins->Flags = 0;
+    Ins->UseCount = 0;
+    Ins->DefCount = 1;
+    Ins->Target = IR_NONE;
+}
+
+void IrSetJump(IrFunction *Fn, U32 Index)
+{
+    PASCAL_NONNULL(Fn);
+    IrIns *Ins = &Fn->Ins[Index];
+    PASCAL_ASSERT(Ins->Flags & IR_INS_BRANCH, "Only a branch can become a jump");
+    PASCAL_ASSERT(Fn->Blocks[Ins->Block].Last == Index, "Branch must end its block");
+
+    /* the offset is patched when lowered */
+    Ins->Op = OP_BR;
+    Ins->Code[0] = PVM_BR(0);
+    Ins->Code[1] = 0;
+    Ins->Size = 2;
+    Ins->Ext = 0;
+    Ins->Flags = IR_INS_BRANCH | IR_INS_JUMP;
+    Ins->UseCount = 0;
+    Ins->DefCount = 0;
+    if (IR_NONE != Fn->Blocks[Ins->Block].Succ[0])
+        IrRemoveEdge(Fn, Ins->Block, 0);
+}
+
+void IrRemoveEdge(IrFunction *Fn, U32 Block, UInt Which)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_ASSERT(Which < 2, "Blocks have 2 successors");
+    U32 To = Fn->Blocks[Block].Succ[Which];
+    PASCAL_ASSERT(IR_NONE != To, "No edge to remove");
+    Fn->Blocks[Block].Succ[Which] = IR_NONE;
+
+    IrBlock *B = &Fn->Blocks[To];
+    U32 Index = 0;
+    while (Index < B->PredCount && B->Pred[Index] != Block)
+        Index++;
+    PASCAL_ASSERT(Index < B->PredCount, "Edge is not in the predecessor list");
+
+    U32 Tail = B->PredCount - Index - 1;
+    memmove(&B->Pred[Index], &B->Pred[Index + 1], Tail * sizeof *B->Pred);
+    B->PredCount--;
+    for (U32 i = B->First; IR_NONE != i && IR_OP_PHI == Fn->Ins[i].Op; i = Fn->Ins[i].Next)
+    {
+        IrIns *Phi = &Fn->Ins[i];
+        memmove(&Phi->Use[Index], &Phi->Use[Index + 1], Tail * sizeof *Phi->Use);
+        Phi->UseCount--;
+    }
+}
+
+void IrAddEdge(IrFunction *Fn, U32 Block, UInt Which, U32 To, U32 Like)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_ASSERT(Which < 2, "Blocks have 2 successors");
+    PASCAL_ASSERT(IR_NONE == Fn->Blocks[Block].Succ[Which], "Edge is already there");
+    Fn->Blocks[Block].Succ[Which] = To;
+
+    IrBlock *B = &Fn->Blocks[To];
+    U32 Index = 0;
+    while (Index < B->PredCount && B->Pred[Index] != Like)
+        Index++;
+    PASCAL_ASSERT(Index < B->PredCount, "Like is not a predecessor");
+
+    U32 *Pred = ArenaAllocate(Fn->Arena, (B->PredCount + 1) * sizeof *Pred);
+    memcpy(Pred, B->Pred, B->PredCount * sizeof *Pred);
+    Pred[B->PredCount] = Block;
+    B->Pred = Pred;
+    for (U32 i = B->First; IR_NONE != i && IR_OP_PHI == Fn->Ins[i].Op; i = Fn->Ins[i].Next)
+    {
+        IrIns *Phi = &Fn->Ins[i];
+        IrOperand *Use = ArenaAllocate(Fn->Arena, (Phi->UseCount + 1) * sizeof *Use);
+        memcpy(Use, Phi->Use, Phi->UseCount * sizeof *Use);
+        Use[Phi->UseCount] = Use[Index];
+        Phi->Use = Use;
+        Phi->UseCount++;
+    }
+    B->PredCount++;
+}
+
+void IrClearBlock(IrFunction *Fn, U32 Block)
+{
+    PASCAL_NONNULL(Fn);
+    while (IR_NONE != Fn->Blocks[Block].First)
+        IrRemoveIns(Fn, Fn->Blocks[Block].First);
+    for (UInt i = 0; i < 2; i++)
+    {
+        if (IR_NONE != Fn->Blocks[Block].Succ[i])
+            IrRemoveEdge(Fn, Block, i);
+    }
+}
+
+static bool IrIsRemovable(const IrIns *Ins)
+{
+    return IR_OP_ENTRY != Ins->Op
+        && 0 == (Ins->Flags & (IR_INS_SIDE_EFFECT | IR_INS_STORE | IR_INS_CALL | IR_INS_BRANCH | IR_INS_JUMP));
+}
+
+U32 IrRemoveDeadCode(IrFunction *Fn)
+{
+    PASCAL_NONNULL(Fn);
+    U32 *UseCount = ArenaAllocateZero(Fn->Arena, (Fn->ValueCount + 1) * sizeof *UseCount);
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            Ins->Use[k].Value = IrResolve(Fn, Ins->Use[k].Value);
+            if (IR_NONE != Ins->Use[k].Value)
+                UseCount[Ins->Use[k].Value]++;
+        }
+    }
+
+    /* backward, so that a chain goes in one sweep */
+    U32 Removed = 0;
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (U32 i = Fn->InsCount; i-- > 0; )
+        {
+            IrIns *Ins = &Fn->Ins[i];
+            if (IR_NONE == Ins->Block || !IrIsRemovable(Ins))
+                continue;
+
+            bool Used = false;
+            for (U32 k = 0; k < Ins->DefCount && !Used; k++)
+                Used = IR_NONE == Ins->Def[k].Value || 0 != UseCount[Ins->Def[k].Value];
+            if (Used)
+                continue;
+
+            for (U32 k = 0; k < Ins->UseCount; k++)
+            {
+                if (IR_NONE != Ins->Use[k].Value)
+                    UseCount[Ins->Use[k].Value]--;
+            }
+            IrRemoveIns(Fn, i);
+            Removed++;
+            Changed = true;
+        }
+    }
+    return Removed;
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   LIFTING
+ */
+/*===============================================================================*/
+
+
+static bool IrIsFixedReg(UInt Reg)
+{
+    return PVM_REG_GP == Reg || PVM_REG_FP == Reg || PVM_REG_SP == Reg;
+}
+
+static void IrUse(IrLifter *L, UInt Reg, IrSlot Slot)
+{
+    PASCAL_ASSERT(L->UseCount < IR_MAX_USES, "Too many uses");
+    L->Use[L->UseCount++] = (IrOperand) {
+        .Value = IR_NONE,
+        .Reg = Reg,
+        .Slot = Slot,
+    };
+}
+
+static void IrDef(IrLifter *L, UInt Reg, IrSlot Slot, IrType Type)
+{
+    PASCAL_ASSERT(L->DefCount < IR_MAX_DEFS, "Too many definitions");
+    /* SP, FP and GP are not values, whatever changes them has to stay */
+    if (IrIsFixedReg(Reg))
+        L->Flags |= IR_INS_SIDE_EFFECT;
+    L->DefType[L->DefCount] = Type;
+    L->Def[L->DefCount++] = (IrOperand) {
+        .Value = IR_NONE,
+        .Reg = Reg,
+        .Slot = Slot,
+    };
+}
+
+static void IrUseArgs(IrLifter *L)
+{
+    for (UInt i = 0; i < PVM_ARGREG_COUNT; i++)
+    {
+        IrUse(L, PVM_ARGREG_0 + i, IR_SLOT_FIXED);
+        IrUse(L, PVM_ARGREG_F0 + i, IR_SLOT_FIXED);
+    }
+}
+
+static void IrRegList(IrLifter *L, UInt Base, UInt List, bool Push, IrType Type)
+{
+    for (UInt i = 0; i < 8; i++)
+    {
+        if (0 == ((List >> i) & 1))
+            continue;
+        if (Push)
+            IrUse(L, Base + i, IR_SLOT_FIXED);
+        else IrDef(L, Base + i, IR_SLOT_FIXED, Type);
+    }
+}
+
+
+/* register operands of the instruction, returns false if it is not one the IR knows */
+static bool IrLiftOperands(IrLifter *L, const IrDecoded *D)
+{
+    UInt Rd = D->Rd, Rs = D->Rs, Rt = D->Rt;
+    switch (D->Op)
+    {
+    case OP_SYS:
+    {
+        switch (PVM_GET_SYS_OP(D->Opcode))
+        {
+        case OP_SYS_ENTER: L->Flags |= IR_INS_SIDE_EFFECT; break;
+        case OP_SYS_EXIT:
+        {
+            /* the return value */
+            IrUse(L, PVM_RETREG, IR_SLOT_FIXED);
+            IrUse(L, PVM_FRETREG, IR_SLOT_FIXED);
+            L->Flags |= IR_INS_JUMP | IR_INS_SIDE_EFFECT;
+        } break;
+        /* these write through the pointers they are given */
+        case OP_SYS_READ:
+        case OP_SYS_READLN:
+        case OP_SYS_ASSIGN:
+        case OP_SYS_READ_FILE:
+        case OP_SYS_READLN_FILE:
+        case OP_SYS_READ_RECORD:
+            L->Flags |= IR_INS_STORE;
+            FALLTHROUGH;
+        case OP_SYS_WRITE:
+        case OP_SYS_RESET:
+        case OP_SYS_REWRITE:
+        case OP_SYS_CLOSE:
+        case OP_SYS_WRITE_FILE:
+        case OP_SYS_EOF:
+        case OP_SYS_EOLN:
+        case OP_SYS_WRITE_RECORD:
+        case OP_SYS_SEEK:
+        case OP_SYS_FILESIZE:
+        case OP_SYS_FILEPOS:
+        {
+            /* the argument count or a result in R0, the file in R1 */
+            IrUse(L, 0, IR_SLOT_FIXED);
+            IrUse(L, 1, IR_SLOT_FIXED);
+            IrDef(L, 0, IR_SLOT_FIXED, IR_TYPE_I64);
+            L->Flags |= IR_INS_CALL | IR_INS_LOAD | IR_INS_SIDE_EFFECT;
+        } break;
+        default: return false;
+        }
+    } break;
+
+    case OP_DIV: case OP_IDIV: case OP_MOD:
+        L->Flags |= IR_INS_SIDE_EFFECT; /* division by 0 */
+        FALLTHROUGH;
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_IMUL:
+    case OP_AND: case OP_OR: case OP_XOR:
+    case OP_VSHL: case OP_VSHR: case OP_VASR:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+    } break;
+    case OP_DIV64: case OP_IDIV64: case OP_MOD64:
+        L->Flags |= IR_INS_SIDE_EFFECT;
+        FALLTHROUGH;
+    case OP_ADD64: case OP_SUB64: case OP_MUL64: case OP_IMUL64:
+    case OP_AND64: case OP_OR64: case OP_XOR64:
+    case OP_VSHL64: case OP_VSHR64: case OP_VASR64:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+    case OP_SADD:
+    {
+        /* Rd ends up pointing to the VM's temporary string */
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+        L->Flags |= IR_INS_LOAD | IR_INS_STORE | IR_INS_SIDE_EFFECT;
+    } break;
+
+    case OP_NEG: case OP_NOT: case OP_SETEZ:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+    } break;
+    case OP_NEG64: case OP_NOT64: case OP_SETEZ64:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+
+    /* Rs is an immediate */
+    case OP_ADDI: case OP_ADDQI:
+    case OP_QSHL: case OP_QSHR: case OP_QASR:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+    } break;
+    case OP_ADDI64: case OP_ADDQI64:
+    case OP_QSHL64: case OP_QSHR64: case OP_QASR64:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+
+    case OP_STRLT: case OP_STREQ:
+        L->Flags |= IR_INS_LOAD;
+        FALLTHROUGH;
+    case OP_SEQ: case OP_SLT: case OP_ISLT:
+    case OP_SEQ64: case OP_SLT64: case OP_ISLT64:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, IR_REG_FLAG, IR_SLOT_FIXED, IR_TYPE_FLAG);
+    } break;
+    case OP_STRCPY:
+    case OP_MEMCPY:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        L->Flags |= IR_INS_LOAD | IR_INS_STORE | IR_INS_SIDE_EFFECT;
+    } break;
+    case OP_VMEMCPY:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrUse(L, Rt, IR_SLOT_RT);
+        L->Flags |= IR_INS_LOAD | IR_INS_STORE | IR_INS_SIDE_EFFECT;
+    } break;
+    case OP_VMEMEQU:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrUse(L, Rt, IR_SLOT_RT);
+        IrDef(L, IR_REG_FLAG, IR_SLOT_FIXED, IR_TYPE_FLAG);
+        L->Flags |= IR_INS_LOAD;
+    } break;
+
+    case OP_BEZ: case OP_BNZ:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        L->Flags |= IR_INS_BRANCH;
+    } break;
+    case OP_BR: L->Flags |= IR_INS_BRANCH | IR_INS_JUMP; break;
+    case OP_BCT: case OP_BCF:
+    {
+        IrUse(L, IR_REG_FLAG, IR_SLOT_FIXED);
+        L->Flags |= IR_INS_BRANCH;
+    } break;
+    case OP_BRI:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+        L->Flags |= IR_INS_BRANCH | IR_INS_JUMP;
+    } break;
+    case OP_CALLPTR:
+        IrUse(L, Rd, IR_SLOT_RD);
+        FALLTHROUGH;
+    case OP_CALL:
+    {
+        IrUseArgs(L);
+        IrDef(L, PVM_RETREG, IR_SLOT_FIXED, IR_TYPE_I64);
+        IrDef(L, PVM_FRETREG, IR_SLOT_FIXED, IR_TYPE_F64);
+        L->Flags |= IR_INS_CALL | IR_INS_LOAD | IR_INS_STORE | IR_INS_SIDE_EFFECT;
+        if (OP_CALL == D->Op)
+            L->Flags |= IR_INS_SUBROUTINE_REF;
+    } break;
+    case OP_LDRIP:
+    {
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+        L->Flags |= IR_INS_SUBROUTINE_REF | IR_INS_SIDE_EFFECT;
+    } break;
+
+    case OP_PSHL: case OP_PSHH:
+    case OP_POPL: case OP_POPH:
+    case OP_FPSHL: case OP_FPSHH:
+    case OP_FPOPL: case OP_FPOPH:
+    {
+        PVMOp Op = D->Op;
+        bool IsHigh = OP_PSHH == Op || OP_POPH == Op || OP_FPSHH == Op || OP_FPOPH == Op;
+        bool IsFloat = OP_FPSHL == Op || OP_FPSHH == Op || OP_FPOPL == Op || OP_FPOPH == Op;
+        bool Push = OP_PSHL == Op || OP_PSHH == Op || OP_FPSHL == Op || OP_FPSHH == Op;
+        UInt Base = (IsHigh? 8 : 0) + ((D->Ext & PVM_EXT_S)? PVM_EXT_REG : 0) + (IsFloat? PVM_REG_COUNT : 0);
+        IrRegList(L, Base, PVM_GET_REGLIST(D->Opcode), Push, IsFloat? IR_TYPE_F64 : IR_TYPE_I64);
+        L->Flags |= (Push? IR_INS_STORE : IR_INS_LOAD) | IR_INS_SIDE_EFFECT;
+    } break;
+
+    case OP_FADD: case OP_FSUB: case OP_FMUL: case OP_FDIV:
+    {
+        IrUse(L, IR_F(Rd), IR_SLOT_RD);
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F32);
+    } break;
+    case OP_FADD64: case OP_FSUB64: case OP_FMUL64: case OP_FDIV64:
+    {
+        IrUse(L, IR_F(Rd), IR_SLOT_RD);
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F64);
+    } break;
+    case OP_FNEG: case OP_FMOV: case OP_F64TOF32:
+    {
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F32);
+    } break;
+    case OP_FNEG64: case OP_FMOV64: case OP_F32TOF64:
+    {
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F64);
+    } break;
+    case OP_FSEQ: case OP_FSGT: case OP_FSLT: case OP_FSNE: case OP_FSGE: case OP_FSLE:
+    case OP_FSEQ64: case OP_FSGT64: case OP_FSLT64: case OP_FSNE64: case OP_FSGE64: case OP_FSLE64:
+    {
+        IrUse(L, IR_F(Rd), IR_SLOT_RD);
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, IR_REG_FLAG, IR_SLOT_FIXED, IR_TYPE_FLAG);
+    } break;
+
+    case OP_GETFLAG: case OP_GETNFLAG:
+    {
+        IrUse(L, IR_REG_FLAG, IR_SLOT_FIXED);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+    } break;
+    case OP_SETFLAG: case OP_SETNFLAG:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrDef(L, IR_REG_FLAG, IR_SLOT_FIXED, IR_TYPE_FLAG);
+    } break;
+    case OP_NEGFLAG:
+    {
+        IrUse(L, IR_REG_FLAG, IR_SLOT_FIXED);
+        IrDef(L, IR_REG_FLAG, IR_SLOT_FIXED, IR_TYPE_FLAG);
+    } break;
+
+    case OP_MOV32: case OP_MOVZEX32_8: case OP_MOVZEX32_16:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+    } break;
+    case OP_MOV64: case OP_MOVZEX64_8: case OP_MOVZEX64_16: case OP_MOVZEX64_32: case OP_MOVSEX64_32:
+    case OP_LEA: case OP_LEAL:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+    case OP_MOVI: case OP_MOVQI:
+    {
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+
+    case OP_F64TOI64:
+    {
+        IrUse(L, IR_F(Rs), IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+    } break;
+    case OP_I64TOF64: case OP_U64TOF64: case OP_I32TOF64: case OP_U32TOF64:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F64);
+    } break;
+    case OP_I64TOF32: case OP_U64TOF32: case OP_I32TOF32: case OP_U32TOF32:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, IR_TYPE_F32);
+    } break;
+
+    case OP_LD32: case OP_LDZEX32_8: case OP_LDZEX32_16: case OP_LDSEX32_8: case OP_LDSEX32_16:
+    case OP_LD32L: case OP_LDZEX32_8L: case OP_LDZEX32_16L: case OP_LDSEX32_8L: case OP_LDSEX32_16L:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I32);
+        L->Flags |= IR_INS_LOAD;
+    } break;
+    case OP_LD64: case OP_LDZEX64_8: case OP_LDZEX64_16: case OP_LDZEX64_32:
+    case OP_LDSEX64_8: case OP_LDSEX64_16: case OP_LDSEX64_32:
+    case OP_LD64L: case OP_LDZEX64_8L: case OP_LDZEX64_16L: case OP_LDZEX64_32L:
+    case OP_LDSEX64_8L: case OP_LDSEX64_16L: case OP_LDSEX64_32L:
+    {
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, Rd, IR_SLOT_RD, IR_TYPE_I64);
+        L->Flags |= IR_INS_LOAD;
+    } break;
+    case OP_LDF32: case OP_LDF32L:
+    case OP_LDF64: case OP_LDF64L:
+    {
+        bool Is64 = OP_LDF64 == D->Op || OP_LDF64L == D->Op;
+        IrUse(L, Rs, IR_SLOT_RS);
+        IrDef(L, IR_F(Rd), IR_SLOT_RD, Is64? IR_TYPE_F64 : IR_TYPE_F32);
+        L->Flags |= IR_INS_LOAD;
+    } break;
+    /* Rd is stored at Rs + offset */
+    case OP_ST8: case OP_ST16: case OP_ST32: case OP_ST64:
+    case OP_ST8L: case OP_ST16L: case OP_ST32L: case OP_ST64L:
+    {
+        IrUse(L, Rd, IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        L->Flags |= IR_INS_STORE | IR_INS_SIDE_EFFECT;
+    } break;
+    case OP_STF32: case OP_STF32L:
+    case OP_STF64: case OP_STF64L:
+    {
+        IrUse(L, IR_F(Rd), IR_SLOT_RD);
+        IrUse(L, Rs, IR_SLOT_RS);
+        L->Flags |= IR_INS_STORE | IR_INS_SIDE_EFFECT;
+    } break;
+
+    default:
+    {
+        if (OP_BEQQI <= D->Op && D->Op <= OP_IBGEQI64)
+        {
+            /* Rs is an immediate */
+            IrUse(L, Rd, IR_SLOT_RD);
+            L->Flags |= IR_INS_BRANCH;
+        }
+        else if (OP_BEQ <= D->Op && D->Op <= OP_IBGE64)
+        {
+            IrUse(L, Rd, IR_SLOT_RD);
+            IrUse(L, Rs, IR_SLOT_RS);
+            L->Flags |= IR_INS_BRANCH;
+        }
+        else if (OP_FBEQ <= D->Op && D->Op <= OP_FBNLE64)
+        {
+            IrUse(L, IR_F(Rd), IR_SLOT_RD);
+            IrUse(L, IR_F(Rs), IR_SLOT_RS);
+            L->Flags |= IR_INS_BRANCH;
+        }
+        else if (OP_ADD3 <= D->Op && D->Op <= OP_VASR3_64)
+        {
+            bool Is64 = D->Op >= OP_ADD3_64;
+            PVMOp Op32 = Is64? D->Op - (OP_ADD3_64 - OP_ADD3) : D->Op;
+            if (OP_DIV3 == Op32 || OP_IDIV3 == Op32 || OP_MOD3 == Op32)
+                L->Flags |= IR_INS_SIDE_EFFECT;
+            IrUse(L, Rs, IR_SLOT_RS);
+            IrUse(L, Rt, IR_SLOT_RT);
+            IrDef(L, Rd, IR_SLOT_RD, Is64? IR_TYPE_I64 : IR_TYPE_I32);
+        }
+        else if (OP_FADD3 <= D->Op && D->Op <= OP_FDIV3_64)
+        {
+            bool Is64 = D->Op >= OP_FADD3_64;
+            IrUse(L, IR_F(Rs), IR_SLOT_RS);
+            IrUse(L, IR_F(Rt), IR_SLOT_RT);
+            IrDef(L, IR_F(Rd), IR_SLOT_RD, Is64? IR_TYPE_F64 : IR_TYPE_F32);
+        }
+        else return false;
+    } break;
+    }
+    return true;
+}
+
+
+static IrDecoded IrDecode(const U16 *Code, U32 Addr)
+{
+    IrDecoded D = { 0 };
+    U32 OpcodeAddr = Addr;
+    if (OP_EXT == PVM_GET_OP(Code[Addr]))
+    {
+        D.Ext = PVM_GET_EXT(Code[Addr]);
+        OpcodeAddr++;
+    }
+    const U16 *Ins = &Code[OpcodeAddr];
+    D.Opcode = Ins[0];
+    D.Op = PVM_GET_OP(D.Opcode);
+    D.Next = Addr + PVMInstructionSize(Code, Addr);
+    D.Size = D.Next - OpcodeAddr;
+    D.Rd = PVM_GET_RD(D.Opcode) + ((D.Ext & PVM_EXT_D)? PVM_EXT_REG : 0);
+    D.Rs = PVM_GET_RS(D.Opcode) + ((D.Ext & PVM_EXT_S)? PVM_EXT_REG : 0);
+    D.Rt = D.Size > 1
+        ? PVM_GET_RT(Ins[1]) + ((D.Ext & PVM_EXT_T)? PVM_EXT_REG : 0)
+        : 0;
+
+    /* same offsets as PVMDecodeChunk, from the end of the instruction */
+    D.HasTarget = true;
+    if (PVMIsCompareAndBranch(D.Op))
+    {
+        D.Target = D.Next + (I32)((U32)Ins[1] | (U32)Ins[2] << 16);
+        return D;
+    }
+    switch (D.Op)
+    {
+    case OP_BR:
+    case OP_BCT:
+    case OP_BCF:
+    {
+        D.Target = D.Next + BitSex32Safe(((U32)Ins[1] << 8) | ((U32)D.Opcode & 0xFF), 23);
+    } break;
+    case OP_BEZ:
+    case OP_BNZ:
+    {
+        D.Target = D.Next + BitSex32Safe(((U32)Ins[1] << 4) | ((U32)D.Opcode & 0xF), 19);
+    } break;
+    case OP_BRI:
+    {
+        D.Target = D.Next + (I16)Ins[1];
+    } break;
+    default: D.HasTarget = false; break;
+    }
+    return D;
+}
+
+
+
+
+static U32 IrEntryValue(IrBuilder *Builder, UInt Reg)
+{
+    if (IR_NONE != Builder->EntryValue[Reg])
+        return Builder->EntryValue[Reg];
+
+    IrFunction *Fn = Builder->Fn;
+    U32 Entry = Fn->Blocks[0].First;
+    IrIns *Ins = &Fn->Ins[Entry];
+    PASCAL_ASSERT(IR_OP_ENTRY == Ins->Op, "Entry block must start with entry");
+    U32 Value = IrNewValue(Fn, Entry, Reg, IR_TYPE_NONE);
+    Ins->Def[Ins->DefCount++] = (IrOperand) {
+        .Value = Value,
+        .Reg = Reg,
+        .Slot = IR_SLOT_FIXED,
+    };
+    Builder->EntryValue[Reg] = Value;
+    return Value;
+}
+
+static U32 IrReadAtEntry(IrBuilder *Builder, U32 Block, UInt Reg);
+
+static U32 IrReadAtEnd(IrBuilder *Builder, U32 Block, UInt Reg)
+{
+    U32 Value = Builder->LastDef[Block*IR_REG_COUNT + Reg];
+    if (IR_NONE != Value)
+        return Value;
+    return IrReadAtEntry(Builder, Block, Reg);
+}
+
+/* Braun et al., every block is sealed since the whole graph is known up front */
+static U32 IrReadAtEntry(IrBuilder *Builder, U32 Block, UInt Reg)
+{
+    IrFunction *Fn = Builder->Fn;
+    U32 *Slot = &Builder->EntryDef[Block*IR_REG_COUNT + Reg];
+    if (IR_NONE != *Slot)
+        return *Slot;
+
+    U32 Value;
+    const IrBlock *B = &Fn->Blocks[Block];
+    if (0 == Block || !Builder->Reachable[Block])
+    {
+        Value = IrEntryValue(Builder, Reg);
+    }
+    else if (1 == B->PredCount)
+    {
+        Value = IrReadAtEnd(Builder, B->Pred[0], Reg);
+    }
+    else
+    {
+        U32 PredCount = B->PredCount;
+        U32 Phi = IrNewIns(Fn, IR_OP_PHI);
+        Value = IrNewValue(Fn, Phi, Reg, IR_TYPE_NONE);
+        IrIns *Ins = &Fn->Ins[Phi];
+        Ins->UseCount = PredCount;
+        Ins->Use = ArenaAllocate(Fn->Arena, PredCount * sizeof *Ins->Use);
+        Ins->DefCount = 1;
+        Ins->Def = ArenaAllocate(Fn->Arena, sizeof *Ins->Def);
+        Ins->Def[0] = (IrOperand) { .Value = Value, .Reg = Reg, .Slot = IR_SLOT_FIXED };
+        IrPrepend(Fn, Block, Phi);
+
+        /* a loop comes back here before the operands are known */
+        *Slot = Value;
+        for (U32 i = 0; i < PredCount; i++)
+        {
+            U32 Operand = IrReadAtEnd(Builder, Fn->Blocks[Block].Pred[i], Reg);
+            Fn->Ins[Phi].Use[i] = (IrOperand) { .Value = Operand, .Reg = Reg, .Slot = IR_SLOT_FIXED };
+        }
+    }
+    *Slot = Value;
+    return Value;
+}
+
+
+/* a phi of itself and one other value is that value */
+static void IrRemoveTrivialPhis(IrFunction *Fn)
+{
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (U32 i = 0; i < Fn->InsCount; i++)
+        {
+            IrIns *Ins = &Fn->Ins[i];
+            if (IR_OP_PHI != Ins->Op || IR_NONE == Ins->Block)
+                continue;
+
+            U32 Self = Ins->Def[0].Value;
+            U32 Same = IR_NONE;
+            bool Trivial = true;
+            for (U32 k = 0; k < Ins->UseCount; k++)
+            {
+                U32 Operand = IrResolve(Fn, Ins->Use[k].Value);
+                Ins->Use[k].Value = Operand;
+                if (Operand == Self || Operand == Same)
+                    continue;
+                if (IR_NONE != Same)
+                {
+                    Trivial = false;
+                    break;
+                }
+                Same = Operand;
+            }
+            if (Trivial && IR_NONE != Same)
+            {
+                Fn->Values[Self].Forward = Same;
+                IrRemoveIns(Fn, i);
+                Changed = true;
+            }
+        }
+    }
+}
+
+static void IrResolveOperands(IrFunction *Fn)
+{
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        for (U32 k = 0; k < Ins->UseCount; k++)
+            Ins->Use[k].Value = IrResolve(Fn, Ins->Use[k].Value);
+    }
+
+    /* a phi has the type of what it merges */
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_OP_PHI != Ins->Op || IR_NONE == Ins->Block)
+            continue;
+        IrValue *Phi = &Fn->Values[Ins->Def[0].Value];
+        for (U32 k = 0; k < Ins->UseCount && IR_TYPE_NONE == Phi->Type; k++)
+            Phi->Type = Fn->Values[Ins->Use[k].Value].Type;
+    }
+}
+
+
+void IrSimplifyPhis(IrFunction *Fn)
+{
+    PASCAL_NONNULL(Fn);
+    IrRemoveTrivialPhis(Fn);
+    IrResolveOperands(Fn);
+}
+
+
+static void IrFindReachable(IrFunction *Fn, bool *Reachable)
+{
+    U32 *Stack = ArenaAllocate(Fn->Arena, Fn->BlockCount * sizeof *Stack);
+    U32 Count = 0;
+    Reachable[0] = true;
+    Stack[Count++] = 0;
+    while (Count)
+    {
+        const IrBlock *B = &Fn->Blocks[Stack[--Count]];
+        for (UInt i = 0; i < 2; i++)
+        {
+            U32 Succ = B->Succ[i];
+            if (IR_NONE != Succ && !Reachable[Succ])
+            {
+                Reachable[Succ] = true;
+                Stack[Count++] = Succ;
+            }
+        }
+    }
+}
+
+
+bool IrLift(IrFunction *Fn, PascalArena *Arena, const PVMChunk *Chunk, U32 Start, U32 End)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_NONNULL(Arena);
+    PASCAL_NONNULL(Chunk);
+
+    *Fn = (IrFunction) {
+        .Arena = Arena,
+        .Start = Start,
+        .End = End,
+    };
+    if (Start >= End || End - Start > IR_MAX_REGION_SIZE)
+        return false;
+
+    /* where instructions start */
+    const U16 *Code = Chunk->Code;
+    U32 Size = End - Start;
+    U8 *Mark = ArenaAllocateZero(Arena, Size + 1);
+    U32 InsCount = 0;
+    U32 Addr = Start;
+    while (Addr < End)
+    {
+        Mark[Addr - Start] = IR_MARK_INS;
+        InsCount++;
+        Addr += PVMInstructionSize(Code, Addr);
+    }
+    if (Addr != End)
+        return false;
+
+    /* blocks start at branch targets and after branches */
+    Mark[0] |= IR_MARK_LEADER;
+    Mark[Size] = IR_MARK_INS | IR_MARK_LEADER;
+    for (Addr = Start; Addr < End; Addr = IrDecode(Code, Addr).Next)
+    {
+        IrDecoded D = IrDecode(Code, Addr);
+        /* a nested subroutine, the parent falls through into it */
+        if (OP_SYS == D.Op && OP_SYS_ENTER == PVM_GET_SYS_OP(D.Opcode) && Addr != Start)
+            return false;
+        if (D.HasTarget)
+        {
+            if (D.Target < Start || D.Target > End || 0 == (Mark[D.Target - Start] & IR_MARK_INS))
+                return false;
+            Mark[D.Target - Start] |= IR_MARK_LEADER;
+            Mark[D.Next - Start] |= IR_MARK_LEADER;
+        }
+        else if (OP_SYS == D.Op && OP_SYS_EXIT == PVM_GET_SYS_OP(D.Opcode))
+        {
+            Mark[D.Next - Start] |= IR_MARK_LEADER;
+        }
+    }
+
+    U32 *BlockAt = ArenaAllocate(Arena, (Size + 1) * sizeof *BlockAt);
+    U32 BlockCount = 0;
+    for (U32 i = 0; i <= Size; i++)
+    {
+        if (Mark[i] & IR_MARK_LEADER)
+            BlockAt[i] = BlockCount++;
+    }
+    Fn->BlockCount = BlockCount;
+    Fn->Blocks = ArenaAllocate(Arena, BlockCount * sizeof *Fn->Blocks);
+    for (U32 i = 0; i <= Size; i++)
+    {
+        if (Mark[i] & IR_MARK_LEADER)
+        {
+            Fn->Blocks[BlockAt[i]] = (IrBlock) {
+                .First = IR_NONE,
+                .Last = IR_NONE,
+                .Succ = { IR_NONE, IR_NONE },
+                .StreamOffset = Start + i,
+                .Location = IR_NONE,
+            };
+        }
+    }
+
+
+    IrBuilder Builder = {
+        .Fn = Fn,
+        .LastDef = ArenaAllocate(Arena, BlockCount * IR_REG_COUNT * sizeof(U32)),
+        .EntryDef = ArenaAllocate(Arena, BlockCount * IR_REG_COUNT * sizeof(U32)),
+        .Reachable = ArenaAllocateZero(Arena, BlockCount * sizeof(bool)),
+    };
+    memset(Builder.LastDef, 0xFF, BlockCount * IR_REG_COUNT * sizeof(U32));
+    memset(Builder.EntryDef, 0xFF, BlockCount * IR_REG_COUNT * sizeof(U32));
+    memset(Builder.EntryValue, 0xFF, sizeof Builder.EntryValue);
+
+
+    /* the instructions, every definition is a new value */
+    Fn->InsCap = InsCount + 1;
+    Fn->Ins = ArenaAllocate(Arena, Fn->InsCap * sizeof *Fn->Ins);
+    U32 Entry = IrNewIns(Fn, IR_OP_ENTRY);
+    Fn->Ins[Entry].Def = ArenaAllocate(Arena, IR_REG_COUNT * sizeof *Fn->Ins[Entry].Def);
+    IrAppend(Fn, 0, Entry);
+
+    U32 Block = 0;
+    for (Addr = Start; Addr < End; )
+    {
+        IrDecoded D = IrDecode(Code, Addr);
+        if (Mark[Addr - Start] & IR_MARK_LEADER)
+            Block = BlockAt[Addr - Start];
+
+        IrLifter L = { 0 };
+        if (!IrLiftOperands(&L, &D))
+            return false;
+
+        U32 Index = IrNewIns(Fn, D.Op);
+        IrIns *Ins = &Fn->Ins[Index];
+        Ins->Flags = L.Flags;
+        Ins->Size = D.Size;
+        Ins->Ext = D.Ext;
+        Ins->StreamOffset = Addr;
+        memcpy(Ins->Code, &Code[D.Next - D.Size], D.Size * sizeof(U16));
+        if (D.HasTarget)
+            Ins->Target = BlockAt[D.Target - Start];
+
+        Ins->UseCount = L.UseCount;
+        Ins->Use = ArenaAllocate(Arena, (L.UseCount + 1) * sizeof *Ins->Use);
+        memcpy(Ins->Use, L.Use, L.UseCount * sizeof *Ins->Use);
+        Ins->DefCount = L.DefCount;
+        Ins->Def = ArenaAllocate(Arena, (L.DefCount + 1) * sizeof *Ins->Def);
+        for (UInt i = 0; i < L.DefCount; i++)
+        {
+            Ins->Def[i] = L.Def[i];
+            if (IrIsFixedReg(L.Def[i].Reg))
+                continue;
+            U32 Value = IrNewValue(Fn, Index, L.Def[i].Reg, L.DefType[i]);
+            Ins->Def[i].Value = Value;
+            Builder.LastDef[Block*IR_REG_COUNT + L.Def[i].Reg] = Value;
+        }
+        IrAppend(Fn, Block, Index);
+        Addr = D.Next;
+    }
+
+
+    /* edges, the empty block at the end has none */
+    U32 *PredCount = ArenaAllocateZero(Arena, BlockCount * sizeof *PredCount);
+    for (U32 b = 0; b + 1 < BlockCount; b++)
+    {
+        IrBlock *B = &Fn->Blocks[b];
+        const IrIns *Last = &Fn->Ins[B->Last];
+        if (Last->Flags & IR_INS_BRANCH)
+            B->Succ[1] = Last->Target;
+        if (0 == (Last->Flags & IR_INS_JUMP))
+            B->Succ[0] = b + 1;
+        for (UInt i = 0; i < 2; i++)
+        {
+            if (IR_NONE != B->Succ[i])
+                PredCount[B->Succ[i]]++;
+        }
+    }
+    for (U32 b = 0; b < BlockCount; b++)
+    {
+        Fn->Blocks[b].Pred = ArenaAllocate(Arena, (PredCount[b] + 1) * sizeof(U32));
+    }
+    for (U32 b = 0; b < BlockCount; b++)
+    {
+        for (UInt i = 0; i < 2; i++)
+        {
+            U32 Succ = Fn->Blocks[b].Succ[i];
+            if (IR_NONE != Succ)
+                Fn->Blocks[Succ].Pred[Fn->Blocks[Succ].PredCount++] = b;
+        }
+    }
+    /* the entry values would need a phi */
+    if (Fn->Blocks[0].PredCount)
+        return false;
+    IrFindReachable(Fn, Builder.Reachable);
+
+
+    /* uses, from the block itself or what flows into it */
+    U32 Current[IR_REG_COUNT];
+    for (U32 b = 0; b < BlockCount; b++)
+    {
+        memset(Current, 0xFF, sizeof Current);
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            if (IR_OP_PHI == Fn->Ins[i].Op || IR_OP_ENTRY == Fn->Ins[i].Op)
+                continue;
+            for (U32 k = 0; k < Fn->Ins[i].UseCount; k++)
+            {
+                UInt Reg = Fn->Ins[i].Use[k].Reg;
+                if (IrIsFixedReg(Reg))
+                    continue;
+                U32 Value = IR_NONE != Current[Reg]
+                    ? Current[Reg]
+                    : IrReadAtEntry(&Builder, b, Reg);
+                /* Fn->Ins can move when a phi is created */
+                Fn->Ins[i].Use[k].Value = Value;
+            }
+            for (U32 k = 0; k < Fn->Ins[i].DefCount; k++)
+            {
+                const IrOperand *Def = &Fn->Ins[i].Def[k];
+                if (IR_NONE != Def->Value)
+                    Current[Def->Reg] = Def->Value;
+            }
+        }
+    }
+    IrSimplifyPhis(Fn);
+    return true;
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   LOWERING
+ */
+/*===============================================================================*/
+
+
+static UInt IrRegOf(IrFunction *Fn, const IrOperand *Operand)
+{
+    if (IR_NONE == Operand->Value)
+        return Operand->Reg;
+    return Fn->Values[IrResolve(Fn, Operand->Value)].Reg;
+}
+
+/* the register fields and prefix bits of the operands */
+static void IrEncodeOperands(IrFunction *Fn, const IrOperand *Operands, U32 Count, U16 *Code, UInt *Ext)
+{
+    for (U32 i = 0; i < Count; i++)
+    {
+        UInt Reg = IrRegOf(Fn, &Operands[i]);
+        U16 Field = Reg & 0xF;
+        bool High = 0 != (Reg & PVM_EXT_REG);
+        switch ((IrSlot)Operands[i].Slot)
+        {
+        case IR_SLOT_RD:
+        {
+            Code[0] = (Code[0] & ~0x00F0) | Field << 4;
+            *Ext = High? *Ext | PVM_EXT_D : *Ext & ~PVM_EXT_D;
+        } break;
+        case IR_SLOT_RS:
+        {
+            Code[0] = (Code[0] & ~0x000F) | Field;
+            *Ext = High? *Ext | PVM_EXT_S : *Ext & ~PVM_EXT_S;
+        } break;
+        case IR_SLOT_RT:
+        {
+            Code[1] = (Code[1] & ~0x00F0) | Field << 4;
+            *Ext = High? *Ext | PVM_EXT_T : *Ext & ~PVM_EXT_T;
+        } break;
+        case IR_SLOT_FIXED: break;
+        }
+    }
+}
+
+static void IrLowerIns(IrFunction *Fn, PVMChunk *Chunk, IrIns *Ins)
+{
+    Ins->Location = Chunk->Count;
+    if (IR_OP_PHI == Ins->Op)
+    {
+        UInt Reg = IrRegOf(Fn, &Ins->Def[0]);
+        for (U32 i = 0; i < Ins->UseCount; i++)
+        {
+            PASCAL_ASSERT(IrRegOf(Fn, &Ins->Use[i]) == Reg, "Phi operands must be in the same register");
+        }
+        return;
+    }
+    if (IR_OP_ENTRY == Ins->Op)
+        return;
+
+    U16 Code[IR_MAX_INS_SIZE];
+    UInt Ext = Ins->Ext;
+    memcpy(Code, Ins->Code, sizeof Code);
+    IrEncodeOperands(Fn, Ins->Use, Ins->UseCount, Code, &Ext);
+    IrEncodeOperands(Fn, Ins->Def, Ins->DefCount, Code, &Ext);
+
+    Ins->Location = ChunkWriteOp(Chunk, Code[0] | (U32)Ext << 16);
+    for (UInt i = 1; i < Ins->Size; i++)
+        ChunkWriteCode(Chunk, Code[i]);
+}
+
+void IrLower(IrFunction *Fn, PVMEmitter *Emitter)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_NONNULL(Emitter);
+
+    PVMChunk *Chunk = Emitter->Chunk;
+    Chunk->Count = Fn->Start;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        Fn->Blocks[b].Location = Chunk->Count;
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+            IrLowerIns(Fn, Chunk, &Fn->Ins[i]);
+    }
+
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            const IrIns *Ins = &Fn->Ins[i];
+            if (Ins->Flags & IR_INS_BRANCH)
+                PVMPatchBranch(Emitter, Ins->Location, Fn->Blocks[Ins->Target].Location);
+        }
+    }
+    /* nothing written before can be merged with what comes next */
+    PVMGetCurrentLocation(Emitter);
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   DUMP
+ */
+/*===============================================================================*/
+
+
+static void IrDumpReg(FILE *Out, UInt Reg)
+{
+    if (IR_REG_FLAG == Reg)
+        fprintf(Out, "flag");
+    else if (PVM_REG_SP == Reg)
+        fprintf(Out, "rsp");
+    else if (PVM_REG_FP == Reg)
+        fprintf(Out, "rfp");
+    else if (PVM_REG_GP == Reg)
+        fprintf(Out, "rgp");
+    else if (Reg >= PVM_REG_COUNT)
+        fprintf(Out, "f%u", Reg - PVM_REG_COUNT);
+    else fprintf(Out, "r%u", Reg);
+}
+
+static void IrDumpOperand(const IrFunction *Fn, FILE *Out, const IrOperand *Operand, bool WithType)
+{
+    static const char *TypeName[] = {
+        [IR_TYPE_NONE] = "?",
+        [IR_TYPE_I32] = "i32",
+        [IR_TYPE_I64] = "i64",
+        [IR_TYPE_F32] = "f32",
+        [IR_TYPE_F64] = "f64",
+        [IR_TYPE_FLAG] = "flag",
+    };
+    fputc(' ', Out);
+    if (IR_NONE == Operand->Value)
+    {
+        IrDumpReg(Out, Operand->Reg);
+        return;
+    }
+    const IrValue *Value = &Fn->Values[Operand->Value];
+    fprintf(Out, "v%u", Operand->Value);
+    if (WithType)
+        fprintf(Out, ":%s", TypeName[Value->Type]);
+    fputc('(', Out);
+    IrDumpReg(Out, Value->Reg);
+    fputc(')', Out);
+}
+
+void IrDump(const IrFunction *Fn, FILE *Out)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_NONNULL(Out);
+
+    fprintf(Out, "IR of [%u, %u): %u blocks, %u values\n", Fn->Start, Fn->End, Fn->BlockCount, Fn->ValueCount);
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        const IrBlock *B = &Fn->Blocks[b];
+        fprintf(Out, "b%u @%u:", b, B->StreamOffset);
+        for (U32 i = 0; i < B->PredCount; i++)
+            fprintf(Out, " b%u", B->Pred[i]);
+        fputc('\n', Out);
+
+        for (U32 i = B->First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            const IrIns *Ins = &Fn->Ins[i];
+            if (IR_OP_PHI == Ins->Op)
+                fprintf(Out, "    phi  ");
+            else if (IR_OP_ENTRY == Ins->Op)
+                fprintf(Out, "    entry");
+            else fprintf(Out, "    %-5s", PVMMnemonic(Ins->Code[0]));
+
+            for (U32 k = 0; k < Ins->DefCount; k++)
+                IrDumpOperand(Fn, Out, &Ins->Def[k], true);
+            if (Ins->UseCount)
+                fprintf(Out, " <-");
+            for (U32 k = 0; k < Ins->UseCount; k++)
+                IrDumpOperand(Fn, Out, &Ins->Use[k], false);
+            if (Ins->Flags & IR_INS_BRANCH)
+                fprintf(Out, " -> b%u", Ins->Target);
+            fputc('\n', Out);
+        }
+    }
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   DRIVER
+ */
+/*===============================================================================*/
+
+
+/* instructions are in the order they were lifted in */
+static U32 IrInsAt(const IrFunction *Fn, U32 StreamOffset)
+{
+    U32 Lo = 0, Hi = Fn->InsCount;
+    while (Lo < Hi)
+    {
+        U32 Mid = Lo + (Hi - Lo) / 2;
+        U32 Offset = Fn->Ins[Mid].StreamOffset;
+        if (IR_OP_ENTRY == Fn->Ins[Mid].Op || Offset < StreamOffset)
+            Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    if (Lo < Fn->InsCount && Fn->Ins[Lo].StreamOffset == StreamOffset)
+        return Lo;
+    return IR_NONE;
+}
+
+bool IrFindReferences(PascalCompiler *Compiler, IrFunction *Fn)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Fn);
+    for (U32 i = 0; i < Compiler->SubroutineReferences.Count; i++)
+    {
+        U32 CallSite = Compiler->SubroutineReferences.Data[i].CallSite;
+        if (CallSite < Fn->Start || CallSite >= Fn->End)
+            continue;
+
+        U32 Index = IrInsAt(Fn, CallSite);
+        if (IR_NONE == Index || 0 == (Fn->Ins[Index].Flags & IR_INS_SUBROUTINE_REF))
+            return false;
+        Fn->Ins[Index].Reference = i;
+    }
+    return true;
+}
+
+static void IrMoveDebugInfo(const IrFunction *Fn, PVMChunk *Chunk, U32 NewEnd)
+{
+    /* an instruction that is gone takes the place of the next one */
+    U32 Size = Fn->End - Fn->Start;
+    U32 *Location = ArenaAllocate(Fn->Arena, (Size + 1) * sizeof *Location);
+    memset(Location, 0xFF, (Size + 1) * sizeof *Location);
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE != Ins->Block && IR_NONE != Ins->StreamOffset)
+            Location[Ins->StreamOffset - Fn->Start] = Ins->Location;
+    }
+    Location[Size] = NewEnd;
+    for (U32 i = Size; i > 0; i--)
+    {
+        if (IR_NONE == Location[i - 1])
+            Location[i - 1] = Location[i];
+    }
+
+    for (U32 i = 0; i < Chunk->Debug.Count; i++)
+    {
+        LineDebugInfo *Info = &Chunk->Debug.Info[i];
+        if (Fn->Start <= Info->StreamOffset && Info->StreamOffset <= Fn->End)
+            Info->StreamOffset = Location[Info->StreamOffset - Fn->Start];
+    }
+}
+
+/* call sites that were optimized away are dropped from the compiler's list */
+static void IrMoveReferences(PascalCompiler *Compiler, const IrFunction *Fn)
+{
+    bool Dropped = false;
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Reference)
+            continue;
+        Dropped = Dropped || IR_NONE == Ins->Block;
+        Compiler->SubroutineReferences.Data[Ins->Reference].CallSite = IR_NONE == Ins->Block
+            ? IR_NONE
+            : Ins->Location;
+    }
+    if (!Dropped)
+        return;
+
+    U32 Count = 0;
+    for (U32 i = 0; i < Compiler->SubroutineReferences.Count; i++)
+    {
+        if (IR_NONE != Compiler->SubroutineReferences.Data[i].CallSite)
+            Compiler->SubroutineReferences.Data[Count++] = Compiler->SubroutineReferences.Data[i];
+    }
+    Compiler->SubroutineReferences.Count = Count;
+}
+
+/* registers the code of Fn writes, with what the subroutines it calls write.
+ * Only the registers it was lifted with are the ones written, Fn has to be lifted from what was emitted */
+static U64 IrClobbers(const PascalCompiler *Compiler, const IrFunction *Fn)
+{
+    U64 Clobbers = 0;
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        if (OP_CALLPTR == Ins->Op || (OP_CALL == Ins->Op && IR_NONE == Ins->Reference))
+            return UINT64_MAX;
+        if (OP_CALL == Ins->Op)
+            Clobbers |= SubroutineClobbers(Compiler,
+                    Compiler->SubroutineReferences.Data[Ins->Reference].SubroutineLocation
+            );
+        for (U32 k = 0; k < Ins->DefCount; k++)
+        {
+            if (Ins->Def[k].Reg < IR_REG_FLAG)
+                Clobbers |= (U64)1 << Ins->Def[k].Reg;
+        }
+    }
+    return Clobbers;
+}
+
+U64 IrOptimizeSubroutine(PascalCompiler *Compiler, U32 Start)
+{
+    PASCAL_NONNULL(Compiler);
+
+    PVMEmitter *Emitter = EMITTER();
+    PVMChunk *Chunk = Emitter->Chunk;
+    U32 End = Chunk->Count;
+    if (Compiler->Error || !Emitter->ShouldEmit || End - Start > IR_MAX_REGION_SIZE)
+        return UINT64_MAX;
+
+    PascalArena Arena = ArenaInit(IR_ARENA_SIZE, 4);
+    IrFunction Fn;
+    U64 Clobbers = UINT64_MAX;
+    bool Lifted = IrLift(&Fn, &Arena, Chunk, Start, End) && IrFindReferences(Compiler, &Fn);
+    /* the promoted variables only become values once the code is lifted again */
+    if (Lifted && Compiler->Flags.OptLevel >= 1 && IrPromoteLocals(Compiler, &Fn))
+    {
+        IrLower(&Fn, Emitter);
+        IrMoveReferences(Compiler, &Fn);
+        IrMoveDebugInfo(&Fn, Chunk, Chunk->Count);
+        ArenaReset(&Arena);
+        Lifted = IrLift(&Fn, &Arena, Chunk, Start, Chunk->Count) && IrFindReferences(Compiler, &Fn);
+    }
+    if (Lifted)
+    {
+        if (Compiler->Flags.OptLevel >= 1)
+        {
+            IrPropagateConstants(&Fn);
+            IrRemoveDeadCode(&Fn);
+            U32 Rules = PEEPHOLE_ALL_RULES;
+            if (Compiler->Flags.NoThreeOperand)
+                Rules &= ~(1u << PEEPHOLE_THREE_OPERAND);
+            IrPeephole(&Fn, Rules, &Compiler->Peephole);
+            /* spills whose reload got the register back go away */
+            if (IrAllocateRegisters(&Fn))
+                IrPeephole(&Fn, Rules, &Compiler->Peephole);
+        }
+        if (Compiler->Flags.DumpIr)
+            IrDump(&Fn, Compiler->LogFile);
+
+        IrLower(&Fn, Emitter);
+        IrMoveReferences(Compiler, &Fn);
+        IrMoveDebugInfo(&Fn, Chunk, Chunk->Count);
+
+        /* the passes moved values to other registers than the ones they were lifted with */
+        ArenaReset(&Arena);
+        if (IrLift(&Fn, &Arena, Chunk, Start, Chunk->Count) && IrFindReferences(Compiler, &Fn))
+            Clobbers = IrClobbers(Compiler, &Fn);
+    }
+    ArenaDeinit(&Arena);
+    return Clobbers;
+}
+
+
+#undef IR_MARK_INS
+#undef IR_MARK_LEADER
+#undef IR_MAX_USES
+#undef IR_MAX_DEFS
+#undef IR_F
+
@@ -0,0 +1,198 @@
+
+#include <string.h>
+
+#include "Compiler/Link.h"
+#include "Compiler/Data.h"
+
+
+
+#define LINK_NONE UINT32_MAX
+
+
+/* a subroutine at global scope, with all the ones nested in it */
+typedef struct LinkUnit
+{
+    U32 Start, End;
+    U32 RemovedBefore;  /* halfwords of dead units before this one */
+    bool Live;
+} LinkUnit;
+
+typedef struct Linker
+{
+    LinkUnit *Units;
+    U32 UnitCount;
+    U32 Removed;
+} Linker;
+
+
+
+
+/* the unit Offset is in, or LINK_NONE for code outside of subroutines */
+static U32 LinkUnitOf(const Linker *L, U32 Offset)
+{
+    U32 Lo = 0, Hi = L->UnitCount;
+    while (Lo < Hi)
+    {
+        U32 Mid = Lo + (Hi - Lo) / 2;
+        if (L->Units[Mid].Start <= Offset)
+            Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    if (0 == Lo || Offset >= L->Units[Lo - 1].End)
+        return LINK_NONE;
+    return Lo - 1;
+}
+
+static bool LinkIsDead(const Linker *L, U32 Offset)
+{
+    U32 Unit = LinkUnitOf(L, Offset);
+    return LINK_NONE != Unit && !L->Units[Unit].Live;
+}
+
+/* where Offset is once the dead units before it are gone */
+static U32 LinkMove(const Linker *L, U32 Offset)
+{
+    U32 Lo = 0, Hi = L->UnitCount;
+    while (Lo < Hi)
+    {
+        U32 Mid = Lo + (Hi - Lo) / 2;
+        if (L->Units[Mid].End <= Offset)
+            Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    return Offset - (Lo == L->UnitCount? L->Removed : L->Units[Lo].RemovedBefore);
+}
+
+
+static void LinkMarkLive(PascalCompiler *Compiler, Linker *L)
+{
+    /* code outside of subroutines is the entry point and is always there */
+    U32 Entry = LinkUnitOf(L, Compiler->EntryPoint);
+    if (LINK_NONE != Entry)
+        L->Units[Entry].Live = true;
+
+    /* callers come after their callees more often than not, so this is backward */
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (U32 i = Compiler->SubroutineReferences.Count; i-- > 0;)
+        {
+            U32 From = LinkUnitOf(L, Compiler->SubroutineReferences.Data[i].CallSite);
+            U32 To = LinkUnitOf(L, *Compiler->SubroutineReferences.Data[i].SubroutineLocation);
+            if ((LINK_NONE == From || L->Units[From].Live) && LINK_NONE != To && !L->Units[To].Live)
+            {
+                L->Units[To].Live = true;
+                Changed = true;
+            }
+        }
+    }
+}
+
+static U32 LinkCompact(PascalCompiler *Compiler, Linker *L)
+{
+    PVMChunk *Chunk = EMITTER()->Chunk;
+    for (U32 i = 0; i < L->UnitCount; i++)
+    {
+        L->Units[i].RemovedBefore = L->Removed;
+        if (!L->Units[i].Live)
+            L->Removed += L->Units[i].End - L->Units[i].Start;
+    }
+    if (0 == L->Removed)
+        return 0;
+
+    /* everything that points into the code, while the old offsets still mean something */
+    for (U32 i = 0; i < Compiler->SubroutineBodies.Count; i++)
+    {
+        U32 *Location = Compiler->SubroutineBodies.Data[i].Location;
+        if (!LinkIsDead(L, *Location))
+            *Location = LinkMove(L, *Location);
+    }
+    U32 Count = 0;
+    for (U32 i = 0; i < Compiler->SubroutineReferences.Count; i++)
+    {
+        U32 CallSite = Compiler->SubroutineReferences.Data[i].CallSite;
+        if (LinkIsDead(L, CallSite))
+            continue;
+        Compiler->SubroutineReferences.Data[Count] = Compiler->SubroutineReferences.Data[i];
+        Compiler->SubroutineReferences.Data[Count].CallSite = LinkMove(L, CallSite);
+        Count++;
+    }
+    Compiler->SubroutineReferences.Count = Count;
+    Compiler->EntryPoint = LinkMove(L, Compiler->EntryPoint);
+
+    Count = 0;
+    for (U32 i = 0; i < Chunk->Debug.Count; i++)
+    {
+        LineDebugInfo *Info = &Chunk->Debug.Info[i];
+        if (LinkIsDead(L, Info->StreamOffset))
+            continue;
+        Info->StreamOffset = LinkMove(L, Info->StreamOffset);
+        if (Count != i)
+            Chunk->Debug.Info[Count] = *Info;
+        Count++;
+    }
+    Chunk->Debug.Count = Count;
+
+    /* then the code itself, live units keep their layout so branches within them are still right */
+    U32 Write = 0, Read = 0;
+    for (U32 i = 0; i < L->UnitCount; i++)
+    {
+        if (L->Units[i].Live)
+            continue;
+        memmove(&Chunk->Code[Write], &Chunk->Code[Read], (L->Units[i].Start - Read) * sizeof *Chunk->Code);
+        Write += L->Units[i].Start - Read;
+        Read = L->Units[i].End;
+    }
+    memmove(&Chunk->Code[Write], &Chunk->Code[Read], (Chunk->Count - Read) * sizeof *Chunk->Code);
+    Chunk->Count = Write + (Chunk->Count - Read);
+
+    /* nothing written before can be merged with what comes next */
+    PVMGetCurrentLocation(EMITTER());
+    return L->Removed;
+}
+
+
+
+
+U32 LinkRemoveDeadSubroutines(PascalCompiler *Compiler)
+{
+    PASCAL_NONNULL(Compiler);
+
+    U32 UnitCount = 0;
+    for (U32 i = 0; i < Compiler->SubroutineBodies.Count; i++)
+        UnitCount += !Compiler->SubroutineBodies.Data[i].IsNested;
+    if (0 == UnitCount)
+        return 0;
+
+    Linker L = {
+        .Units = GPAAllocateArray(&Compiler->InternalAlloc, LinkUnit, UnitCount),
+        .UnitCount = 0,
+        .Removed = 0,
+    };
+    for (U32 i = 0; i < Compiler->SubroutineBodies.Count; i++)
+    {
+        if (Compiler->SubroutineBodies.Data[i].IsNested)
+            continue;
+        LinkUnit Unit = {
+            .Start = *Compiler->SubroutineBodies.Data[i].Location,
+            .End = Compiler->SubroutineBodies.Data[i].End,
+        };
+        /* the code is not laid out like the compiler left it, better keep everything */
+        if (Unit.Start >= Unit.End || (0 != L.UnitCount && L.Units[L.UnitCount - 1].End > Unit.Start))
+        {
+            GPADeallocate(&Compiler->InternalAlloc, L.Units);
+            return 0;
+        }
+        L.Units[L.UnitCount++] = Unit;
+    }
+
+    LinkMarkLive(Compiler, &L);
+    U32 Removed = LinkCompact(Compiler, &L);
+    GPADeallocate(&Compiler->InternalAlloc, L.Units);
+    return Removed;
+}
+
+
+#undef LINK_NONE
+
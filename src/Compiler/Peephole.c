@@ -0,0 +1,706 @@
+
+#include "Compiler/Peephole.h"
+
+
+
+/* how far back or ahead a rule looks for the other half of its pattern */
+#define PEEPHOLE_WINDOW 16
+
+
+typedef struct Peephole
+{
+    IrFunction *Fn;
+    U32 *UseCount;  /* per value */
+} Peephole;
+
+typedef bool (*PeepholeRuleFn)(Peephole *P, U32 Index);
+
+/* a load or store of an FP, GP, SP or pointer relative slot */
+typedef struct PeepholeAccess
+{
+    UInt Width;
+    UInt Class;     /* 0 unless the load gives back exactly what the same class of store wrote */
+    bool IsStore;
+    const IrOperand *Base;
+    I32 Offset;
+} PeepholeAccess;
+
+enum {
+    PEEPHOLE_CLASS_NONE = 0,
+    PEEPHOLE_CLASS_I32,
+    PEEPHOLE_CLASS_I64,
+    PEEPHOLE_CLASS_F32,
+    PEEPHOLE_CLASS_F64,
+};
+
+
+
+
+static UInt PeepholeRegOf(IrFunction *Fn, const IrOperand *Operand)
+{
+    if (IR_NONE == Operand->Value)
+        return Operand->Reg;
+    return Fn->Values[IrResolve(Fn, Operand->Value)].Reg;
+}
+
+static bool PeepholeTouchesReg(IrFunction *Fn, const IrIns *Ins, UInt Reg)
+{
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        if (PeepholeRegOf(Fn, &Ins->Use[i]) == Reg)
+            return true;
+    }
+    for (U32 i = 0; i < Ins->DefCount; i++)
+    {
+        if (PeepholeRegOf(Fn, &Ins->Def[i]) == Reg)
+            return true;
+    }
+    return false;
+}
+
+static bool PeepholeDefinesReg(IrFunction *Fn, const IrIns *Ins, UInt Reg)
+{
+    for (U32 i = 0; i < Ins->DefCount; i++)
+    {
+        if (PeepholeRegOf(Fn, &Ins->Def[i]) == Reg)
+            return true;
+    }
+    return false;
+}
+
+static const IrOperand *PeepholeOperandAt(const IrIns *Ins, IrSlot Slot)
+{
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        if (Slot == Ins->Use[i].Slot)
+            return &Ins->Use[i];
+    }
+    return NULL;
+}
+
+static bool PeepholeIsPushOrPop(U16 Op)
+{
+    return OP_PSHL == Op || OP_PSHH == Op || OP_FPSHL == Op || OP_FPSHH == Op
+        || OP_POPL == Op || OP_POPH == Op || OP_FPOPL == Op || OP_FPOPH == Op;
+}
+
+static bool PeepholeAccessOf(const IrIns *Ins, PeepholeAccess *Access)
+{
+    PeepholeAccess A = { 0 };
+    switch ((PVMOp)Ins->Op)
+    {
+    case OP_LD32: case OP_LD32L:    A.Width = 4; A.Class = PEEPHOLE_CLASS_I32; break;
+    case OP_LD64: case OP_LD64L:    A.Width = 8; A.Class = PEEPHOLE_CLASS_I64; break;
+    case OP_LDF32: case OP_LDF32L:  A.Width = 4; A.Class = PEEPHOLE_CLASS_F32; break;
+    case OP_LDF64: case OP_LDF64L:  A.Width = 8; A.Class = PEEPHOLE_CLASS_F64; break;
+    case OP_LDZEX32_8: case OP_LDZEX32_8L: case OP_LDZEX64_8: case OP_LDZEX64_8L:
+    case OP_LDSEX32_8: case OP_LDSEX32_8L: case OP_LDSEX64_8: case OP_LDSEX64_8L:
+                                    A.Width = 1; break;
+    case OP_LDZEX32_16: case OP_LDZEX32_16L: case OP_LDZEX64_16: case OP_LDZEX64_16L:
+    case OP_LDSEX32_16: case OP_LDSEX32_16L: case OP_LDSEX64_16: case OP_LDSEX64_16L:
+                                    A.Width = 2; break;
+    case OP_LDZEX64_32: case OP_LDZEX64_32L: case OP_LDSEX64_32: case OP_LDSEX64_32L:
+                                    A.Width = 4; break;
+
+    case OP_ST8: case OP_ST8L:      A.Width = 1; A.IsStore = true; break;
+    case OP_ST16: case OP_ST16L:    A.Width = 2; A.IsStore = true; break;
+    case OP_ST32: case OP_ST32L:    A.Width = 4; A.IsStore = true; A.Class = PEEPHOLE_CLASS_I32; break;
+    case OP_ST64: case OP_ST64L:    A.Width = 8; A.IsStore = true; A.Class = PEEPHOLE_CLASS_I64; break;
+    case OP_STF32: case OP_STF32L:  A.Width = 4; A.IsStore = true; A.Class = PEEPHOLE_CLASS_F32; break;
+    case OP_STF64: case OP_STF64L:  A.Width = 8; A.IsStore = true; A.Class = PEEPHOLE_CLASS_F64; break;
+    default: return false;
+    }
+    A.Base = PeepholeOperandAt(Ins, IR_SLOT_RS);
+    A.Offset = 2 == Ins->Size
+        ? (I16)Ins->Code[1]
+        : (I32)((U32)Ins->Code[1] | (U32)Ins->Code[2] << 16);
+    *Access = A;
+    return NULL != A.Base;
+}
+
+static bool PeepholeSameBase(IrFunction *Fn, const IrOperand *A, const IrOperand *B)
+{
+    if (IR_NONE == A->Value || IR_NONE == B->Value)
+        return IR_NONE == A->Value && IR_NONE == B->Value && A->Reg == B->Reg;
+    return IrResolve(Fn, A->Value) == IrResolve(Fn, B->Value);
+}
+
+static bool PeepholeOverlaps(const PeepholeAccess *A, const PeepholeAccess *B)
+{
+    return (I64)A->Offset < (I64)B->Offset + B->Width
+        && (I64)B->Offset < (I64)A->Offset + A->Width;
+}
+
+/* the frame and globals are apart, nothing else is known to be */
+static bool PeepholeMayAlias(IrFunction *Fn, const PeepholeAccess *A, const PeepholeAccess *B)
+{
+    if (PeepholeSameBase(Fn, A->Base, B->Base))
+        return PeepholeOverlaps(A, B);
+    bool FixedA = IR_NONE == A->Base->Value && PVM_REG_SP != A->Base->Reg;
+    bool FixedB = IR_NONE == B->Base->Value && PVM_REG_SP != B->Base->Reg;
+    return !(FixedA && FixedB);
+}
+
+
+static void PeepholeForward(Peephole *P, U32 From, U32 To)
+{
+    P->Fn->Values[From].Forward = To;
+    P->UseCount[To] += P->UseCount[From];
+    P->UseCount[From] = 0;
+}
+
+static void PeepholeRemove(Peephole *P, U32 Index)
+{
+    IrIns *Ins = &P->Fn->Ins[Index];
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        U32 Value = IrResolve(P->Fn, Ins->Use[i].Value);
+        if (IR_NONE != Value)
+            P->UseCount[Value]--;
+    }
+    IrRemoveIns(P->Fn, Index);
+}
+
+
+
+
+/*===============================================================================*/
+/*
+ *                                   RULES
+ */
+/*===============================================================================*/
+
+
+/* mov rA, rB; add rC, rA: the only reader of rA reads rB, if rB still has it */
+static bool PeepholeForwardMove(Peephole *P, U32 Index, U32 From, U32 To)
+{
+    IrFunction *Fn = P->Fn;
+    if (1 != P->UseCount[To])
+        return false;
+
+    UInt RegB = Fn->Values[From].Reg;
+    UInt Distance = 0;
+    for (U32 i = Fn->Ins[Index].Next; IR_NONE != i && ++Distance <= PEEPHOLE_WINDOW; i = Fn->Ins[i].Next)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            if (IrResolve(Fn, Ins->Use[k].Value) != To)
+                continue;
+            /* only a source register can change, Rd is written back */
+            if ((IR_SLOT_RS != Ins->Use[k].Slot && IR_SLOT_RT != Ins->Use[k].Slot) || Ins->Op >= IR_OP_PHI)
+                return false;
+            Ins->Use[k].Value = From;
+            Ins->Use[k].Reg = RegB;
+            PeepholeRemove(P, Index);
+            P->UseCount[To] = 0;
+            P->UseCount[From]++;
+            return true;
+        }
+        if (PeepholeDefinesReg(Fn, Ins, RegB))
+            return false;
+    }
+    return false;
+}
+
+/*
+ * mov rA, rB: the instructions computing rB for it compute it in rA instead.
+ * A chain of two operand instructions (ld r1; addqi r1, -1; mov r0, r1) moves with them
+ */
+static bool PeepholeCoalesceMove(Peephole *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    IrIns *Move = &Fn->Ins[Index];
+    if (OP_MOV32 != Move->Op && OP_MOV64 != Move->Op && OP_FMOV != Move->Op && OP_FMOV64 != Move->Op)
+        return false;
+
+    U32 To = Move->Def[0].Value;
+    U32 From = IrResolve(Fn, Move->Use[0].Value);
+    if (IR_NONE == From || IR_NONE == To)
+        return false;
+    UInt RegA = Fn->Values[To].Reg;
+    if (Fn->Values[From].Reg == RegA)
+    {
+        PeepholeRemove(P, Index);
+        PeepholeForward(P, To, From);
+        return true;
+    }
+    /* a whole register copied from one of unknown type is still the same bits */
+    bool SameType = Fn->Values[From].Type == Fn->Values[To].Type;
+    bool WholeCopy = IR_TYPE_NONE == Fn->Values[From].Type && (OP_MOV64 == Move->Op || OP_FMOV64 == Move->Op);
+    if ((SameType || WholeCopy) && PeepholeForwardMove(P, Index, From, To))
+        return true;
+    if (!SameType || 1 != P->UseCount[From])
+        return false;
+
+    /* walk the chain back to the instruction that starts it */
+    U32 Chain[PEEPHOLE_WINDOW];
+    UInt ChainLength = 0;
+    U32 Value = From;
+    U32 Head;
+    for (;;)
+    {
+        if (ChainLength == PEEPHOLE_WINDOW)
+            return false;
+        Head = Fn->Values[Value].Ins;
+        const IrIns *Def = &Fn->Ins[Head];
+        if (Def->Block != Move->Block || Def->Op >= IR_OP_PHI
+        || 1 != Def->DefCount || IR_SLOT_RD != Def->Def[0].Slot)
+            return false;
+        Chain[ChainLength++] = Value;
+
+        const IrOperand *Rd = PeepholeOperandAt(Def, IR_SLOT_RD);
+        if (NULL == Rd)
+            break;
+        Value = IrResolve(Fn, Rd->Value);
+        if (IR_NONE == Value || 1 != P->UseCount[Value])
+            return false;
+    }
+
+    /* rA must be left alone from the head of the chain to the move */
+    UInt Distance = 0;
+    U32 i = Fn->Ins[Head].Next;
+    for (; i != Index; i = Fn->Ins[i].Next)
+    {
+        if (IR_NONE == i || ++Distance > PEEPHOLE_WINDOW || PeepholeTouchesReg(Fn, &Fn->Ins[i], RegA))
+            return false;
+    }
+
+    for (UInt k = 0; k < ChainLength; k++)
+        Fn->Values[Chain[k]].Reg = RegA;
+    PeepholeRemove(P, Index);
+    PeepholeForward(P, To, From);
+    return true;
+}
+
+
+/* mov rA, rB; add rA, rC: add3 rA, rB, rC when rB is still needed after the add */
+static bool PeepholeFormThreeOperand(Peephole *P, U32 Index)
+{
+    static const U16 ThreeOperandOf[][3] = {
+        /* two-operand, three-operand, the move before it */
+        { OP_ADD, OP_ADD3, OP_MOV32 }, { OP_SUB, OP_SUB3, OP_MOV32 },
+        { OP_MUL, OP_MUL3, OP_MOV32 }, { OP_IMUL, OP_IMUL3, OP_MOV32 },
+        { OP_DIV, OP_DIV3, OP_MOV32 }, { OP_IDIV, OP_IDIV3, OP_MOV32 },
+        { OP_MOD, OP_MOD3, OP_MOV32 },
+        { OP_AND, OP_AND3, OP_MOV32 }, { OP_OR, OP_OR3, OP_MOV32 }, { OP_XOR, OP_XOR3, OP_MOV32 },
+        { OP_VSHL, OP_VSHL3, OP_MOV32 }, { OP_VSHR, OP_VSHR3, OP_MOV32 }, { OP_VASR, OP_VASR3, OP_MOV32 },
+        { OP_ADD64, OP_ADD3_64, OP_MOV64 }, { OP_SUB64, OP_SUB3_64, OP_MOV64 },
+        { OP_MUL64, OP_MUL3_64, OP_MOV64 }, { OP_IMUL64, OP_IMUL3_64, OP_MOV64 },
+        { OP_DIV64, OP_DIV3_64, OP_MOV64 }, { OP_IDIV64, OP_IDIV3_64, OP_MOV64 },
+        { OP_MOD64, OP_MOD3_64, OP_MOV64 },
+        { OP_AND64, OP_AND3_64, OP_MOV64 }, { OP_OR64, OP_OR3_64, OP_MOV64 }, { OP_XOR64, OP_XOR3_64, OP_MOV64 },
+        { OP_VSHL64, OP_VSHL3_64, OP_MOV64 }, { OP_VSHR64, OP_VSHR3_64, OP_MOV64 }, { OP_VASR64, OP_VASR3_64, OP_MOV64 },
+        { OP_FADD, OP_FADD3, OP_FMOV }, { OP_FSUB, OP_FSUB3, OP_FMOV },
+        { OP_FMUL, OP_FMUL3, OP_FMOV }, { OP_FDIV, OP_FDIV3, OP_FMOV },
+        { OP_FADD64, OP_FADD3_64, OP_FMOV64 }, { OP_FSUB64, OP_FSUB3_64, OP_FMOV64 },
+        { OP_FMUL64, OP_FMUL3_64, OP_FMOV64 }, { OP_FDIV64, OP_FDIV3_64, OP_FMOV64 },
+    };
+    IrFunction *Fn = P->Fn;
+    IrIns *Op = &Fn->Ins[Index];
+    UInt Form = 0;
+    while (Form < STATIC_ARRAY_SIZE(ThreeOperandOf) && ThreeOperandOf[Form][0] != Op->Op)
+        Form++;
+    if (STATIC_ARRAY_SIZE(ThreeOperandOf) == Form || 2 != Op->UseCount || 1 != Op->DefCount)
+        return false;
+
+    /* rA is only read by the op, otherwise the move has to stay */
+    const IrOperand *Rd = PeepholeOperandAt(Op, IR_SLOT_RD);
+    const IrOperand *Rs = PeepholeOperandAt(Op, IR_SLOT_RS);
+    U32 Moved = NULL == Rd? IR_NONE : IrResolve(Fn, Rd->Value);
+    if (NULL == Rs || IR_NONE == Moved || 1 != P->UseCount[Moved])
+        return false;
+    U32 MoveIndex = Fn->Values[Moved].Ins;
+    const IrIns *Move = &Fn->Ins[MoveIndex];
+    if (ThreeOperandOf[Form][2] != Move->Op || Move->Block != Op->Block || Move->Ext)
+        return false;
+    U32 From = IrResolve(Fn, Move->Use[0].Value);
+    if (IR_NONE == From)
+        return false;
+
+    /* rB is now read at the op, rA is left as it was until then */
+    UInt RegA = Fn->Values[Moved].Reg;
+    UInt RegB = Fn->Values[From].Reg;
+    UInt Distance = 0;
+    for (U32 i = Move->Next; i != Index; i = Fn->Ins[i].Next)
+    {
+        if (IR_NONE == i || ++Distance > PEEPHOLE_WINDOW
+        || PeepholeTouchesReg(Fn, &Fn->Ins[i], RegA) || PeepholeDefinesReg(Fn, &Fn->Ins[i], RegB))
+            return false;
+    }
+
+    /* Rd, Rs and Rt are filled in when lowered */
+    IrOperand Rt = *Rs;
+    Rt.Slot = IR_SLOT_RT;
+    PeepholeRemove(P, MoveIndex);
+    P->UseCount[Moved] = 0;
+    P->UseCount[From]++;
+    Op->Op = ThreeOperandOf[Form][1];
+    Op->Code[0] = BIT_POS32(Op->Op, 8, 8);
+    Op->Code[1] = 0;
+    Op->Size = 2;
+    Op->Ext = 0;
+    Op->Use[0] = (IrOperand) {
+        .Value = From,
+        .Reg = RegB,
+        .Slot = IR_SLOT_RS,
+    };
+    Op->Use[1] = Rt;
+    return true;
+}
+
+
+/* a load of a slot that was just stored or loaded takes the register it is still in */
+static bool PeepholeForwardStore(Peephole *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    IrIns *Load = &Fn->Ins[Index];
+    PeepholeAccess Access;
+    if (!PeepholeAccessOf(Load, &Access) || Access.IsStore || PEEPHOLE_CLASS_NONE == Access.Class)
+        return false;
+
+    bool Defined[IR_REG_COUNT] = { 0 };
+    bool FixedBase = IR_NONE == Access.Base->Value && PVM_REG_SP != Access.Base->Reg;
+    U32 Source = IR_NONE;
+    U32 Block = Load->Block;
+    U32 i = Load->Prev;
+    for (UInt Distance = 0; Distance < PEEPHOLE_WINDOW; Distance++, i = IR_NONE == i? i : Fn->Ins[i].Prev)
+    {
+        if (IR_NONE == i)
+        {
+            /* up into the only block that leads here */
+            const IrBlock *B = &Fn->Blocks[Block];
+            if (1 != B->PredCount)
+                break;
+            Block = B->Pred[0];
+            i = Fn->Blocks[Block].Last;
+            continue;
+        }
+        const IrIns *Ins = &Fn->Ins[i];
+        PeepholeAccess Other;
+        if (PeepholeAccessOf(Ins, &Other))
+        {
+            if (Other.Class == Access.Class && Other.Offset == Access.Offset
+            && PeepholeSameBase(Fn, Other.Base, Access.Base))
+            {
+                Source = Other.IsStore
+                    ? IrResolve(Fn, PeepholeOperandAt(Ins, IR_SLOT_RD)->Value)
+                    : Ins->Def[0].Value;
+                break;
+            }
+            if (Other.IsStore && PeepholeMayAlias(Fn, &Access, &Other))
+                return false;
+        }
+        else if ((Ins->Flags & (IR_INS_CALL | IR_INS_STORE)) && !(FixedBase && PeepholeIsPushOrPop(Ins->Op)))
+            return false;
+        else if (!FixedBase && PeepholeIsPushOrPop(Ins->Op))
+            return false;
+
+        for (U32 k = 0; k < Ins->DefCount; k++)
+            Defined[PeepholeRegOf(Fn, &Ins->Def[k])] = true;
+    }
+    if (IR_NONE == Source || Defined[Fn->Values[Source].Reg] || Defined[Access.Base->Reg])
+        return false;
+
+    U32 Result = Load->Def[0].Value;
+    if (Fn->Values[Source].Reg == Fn->Values[Result].Reg)
+    {
+        PeepholeRemove(P, Index);
+        PeepholeForward(P, Result, Source);
+        return true;
+    }
+
+    /* becomes a move, Rd and Rs are filled in when lowered */
+    static const U16 MoveOp[] = {
+        [PEEPHOLE_CLASS_I32] = OP_MOV32,
+        [PEEPHOLE_CLASS_I64] = OP_MOV64,
+        [PEEPHOLE_CLASS_F32] = OP_FMOV,
+        [PEEPHOLE_CLASS_F64] = OP_FMOV64,
+    };
+    if (IR_NONE != Access.Base->Value)
+        P->UseCount[IrResolve(Fn, Access.Base->Value)]--;
+    P->UseCount[Source]++;
+    Load->Op = MoveOp[Access.Class];
+    Load->Code[0] = BIT_POS32(Load->Op, 8, 8);
+    Load->Size = 1;
+    Load->Ext = 0;
+    Load->Flags = 0;
+    Load->UseCount = 1;
+    Load->Use[0] = (IrOperand) {
+        .Value = Source,
+        .Reg = Fn->Values[Source].Reg,
+        .Slot = IR_SLOT_RS,
+    };
+    return true;
+}
+
+
+/* a branch to a jump goes where the jump goes, a jump to the block right after it is dropped */
+static bool PeepholeThreadJump(Peephole *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    IrIns *Branch = &Fn->Ins[Index];
+    if (!(Branch->Flags & IR_INS_BRANCH) || OP_BRI == Branch->Op)
+        return false;
+
+    U32 Block = Branch->Block;
+    U32 Target = Branch->Target;
+    if (OP_BR == Branch->Op && Target > Block)
+    {
+        U32 Next = Block + 1;
+        while (Next < Target && IR_NONE == Fn->Blocks[Next].First)
+            Next++;
+        if (Next == Target)
+        {
+            /* the same edge, now falling through */
+            PeepholeRemove(P, Index);
+            Fn->Blocks[Block].Succ[0] = Target;
+            Fn->Blocks[Block].Succ[1] = IR_NONE;
+            return true;
+        }
+    }
+
+    /* to the end of a chain of jumps */
+    U32 Last = Target, To = Target;
+    for (U32 Hops = 0; ; Hops++)
+    {
+        U32 First = Fn->Blocks[To].First;
+        if (IR_NONE == First || OP_BR != Fn->Ins[First].Op)
+            break;
+        if (Hops == Fn->BlockCount)
+            return false;
+        Last = To;
+        To = Fn->Ins[First].Target;
+    }
+    if (To == Target)
+        return false;
+
+    /* the new edge first, Last might go with Target */
+    Fn->Blocks[Block].Succ[1] = IR_NONE;
+    IrAddEdge(Fn, Block, 1, To, Last);
+    Fn->Blocks[Block].Succ[1] = Target;
+    IrRemoveEdge(Fn, Block, 1);
+    Fn->Blocks[Block].Succ[1] = To;
+    Branch->Target = To;
+    if (0 == Fn->Blocks[Target].PredCount && 0 != Target)
+        IrClearBlock(Fn, Target);
+    return true;
+}
+
+
+static bool PeepholeIsPairOf(const IrIns *Push, const IrIns *Pop)
+{
+    static const U16 PopOf[][2] = {
+        { OP_PSHL, OP_POPL }, { OP_PSHH, OP_POPH },
+        { OP_FPSHL, OP_FPOPL }, { OP_FPSHH, OP_FPOPH },
+    };
+    for (UInt i = 0; i < STATIC_ARRAY_SIZE(PopOf); i++)
+    {
+        if (PopOf[i][0] == Push->Op && PopOf[i][1] == Pop->Op)
+            return (Push->Code[0] & 0xFF) == (Pop->Code[0] & 0xFF) && Push->Ext == Pop->Ext;
+    }
+    return false;
+}
+
+/* Load reads what a store before it in its own block wrote to the slot, not what Store wrote */
+static bool PeepholeStoredBefore(Peephole *P, U32 Load, U32 Store, const PeepholeAccess *Slot)
+{
+    IrFunction *Fn = P->Fn;
+    for (U32 i = Fn->Ins[Load].Prev; IR_NONE != i && i != Store; i = Fn->Ins[i].Prev)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        PeepholeAccess Other;
+        if ((Ins->Flags & IR_INS_CALL) || PeepholeIsPushOrPop(Ins->Op) || PeepholeDefinesReg(Fn, Ins, PVM_REG_SP))
+            return false;
+        if (PeepholeAccessOf(Ins, &Other) && Other.IsStore
+        && PeepholeSameBase(Fn, Other.Base, Slot->Base) && PeepholeOverlaps(&Other, Slot))
+            return Other.Offset == Slot->Offset && Other.Width == Slot->Width;
+    }
+    return false;
+}
+
+/* st64 rX, [rsp - n] ... ld64 rX, [rsp - n] where rX still has what was stored, or it is never used */
+static bool PeepholeRemoveSpillPair(Peephole *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    const IrIns *Store = &Fn->Ins[Index];
+    PeepholeAccess Spill;
+    if (!PeepholeAccessOf(Store, &Spill) || !Spill.IsStore
+    || (PEEPHOLE_CLASS_I64 != Spill.Class && PEEPHOLE_CLASS_F64 != Spill.Class)
+    || IR_NONE != Spill.Base->Value || PVM_REG_SP != Spill.Base->Reg || Spill.Offset > 0)
+        return false;
+    U32 Saved = IrResolve(Fn, PeepholeOperandAt(Store, IR_SLOT_RD)->Value);
+    if (IR_NONE == Saved)
+        return false;
+    UInt Reg = Fn->Values[Saved].Reg;
+
+    /* up to the end of the block, nothing in between moves SP */
+    bool Clobbered = false;
+    U32 Reload = Store->Next;
+    for (; IR_NONE != Reload; Reload = Fn->Ins[Reload].Next)
+    {
+        const IrIns *Ins = &Fn->Ins[Reload];
+        PeepholeAccess Other;
+        if ((Ins->Flags & IR_INS_CALL) || PeepholeIsPushOrPop(Ins->Op) || PeepholeDefinesReg(Fn, Ins, PVM_REG_SP))
+            return false;
+        if (PeepholeAccessOf(Ins, &Other) && PeepholeSameBase(Fn, Other.Base, Spill.Base))
+        {
+            if (!Other.IsStore && Other.Class == Spill.Class && Other.Offset == Spill.Offset)
+                break;
+            if (PeepholeOverlaps(&Other, &Spill))
+                return false;
+        }
+        Clobbered = Clobbered || PeepholeDefinesReg(Fn, Ins, Reg);
+    }
+    if (IR_NONE == Reload)
+        return false;
+    U32 Restored = Fn->Ins[Reload].Def[0].Value;
+    if (Fn->Values[Restored].Reg != Reg || (Clobbered && 0 != P->UseCount[Restored]))
+        return false;
+
+    /* nothing else may read the slot, unless it is reused for another spill first */
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        PeepholeAccess Other;
+        if (i != Reload && IR_NONE != Fn->Ins[i].Block && PeepholeAccessOf(&Fn->Ins[i], &Other)
+        && !Other.IsStore && PeepholeSameBase(Fn, Other.Base, Spill.Base) && PeepholeOverlaps(&Other, &Spill)
+        && !PeepholeStoredBefore(P, i, Index, &Spill))
+            return false;
+    }
+
+    PeepholeRemove(P, Reload);
+    PeepholeRemove(P, Index);
+    if (!Clobbered)
+        PeepholeForward(P, Restored, Saved);
+    return true;
+}
+
+/*
+ * pop { list } right before push { list }, from saving registers around 2 calls in a row:
+ * the stack already has them. push { list } right before pop { list } does nothing
+ */
+static bool PeepholeRemoveSpill(Peephole *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    const IrIns *Second = &Fn->Ins[Index];
+    if (IR_NONE == Second->Prev)
+        return PeepholeRemoveSpillPair(P, Index);
+    U32 PrevIndex = Second->Prev;
+    const IrIns *First = &Fn->Ins[PrevIndex];
+
+    if (PeepholeIsPairOf(Second, First))
+    {
+        /* the registers popped are only pushed back */
+        if (First->DefCount != Second->UseCount)
+            return false;
+        for (U32 i = 0; i < First->DefCount; i++)
+        {
+            if (IR_NONE == First->Def[i].Value
+            || 1 != P->UseCount[First->Def[i].Value]
+            || IrResolve(Fn, Second->Use[i].Value) != First->Def[i].Value)
+                return false;
+        }
+        PeepholeRemove(P, Index);
+        PeepholeRemove(P, PrevIndex);
+        return true;
+    }
+    if (PeepholeIsPairOf(First, Second))
+    {
+        if (Second->DefCount != First->UseCount)
+            return false;
+        for (U32 i = 0; i < First->UseCount; i++)
+        {
+            if (IR_NONE == IrResolve(Fn, First->Use[i].Value) || IR_NONE == Second->Def[i].Value)
+                return false;
+        }
+        for (U32 i = 0; i < Second->DefCount; i++)
+            PeepholeForward(P, Second->Def[i].Value, IrResolve(Fn, First->Use[i].Value));
+        PeepholeRemove(P, Index);
+        PeepholeRemove(P, PrevIndex);
+        return true;
+    }
+    return PeepholeRemoveSpillPair(P, Index);
+}
+
+
+static const struct {
+    const char *Name;
+    PeepholeRuleFn Apply;
+} sPeepholeRules[PEEPHOLE_RULE_COUNT] = {
+    [PEEPHOLE_COALESCE_MOVE] = { "mov coalescing", PeepholeCoalesceMove },
+    [PEEPHOLE_FORWARD_STORE] = { "store to load forwarding", PeepholeForwardStore },
+    [PEEPHOLE_THREAD_JUMP] = { "jump threading", PeepholeThreadJump },
+    [PEEPHOLE_DEAD_SPILL] = { "dead spill elimination", PeepholeRemoveSpill },
+    [PEEPHOLE_THREE_OPERAND] = { "three-operand forming", PeepholeFormThreeOperand },
+};
+
+
+
+
+bool IrPeephole(IrFunction *Fn, U32 Rules, PeepholeStats *Stats)
+{
+    PASCAL_NONNULL(Fn);
+    PASCAL_NONNULL(Stats);
+
+    Peephole P = {
+        .Fn = Fn,
+        .UseCount = ArenaAllocateZero(Fn->Arena, (Fn->ValueCount + 1) * sizeof *P.UseCount),
+    };
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            Ins->Use[k].Value = IrResolve(Fn, Ins->Use[k].Value);
+            if (IR_NONE != Ins->Use[k].Value)
+                P.UseCount[Ins->Use[k].Value]++;
+        }
+    }
+
+    /* every rule takes instructions away, so this ends */
+    bool Changed = false;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        U32 i = Fn->Blocks[b].First;
+        while (IR_NONE != i)
+        {
+            U32 Prev = Fn->Ins[i].Prev;
+            UInt Rule = 0;
+            while (Rule < PEEPHOLE_RULE_COUNT
+            && !((Rules >> Rule & 1) && sPeepholeRules[Rule].Apply(&P, i)))
+                Rule++;
+            if (PEEPHOLE_RULE_COUNT == Rule)
+            {
+                i = Fn->Ins[i].Next;
+                continue;
+            }
+
+            Stats->Hits[Rule]++;
+            Changed = true;
+            /* the same instruction or the one before it may now start another pattern */
+            if (IR_NONE != Fn->Ins[i].Block)
+                continue;
+            i = IR_NONE != Prev && IR_NONE != Fn->Ins[Prev].Block
+                ? Prev
+                : Fn->Blocks[b].First;
+        }
+    }
+    if (Changed)
+        IrSimplifyPhis(Fn);
+    return Changed;
+}
+
+
+void PeepholeReport(const PeepholeStats *Stats, FILE *Out)
+{
+    PASCAL_NONNULL(Stats);
+    PASCAL_NONNULL(Out);
+    for (UInt i = 0; i < PEEPHOLE_RULE_COUNT; i++)
+        fprintf(Out, "Peephole %s: %u\n", sPeepholeRules[i].Name, Stats->Hits[i]);
+}
+
+
+#undef PEEPHOLE_WINDOW
+
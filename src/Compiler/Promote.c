@@ -0,0 +1,696 @@
+#include <string.h>
+
+#include "Compiler/Promote.h"
+#include "Compiler/Compiler.h"
+#include "Vartab.h"
+#include "Variable.h"
+
+
+
+/* a scalar that lives in the frame */
+typedef struct PromoteVar
+{
+    I32 Offset;         /* from FP */
+    U32 Size;
+    bool IsFloat;
+    bool Rejected;      /* has to stay in memory */
+    bool SignExtended;  /* narrower than 32 bits and loaded sign extended, the register keeps it that way */
+    U32 AccessCount;
+    U64 Weight;
+    U32 Bit;            /* among the promoted ones, IR_NONE if it was not */
+    U8 Reg;
+} PromoteVar;
+
+/* a load or store of FP + Offset */
+typedef struct PromoteAccess
+{
+    I32 Offset;
+    UInt Width;
+    bool IsStore, IsFloat;
+    bool SignExtends;   /* a load of fewer than 32 bits that sign extends them */
+    U16 Move;           /* what a load becomes once the variable is in a register */
+} PromoteAccess;
+
+typedef struct Promote
+{
+    const PascalCompiler *Compiler;
+    IrFunction *Fn;
+    PromoteVar *Vars;   /* in order of offset */
+    U32 VarCount;
+    U32 Promoted[PROMOTE_MAX_VARS];
+    U32 PromotedCount;
+    U32 InsCount;       /* before anything was inserted */
+    U32 Enter;          /* the instruction */
+    U32 *VarOf;         /* per instruction, the variable it loads or stores whole, IR_NONE for any other */
+    U32 *Depth;         /* per block, how many loops it is in */
+    U64 *LiveIn, *LiveOut;  /* per block, by bit */
+    U64 *LiveAfter;     /* per call, the promoted variables still needed after it */
+    U64 *Clobbered;     /* per call, the promoted variables whose register it writes */
+    U64 CallClobbers;   /* registers any of the calls write */
+    U64 *CleanOut;      /* per block, the promoted variables whose slot holds what their register does */
+    bool Used[IR_REG_FLAG];
+} Promote;
+
+
+
+
+static bool PromoteIsReserved(UInt Reg)
+{
+    return PVM_REG_GP == Reg || PVM_REG_FP == Reg || PVM_REG_SP == Reg;
+}
+
+static bool PromoteIsCall(const IrIns *Ins)
+{
+    /* sys ops keep every register but R0 */
+    return OP_CALL == Ins->Op || OP_CALLPTR == Ins->Op;
+}
+
+static bool PromoteIsScalar(const VarType *Type)
+{
+    return IntegralTypeIsOrdinal(Type->Integral)
+        || IntegralTypeIsFloat(Type->Integral)
+        || TYPE_POINTER == Type->Integral;
+}
+
+static const IrOperand *PromoteOperandAt(const IrIns *Ins, IrSlot Slot)
+{
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        if (Slot == Ins->Use[i].Slot)
+            return &Ins->Use[i];
+    }
+    return NULL;
+}
+
+static I32 PromoteOffsetOf(const IrIns *Ins)
+{
+    return 2 == Ins->Size
+        ? (I16)Ins->Code[1]
+        : (I32)((U32)Ins->Code[1] | (U32)Ins->Code[2] << 16);
+}
+
+static bool PromoteAccessOf(const IrIns *Ins, PromoteAccess *Access)
+{
+    PromoteAccess A = { 0 };
+    switch ((PVMOp)Ins->Op)
+    {
+    case OP_LD32: case OP_LD32L:                A.Width = 4; A.Move = OP_MOV32; break;
+    case OP_LD64: case OP_LD64L:                A.Width = 8; A.Move = OP_MOV64; break;
+    case OP_LDZEX32_8: case OP_LDZEX32_8L:      A.Width = 1; A.Move = OP_MOVZEX32_8; break;
+    case OP_LDZEX32_16: case OP_LDZEX32_16L:    A.Width = 2; A.Move = OP_MOVZEX32_16; break;
+    case OP_LDZEX64_8: case OP_LDZEX64_8L:      A.Width = 1; A.Move = OP_MOVZEX64_8; break;
+    case OP_LDZEX64_16: case OP_LDZEX64_16L:    A.Width = 2; A.Move = OP_MOVZEX64_16; break;
+    case OP_LDZEX64_32: case OP_LDZEX64_32L:    A.Width = 4; A.Move = OP_MOVZEX64_32; break;
+    case OP_LDSEX64_32: case OP_LDSEX64_32L:    A.Width = 4; A.Move = OP_MOVSEX64_32; break;
+    /* the register already holds them sign extended to 32 bits */
+    case OP_LDSEX32_8: case OP_LDSEX32_8L:      A.Width = 1; A.Move = OP_MOV32; A.SignExtends = true; break;
+    case OP_LDSEX32_16: case OP_LDSEX32_16L:    A.Width = 2; A.Move = OP_MOV32; A.SignExtends = true; break;
+    case OP_LDSEX64_8: case OP_LDSEX64_8L:      A.Width = 1; A.Move = OP_MOVSEX64_32; A.SignExtends = true; break;
+    case OP_LDSEX64_16: case OP_LDSEX64_16L:    A.Width = 2; A.Move = OP_MOVSEX64_32; A.SignExtends = true; break;
+    case OP_LDF32: case OP_LDF32L:              A.Width = 4; A.Move = OP_FMOV; A.IsFloat = true; break;
+    case OP_LDF64: case OP_LDF64L:              A.Width = 8; A.Move = OP_FMOV64; A.IsFloat = true; break;
+
+    case OP_ST8: case OP_ST8L:                  A.Width = 1; A.IsStore = true; break;
+    case OP_ST16: case OP_ST16L:                A.Width = 2; A.IsStore = true; break;
+    case OP_ST32: case OP_ST32L:                A.Width = 4; A.IsStore = true; break;
+    case OP_ST64: case OP_ST64L:                A.Width = 8; A.IsStore = true; break;
+    case OP_STF32: case OP_STF32L:              A.Width = 4; A.IsStore = true; A.IsFloat = true; break;
+    case OP_STF64: case OP_STF64L:              A.Width = 8; A.IsStore = true; A.IsFloat = true; break;
+    default: return false;
+    }
+    A.Offset = PromoteOffsetOf(Ins);
+    *Access = A;
+    return true;
+}
+
+
+
+
+/* the scalars of Scope in the frame, in order of offset */
+static void PromoteCollectVars(Promote *P, const PascalVartab *Scope)
+{
+    P->Vars = ArenaAllocate(P->Fn->Arena, (Scope->Count + 1) * sizeof *P->Vars);
+    P->VarCount = 0;
+    for (ISize i = 0; i < Scope->Cap; i++)
+    {
+        const PascalVar *Var = &Scope->Table[i];
+        const VarLocation *Location = Var->Location;
+        /* empty or deleted */
+        if (0 == Var->Str.Len || NULL == Location)
+            continue;
+        if (VAR_MEM != Location->LocationType || PVM_REG_FP != Location->As.Memory.RegPtr.ID
+        || !PromoteIsScalar(&Location->Type))
+            continue;
+        /* arguments on the stack are written by the caller */
+        I32 Offset = (I32)Location->As.Memory.Location;
+        U32 Size = Location->Type.Size;
+        if (Offset < 0 || (1 != Size && 2 != Size && 4 != Size && 8 != Size))
+            continue;
+
+        U32 At = P->VarCount++;
+        while (At > 0 && P->Vars[At - 1].Offset > Offset)
+        {
+            P->Vars[At] = P->Vars[At - 1];
+            At--;
+        }
+        P->Vars[At] = (PromoteVar) {
+            .Offset = Offset,
+            .Size = Size,
+            .IsFloat = IntegralTypeIsFloat(Location->Type.Integral),
+            .Bit = IR_NONE,
+        };
+    }
+}
+
+/* the first variable that ends after Offset */
+static U32 PromoteFindVar(const Promote *P, I32 Offset)
+{
+    U32 Lo = 0, Hi = P->VarCount;
+    while (Lo < Hi)
+    {
+        U32 Mid = Lo + (Hi - Lo) / 2;
+        if ((I64)P->Vars[Mid].Offset + P->Vars[Mid].Size <= Offset)
+            Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    return Lo;
+}
+
+static void PromoteReject(Promote *P, I32 Offset, UInt Width)
+{
+    for (U32 v = PromoteFindVar(P, Offset); v < P->VarCount && P->Vars[v].Offset < (I64)Offset + Width; v++)
+        P->Vars[v].Rejected = true;
+}
+
+static void PromoteFindLoops(Promote *P)
+{
+    IrFunction *Fn = P->Fn;
+    P->Depth = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *P->Depth);
+
+    /* the code is laid out in order, a loop is the blocks from the target of a back edge to its source */
+    I32 *Delta = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *Delta);
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        for (UInt k = 0; k < 2; k++)
+        {
+            U32 To = Fn->Blocks[b].Succ[k];
+            if (IR_NONE != To && To <= b)
+            {
+                Delta[To]++;
+                Delta[b + 1]--;
+            }
+        }
+    }
+    I32 Depth = 0;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        Depth += Delta[b];
+        P->Depth[b] = Depth;
+    }
+}
+
+/* which variables are only ever loaded and stored whole, and which registers Fn does not touch.
+ * Returns false if FP is used in a way that could reach any of them */
+static bool PromoteScan(Promote *P)
+{
+    IrFunction *Fn = P->Fn;
+    P->VarOf = ArenaAllocate(Fn->Arena, (Fn->InsCount + 1) * sizeof *P->VarOf);
+    memset(P->VarOf, 0xFF, (Fn->InsCount + 1) * sizeof *P->VarOf);
+
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        U64 Weight = (U64)1 << 3*uMin(P->Depth[b], 6);
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            const IrIns *Ins = &Fn->Ins[i];
+            if (IR_OP_ENTRY == Ins->Op)
+                continue;
+            if (OP_SYS == Ins->Op && OP_SYS_ENTER == PVM_GET_SYS_OP(Ins->Code[0]))
+                P->Enter = i;
+            for (U32 k = 0; k < Ins->DefCount; k++)
+            {
+                if (Ins->Def[k].Reg < IR_REG_FLAG)
+                    P->Used[Ins->Def[k].Reg] = true;
+            }
+
+            for (U32 k = 0; k < Ins->UseCount; k++)
+            {
+                const IrOperand *Use = &Ins->Use[k];
+                if (Use->Reg < IR_REG_FLAG)
+                    P->Used[Use->Reg] = true;
+                if (PVM_REG_FP != Use->Reg)
+                    continue;
+
+                PromoteAccess Access;
+                if (IR_SLOT_RS == Use->Slot && PromoteAccessOf(Ins, &Access))
+                {
+                    U32 v = PromoteFindVar(P, Access.Offset);
+                    PromoteVar *Var = &P->Vars[v];
+                    if (v == P->VarCount || Var->Offset >= (I64)Access.Offset + Access.Width)
+                        continue;
+                    if (Var->Offset != Access.Offset || Var->Size != Access.Width || Var->IsFloat != Access.IsFloat)
+                    {
+                        PromoteReject(P, Access.Offset, Access.Width);
+                        continue;
+                    }
+                    P->VarOf[i] = v;
+                    Var->AccessCount++;
+                    Var->Weight += Weight;
+                    Var->SignExtended = Var->SignExtended || Access.SignExtends;
+                }
+                else if (IR_SLOT_RS == Use->Slot && (OP_LEA == Ins->Op || OP_LEAL == Ins->Op))
+                    PromoteReject(P, PromoteOffsetOf(Ins), 1);
+                /* the address of the variable at offset 0 */
+                else if (IR_SLOT_RS == Use->Slot && (OP_MOV32 == Ins->Op || OP_MOV64 == Ins->Op))
+                    PromoteReject(P, 0, 1);
+                else return false;
+            }
+        }
+    }
+    return IR_NONE != P->Enter;
+}
+
+/* registers the call at Index writes, all of them if what it calls is not known yet */
+static U64 PromoteCallClobbers(const Promote *P, U32 Index)
+{
+    const IrIns *Ins = &P->Fn->Ins[Index];
+    if (OP_CALL != Ins->Op || IR_NONE == Ins->Reference)
+        return UINT64_MAX;
+    return SubroutineClobbers(P->Compiler,
+            P->Compiler->SubroutineReferences.Data[Ins->Reference].SubroutineLocation
+    );
+}
+
+static void PromoteFindCallClobbers(Promote *P)
+{
+    const IrFunction *Fn = P->Fn;
+    for (U32 i = 0; i < P->InsCount; i++)
+    {
+        if (IR_NONE != Fn->Ins[i].Block && PromoteIsCall(&Fn->Ins[i]))
+            P->CallClobbers |= PromoteCallClobbers(P, i);
+    }
+}
+
+/* per call, the promoted variables it clobbers */
+static void PromoteFindClobbered(Promote *P)
+{
+    const IrFunction *Fn = P->Fn;
+    P->Clobbered = ArenaAllocateZero(Fn->Arena, (P->InsCount + 1) * sizeof *P->Clobbered);
+    for (U32 i = 0; i < P->InsCount; i++)
+    {
+        if (IR_NONE == Fn->Ins[i].Block || !PromoteIsCall(&Fn->Ins[i]))
+            continue;
+        U64 Regs = PromoteCallClobbers(P, i);
+        for (U32 k = 0; k < P->PromotedCount; k++)
+        {
+            if (Regs & ((U64)1 << P->Vars[P->Promoted[k]].Reg))
+                P->Clobbered[i] |= (U64)1 << k;
+        }
+    }
+}
+
+/* a register of the class Fn does not use, preferably one no call writes, IR_REG_FLAG if there is none */
+static UInt PromoteFreeReg(const Promote *P, bool IsFloat)
+{
+    UInt First = IsFloat? PVM_REG_COUNT : 0;
+    UInt Last = IsFloat? IR_REG_FLAG : PVM_REG_COUNT;
+    UInt Found = IR_REG_FLAG;
+    for (UInt Reg = First; Reg < Last; Reg++)
+    {
+        if (P->Used[Reg] || PromoteIsReserved(Reg))
+            continue;
+        if (!(P->CallClobbers & ((U64)1 << Reg)))
+            return Reg;
+        if (IR_REG_FLAG == Found)
+            Found = Reg;
+    }
+    return Found;
+}
+
+/* the heaviest variables get the registers Fn does not use */
+static void PromoteChoose(Promote *P)
+{
+    U32 *Order = ArenaAllocate(P->Fn->Arena, (P->VarCount + 1) * sizeof *Order);
+    U32 Count = 0;
+    for (U32 v = 0; v < P->VarCount; v++)
+    {
+        const PromoteVar *Var = &P->Vars[v];
+        if (Var->Rejected || 0 == Var->AccessCount)
+            continue;
+        U32 At = Count++;
+        while (At > 0 && P->Vars[Order[At - 1]].Weight < Var->Weight)
+        {
+            Order[At] = Order[At - 1];
+            At--;
+        }
+        Order[At] = v;
+    }
+
+    for (U32 i = 0; i < Count && P->PromotedCount < PROMOTE_MAX_VARS; i++)
+    {
+        PromoteVar *Var = &P->Vars[Order[i]];
+        UInt Reg = PromoteFreeReg(P, Var->IsFloat);
+        if (IR_REG_FLAG == Reg)
+            continue;
+
+        P->Used[Reg] = true;
+        Var->Reg = Reg;
+        Var->Bit = P->PromotedCount;
+        P->Promoted[P->PromotedCount++] = Order[i];
+    }
+}
+
+
+static U32 PromoteBitOf(const Promote *P, U32 Index)
+{
+    if (Index >= P->InsCount || IR_NONE == P->VarOf[Index])
+        return IR_NONE;
+    return P->Vars[P->VarOf[Index]].Bit;
+}
+
+static bool PromoteIsStore(const Promote *P, U32 Index)
+{
+    PromoteAccess Access;
+    return PromoteAccessOf(&P->Fn->Ins[Index], &Access) && Access.IsStore;
+}
+
+/* which promoted variables are still needed where each block starts and ends, and after each call */
+static void PromoteLiveness(Promote *P)
+{
+    IrFunction *Fn = P->Fn;
+    P->LiveIn = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *P->LiveIn);
+    P->LiveOut = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *P->LiveOut);
+    P->LiveAfter = ArenaAllocateZero(Fn->Arena, (P->InsCount + 1) * sizeof *P->LiveAfter);
+    U64 *Gen = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *Gen);
+    U64 *Kill = ArenaAllocateZero(Fn->Arena, (Fn->BlockCount + 1) * sizeof *Kill);
+
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            U32 Bit = PromoteBitOf(P, i);
+            if (IR_NONE == Bit)
+                continue;
+            U64 Mask = (U64)1 << Bit;
+            if (PromoteIsStore(P, i))
+                Kill[b] |= Mask;
+            else if (!(Kill[b] & Mask))
+                Gen[b] |= Mask;
+        }
+    }
+
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (U32 b = Fn->BlockCount; b-- > 0;)
+        {
+            U64 Out = 0;
+            for (UInt k = 0; k < 2; k++)
+            {
+                if (IR_NONE != Fn->Blocks[b].Succ[k])
+                    Out |= P->LiveIn[Fn->Blocks[b].Succ[k]];
+            }
+            U64 In = Gen[b] | (Out & ~Kill[b]);
+            Changed = Changed || In != P->LiveIn[b] || Out != P->LiveOut[b];
+            P->LiveIn[b] = In;
+            P->LiveOut[b] = Out;
+        }
+    }
+
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        U64 Live = P->LiveOut[b];
+        for (U32 i = Fn->Blocks[b].Last; IR_NONE != i; i = Fn->Ins[i].Prev)
+        {
+            U32 Bit = PromoteBitOf(P, i);
+            if (PromoteIsCall(&Fn->Ins[i]))
+                P->LiveAfter[i] = Live;
+            else if (IR_NONE == Bit)
+                continue;
+            else if (PromoteIsStore(P, i))
+                Live &= ~((U64)1 << Bit);
+            else Live |= (U64)1 << Bit;
+        }
+    }
+}
+
+/* a store makes the slot stale, a call writes back and reloads what it clobbers and is needed after it */
+static U64 PromoteCleanAfter(const Promote *P, U32 Block, U64 Clean)
+{
+    const IrFunction *Fn = P->Fn;
+    for (U32 i = Fn->Blocks[Block].First; IR_NONE != i; i = Fn->Ins[i].Next)
+    {
+        U32 Bit = PromoteBitOf(P, i);
+        if (PromoteIsCall(&Fn->Ins[i]))
+            Clean = (Clean & ~P->Clobbered[i]) | (P->LiveAfter[i] & P->Clobbered[i]);
+        else if (IR_NONE != Bit && PromoteIsStore(P, i))
+            Clean &= ~((U64)1 << Bit);
+    }
+    return Clean;
+}
+
+static U64 PromoteCleanIn(const Promote *P, U32 Block)
+{
+    /* on entry, the registers are loaded from the slots */
+    U64 Clean = ~(U64)0;
+    const IrBlock *B = &P->Fn->Blocks[Block];
+    for (U32 k = 0; k < B->PredCount; k++)
+        Clean &= P->CleanOut[B->Pred[k]];
+    return Clean;
+}
+
+static void PromoteFindClean(Promote *P)
+{
+    IrFunction *Fn = P->Fn;
+    P->CleanOut = ArenaAllocate(Fn->Arena, (Fn->BlockCount + 1) * sizeof *P->CleanOut);
+    for (U32 b = 0; b <= Fn->BlockCount; b++)
+        P->CleanOut[b] = ~(U64)0;
+
+    bool Changed = true;
+    while (Changed)
+    {
+        Changed = false;
+        for (U32 b = 0; b < Fn->BlockCount; b++)
+        {
+            U64 Out = PromoteCleanAfter(P, b, PromoteCleanIn(P, b));
+            Changed = Changed || Out != P->CleanOut[b];
+            P->CleanOut[b] = Out;
+        }
+    }
+}
+
+
+
+
+static IrOperand *PromoteOperands(IrFunction *Fn, U32 Count)
+{
+    return ArenaAllocate(Fn->Arena, Count * sizeof(IrOperand));
+}
+
+static IrOperand PromoteReg(UInt Reg, IrSlot Slot)
+{
+    return (IrOperand) {
+        .Value = IR_NONE,
+        .Reg = Reg,
+        .Slot = Slot,
+    };
+}
+
+/* ld or st of the whole variable, the way the emitter writes them, Rd and Rs are filled in when lowered */
+static void PromoteSetMemory(IrFunction *Fn, U32 Index, const PromoteVar *Var, bool IsStore)
+{
+    static const U16 Ops[2][2][9] = {
+        [false] = {
+            [false] = { [1] = OP_LDZEX32_8, [2] = OP_LDZEX32_16, [4] = OP_LD32, [8] = OP_LD64 },
+            [true]  = { [4] = OP_LDF32, [8] = OP_LDF64 },
+        },
+        [true] = {
+            [false] = { [1] = OP_ST8, [2] = OP_ST16, [4] = OP_ST32, [8] = OP_ST64 },
+            [true]  = { [4] = OP_STF32, [8] = OP_STF64 },
+        },
+    };
+    static const U16 LongOps[2][2][9] = {
+        [false] = {
+            [false] = { [1] = OP_LDZEX32_8L, [2] = OP_LDZEX32_16L, [4] = OP_LD32L, [8] = OP_LD64L },
+            [true]  = { [4] = OP_LDF32L, [8] = OP_LDF64L },
+        },
+        [true] = {
+            [false] = { [1] = OP_ST8L, [2] = OP_ST16L, [4] = OP_ST32L, [8] = OP_ST64L },
+            [true]  = { [4] = OP_STF32L, [8] = OP_STF64L },
+        },
+    };
+    bool IsShort = IN_I16(Var->Offset);
+    U16 Op = IsShort
+        ? Ops[IsStore][Var->IsFloat][Var->Size]
+        : LongOps[IsStore][Var->IsFloat][Var->Size];
+    if (!IsStore && Var->SignExtended)
+        Op = 1 == Var->Size
+            ? (IsShort? OP_LDSEX32_8 : OP_LDSEX32_8L)
+            : (IsShort? OP_LDSEX32_16 : OP_LDSEX32_16L);
+
+    IrIns *Ins = &Fn->Ins[Index];
+    Ins->Op = Op;
+    Ins->Code[0] = BIT_POS32(Op, 8, 8);
+    Ins->Code[1] = Var->Offset;
+    Ins->Code[2] = (U32)Var->Offset >> 16;
+    Ins->Size = IsShort? 2 : 3;
+    Ins->Ext = 0;
+    Ins->Flags = IsStore? IR_INS_STORE : IR_INS_LOAD;
+    if (IsStore)
+    {
+        Ins->Use = PromoteOperands(Fn, 2);
+        Ins->Use[0] = PromoteReg(Var->Reg, IR_SLOT_RD);
+        Ins->Use[1] = PromoteReg(PVM_REG_FP, IR_SLOT_RS);
+        Ins->UseCount = 2;
+        Ins->DefCount = 0;
+    }
+    else
+    {
+        Ins->Use = PromoteOperands(Fn, 1);
+        Ins->Use[0] = PromoteReg(PVM_REG_FP, IR_SLOT_RS);
+        Ins->Def = PromoteOperands(Fn, 1);
+        Ins->Def[0] = PromoteReg(Var->Reg, IR_SLOT_RD);
+        Ins->UseCount = 1;
+        Ins->DefCount = 1;
+    }
+}
+
+/* mov of Move from Source to Dest, Rd and Rs are filled in when lowered */
+static void PromoteSetMove(IrFunction *Fn, U32 Index, U16 Move, IrOperand Dest, IrOperand Source)
+{
+    IrIns *Ins = &Fn->Ins[Index];
+    Ins->Op = Move;
+    Ins->Code[0] = BIT_POS32(Move, 8, 8);
+    Ins->Size = 1;
+    Ins->Ext = 0;
+    Ins->Flags = 0;
+    Ins->Use = PromoteOperands(Fn, 1);
+    Ins->Use[0] = Source;
+    Ins->Use[0].Slot = IR_SLOT_RS;
+    Ins->Def = PromoteOperands(Fn, 1);
+    Ins->Def[0] = Dest;
+    Ins->Def[0].Slot = IR_SLOT_RD;
+    Ins->UseCount = 1;
+    Ins->DefCount = 1;
+}
+
+static void PromoteSetShift(IrFunction *Fn, U32 Index, UInt Reg, UInt Amount)
+{
+    IrIns *Ins = &Fn->Ins[Index];
+    Ins->Code[0] = BIT_POS32(Ins->Op, 8, 8) | (Amount & 0xF);
+    Ins->Size = 1;
+    Ins->Ext = (Amount & PVM_EXT_REG)? PVM_EXT_S : 0;
+    Ins->Flags = 0;
+    Ins->Use = PromoteOperands(Fn, 1);
+    Ins->Use[0] = PromoteReg(Reg, IR_SLOT_RD);
+    Ins->Def = PromoteOperands(Fn, 1);
+    Ins->Def[0] = PromoteReg(Reg, IR_SLOT_RD);
+    Ins->UseCount = 1;
+    Ins->DefCount = 1;
+}
+
+static void PromoteRewriteAccess(Promote *P, U32 Index)
+{
+    IrFunction *Fn = P->Fn;
+    const PromoteVar *Var = &P->Vars[P->VarOf[Index]];
+    PromoteAccess Access;
+    PromoteAccessOf(&Fn->Ins[Index], &Access);
+    if (!Access.IsStore)
+    {
+        PromoteSetMove(Fn, Index, Access.Move, Fn->Ins[Index].Def[0], PromoteReg(Var->Reg, IR_SLOT_RS));
+        return;
+    }
+
+    U16 Move = Var->IsFloat
+        ? (8 == Var->Size? OP_FMOV64 : OP_FMOV)
+        : (8 == Var->Size? OP_MOV64 : OP_MOV32);
+    IrOperand Source = *PromoteOperandAt(&Fn->Ins[Index], IR_SLOT_RD);
+    PromoteSetMove(Fn, Index, Move, PromoteReg(Var->Reg, IR_SLOT_RD), Source);
+    if (Var->SignExtended && Var->Size < 4)
+    {
+        UInt Amount = 32 - 8*Var->Size;
+        U32 Shift = IrInsertAfter(Fn, Index, OP_QSHL);
+        PromoteSetShift(Fn, Shift, Var->Reg, Amount);
+        Shift = IrInsertAfter(Fn, Shift, OP_QASR);
+        PromoteSetShift(Fn, Shift, Var->Reg, Amount);
+    }
+}
+
+static void PromoteRewrite(Promote *P)
+{
+    IrFunction *Fn = P->Fn;
+
+    /* the ones that could be read before they are written start out with what is in their slot */
+    U64 LiveIn = P->LiveIn[0];
+    for (U32 k = P->PromotedCount; k-- > 0;)
+    {
+        if (LiveIn & ((U64)1 << k))
+            PromoteSetMemory(Fn, IrInsertAfter(Fn, P->Enter, 0), &P->Vars[P->Promoted[k]], false);
+    }
+
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        U64 Clean = PromoteCleanIn(P, b);
+        U32 Next;
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Next)
+        {
+            Next = Fn->Ins[i].Next;
+            if (i >= P->InsCount)
+                continue;
+            if (PromoteIsCall(&Fn->Ins[i]))
+            {
+                U64 Saved = P->LiveAfter[i] & P->Clobbered[i];
+                for (U32 k = 0; k < P->PromotedCount; k++)
+                {
+                    U64 Mask = (U64)1 << k;
+                    const PromoteVar *Var = &P->Vars[P->Promoted[k]];
+                    if (Saved & Mask & ~Clean)
+                        PromoteSetMemory(Fn, IrInsertBefore(Fn, i, 0), Var, true);
+                    if (Saved & Mask)
+                        PromoteSetMemory(Fn, IrInsertAfter(Fn, i, 0), Var, false);
+                }
+                Clean = (Clean & ~P->Clobbered[i]) | Saved;
+            }
+            else if (IR_NONE != PromoteBitOf(P, i))
+            {
+                if (PromoteIsStore(P, i))
+                    Clean &= ~((U64)1 << PromoteBitOf(P, i));
+                PromoteRewriteAccess(P, i);
+            }
+        }
+    }
+}
+
+
+
+
+bool IrPromoteLocals(PascalCompiler *Compiler, IrFunction *Fn)
+{
+    PASCAL_NONNULL(Compiler);
+    PASCAL_NONNULL(Fn);
+
+    Promote P = {
+        .Compiler = Compiler,
+        .Fn = Fn,
+        .InsCount = Fn->InsCount,
+        .Enter = IR_NONE,
+    };
+    PromoteCollectVars(&P, CurrentScope(Compiler));
+    if (0 == P.VarCount)
+        return false;
+    PromoteFindLoops(&P);
+    if (!PromoteScan(&P))
+        return false;
+    PromoteFindCallClobbers(&P);
+    PromoteChoose(&P);
+    if (0 == P.PromotedCount)
+        return false;
+
+    PromoteFindClobbered(&P);
+    PromoteLiveness(&P);
+    PromoteFindClean(&P);
+    PromoteRewrite(&P);
+    return true;
+}
+
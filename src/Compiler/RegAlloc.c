@@ -0,0 +1,662 @@
+
+#include <string.h>
+
+#include "Compiler/RegAlloc.h"
+
+
+
+/* positions: every block starts and ends with one, an instruction reads its operands at its own
+ * and writes its results at the next, phis write theirs where their block starts */
+typedef struct RegAllocRange
+{
+    U32 Start, End; /* both are in it, Start is IR_NONE if it is empty */
+} RegAllocRange;
+
+/* st64 rX, [rsp + n] ... ld64 rY, [rsp + n] in a block, with nothing moving SP in between */
+typedef struct RegAllocPair
+{
+    U32 Stored, Restored;   /* groups */
+    U32 StorePos, ReloadPos;
+    bool Broken;            /* the reload does not get the register that was spilled */
+} RegAllocPair;
+
+typedef struct RegAlloc
+{
+    IrFunction *Fn;
+    U32 *Pos;               /* per instruction */
+    U32 *BlockStart, *BlockEnd;
+    U32 PosCount;
+
+    /* per value, a group is the values that must share a register, named after one of them */
+    U32 *Group;
+    RegAllocRange *Live;    /* of the value, then of the group */
+    bool *Fixed;            /* the group keeps its register */
+    bool *Assigned;
+    U8 *Reg;
+    U32 *Hint;              /* the group a move copies it from, IR_NONE if there is none */
+    U32 *PairOf;            /* the pair it is the reload of, IR_NONE if there is none */
+
+    RegAllocPair *Pairs;
+    U32 PairCount, PairCap;
+
+    /* intervals of fixed groups per register, merged and in order */
+    RegAllocRange *Busy;
+    U32 BusyFirst[IR_REG_FLAG], BusyEnd[IR_REG_FLAG];
+    U32 BusyCursor[IR_REG_FLAG];
+    U32 ActiveUntil[IR_REG_FLAG];   /* past the end of the last group that was given the register */
+} RegAlloc;
+
+
+
+
+static void *RegAllocArray(RegAlloc *A, U32 Count, U32 Size)
+{
+    return ArenaAllocate(A->Fn->Arena, (Count + 1) * Size);
+}
+
+static bool RegAllocIsReserved(UInt Reg)
+{
+    return PVM_REG_GP == Reg || PVM_REG_FP == Reg || PVM_REG_SP == Reg;
+}
+
+static bool RegAllocIsPushOrPop(U16 Op)
+{
+    return OP_PSHL == Op || OP_PSHH == Op || OP_FPSHL == Op || OP_FPSHH == Op
+        || OP_POPL == Op || OP_POPH == Op || OP_FPOPL == Op || OP_FPOPH == Op;
+}
+
+/* the load that gives back what the store wrote, 0 if it is not a store of a whole register */
+static U16 RegAllocReloadOf(U16 Op)
+{
+    switch (Op)
+    {
+    case OP_ST64: return OP_LD64;
+    case OP_ST64L: return OP_LD64L;
+    case OP_STF64: return OP_LDF64;
+    case OP_STF64L: return OP_LDF64L;
+    default: return 0;
+    }
+}
+
+static bool RegAllocIsReload(U16 Op)
+{
+    return OP_LD64 == Op || OP_LD64L == Op || OP_LDF64 == Op || OP_LDF64L == Op;
+}
+
+static I32 RegAllocOffsetOf(const IrIns *Ins)
+{
+    return 2 == Ins->Size
+        ? (I16)Ins->Code[1]
+        : (I32)((U32)Ins->Code[1] | (U32)Ins->Code[2] << 16);
+}
+
+static const IrOperand *RegAllocOperandAt(const IrIns *Ins, IrSlot Slot)
+{
+    for (U32 i = 0; i < Ins->UseCount; i++)
+    {
+        if (Slot == Ins->Use[i].Slot)
+            return &Ins->Use[i];
+    }
+    return NULL;
+}
+
+static bool RegAllocTouchesSP(const IrIns *Ins, bool Defines)
+{
+    const IrOperand *Operands = Defines? Ins->Def : Ins->Use;
+    U32 Count = Defines? Ins->DefCount : Ins->UseCount;
+    for (U32 i = 0; i < Count; i++)
+    {
+        if (IR_NONE == Operands[i].Value && PVM_REG_SP == Operands[i].Reg)
+            return true;
+    }
+    return false;
+}
+
+
+static U32 RegAllocFind(RegAlloc *A, U32 Value)
+{
+    while (A->Group[Value] != Value)
+    {
+        A->Group[Value] = A->Group[A->Group[Value]];
+        Value = A->Group[Value];
+    }
+    return Value;
+}
+
+static void RegAllocUnion(RegAlloc *A, U32 X, U32 Y)
+{
+    if (IR_NONE == X || IR_NONE == Y)
+        return;
+    X = RegAllocFind(A, X);
+    Y = RegAllocFind(A, Y);
+    if (X != Y)
+        A->Group[Y] = X;
+}
+
+static void RegAllocExtend(RegAllocRange *Range, U32 Pos)
+{
+    if (IR_NONE == Range->Start || Pos < Range->Start)
+        Range->Start = Pos;
+    if (Pos > Range->End)
+        Range->End = Pos;
+}
+
+
+
+
+static void RegAllocNumber(RegAlloc *A)
+{
+    IrFunction *Fn = A->Fn;
+    U32 Pos = 0;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        A->BlockStart[b] = Pos++;
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            if (IR_OP_PHI == Fn->Ins[i].Op)
+                A->Pos[i] = A->BlockStart[b];
+            else
+            {
+                A->Pos[i] = Pos;
+                Pos += 2;
+            }
+        }
+        A->BlockEnd[b] = Pos++;
+    }
+    A->PosCount = Pos;
+}
+
+/* a source is still needed while the instruction writes, unless it is only copied or written over in place */
+static bool RegAllocUseEndsEarly(IrFunction *Fn, const IrIns *Ins, U32 Value)
+{
+    if (OP_MOV64 == Ins->Op || OP_FMOV64 == Ins->Op)
+        return true;
+    for (U32 k = 0; k < Ins->DefCount; k++)
+    {
+        U32 Def = IrResolve(Fn, Ins->Def[k].Value);
+        if (IR_NONE != Def && Fn->Values[Def].Reg == Fn->Values[Value].Reg)
+            return true;
+    }
+    return false;
+}
+
+/* Value is live when Block starts, and so when its predecessors end, up to the block that defines it */
+static void RegAllocLiveIn(RegAlloc *A, U32 Value, U32 DefBlock, U32 Block, U32 *Seen, U32 *Worklist)
+{
+    if (Seen[Block] == Value)
+        return;
+    Seen[Block] = Value;
+    U32 Count = 0;
+    Worklist[Count++] = Block;
+    while (Count)
+    {
+        U32 Next = Worklist[--Count];
+        const IrBlock *B = &A->Fn->Blocks[Next];
+        RegAllocExtend(&A->Live[Value], A->BlockStart[Next]);
+        for (U32 p = 0; p < B->PredCount; p++)
+        {
+            U32 Pred = B->Pred[p];
+            RegAllocExtend(&A->Live[Value], A->BlockEnd[Pred]);
+            if (Pred != DefBlock && Seen[Pred] != Value)
+            {
+                Seen[Pred] = Value;
+                Worklist[Count++] = Pred;
+            }
+        }
+    }
+}
+
+/* one interval per value from its definition to its last use, with no holes */
+static bool RegAllocComputeLiveness(RegAlloc *A)
+{
+    IrFunction *Fn = A->Fn;
+    U32 *UseStart = ArenaAllocateZero(Fn->Arena, (Fn->ValueCount + 2) * sizeof *UseStart);
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        A->Live[v] = (RegAllocRange) { .Start = IR_NONE, .End = 0 };
+        A->Fixed[v] = false;
+    }
+
+    /* definitions, and what keeps a value where it is */
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        bool IsPhi = IR_OP_PHI == Ins->Op;
+        bool IsEntry = IR_OP_ENTRY == Ins->Op;
+        for (U32 k = 0; k < Ins->DefCount; k++)
+        {
+            U32 Value = IrResolve(Fn, Ins->Def[k].Value);
+            if (IR_NONE == Value)
+                continue;
+            RegAllocExtend(&A->Live[Value], IsPhi? A->BlockStart[Ins->Block] : A->Pos[i] + 1);
+            if ((!IsPhi && (IsEntry || IR_SLOT_FIXED == Ins->Def[k].Slot)) || Fn->Values[Value].Reg >= IR_REG_FLAG)
+                A->Fixed[Value] = true;
+        }
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            U32 Value = IrResolve(Fn, Ins->Use[k].Value);
+            if (IR_NONE == Value)
+                continue;
+            UseStart[Value + 2]++;
+            if (!IsPhi && IR_SLOT_FIXED == Ins->Use[k].Slot)
+                A->Fixed[Value] = true;
+        }
+    }
+
+    /* the uses of each value together, so that a walk marks blocks for one value at a time */
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+        UseStart[v + 2] += UseStart[v + 1];
+    U32 UseTotal = UseStart[Fn->ValueCount + 1];
+    U32 *UseIns = RegAllocArray(A, UseTotal, sizeof *UseIns);
+    U8 *UseIndex = RegAllocArray(A, UseTotal, sizeof *UseIndex);
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block)
+            continue;
+        for (U32 k = 0; k < Ins->UseCount; k++)
+        {
+            U32 Value = IrResolve(Fn, Ins->Use[k].Value);
+            if (IR_NONE == Value)
+                continue;
+            U32 At = UseStart[Value + 1]++;
+            UseIns[At] = i;
+            UseIndex[At] = k;
+        }
+    }
+
+    U32 *Seen = RegAllocArray(A, Fn->BlockCount, sizeof *Seen);
+    U32 *Worklist = RegAllocArray(A, Fn->BlockCount, sizeof *Worklist);
+    memset(Seen, 0xFF, Fn->BlockCount * sizeof *Seen);
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        if (UseStart[v] == UseStart[v + 1])
+            continue;
+        U32 DefBlock = Fn->Ins[Fn->Values[v].Ins].Block;
+        if (IR_NONE == DefBlock || IR_NONE == A->Live[v].Start)
+            return false;
+
+        for (U32 u = UseStart[v]; u < UseStart[v + 1]; u++)
+        {
+            const IrIns *Ins = &Fn->Ins[UseIns[u]];
+            U32 Block = Ins->Block;
+            if (IR_OP_PHI == Ins->Op)
+            {
+                /* read when the predecessor it comes from ends */
+                Block = Fn->Blocks[Ins->Block].Pred[UseIndex[u]];
+                RegAllocExtend(&A->Live[v], A->BlockEnd[Block]);
+            }
+            else
+            {
+                bool EndsEarly = IR_SLOT_FIXED == Ins->Use[UseIndex[u]].Slot || RegAllocUseEndsEarly(Fn, Ins, v);
+                RegAllocExtend(&A->Live[v], A->Pos[UseIns[u]] + !EndsEarly);
+            }
+            if (Block != DefBlock)
+                RegAllocLiveIn(A, v, DefBlock, Block, Seen, Worklist);
+        }
+    }
+    return true;
+}
+
+
+/* values that must be in the same register end up in the same group */
+static void RegAllocMakeGroups(RegAlloc *A)
+{
+    IrFunction *Fn = A->Fn;
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+        A->Group[v] = v;
+
+    for (U32 i = 0; i < Fn->InsCount; i++)
+    {
+        const IrIns *Ins = &Fn->Ins[i];
+        if (IR_NONE == Ins->Block || 0 == Ins->DefCount)
+            continue;
+        if (IR_OP_PHI == Ins->Op)
+        {
+            for (U32 k = 0; k < Ins->UseCount; k++)
+                RegAllocUnion(A, IrResolve(Fn, Ins->Def[0].Value), IrResolve(Fn, Ins->Use[k].Value));
+            continue;
+        }
+        /* a field that is both read and written */
+        for (U32 d = 0; d < Ins->DefCount; d++)
+        {
+            if (IR_SLOT_FIXED == Ins->Def[d].Slot)
+                continue;
+            for (U32 k = 0; k < Ins->UseCount; k++)
+            {
+                if (Ins->Use[k].Slot == Ins->Def[d].Slot)
+                    RegAllocUnion(A, IrResolve(Fn, Ins->Def[d].Value), IrResolve(Fn, Ins->Use[k].Value));
+            }
+        }
+    }
+
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        A->Reg[v] = Fn->Values[v].Reg;
+        A->Assigned[v] = false;
+        A->Hint[v] = IR_NONE;
+        A->PairOf[v] = IR_NONE;
+    }
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        U32 Root = RegAllocFind(A, v);
+        if (Root == v || IR_NONE == A->Live[v].Start)
+            continue;
+        RegAllocExtend(&A->Live[Root], A->Live[v].Start);
+        RegAllocExtend(&A->Live[Root], A->Live[v].End);
+        A->Fixed[Root] = A->Fixed[Root] || A->Fixed[v] || Fn->Values[v].Reg != Fn->Values[Root].Reg;
+    }
+}
+
+/* the callee writes whatever it wants, what lives across a call was saved by the emitter where it is */
+static void RegAllocFixAcrossCalls(RegAlloc *A)
+{
+    IrFunction *Fn = A->Fn;
+    U32 *Calls = RegAllocArray(A, Fn->InsCount, sizeof *Calls);
+    U32 CallCount = 0;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            if (Fn->Ins[i].Flags & IR_INS_CALL)
+                Calls[CallCount++] = A->Pos[i];
+        }
+    }
+    if (0 == CallCount)
+        return;
+
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        const RegAllocRange *Live = &A->Live[v];
+        if (A->Group[v] != v || A->Fixed[v] || IR_NONE == Live->Start)
+            continue;
+        U32 Lo = 0, Hi = CallCount;
+        while (Lo < Hi)
+        {
+            U32 Mid = Lo + (Hi - Lo) / 2;
+            if (Calls[Mid] < Live->Start)
+                Lo = Mid + 1;
+            else Hi = Mid;
+        }
+        A->Fixed[v] = Lo < CallCount && Calls[Lo] + 2 <= Live->End;
+    }
+}
+
+
+static void RegAllocAddPair(RegAlloc *A, RegAllocPair Pair)
+{
+    if (A->PairCount == A->PairCap)
+    {
+        U32 NewCap = A->PairCap * 2 + 8;
+        RegAllocPair *Pairs = RegAllocArray(A, NewCap, sizeof *Pairs);
+        if (A->PairCount)
+            memcpy(Pairs, A->Pairs, A->PairCount * sizeof *Pairs);
+        A->Pairs = Pairs;
+        A->PairCap = NewCap;
+    }
+    A->Pairs[A->PairCount++] = Pair;
+}
+
+/* the spills the emitter wrote, and moves whose copy would like the register of what it copies */
+static void RegAllocFindHints(RegAlloc *A)
+{
+    IrFunction *Fn = A->Fn;
+    for (U32 b = 0; b < Fn->BlockCount; b++)
+    {
+        for (U32 i = Fn->Blocks[b].First; IR_NONE != i; i = Fn->Ins[i].Next)
+        {
+            const IrIns *Store = &Fn->Ins[i];
+            if ((OP_MOV64 == Store->Op || OP_FMOV64 == Store->Op) && 1 == Store->DefCount)
+            {
+                U32 To = IrResolve(Fn, Store->Def[0].Value);
+                U32 From = IrResolve(Fn, Store->Use[0].Value);
+                if (IR_NONE != To && IR_NONE != From)
+                    A->Hint[RegAllocFind(A, To)] = RegAllocFind(A, From);
+                continue;
+            }
+
+            U16 ReloadOp = RegAllocReloadOf(Store->Op);
+            const IrOperand *Base = RegAllocOperandAt(Store, IR_SLOT_RS);
+            const IrOperand *Saved = RegAllocOperandAt(Store, IR_SLOT_RD);
+            if (0 == ReloadOp || NULL == Base || NULL == Saved
+            || IR_NONE != Base->Value || PVM_REG_SP != Base->Reg || RegAllocOffsetOf(Store) > 0)
+                continue;
+
+            I32 Offset = RegAllocOffsetOf(Store);
+            U32 Reload = IR_NONE;
+            for (U32 k = Store->Next; IR_NONE != k; k = Fn->Ins[k].Next)
+            {
+                const IrIns *Ins = &Fn->Ins[k];
+                if ((Ins->Flags & IR_INS_CALL) || RegAllocIsPushOrPop(Ins->Op) || RegAllocTouchesSP(Ins, true))
+                    break;
+                if (!RegAllocTouchesSP(Ins, false))
+                    continue;
+                if (0 == RegAllocReloadOf(Ins->Op) && !RegAllocIsReload(Ins->Op))
+                    break;
+                I32 Other = RegAllocOffsetOf(Ins);
+                if (ReloadOp == Ins->Op && Other == Offset)
+                {
+                    Reload = k;
+                    break;
+                }
+                if ((I64)Other > (I64)Offset - 8 && (I64)Other < (I64)Offset + 8)
+                    break;
+            }
+            if (IR_NONE == Reload)
+                continue;
+
+            U32 Stored = IrResolve(Fn, Saved->Value);
+            U32 Restored = IrResolve(Fn, Fn->Ins[Reload].Def[0].Value);
+            if (IR_NONE == Stored || IR_NONE == Restored)
+                continue;
+            Stored = RegAllocFind(A, Stored);
+            Restored = RegAllocFind(A, Restored);
+            if (Stored == Restored || A->Fixed[Restored] || IR_NONE != A->PairOf[Restored])
+                continue;
+            A->PairOf[Restored] = A->PairCount;
+            RegAllocAddPair(A, (RegAllocPair) {
+                .Stored = Stored,
+                .Restored = Restored,
+                .StorePos = A->Pos[i],
+                .ReloadPos = A->Pos[Reload],
+            });
+        }
+    }
+}
+
+
+/* Order gets the groups in Groups by where they start */
+static void RegAllocSort(RegAlloc *A, U32 *Order, const U32 *Groups, U32 Count)
+{
+    U32 *Bucket = ArenaAllocateZero(A->Fn->Arena, (A->PosCount + 1) * sizeof *Bucket);
+    for (U32 i = 0; i < Count; i++)
+        Bucket[A->Live[Groups[i]].Start + 1]++;
+    for (U32 p = 0; p < A->PosCount; p++)
+        Bucket[p + 1] += Bucket[p];
+    for (U32 i = 0; i < Count; i++)
+        Order[Bucket[A->Live[Groups[i]].Start]++] = Groups[i];
+}
+
+/* returns the groups that get a register, in order */
+static U32 RegAllocCollect(RegAlloc *A, U32 *Order)
+{
+    IrFunction *Fn = A->Fn;
+    U32 *Groups = RegAllocArray(A, Fn->ValueCount, sizeof *Groups);
+    U32 *Fixed = RegAllocArray(A, Fn->ValueCount, sizeof *Fixed);
+    U32 GroupCount = 0, FixedCount = 0;
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        if (A->Group[v] != v || IR_NONE == A->Live[v].Start)
+            continue;
+        if (!A->Fixed[v])
+            Groups[GroupCount++] = v;
+        else if (A->Reg[v] < IR_REG_FLAG)
+            Fixed[FixedCount++] = v;
+        A->Assigned[v] = A->Fixed[v];
+    }
+
+    /* what fixed groups occupy, per register */
+    U32 *Sorted = RegAllocArray(A, FixedCount, sizeof *Sorted);
+    RegAllocSort(A, Sorted, Fixed, FixedCount);
+    A->Busy = RegAllocArray(A, FixedCount, sizeof *A->Busy);
+    memset(A->BusyEnd, 0, sizeof A->BusyEnd);
+    for (U32 i = 0; i < FixedCount; i++)
+        A->BusyEnd[A->Reg[Sorted[i]]]++;
+    U32 First = 0;
+    for (UInt r = 0; r < IR_REG_FLAG; r++)
+    {
+        A->BusyFirst[r] = First;
+        First += A->BusyEnd[r];
+        A->BusyEnd[r] = A->BusyFirst[r];
+        A->BusyCursor[r] = A->BusyFirst[r];
+        A->ActiveUntil[r] = 0;
+    }
+    for (U32 i = 0; i < FixedCount; i++)
+    {
+        UInt Reg = A->Reg[Sorted[i]];
+        RegAllocRange Live = A->Live[Sorted[i]];
+        RegAllocRange *Last = &A->Busy[A->BusyEnd[Reg] - 1];
+        if (A->BusyEnd[Reg] != A->BusyFirst[Reg] && Live.Start <= Last->End)
+            Last->End = uMax(Last->End, Live.End);
+        else A->Busy[A->BusyEnd[Reg]++] = Live;
+    }
+
+    RegAllocSort(A, Order, Groups, GroupCount);
+    return GroupCount;
+}
+
+static bool RegAllocIsBusy(RegAlloc *A, UInt Reg, RegAllocRange Live)
+{
+    /* groups come in order of where they start, the cursor only moves forward */
+    U32 *Cursor = &A->BusyCursor[Reg];
+    while (*Cursor < A->BusyEnd[Reg] && A->Busy[*Cursor].End < Live.Start)
+        (*Cursor)++;
+    return *Cursor < A->BusyEnd[Reg] && A->Busy[*Cursor].Start <= Live.End;
+}
+
+/* the spills still waiting for their reload while Live is, by the register they were spilled from */
+static void RegAllocProtected(RegAlloc *A, U32 Group, RegAllocRange Live, U32 *ReloadAt)
+{
+    for (U32 i = 0; i < A->PairCount; i++)
+    {
+        const RegAllocPair *Pair = &A->Pairs[i];
+        if (Pair->Broken || i == A->PairOf[Group] || !A->Assigned[Pair->Stored]
+        || Pair->StorePos >= Live.End || Pair->ReloadPos <= Live.Start)
+            continue;
+        UInt Reg = A->Reg[Pair->Stored];
+        ReloadAt[Reg] = uMax(ReloadAt[Reg], Pair->ReloadPos);
+    }
+}
+
+static bool RegAllocScan(RegAlloc *A, const U32 *Order, U32 Count)
+{
+    for (U32 n = 0; n < Count; n++)
+    {
+        U32 Group = Order[n];
+        RegAllocRange Live = A->Live[Group];
+        UInt First = A->Reg[Group] < PVM_REG_COUNT? 0 : PVM_REG_COUNT;
+        UInt Last = First + (A->Reg[Group] < PVM_REG_COUNT? PVM_REG_COUNT : PVM_FREG_COUNT);
+
+        bool Free[IR_REG_FLAG];
+        U32 ReloadAt[IR_REG_FLAG] = { 0 };
+        for (UInt r = First; r < Last; r++)
+        {
+            Free[r] = !RegAllocIsReserved(r) && A->ActiveUntil[r] <= Live.Start
+                && !RegAllocIsBusy(A, r, Live);
+        }
+        RegAllocProtected(A, Group, Live, ReloadAt);
+
+        /* the register that was spilled for a reload, the one copied for a move, then the one it had */
+        U32 Hints[3] = { IR_NONE, IR_NONE, A->Reg[Group] };
+        U32 Pair = A->PairOf[Group];
+        if (IR_NONE != Pair && !A->Pairs[Pair].Broken && A->Assigned[A->Pairs[Pair].Stored])
+            Hints[0] = A->Reg[A->Pairs[Pair].Stored];
+        if (IR_NONE != A->Hint[Group] && A->Assigned[A->Hint[Group]])
+            Hints[1] = A->Reg[A->Hint[Group]];
+
+        U32 Choice = IR_NONE;
+        for (UInt h = 0; h < STATIC_ARRAY_SIZE(Hints) && IR_NONE == Choice; h++)
+        {
+            if (Hints[h] >= First && Hints[h] < Last && Free[Hints[h]] && 0 == ReloadAt[Hints[h]])
+                Choice = Hints[h];
+        }
+        for (UInt r = First; r < Last && IR_NONE == Choice; r++)
+        {
+            if (Free[r] && 0 == ReloadAt[r])
+                Choice = r;
+        }
+        if (IR_NONE == Choice)
+        {
+            /* the spill reloaded last is the one that stays */
+            for (UInt r = First; r < Last; r++)
+            {
+                if (Free[r] && (IR_NONE == Choice || ReloadAt[r] > ReloadAt[Choice]))
+                    Choice = r;
+            }
+            if (IR_NONE == Choice)
+                return false;
+            for (U32 i = 0; i < A->PairCount; i++)
+            {
+                RegAllocPair *Other = &A->Pairs[i];
+                if (!Other->Broken && i != Pair && A->Assigned[Other->Stored] && A->Reg[Other->Stored] == Choice
+                && Other->StorePos < Live.End && Other->ReloadPos > Live.Start)
+                    Other->Broken = true;
+            }
+        }
+
+        A->Reg[Group] = Choice;
+        A->Assigned[Group] = true;
+        A->ActiveUntil[Choice] = Live.End + 1;
+        if (IR_NONE != Pair && Choice != Hints[0])
+            A->Pairs[Pair].Broken = true;
+    }
+    return true;
+}
+
+
+
+
+bool IrAllocateRegisters(IrFunction *Fn)
+{
+    PASCAL_NONNULL(Fn);
+
+    RegAlloc A = {
+        .Fn = Fn,
+    };
+    A.Pos = RegAllocArray(&A, Fn->InsCount, sizeof *A.Pos);
+    A.BlockStart = RegAllocArray(&A, Fn->BlockCount, sizeof *A.BlockStart);
+    A.BlockEnd = RegAllocArray(&A, Fn->BlockCount, sizeof *A.BlockEnd);
+    A.Group = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Group);
+    A.Live = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Live);
+    A.Fixed = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Fixed);
+    A.Assigned = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Assigned);
+    A.Reg = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Reg);
+    A.Hint = RegAllocArray(&A, Fn->ValueCount, sizeof *A.Hint);
+    A.PairOf = RegAllocArray(&A, Fn->ValueCount, sizeof *A.PairOf);
+
+    RegAllocNumber(&A);
+    if (!RegAllocComputeLiveness(&A))
+        return false;
+    RegAllocMakeGroups(&A);
+    RegAllocFixAcrossCalls(&A);
+    RegAllocFindHints(&A);
+
+    U32 *Order = RegAllocArray(&A, Fn->ValueCount, sizeof *Order);
+    U32 Count = RegAllocCollect(&A, Order);
+    if (!RegAllocScan(&A, Order, Count))
+        return false;
+
+    bool Changed = false;
+    for (U32 v = 0; v < Fn->ValueCount; v++)
+    {
+        if (IR_NONE == A.Live[v].Start)
+            continue;
+        U8 Reg = A.Reg[RegAllocFind(&A, v)];
+        Changed = Changed || Reg != Fn->Values[v].Reg;
+        Fn->Values[v].Reg = Reg;
+    }
+    return Changed;
+}
+
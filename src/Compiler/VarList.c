@@ -171,6 +171,23 @@ bool ParseAndDefineTypename(PascalCompiler *Compiler, const Token *Identifier, V
             PASCAL_UNREACHABLE("TODO: dynamic and open array");
         }
     }
+    else if (ConsumeIfNextTokenIs(Compiler, TOKEN_FILE))
+    {
+        /* only typed files, text is a predefined type */
+        ConsumeOrError(Compiler, TOKEN_OF, "Expected 'of' after 'file'.");
+        Token ElementName = Compiler->Next;
+        VarType Element;
+        if (!ParseAndDefineTypename(Compiler, NULL, &Element))
+            return false;
+        if (TYPE_FILE == Element.Integral || 0 == Element.Size)
+        {
+            StringView ElementType = VarTypeToStringView(Element);
+            ErrorAt(Compiler, &ElementName, "A file cannot hold values of type "STRVIEW_FMT".", 
+                STRVIEW_FMT_ARG(ElementType)
+            );
+        }
+        *Out = VarTypeFile(CompilerCopyType(Compiler, Element));
+    }
     else if (ConsumeIfNextTokenIs(Compiler, TOKEN_FUNCTION))
     {
         /* create the function scope */
@@ -304,7 +321,10 @@ U32 CompileVarList(PascalCompiler *Compiler, UInt BaseRegister, U32 StartAddr, U
         Location->LocationType = VAR_MEM;
         Location->As.Memory = (VarMemory) {
             .Location = EndAddr,
-            .RegPtr.ID = BaseRegister,
+            .RegPtr = {
+                .ID = BaseRegister,
+                .Persistent = true,
+            },
         };
         EndAddr += AlignedSize;
     }
@@ -448,12 +468,18 @@ void CompileArgumentList(PascalCompiler *Compiler,
 }
 
 
-void CompilerEmitCall(PascalCompiler *Compiler, const VarLocation *Location, SaveRegInfo SaveRegs)
+void CompilerEmitCall(PascalCompiler *Compiler, const VarLocation *Location, SaveRegInfo SaveRegs,
+        const InlineSite *Inline)
 {
     PASCAL_NONNULL(Compiler);
     PASCAL_NONNULL(Location);
+    PASCAL_NONNULL(Inline);
 
-    if (TYPE_POINTER == Location->Type.Integral)
+    if (NULL != Inline->Callee)
+    {
+        InlineEmitCall(Compiler, Inline);
+    }
+    else if (TYPE_POINTER == Location->Type.Integral)
     {
         /* function ptr was saved among saved caller regs */
         if (VAR_REG == Location->LocationType
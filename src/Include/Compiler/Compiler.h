@@ -7,6 +7,7 @@
 #include "Vartab.h"
 #include "PVM/Chunk.h"
 #include "Data.h"
+#include "Compiler/Peephole.h"
 
 #define PVM_MAX_FUNCTION_COUNT 1024
 #define PVM_MAX_SCOPE_COUNT 16              /* 15 nested functions */
@@ -39,6 +40,9 @@ struct PascalCompileFlags
 {
     PVMCallConv CallConv;
     PascalCompileMode CompMode;
+    UInt OptLevel;  /* 0 leaves the emitted code as it is */
+    bool DumpIr;    /* each optimized subroutine's IR goes to the log file */
+    bool NoThreeOperand; /* keeps the moves three-operand instructions save, to measure them */
 };
 
 
@@ -85,6 +89,19 @@ struct PascalCompiler
         U32 Count, Cap;
     } SubroutineReferences;
 
+    /* every subroutine body in the order they end, for the link step */
+    struct {
+        struct {
+            U32 *Location;
+            U32 End;
+            U64 Clobbers;   /* registers its code writes, or the code of what it calls */
+            bool IsNested;
+        } *Data;
+        U32 Count, Cap;
+    } SubroutineBodies;
+
+    PeepholeStats Peephole; /* rule hits over every optimized subroutine */
+
     U32 Line;
     U32 EntryPoint;
     FILE *LogFile;
@@ -0,0 +1,22 @@
+#ifndef PASCAL_COMPILER_CONSTPROP_H
+#define PASCAL_COMPILER_CONSTPROP_H
+
+
+#include "Common.h"
+#include "Compiler/Ir.h"
+
+
+/*
+ * sparse conditional constant propagation over Fn.
+ * Besides registers, integers stored to the frame or to globals (FP or GP + offset)
+ * are followed to the loads that read them back, across blocks.
+ * Instructions that always compute the same integer become moves of it,
+ * branches that always go the same way become jumps or are removed,
+ * and blocks that can never run are emptied.
+ * Returns true if Fn changed
+ */
+bool IrPropagateConstants(IrFunction *Fn);
+
+
+#endif /* PASCAL_COMPILER_CONSTPROP_H */
+
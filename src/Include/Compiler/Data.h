@@ -61,6 +61,11 @@ VarLocation *CompilerAllocateVarLocation(PascalCompiler *Compiler);
 
 void PushSubroutineReference(PascalCompiler *Compiler, const U32 *SubroutineLocation, U32 CallSite);
 void ResolveSubroutineReferences(PascalCompiler *Compiler);
+/* the body of the subroutine at *Location ends at the current location,
+ * Clobbers are the registers it writes, or the ones it calls do */
+void PushSubroutineBody(PascalCompiler *Compiler, U32 *Location, bool IsNested, U64 Clobbers);
+/* the registers a call to the subroutine at *Location might write, all of them if its body is not done yet */
+U64 SubroutineClobbers(const PascalCompiler *Compiler, const U32 *Location);
 
 void CompilerResetTmp(PascalCompiler *Compiler);
 void CompilerPushTmp(PascalCompiler *Compiler, Token Identifier);
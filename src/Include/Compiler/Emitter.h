@@ -17,21 +17,36 @@
 struct SaveRegInfo 
 {
     U32 Size;
-    U32 Regs;
+    U64 Regs;
+    U64 Kept; /* allocated registers that were not saved because the callee leaves them alone */
+    U32 StackSpace; /* of the emitter before they were pushed */
     U32 RegLocation[PVM_REG_COUNT + PVM_FREG_COUNT];
 };
 
+/* the content of Reg before it was handed out again, kept in a slot of the frame until Reg is freed */
+typedef struct PVMSpill
+{
+    U32 Reg;
+    U32 Slot;           /* in PVMGPR, counted down from the top of the frame */
+    U32 AllocatedAt;    /* of the content */
+} PVMSpill;
+
 struct PVMEmitter 
 {
     PVMChunk *Chunk;
-    U32 Reglist;
-
-    I32 SpilledIntRegs, SpilledFltRegs;
-    /* offset directly from SP, 
-     * the offset is calculated from 
-     * adding SpilledIntRegs with SpilledFltRegs and multiply by the size of PVMGPR */
-    I32 SpilledIntRegLocation[PVM_REG_COUNT*4];
-    I32 SpilledFltRegLocation[PVM_FREG_COUNT*4];
+    /* R0-R31 in bits 0-31, F0-F31 in bits 32-63 */
+    U64 Reglist;
+
+    /* when each register was handed out, by AllocationCount */
+    U32 AllocatedAt[PVM_REG_COUNT + PVM_FREG_COUNT];
+    U32 AllocationCount;
+    /* registers that hold variables, never spilled */
+    U64 Pinned;
+
+    /* registers that were handed out again while taken, the latest spill is last */
+    PVMSpill *Spills;
+    U32 SpillCount, SpillCap;
+    /* the spill slots at the top of the frame */
     U32 SpilledRegSpace;
     U32 StackSpace;
     struct {
@@ -41,6 +56,11 @@ struct PVMEmitter
 
     bool ShouldEmit;
     VarLocation ReturnValue;
+
+    /* what PVMEmitBranchIf* can turn into a compare and branch: 
+     * the last compare and the last literal loaded into a temporary register, 
+     * UINT32_MAX if a branch target was placed after them */
+    U32 LastCompare, LastLiteral;
 };
 
 PVMEmitter PVMEmitterInit(PVMChunk *Chunk);
@@ -61,13 +81,19 @@ VarRegister PVMAllocateFltReg(PVMEmitter *Emitter);
 #define PVMAllocateRegister(pEmitter, IntegralTyp) \
     (IntegralTypeIsFloat(IntegralTyp) ? PVMAllocateFltReg(pEmitter) : PVMAllocateIntReg(pEmitter))
 VarLocation PVMAllocateRegisterLocation(PVMEmitter *Emitter, VarType Type);
+/* Reg holds a variable from now on until it is freed, it is never spilled */
+void PVMPinRegister(PVMEmitter *Emitter, VarRegister *Reg);
 bool PVMRegisterIsFree(PVMEmitter *Emitter, UInt Reg);
 
 
 /* Branching instructions */
-/* returns the offset of the branch instruction for later patching */
+/* returns the offset of the branch instruction for later patching, 
+ * a compare right before the branch is merged into it and the flag is not set */
 U32 PVMEmitBranchIfFalse(PVMEmitter *Emitter, const VarLocation *Condition);
 U32 PVMEmitBranchIfTrue(PVMEmitter *Emitter, const VarLocation *Condition);
+/* same as above, but the flag still holds Condition after the branch */
+U32 PVMEmitBranchIfFalseKeepFlag(PVMEmitter *Emitter, const VarLocation *Condition);
+U32 PVMEmitBranchIfTrueKeepFlag(PVMEmitter *Emitter, const VarLocation *Condition);
 U32 PVMEmitBranchAndInc(PVMEmitter *Emitter, VarRegister Reg, I8 By, U32 To);
 /* returns the offset of the branch instruction for patching if necessary */
 U32 PVMEmitBranch(PVMEmitter *Emitter, U32 To);
@@ -117,6 +143,13 @@ void PVMEmitMod(PVMEmitter *Emitter, VarRegister Dst, const VarLocation *Src);
 void PVMEmitShl(PVMEmitter *Emitter, VarRegister Dst, const VarLocation *Src);
 void PVMEmitShr(PVMEmitter *Emitter, VarRegister Dst, const VarLocation *Src);
 void PVMEmitAsr(PVMEmitter *Emitter, VarRegister Dst, const VarLocation *Src);
+/* Dst = Lhs Operator Src with a three-operand instruction when Lhs is a register that must not be modified,
+ * Dst is a new register owned by the caller.
+ * Returns false and emits nothing otherwise,
+ * the caller then moves Lhs into Dst and uses the two-operand instructions above */
+bool PVMEmitBinaryOp3(PVMEmitter *Emitter, TokenType Operator,
+        VarLocation *Dst, const VarLocation *Lhs, const VarLocation *Src
+);
 /* returns flag */
 VarLocation PVMEmitSetIfLessOrEqual(PVMEmitter *Emitter, 
         VarRegister A, VarRegister B, IntegralType CommonType
@@ -166,6 +199,8 @@ void PVMInitializeGlobal(PVMEmitter *Emitter, VarMemory GLobal, const VarLiteral
 /* call instructions */
 #define NO_RETURN_REG (2*PVM_REG_COUNT)
 SaveRegInfo PVMEmitSaveCallerRegs(PVMEmitter *Emitter, UInt ReturnRegID);
+/* saves only the allocated registers in Clobbered */
+SaveRegInfo PVMEmitSaveClobberedRegs(PVMEmitter *Emitter, UInt ReturnRegID, U64 Clobbered);
 bool PVMRegIsSaved(SaveRegInfo Saved, UInt RegID);
 VarLocation PVMRetreiveSavedCallerReg(PVMEmitter *Emitter, SaveRegInfo Saved, UInt RegID, VarType Type);
 
@@ -183,6 +218,9 @@ void PVMEmitExit(PVMEmitter *Emitter);
 
 /* system calls */
 void PVMEmitWrite(PVMEmitter *Emitter);
+void PVMEmitRead(PVMEmitter *Emitter, bool Newline);
+/* one of the sys ops that take a text file in R1 */
+void PVMEmitFileOp(PVMEmitter *Emitter, PVMSysOp Op);
 
 
 #endif /* PASCAL_VM2_EMITTER_H */
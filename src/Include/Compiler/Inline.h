@@ -0,0 +1,42 @@
+#ifndef PASCAL_COMPILER_INLINE_H
+#define PASCAL_COMPILER_INLINE_H
+
+
+#include "Common.h"
+#include "Compiler/Data.h"
+
+
+/* subroutines marked inline longer than this many halfwords are called as usual */
+#define INLINE_MAX_SIZE 512
+/* leaf subroutines up to this many halfwords are inlined without being marked at -O2 */
+#define INLINE_MAX_AUTO_SIZE 40
+
+
+typedef struct InlineSite
+{
+    const U32 *Callee;  /* location of the callee's enter, NULL if the call is not inlined */
+    U32 End;            /* where the callee's code ends */
+    U32 FrameBase;      /* the callee's frame starts at this offset of the caller's */
+    U64 Clobbers;       /* registers the callee's code writes, all of them if the call is not inlined */
+} InlineSite;
+
+
+/*
+ * decides whether the call to Location is replaced by a copy of the callee's code,
+ * before the caller saves its registers so that it only has to save the ones the copy writes.
+ * The callee must be finished, at global scope, take all of its arguments in registers,
+ * never use SP and be marked inline, or be a small leaf at -O2.
+ * The callee's frame is then reserved in the caller's
+ */
+InlineSite InlinePlanCall(PascalCompiler *Compiler, const VarLocation *Location);
+
+/*
+ * writes the copy of the callee in place of the call instruction, with its frame moved into the caller's:
+ * the enter is gone, exits jump past the end,
+ * the calls in it are added to the compiler's subroutine references
+ */
+void InlineEmitCall(PascalCompiler *Compiler, const InlineSite *Site);
+
+
+#endif /* PASCAL_COMPILER_INLINE_H */
+
@@ -0,0 +1,180 @@
+#ifndef PASCAL_COMPILER_IR_H
+#define PASCAL_COMPILER_IR_H
+
+
+#include <stdio.h>
+
+#include "Common.h"
+#include "Memory.h"
+#include "PVM/Chunk.h"
+#include "PVM/Isa.h"
+#include "Compiler/Data.h"
+
+
+/*
+ * SSA form of one subroutine, lifted from the code the emitter wrote for it
+ * and lowered back in its place after the optimizer is done with it.
+ * Instructions keep their encoding, their register operands become values:
+ * every definition of a register is a new value,
+ * a block reached with different values of a register starts with a phi of them.
+ * Registers are numbered like the emitter does: R0-R31, F0-F31 as 32-63, then the condition flag.
+ * SP, FP and GP are never renamed
+ */
+#define IR_REG_FLAG (PVM_REG_COUNT + PVM_FREG_COUNT)
+#define IR_REG_COUNT (IR_REG_FLAG + 1)
+#define IR_NONE UINT32_MAX
+/* without the prefix, movi with a 64 bit immediate is the longest */
+#define IR_MAX_INS_SIZE 5
+/* subroutines longer than this many halfwords are left as they are */
+#define IR_MAX_REGION_SIZE (64 * 1024)
+#define IR_ARENA_SIZE (1024 * 1024)
+
+
+typedef enum IrType
+{
+    IR_TYPE_NONE = 0, /* whatever the register held on entry */
+    IR_TYPE_I32,
+    IR_TYPE_I64,
+    IR_TYPE_F32,
+    IR_TYPE_F64,
+    IR_TYPE_FLAG,
+} IrType;
+
+/* ops that are not PVM instructions, never lowered */
+typedef enum IrPseudoOp
+{
+    IR_OP_PHI = 0x100,
+    /* defines the value of each register on entry, the first instruction of the first block */
+    IR_OP_ENTRY,
+} IrPseudoOp;
+
+/* where a register operand is encoded */
+typedef enum IrSlot
+{
+    IR_SLOT_RD,     /* bits 4-7 of the first halfword */
+    IR_SLOT_RS,     /* bits 0-3 of the first halfword */
+    IR_SLOT_RT,     /* bits 4-7 of the second halfword */
+    IR_SLOT_FIXED,  /* implied: arguments, return registers, register lists and the flag */
+} IrSlot;
+
+typedef enum IrInsFlags
+{
+    IR_INS_BRANCH = 1 << 0,         /* Target is where it goes */
+    IR_INS_JUMP = 1 << 1,           /* does not fall through */
+    IR_INS_CALL = 1 << 2,           /* call, callptr and sys ops */
+    IR_INS_LOAD = 1 << 3,
+    IR_INS_STORE = 1 << 4,          /* writes memory */
+    IR_INS_SIDE_EFFECT = 1 << 5,    /* kept even if nothing uses its values */
+    IR_INS_SUBROUTINE_REF = 1 << 6, /* call and ldrip, Reference is patched later */
+} IrInsFlags;
+
+
+typedef struct IrOperand
+{
+    U32 Value;  /* IR_NONE for SP, FP and GP */
+    U8 Reg;     /* the register it was lifted from */
+    U8 Slot;    /* IrSlot */
+} IrOperand;
+
+typedef struct IrValue
+{
+    U32 Ins;        /* the instruction or phi defining it */
+    U32 Forward;    /* a removed phi or instruction stands for this value, IR_NONE otherwise */
+    U8 Reg;         /* where it is kept */
+    U8 Type;        /* IrType */
+} IrValue;
+
+typedef struct IrIns
+{
+    U16 Op;     /* PVMOp or IrPseudoOp */
+    U16 Flags;  /* IrInsFlags */
+    U16 Code[IR_MAX_INS_SIZE];
+    U8 Size;    /* halfwords of Code */
+    U8 Ext;     /* bits of the prefix it was lifted with */
+    U8 UseCount, DefCount;
+    IrOperand *Use, *Def; /* a phi has one use per predecessor of its block, in the same order */
+
+    U32 Block;          /* IR_NONE once removed */
+    U32 Prev, Next;
+    U32 Target;         /* block of a branch */
+    U32 StreamOffset;   /* where it was lifted from, IR_NONE if a pass created it */
+    U32 Location;       /* where it was lowered to */
+    U32 Reference;      /* index into the compiler's SubroutineReferences, or IR_NONE */
+} IrIns;
+
+typedef struct IrBlock
+{
+    U32 First, Last;    /* instructions, phis come first */
+    U32 *Pred;
+    U32 PredCount;
+    U32 Succ[2];        /* the one it falls through to, then the branch target, IR_NONE if there is none */
+    U32 StreamOffset;
+    U32 Location;       /* where it was lowered to */
+} IrBlock;
+
+/* the last block is always empty and stands for the end of the code */
+typedef struct IrFunction
+{
+    PascalArena *Arena;
+    U32 Start, End;
+
+    IrBlock *Blocks;
+    U32 BlockCount;
+    IrIns *Ins;
+    U32 InsCount, InsCap;
+    IrValue *Values;
+    U32 ValueCount, ValueCap;
+} IrFunction;
+
+
+/*
+ * builds the SSA form of Chunk->Code[Start, End), everything is allocated from Arena.
+ * Returns false if the code cannot be lifted:
+ * an unknown instruction, a branch out of it or a nested subroutine in it
+ */
+bool IrLift(IrFunction *Fn, PascalArena *Arena, const PVMChunk *Chunk, U32 Start, U32 End);
+/* writes Fn back at Fn->Start, which must be the end of the chunk,
+ * the new location of each block and instruction is in its Location */
+void IrLower(IrFunction *Fn, PVMEmitter *Emitter);
+void IrDump(const IrFunction *Fn, FILE *Out);
+
+/* the value a removed phi stands for, or Value itself */
+U32 IrResolve(IrFunction *Fn, U32 Value);
+void IrRemoveIns(IrFunction *Fn, U32 Index);
+/* a new instruction of Op right before or after the one at Index in its block,
+ * its encoding, flags and operands are up to the caller. Pointers into Fn->Ins do not survive this */
+U32 IrInsertBefore(IrFunction *Fn, U32 Index, U16 Op);
+U32 IrInsertAfter(IrFunction *Fn, U32 Index, U16 Op);
+
+/* turns the instruction into a move of Imm to its first definition, which must be in Rd */
+void IrSetMoveImm(IrFunction *Fn, U32 Index, U64 Imm);
+/* turns the branch into an unconditional one to its target, the fall through edge is removed */
+void IrSetJump(IrFunction *Fn, U32 Index);
+/* removes the edge from Block to its successor Succ[Which] and the phi operands that came with it */
+void IrRemoveEdge(IrFunction *Fn, U32 Block, UInt Which);
+/* adds an edge from Block to To as its successor Succ[Which],
+ * the phis of To get the same operand for it as they have for the predecessor Like */
+void IrAddEdge(IrFunction *Fn, U32 Block, UInt Which, U32 To, U32 Like);
+/* removes every instruction of Block and its outgoing edges */
+void IrClearBlock(IrFunction *Fn, U32 Block);
+/* removes phis that merge a single value, after edges were removed */
+void IrSimplifyPhis(IrFunction *Fn);
+/* removes instructions without side effects whose values are never used, returns how many */
+U32 IrRemoveDeadCode(IrFunction *Fn);
+
+/* points the instructions in Fn that are call sites in the compiler's SubroutineReferences at them,
+ * returns false if one of them is not an instruction that refers to a subroutine */
+bool IrFindReferences(PascalCompiler *Compiler, IrFunction *Fn);
+
+/*
+ * lifts the subroutine starting at Start (its enter) up to the end of the chunk,
+ * optimizes it at the compiler's optimization level and lowers it back,
+ * the subroutine references and line debug info in it are moved along.
+ * Returns the registers its code writes, or the code of the subroutines it calls,
+ * all of them if that is not known
+ */
+U64 IrOptimizeSubroutine(PascalCompiler *Compiler, U32 Start);
+
+
+#endif /* PASCAL_COMPILER_IR_H */
+
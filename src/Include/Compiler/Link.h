@@ -0,0 +1,21 @@
+#ifndef PASCAL_COMPILER_LINK_H
+#define PASCAL_COMPILER_LINK_H
+
+
+#include "Common.h"
+#include "Compiler/Compiler.h"
+
+
+/*
+ * drops the subroutines that neither the entry point nor anything it reaches
+ * calls or takes the address of, going by the compiler's SubroutineReferences,
+ * and closes the gaps they leave in the code. A nested subroutine goes with the one it is in.
+ * Subroutine locations, call sites, the entry point and debug info follow the code that moved,
+ * so this runs before ResolveSubroutineReferences patches the calls.
+ * Returns the number of halfwords removed
+ */
+U32 LinkRemoveDeadSubroutines(PascalCompiler *Compiler);
+
+
+#endif /* PASCAL_COMPILER_LINK_H */
+
@@ -0,0 +1,42 @@
+#ifndef PASCAL_COMPILER_PEEPHOLE_H
+#define PASCAL_COMPILER_PEEPHOLE_H
+
+
+#include <stdio.h>
+
+#include "Common.h"
+#include "Compiler/Ir.h"
+
+
+typedef enum PeepholeRule
+{
+    PEEPHOLE_COALESCE_MOVE = 0,
+    PEEPHOLE_FORWARD_STORE,
+    PEEPHOLE_THREAD_JUMP,
+    PEEPHOLE_DEAD_SPILL,
+    PEEPHOLE_THREE_OPERAND,
+    PEEPHOLE_RULE_COUNT,
+} PeepholeRule;
+#define PEEPHOLE_ALL_RULES ((1u << PEEPHOLE_RULE_COUNT) - 1)
+
+typedef struct PeepholeStats
+{
+    U32 Hits[PEEPHOLE_RULE_COUNT];
+} PeepholeStats;
+
+
+/*
+ * rewrites short sequences of Fn's instructions with the rule table until none applies:
+ * moves into the register their value is moved to, loads of a slot just stored or loaded,
+ * branches to jumps and jumps to the next block, spills and caller saved pushes that are undone right away,
+ * a move into the register of a two-operand op whose source is still needed after it into the three-operand op.
+ * Only the rules with their bit (1 << PeepholeRule) set in Rules apply.
+ * Hits of each rule are added to Stats, returns true if Fn changed
+ */
+bool IrPeephole(IrFunction *Fn, U32 Rules, PeepholeStats *Stats);
+/* one line per rule */
+void PeepholeReport(const PeepholeStats *Stats, FILE *Out);
+
+
+#endif /* PASCAL_COMPILER_PEEPHOLE_H */
+
@@ -0,0 +1,32 @@
+#ifndef PASCAL_COMPILER_PROMOTE_H
+#define PASCAL_COMPILER_PROMOTE_H
+
+
+#include "Common.h"
+#include "Compiler/Ir.h"
+
+
+/* more variables than this stay in memory */
+#define PROMOTE_MAX_VARS 64
+
+
+/*
+ * keeps the scalar variables and register parameters of the current scope that live in Fn's frame
+ * in registers that Fn never uses otherwise.
+ * A variable whose address is taken (lea, or a move of FP for the one at offset 0)
+ * or that is not always loaded and stored whole stays in memory,
+ * and nothing is promoted if FP is used in any other way.
+ * Variables accessed more often, and more so in loops, get a register first,
+ * one that no call in Fn writes if there is any left;
+ * the rest stay in memory once there are no registers left.
+ * A variable that is still needed after a call that writes its register
+ * is written back before it if it changed, and read again after it.
+ * Captured variables are never seen, a subroutine with nested ones cannot be lifted.
+ * Fn is not in SSA form afterward, it has to be lowered and lifted again.
+ * Returns true if Fn changed
+ */
+bool IrPromoteLocals(PascalCompiler *Compiler, IrFunction *Fn);
+
+
+#endif /* PASCAL_COMPILER_PROMOTE_H */
+
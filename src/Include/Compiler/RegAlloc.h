@@ -0,0 +1,23 @@
+#ifndef PASCAL_COMPILER_REGALLOC_H
+#define PASCAL_COMPILER_REGALLOC_H
+
+
+#include "Common.h"
+#include "Compiler/Ir.h"
+
+
+/*
+ * reassigns the registers of Fn's values by linear scan over their live intervals.
+ * Values that must stay where they are (arguments, return values, register lists, the flag,
+ * whatever lives across a call) keep their register, the others get one that is free for their whole interval.
+ * A reload of a spill is given the register that was spilled when nothing else needs it in between,
+ * so that the peephole pass can drop the pair; when registers run out,
+ * the spill whose reload is the furthest away is the one that stays.
+ * Nothing changes if some value cannot be given a register.
+ * Returns true if a register changed
+ */
+bool IrAllocateRegisters(IrFunction *Fn);
+
+
+#endif /* PASCAL_COMPILER_REGALLOC_H */
+
@@ -4,6 +4,7 @@
 
 #include "Common.h"
 #include "Compiler/Data.h"
+#include "Compiler/Inline.h"
 
 
 
@@ -38,7 +39,10 @@ void CompileArgumentList(PascalCompiler *Compiler,
         I32 *Base, UInt HiddenParamCount
 );
 
-void CompilerEmitCall(PascalCompiler *Compiler, const VarLocation *Location, SaveRegInfo SaveRegs);
+/* Inline is where InlinePlanCall decided to put the callee's code instead of calling it */
+void CompilerEmitCall(PascalCompiler *Compiler, const VarLocation *Location, SaveRegInfo SaveRegs,
+        const InlineSite *Inline
+);
 
 
 #endif /* PASCAL_COMPILER_VARLIST_H */
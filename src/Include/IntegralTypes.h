@@ -20,6 +20,7 @@ typedef enum IntegralType
     TYPE_RECORD,
     TYPE_CHAR,
     TYPE_STATIC_ARRAY,
+    TYPE_FILE,
 
     TYPE_COUNT,
 } IntegralType;
@@ -51,6 +52,7 @@ static inline const char *IntegralTypeToStr(IntegralType Type)
         [TYPE_POINTER] = "pointer",
         [TYPE_CHAR] = "char",
         [TYPE_STATIC_ARRAY] = "array",
+        [TYPE_FILE] = "text",
     };
     PASCAL_STATIC_ASSERT(TYPE_COUNT == STATIC_ARRAY_SIZE(StrLut), "Missing type");
     if (Type < TYPE_COUNT)
@@ -80,6 +82,7 @@ static inline U32 IntegralTypeSize(IntegralType Type)
         return 8;
     case TYPE_FUNCTION:
     case TYPE_POINTER:
+    case TYPE_FILE:
         return sizeof(void*);
     case TYPE_STRING:
         return sizeof(PascalStr);
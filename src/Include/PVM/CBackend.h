@@ -0,0 +1,33 @@
+#ifndef PASCAL_PVM2_CBACKEND_H
+#define PASCAL_PVM2_CBACKEND_H
+
+
+#include "Common.h"
+#include "PVM/PVM.h"
+
+
+/* the generated C is compiled by the system's compiler and loaded with dlopen */
+#if defined(__unix__) || defined(__APPLE__)
+#  define PVM_CBACKEND_AVAILABLE 1
+#else
+#  define PVM_CBACKEND_AVAILABLE 0
+#endif /* unix */
+
+
+typedef struct PVMNativeProgram PVMNativeProgram;
+
+/*
+ * Translates the chunk to C99, one C function per subroutine,
+ * writes it to OutFileName.c, compiles it with $PASCAL_CC (cc by default) into OutFileName.so and loads it.
+ * Returns NULL if any of that failed, the caller should run the chunk some other way
+ */
+PVMNativeProgram *PVMCBackendLoad(PascalVM *PVM, PVMChunk *Chunk, const char *OutFileName);
+
+/* Runs a loaded program, returns the same value that PVMInterpret would have returned */
+PVMReturnValue PVMCBackendRun(PascalVM *PVM, PVMChunk *Chunk, PVMNativeProgram *Program);
+
+void PVMCBackendUnload(PVMNativeProgram *Program);
+
+
+#endif /* PASCAL_PVM2_CBACKEND_H */
+
@@ -35,12 +35,21 @@ typedef struct PVMChunk
         LineDebugInfo *Info;
         U32 Count, Cap;
     } Debug;
+
+    /* fixed-width copy of Code, filled by PVMDecodeChunk */
+    struct {
+        PVMDecodedIns *Ins;
+        U32 *Index; /* stream offset -> index into Ins */
+        U32 Count, Cap, IndexCap;
+    } Decoded;
 } PVMChunk;
 
 PVMChunk ChunkInit(U32 InitialCap);
 void ChunkDeinit(PVMChunk *Chunk);
 
 U32 ChunkWriteCode(PVMChunk *Chunk, U16 Opcode);
+/* writes the OP_EXT prefix first if Opcode has extension bits (PVM_EXT_OF), returns where the instruction starts */
+U32 ChunkWriteOp(PVMChunk *Chunk, U32 Opcode);
 U32 ChunkWriteMovImm(PVMChunk *Chunk, UInt Reg, U64 Imm);
 U32 ChunkWriteGlobalData(PVMChunk *Chunk, const void *Data, U32 Size);
 void ChunkWriteGlobalDataAt(PVMChunk *Chunk, U32 At, const void *Data, U32 Size);
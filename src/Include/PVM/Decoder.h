@@ -0,0 +1,65 @@
+#ifndef PASCAL_PVM2_DECODER_H
+#define PASCAL_PVM2_DECODER_H
+
+
+#include "Common.h"
+#include "PVM/Chunk.h"
+#include "PVM/Isa.h"
+
+
+/* 
+ * An instruction with all of its operands decoded, 
+ * so the interpreter does not have to look at the variable-length encoding again
+ */
+#define PVM_CALLSITE_POLYMORPHIC 2
+
+struct PVMDecodedIns 
+{
+    /* filled in by the interpreter, depends on PVM_DISPATCH */
+    union {
+        const void *Label;
+        void (*Function)(void);
+    } Handler;
+
+    union {
+        U64 Imm;                /* sign extended immediate, memory offset, size, reglist, ... */
+        I64 SImm;
+        PVMDecodedIns *Target;  /* branches, calls and ldrip */
+    } As;
+    /* callptr is an inline cache: As.Target is the last callee (NULL before the first call), 
+     * Rs is the number of different callees seen so far, saturating at PVM_CALLSITE_POLYMORPHIC. 
+     * In push and pop multiple, Rd is the register that bit 0 of the list stands for */
+
+    U32 StreamOffset;   /* offset of the instruction in PVMChunk.Code, its OP_EXT prefix if it has one */
+    U16 Opcode;         /* the instruction's first halfword after the prefix */
+    U8 Rd, Rs;          /* with the prefix applied */
+};
+
+
+/* 
+ * Translates Chunk->Code into Chunk->Decoded.Ins, 
+ * there is always an extra illegal instruction after the last one, 
+ * branches to the middle of an instruction or outside of the chunk are redirected to it. 
+ * If Fuse is true, common pairs of instructions are replaced by superinstructions (PVM_FUSED_OPS). 
+ * Returns the instruction at the entry point 
+ */
+PVMDecodedIns *PVMDecodeChunk(PVMChunk *Chunk, bool Fuse);
+
+/* returns the instruction starting at StreamOffset, or the trailing illegal instruction */
+PVMDecodedIns *PVMDecodedInsAt(const PVMChunk *Chunk, U32 StreamOffset);
+
+/* opcode of the instruction, the first half's for superinstructions */
+PVMOp PVMDecodedOp(const PVMDecodedIns *Ins);
+
+/* size in halfwords of the instruction at Addr, its OP_EXT prefix included */
+U32 PVMInstructionSize(const U16 *Code, U32 Addr);
+
+/* BEQ through FBNLE64, all of them are PVM_CMP_BRANCH_INS_SIZE halfwords with a 32 bit offset */
+bool PVMIsCompareAndBranch(PVMOp Op);
+
+/* ADD3 through FDIV3_64, 2 halfwords, the decoded As.Imm is Rt */
+bool PVMIsThreeOperand(PVMOp Op);
+
+
+#endif /* PASCAL_PVM2_DECODER_H */
+
@@ -7,6 +7,8 @@
 
 void PVMDisasm(FILE *f, const PVMChunk *Code, const char *Name);
 U32 PVMDisasmSingleInstruction(FILE *f, const PVMChunk *Code, U32 Addr);
+/* the mnemonic the disassembler prints for Opcode, "???" if it is not an instruction */
+const char *PVMMnemonic(U16 Opcode);
 
 
 #endif /* PASCAL_PVM2_DISASSEMBLER_H */
@@ -0,0 +1,36 @@
+#ifndef PASCAL_PVM2_ELF_H
+#define PASCAL_PVM2_ELF_H
+
+
+#include "Common.h"
+
+
+/*
+ * Layout of the executable:
+ *  the ELF header and program headers, then Text, loaded read-only and executable at ELF_TEXT_ADDR,
+ *  Data at ELF_DATA_ADDR followed by BssSize zeroed bytes, readable and writable
+ */
+#define ELF_TEXT_ADDR 0x400000
+#define ELF_DATA_ADDR 0x10000000
+#define ELF_HEADER_SIZE (64 + 3*56)
+/* address of Text[0] in the loaded program */
+#define ELF_CODE_ADDR (ELF_TEXT_ADDR + ELF_HEADER_SIZE)
+
+
+typedef struct ElfImage
+{
+    const U8 *Text;
+    U32 TextSize;
+    U32 EntryOffset; /* into Text */
+
+    const U8 *Data;
+    U32 DataSize;
+    U32 BssSize;
+} ElfImage;
+
+/* Writes a static x86-64 Linux executable and makes it executable, returns false on IO error */
+bool ElfWriteExecutable(const char *FileName, const ElfImage *Image);
+
+
+#endif /* PASCAL_PVM2_ELF_H */
+
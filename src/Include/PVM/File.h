@@ -0,0 +1,87 @@
+#ifndef PASCAL_PVM2_FILE_H
+#define PASCAL_PVM2_FILE_H
+
+
+#include <stdio.h>
+
+#include "Common.h"
+#include "PascalString.h"
+#include "PVM/Input.h"
+#include "PVM/Output.h"
+
+
+/*
+ * Files of assign, reset, rewrite and close.
+ * A file variable holds a pointer to a PVMFile, every PVMFile is kept in the VM's list
+ * and a handle is only used after it was found there, so a variable that was never assigned is an error, not a crash.
+ * For a text file, reset reads through a PVMInput, which maps a regular file as a whole and scans it in place,
+ * rewrite writes through a PVMOutput with a buffer of PVM_FILE_BUFFER_SIZE that does not come from the memory pool.
+ * A typed file (file of T) is open for both reading and writing after either of them,
+ * records are copied straight between the VM's memory and a window of PVM_FILE_WINDOW_SIZE mapped over the file.
+ * The window is mapped on the first access and moved when a record falls outside of it,
+ * writing past the end grows the file by PVM_FILE_GROW_SIZE, close cuts it back to the last record
+ */
+#define PVM_FILE_BUFFER_SIZE (1024 * 1024)
+#define PVM_FILE_WINDOW_SIZE (64 * 1024 * 1024)
+/* offset of a window in the file, a multiple of the page size everywhere */
+#define PVM_FILE_WINDOW_ALIGN (64 * 1024)
+#define PVM_FILE_GROW_SIZE (1024 * 1024)
+
+typedef enum PVMFileMode 
+{
+    PVM_FILE_CLOSED = 0,
+    PVM_FILE_INPUT,
+    PVM_FILE_OUTPUT,
+    PVM_FILE_RECORDS,
+} PVMFileMode;
+
+typedef struct PVMFile
+{
+    struct PVMFile *Next;
+    FILE *File; /* NULL while closed */
+    PVMFileMode Mode;
+    PVMInput In;
+    PVMOutput Out;
+    U8 *OutBuffer; /* PVM_FILE_BUFFER_SIZE bytes while open for output */
+
+    /* typed file, offsets are in bytes */
+    U32 RecordSize;
+    U64 Size, Position;
+    U64 Reserved; /* size of the file on disk, can be past Size while it is open */
+    U8 *Window; /* NULL before the first access */
+    U64 WindowOffset;
+    USize WindowSize;
+    bool ReadOnly;
+
+    char Name[PSTR_MAX_LEN + 1];
+} PVMFile;
+
+
+/* Handle if it is in List, NULL otherwise */
+PVMFile *PVMFileFind(PVMFile *List, const PVMFile *Handle);
+/* 
+ * what assign does, Handle is the variable's old value: 
+ * a file from List is closed and renamed, anything else gets a new file added to List
+ */
+PVMFile *PVMFileAssign(PVMFile **List, const PVMFile *Handle, const PascalStr *Name);
+/* 
+ * open for reading, returns false if the file cannot be opened, 
+ * a RecordSize other than 0 opens a typed file for reading and writing, or only for reading if it is read-only
+ */
+bool PVMFileReset(PVMFile *File, U32 RecordSize);
+/* create or truncate for writing, returns false if the file cannot be opened */
+bool PVMFileRewrite(PVMFile *File, U32 RecordSize);
+/* copies the record at the position of a typed file into Dst and moves past it, returns false at the end of the file */
+bool PVMFileReadRecord(PVMFile *File, void *Dst);
+/* copies Src over the record at the position or appends it, returns false if the file cannot be written or grown */
+bool PVMFileWriteRecord(PVMFile *File, const void *Src);
+/* moves to the Record'th record, returns false if it is past the end of the file */
+bool PVMFileSeek(PVMFile *File, I64 Record);
+/* flushes and closes, does nothing if the file is not open */
+void PVMFileClose(PVMFile *File);
+/* closes and frees every file in List */
+void PVMFileCloseAll(PVMFile **List);
+
+
+#endif /* PASCAL_PVM2_FILE_H */
+
@@ -0,0 +1,37 @@
+#ifndef PASCAL_PVM2_GUARD_H
+#define PASCAL_PVM2_GUARD_H
+
+
+#include "Common.h"
+
+
+/*
+ * The PVM's stacks are followed by inaccessible guard pages,
+ * so running off their end faults instead of being compared against it on every push and call
+ */
+#if defined(__unix__) || defined(__APPLE__)
+#  define PVM_GUARD_PAGES 1
+#else
+#  define PVM_GUARD_PAGES 0
+#endif /* unix */
+
+/* bytes after a guarded block that always fault,
+ * a frame bigger than this could skip over them and still has to be checked */
+#define PVM_GUARD_SIZE (64 * 1024)
+
+
+/* zeroed, the PVM_GUARD_SIZE bytes right after Ptr + Size fault, never returns NULL */
+void *PVMGuardAllocate(USize Size);
+void PVMGuardDeallocate(void *Ptr, USize Size);
+
+/*
+ * Calls Fn(Data) and returns true.
+ * If Fn touched a guard page it does not return, PVMGuardedCall returns false instead
+ * with *FaultAt set to the machine instruction that faulted (NULL if unknown).
+ * Calls can be nested, the innermost one returns false
+ */
+bool PVMGuardedCall(void (*Fn)(void *Data), void *Data, const void **FaultAt);
+
+
+#endif /* PASCAL_PVM2_GUARD_H */
+
@@ -0,0 +1,60 @@
+#ifndef PASCAL_PVM2_INPUT_H
+#define PASCAL_PVM2_INPUT_H
+
+
+#include <stdio.h>
+
+#include "Common.h"
+#include "IntegralTypes.h"
+#include "PVM/Output.h"
+
+
+/*
+ * Input of read and readln, parsed in place from a window over the FILE.
+ * A regular file is mapped as a whole, the window starts at the FILE's position.
+ * Anything else is read through the FILE in blocks of the buffer's size,
+ * a terminal one line at a time.
+ * When the VM lets go of a mapped file, the FILE is moved to the first unread byte;
+ * bytes that were read into the buffer but not parsed are lost to the FILE
+ */
+#define PVM_INPUT_BUFFER_SIZE (64 * 1024)
+/* a number is parsed from a contiguous window at least this long, longer numbers are cut */
+#define PVM_INPUT_MAX_NUMBER 128
+/* what read gives a char at the end of the input, like Turbo Pascal */
+#define PVM_INPUT_EOF_CHAR 0x1A
+
+typedef struct PVMInput
+{
+    FILE *File; /* NULL before the first read */
+    const U8 *Curr, *End; /* unparsed bytes of the window */
+    U8 *Buffer; /* allocated on the first read that is not from a mapped file */
+    USize Capacity;
+    U8 *Mapping; /* the whole file, NULL if it is not mapped */
+    USize MappingSize;
+    bool Eof, /* there is nothing in File after End */
+         LineByLine;
+    PVMOutput *Tie; /* flushed before waiting for more input, can be NULL */
+} PVMInput;
+
+
+/* does not allocate, Capacity is raised to fit at least one number, Tie starts out NULL */
+PVMInput PVMInputInit(USize Capacity);
+void PVMInputDeinit(PVMInput *In);
+
+/* makes File the source, gives back what is left of the previous one */
+void PVMInputSetFile(PVMInput *In, FILE *File);
+/*
+ * parses a value of Type the way read does and stores it at Dst,
+ * returns false if the input is not a number when Type is one, or if it does not fit in Type
+ */
+bool PVMInputValue(PVMInput *In, IntegralType Type, void *Dst);
+/* what readln does after its arguments: skips past the next newline */
+void PVMInputSkipLine(PVMInput *In);
+/* nothing is left to read, waits for more input if there could be some */
+bool PVMInputEof(PVMInput *In);
+/* the next character ends the line or there is none */
+bool PVMInputEoln(PVMInput *In);
+
+
+#endif /* PASCAL_PVM2_INPUT_H */
+
@@ -201,7 +201,132 @@ typedef enum PVMOp
     OP_SLT64,
     OP_ISLT64,
     OP_SETEZ64,
+
+
+    /* 
+     * compare and branch, the Condition flag is left untouched:
+     * 0xCCDS 0xIIII 0xIIII, branches if Rd cc Rs, 
+     * the QI versions compare Rd against S as a 4 bit signed immediate.
+     * Same comparisons as SEQ, SLT (unsigned) and ISLT (signed)
+     */
+    OP_BEQ,
+    OP_BNE,
+    OP_BLT,
+    OP_BGE,
+    OP_IBLT,
+    OP_IBGE,
+    OP_BEQ64,
+    OP_BNE64,
+    OP_BLT64,
+    OP_BGE64,
+    OP_IBLT64,
+    OP_IBGE64,
+
+    /* in the same order as above */
+    OP_BEQQI,
+    OP_BNEQI,
+    OP_BLTQI,
+    OP_BGEQI,
+    OP_IBLTQI,
+    OP_IBGEQI,
+    OP_BEQQI64,
+    OP_BNEQI64,
+    OP_BLTQI64,
+    OP_BGEQI64,
+    OP_IBLTQI64,
+    OP_IBGEQI64,
+
+    /* same encoding on float registers, the N versions branch if the comparison is false (or unordered) */
+    OP_FBEQ,
+    OP_FBNE,
+    OP_FBLT,
+    OP_FBNLT,
+    OP_FBLE,
+    OP_FBNLE,
+    OP_FBEQ64,
+    OP_FBNE64,
+    OP_FBLT64,
+    OP_FBNLT64,
+    OP_FBLE64,
+    OP_FBNLE64,
+
+
+    /*
+     * three-operand versions: 0xCCDS 0x00T0, Rd = Rs op Rt,
+     * Rs and Rt are left untouched, otherwise the same as their two-operand counterpart
+     */
+    OP_ADD3,
+    OP_SUB3,
+    OP_MUL3,
+    OP_IMUL3,
+    OP_DIV3,
+    OP_IDIV3,
+    OP_MOD3,
+    OP_AND3,
+    OP_OR3,
+    OP_XOR3,
+    OP_VSHL3,
+    OP_VSHR3,
+    OP_VASR3,
+    OP_ADD3_64,
+    OP_SUB3_64,
+    OP_MUL3_64,
+    OP_IMUL3_64,
+    OP_DIV3_64,
+    OP_IDIV3_64,
+    OP_MOD3_64,
+    OP_AND3_64,
+    OP_OR3_64,
+    OP_XOR3_64,
+    OP_VSHL3_64,
+    OP_VSHR3_64,
+    OP_VASR3_64,
+
+    OP_FADD3,
+    OP_FSUB3,
+    OP_FMUL3,
+    OP_FDIV3,
+    OP_FADD3_64,
+    OP_FSUB3_64,
+    OP_FMUL3_64,
+    OP_FDIV3_64,
+
+
+    /* 
+     * register extension prefix: 0xCC0X, X = 0b0TDS, 
+     * adds 16 to Rt, Rd and Rs of the instruction that follows so that R16-R31 and F16-F31 can be named, 
+     * pshl, pshh, popl, poph and their float versions take the S bit to mean the registers 16 higher. 
+     * The prefix and the instruction are one instruction, branches go to the prefix
+     */
+    OP_EXT,
 } PVMOp;
+PASCAL_STATIC_ASSERT(OP_BEQQI - OP_BEQ == OP_IBGEQI64 - OP_IBGE64, "QI versions must be in the same order");
+
+/* 
+ * Superinstructions: pairs of instructions that are executed together the most, 
+ * counted by test/benchmark/pairs.sh. 
+ * They do not exist in the bytecode, PVMDecodeChunk puts them in place of the first instruction of the pair.
+ * The first instruction must not be one that changes IP.
+ */
+#define PVM_FUSED_OPS(X)\
+    X(LD32, ADDQI)\
+    X(ADDQI, ST32)\
+    X(LD32, LD32)\
+    X(ST32, BR)\
+    X(LD32, BGE)\
+    X(ST32, LD32)\
+    X(LD32, BGEQI)\
+    X(PSHL, LD32)
+
+typedef enum PVMFusedOp 
+{
+    OP_FUSED_BASE = OP_EXT, /* so that the first one is right after the last PVMOp */
+#define PVM_FUSED_OP(First, Second) OP_ ## First ## _ ## Second,
+    PVM_FUSED_OPS(PVM_FUSED_OP)
+#undef PVM_FUSED_OP
+    OP_FUSED_END,
+} PVMFusedOp;
+PASCAL_STATIC_ASSERT(OP_FUSED_END <= 0xFF, "Too many superinstructions, opcodes are 8 bits");
 
 /* sys ops uses Pascal calling convention, 
  * including callee cleanup */
@@ -210,6 +335,29 @@ typedef enum PVMSysOp
     OP_SYS_EXIT,
     OP_SYS_ENTER,
     OP_SYS_WRITE,
+    OP_SYS_READ,
+    OP_SYS_READLN,
+
+    /* R1 holds the address of a file variable */
+    OP_SYS_ASSIGN,
+    /* R0 holds the record size of a typed file, 0 for a text file */
+    OP_SYS_RESET,
+    OP_SYS_REWRITE,
+    OP_SYS_CLOSE,
+    OP_SYS_WRITE_FILE,
+    OP_SYS_READ_FILE,
+    OP_SYS_READLN_FILE,
+    /* or NULL for the standard input, the result goes to R0 */
+    OP_SYS_EOF,
+    OP_SYS_EOLN,
+    /* typed files, the stack holds the address of each record */
+    OP_SYS_WRITE_RECORD,
+    OP_SYS_READ_RECORD,
+    /* the record number is the only (value, type) pair on the stack */
+    OP_SYS_SEEK,
+    /* in records, the result goes to R0 */
+    OP_SYS_FILESIZE,
+    OP_SYS_FILEPOS,
 } PVMSysOp;
 
 typedef enum PVMImmType 
@@ -227,10 +375,25 @@ typedef enum PVMImmType
 
 
 
+/* 
+ * the emitter carries the bits of the extension prefix above the opcode halfword, 
+ * a register in 16-31 (R16-R31) or 48-63 (F16-F31, the emitter numbers F registers after R registers) sets its bit. 
+ * Immediates in a register field never fall in those ranges
+ */
+#define PVM_EXT_S 0x1
+#define PVM_EXT_D 0x2
+#define PVM_EXT_T 0x4
+#define PVM_EXT(Reg, Bit) ((((U32)(Reg) & ~(U32)0x2F) == 0x10) ? (U32)(Bit) << 16 : 0)
+#define PVM_EXT_PREFIX(Bits)\
+    (BIT_POS32(OP_EXT, 8, 8)\
+     | BIT_POS32(Bits, 4, 0))
+
 #define PVM_OP(Ins, Rd, Rs)\
     (BIT_POS32(OP_ ## Ins, 8, 8)\
     | BIT_POS32(Rd, 4, 4)\
-    | BIT_POS32(Rs, 4, 0))
+    | BIT_POS32(Rs, 4, 0)\
+    | PVM_EXT(Rd, PVM_EXT_D)\
+    | PVM_EXT(Rs, PVM_EXT_S))
 #define PVM_OP_ALT(Ins, OperandIs64Bit, Rd, Rs)\
     ((OperandIs64Bit)? \
         PVM_OP(Ins ## 64, Rd, Rs) \
@@ -246,11 +409,16 @@ typedef enum PVMImmType
 
 #define PVM_MOVI(Rd, ImmType) PVM_OP(MOVI, Rd, IMMTYPE_ ## ImmType)
 
+/* second halfword of the three-operand instructions, the extension bit of Rt goes with the opcode */
+#define PVM_RT(Rt) BIT_POS32(Rt, 4, 4)
+#define PVM_OP_RT(Rt) PVM_EXT(Rt, PVM_EXT_T)
+
 
 #define PVM_B(Condition, Rd, Imm4)\
     (BIT_POS32(OP_B ## Condition, 8, 8)\
      | BIT_POS32(Rd, 4, 4)\
-     | BIT_POS32(Imm4, 4, 0))
+     | BIT_POS32(Imm4, 4, 0)\
+     | PVM_EXT(Rd, PVM_EXT_D))
 
 #define PVM_BR(LowerByte)\
     (BIT_POS32(OP_BR, 8, 8)\
@@ -267,7 +435,8 @@ typedef enum PVMImmType
 #define PVM_IMM_OP(Opcode, Rd, ImmType)\
     (BIT_POS32(OP_ ## Opcode, 8, 8)\
      | BIT_POS32(Rd, 4, 4)\
-     | BIT_POS32(ImmType, 4, 0))
+     | BIT_POS32(ImmType, 4, 0)\
+     | PVM_EXT(Rd, PVM_EXT_D))
 
 
 #define PVM_GET_OP(OpcodeHalf) (PVMOp)(((OpcodeHalf) >> 8) & 0xFF)
@@ -275,6 +444,10 @@ typedef enum PVMImmType
 #define PVM_GET_RS(OpcodeHalf) ((OpcodeHalf) & 0xF)
 #define PVM_GET_REGLIST(OpcodeHalf) ((OpcodeHalf) & 0xFF)
 #define PVM_GET_IMMTYPE(OpcodeHalf) (PVMImmType)((OpcodeHalf) & 0xF)
+#define PVM_GET_RT(SecondHalf) PVM_GET_RD(SecondHalf)
+#define PVM_GET_EXT(OpcodeHalf) ((OpcodeHalf) & 0x7)
+/* the extension bits that come with an opcode from PVM_OP and friends */
+#define PVM_EXT_OF(Opcode) (((Opcode) >> 16) & 0x7)
 
 #define PVM_GET_SYS_OP(OpcodeHalf) (PVMSysOp)((OpcodeHalf) & 0xFF)
 
@@ -292,9 +465,12 @@ typedef enum PVMImmType
 #define PVM_BR_OFFSET_SIZE 24
 #define PVM_BCC_OFFSET_SIZE 20
 #define PVM_BRANCH_INS_SIZE 2
+#define PVM_CMP_BRANCH_INS_SIZE 3
 
-#define PVM_REG_COUNT 16
-#define PVM_FREG_COUNT 16
+/* R16-R31 and F16-F31 need the OP_EXT prefix */
+#define PVM_REG_COUNT 32
+#define PVM_FREG_COUNT 32
+#define PVM_EXT_REG 16
 
 #define PVM_REG_GP 13
 #define PVM_REG_FP 14
@@ -0,0 +1,50 @@
+#ifndef PASCAL_PVM2_JIT_H
+#define PASCAL_PVM2_JIT_H
+
+
+#include "Common.h"
+#include "PVM/PVM.h"
+
+
+/* the JIT emits x86-64 code for the System V calling convention */
+#if defined(__x86_64__) && (defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__))
+#  define PVM_JIT_AVAILABLE 1
+#else
+#  define PVM_JIT_AVAILABLE 0
+#endif /* x86-64 and not windows */
+
+
+/*
+ * Translates Chunk->Decoded as PVMDecodeChunk left it, superinstructions included, to native code.
+ * Returns NULL if the JIT is not available or out of memory
+ */
+PVMJitProgram *PVMJitCompile(PVMChunk *Chunk);
+
+/*
+ * Runs compiled code from the decoded instruction At with the state in PVM, 
+ * until the frame it was entered in returns or the program exits.
+ * Returns the same value that PVMInterpret would have returned, PVM->Error is set on error
+ */
+PVMReturnValue PVMJitEnter(PascalVM *PVM, PVMJitProgram *Program, const PVMDecodedIns *At);
+
+void PVMJitFree(PVMJitProgram *Program);
+
+/*
+ * Translates the whole chunk to native code and runs it.
+ * Returns false if the chunk could not be compiled (JIT not available, out of memory),
+ * the caller should use PVMInterpret instead,
+ * otherwise *ReturnValue is set to the same value that PVMInterpret would have returned
+ */
+bool PVMJitRun(PascalVM *PVM, PVMChunk *Chunk, PVMReturnValue *ReturnValue);
+
+/*
+ * Compiles the chunk into a static x86-64 Linux executable with its own small runtime, nothing is run.
+ * StackSize and RetStackSize are the same as PVMInit's.
+ * Returns false and says why on LogFile if the chunk uses an instruction that needs the virtual machine
+ * (floats, strings, memcpy...) or if the file could not be written
+ */
+bool PVMJitWriteExecutable(PVMChunk *Chunk, const char *FileName, U32 StackSize, UInt RetStackSize, FILE *LogFile);
+
+
+#endif /* PASCAL_PVM2_JIT_H */
+
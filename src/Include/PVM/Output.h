@@ -0,0 +1,70 @@
+#ifndef PASCAL_PVM2_OUTPUT_H
+#define PASCAL_PVM2_OUTPUT_H
+
+
+#include <stdio.h>
+
+#include "Common.h"
+#include "IntegralTypes.h"
+#include "PVM/Isa.h"
+
+
+/*
+ * Output of write and writeln, formatted straight into a buffer owned by the VM.
+ * The buffer goes to its FILE when it is full, when output switches to another FILE
+ * and at the end of PVMRun. If the FILE is a terminal it also goes out after every newline
+ */
+#define PVM_OUTPUT_BUFFER_SIZE (64 * 1024)
+/* the buffer comes out of the memory pool, which is not much bigger than 1MB */
+#define PVM_OUTPUT_MAX_BUFFER_SIZE (256 * 1024)
+/* 
+ * With a writer thread the buffer is copied into a lock-free single producer single consumer ring 
+ * instead of being written, the thread drains the ring with write(2)/writev(2). 
+ * The VM only blocks when the ring is full and when PVMOutputFlush waits for it to drain
+ */
+#if (defined(__unix__) || defined(__APPLE__)) && defined(__GNUC__)
+#  define PVM_OUTPUT_ASYNC 1
+#else
+#  define PVM_OUTPUT_ASYNC 0
+#endif /* unix */
+#define PVM_OUTPUT_RING_SIZE (1024 * 1024)
+/* longest formatted value other than strings: -DBL_MAX as %f */
+#define PVM_OUTPUT_MAX_VALUE 400
+
+typedef struct PVMOutputRing PVMOutputRing;
+
+typedef struct PVMOutput
+{
+    FILE *File; /* NULL before the first write */
+    U8 *Buffer; /* allocated on the first write */
+    USize Count, Capacity;
+    bool LineBuffered;
+    bool OwnsBuffer; /* false if the caller handed the buffer in */
+    PVMOutputRing *Ring; /* NULL without a writer thread */
+} PVMOutput;
+
+
+/* does not allocate, Capacity is raised to fit at least one value and capped at PVM_OUTPUT_MAX_BUFFER_SIZE */
+PVMOutput PVMOutputInit(USize Capacity);
+/* writes through Buffer of Capacity bytes, which the caller owns and may free after PVMOutputDeinit */
+PVMOutput PVMOutputInitWithBuffer(U8 *Buffer, USize Capacity);
+/* also stops the writer thread */
+void PVMOutputDeinit(PVMOutput *Out);
+/* 
+ * Starts a writer thread with a ring of at least RingCapacity bytes (0 for PVM_OUTPUT_RING_SIZE), 
+ * returns false and keeps writing synchronously if threads are not available 
+ */
+bool PVMOutputStartWriter(PVMOutput *Out, USize RingCapacity);
+
+/* makes File the destination, flushes what was written to the previous one */
+void PVMOutputSetFile(PVMOutput *Out, FILE *File);
+/* appends Value formatted the way write and writeln print Type */
+void PVMOutputValue(PVMOutput *Out, IntegralType Type, PVMGPR Value);
+/* called after all arguments of a write, flushes a terminal if a line was completed */
+void PVMOutputEndWrite(PVMOutput *Out);
+/* returns once everything written so far reached the FILE */
+void PVMOutputFlush(PVMOutput *Out);
+
+
+#endif /* PASCAL_PVM2_OUTPUT_H */
+
@@ -5,24 +5,46 @@
 
 #include "PVM/Chunk.h"
 #include "PVM/Isa.h"
+#include "PVM/File.h"
+#include "PVM/Input.h"
+#include "PVM/Output.h"
 #include "PascalString.h"
 
 
+/* How PVMInterpret gets from one instruction to the next, 
+ * pick one with -DPVM_DISPATCH=PVM_DISPATCH_xxx */
+#define PVM_DISPATCH_SWITCH 0   /* one big switch, works everywhere */
+#define PVM_DISPATCH_THREADED 1 /* computed goto, gcc and clang only */
+#define PVM_DISPATCH_TAILCALL 2 /* a function per handler, gcc and clang only */
+
+#ifndef PVM_DISPATCH
+#  if defined(__GNUC__)
+#    define PVM_DISPATCH PVM_DISPATCH_THREADED
+#  else
+#    define PVM_DISPATCH PVM_DISPATCH_SWITCH
+#  endif /* __GNUC__ */
+#endif /* PVM_DISPATCH */
+
+
 
 typedef struct PVMSaveFrame 
 {
-    U16 *IP;
+    PVMDecodedIns *IP;
     PVMPTR FP;
 } PVMSaveFrame;
 
 
+typedef struct PVMJitProgram PVMJitProgram;
+
 typedef struct PascalVM 
 {
     PVMGPR R[PVM_REG_COUNT];
-    PVMFPR F[PVM_REG_COUNT];
+    PVMFPR F[PVM_FREG_COUNT];
     PascalStr TmpStr;
     bool Condition;
 
+    /* both stacks grow up and are followed by guard pages (PVMGuardAllocate), 
+     * running off their End faults and is reported as PVM_CALLSTACK_OVERFLOW */
     struct {
         PVMPTR Start;
         PVMPTR End;
@@ -30,10 +52,31 @@ typedef struct PascalVM
     struct {
         PVMSaveFrame *Val;
         PVMSaveFrame *Start;
-        int SizeLeft;
+        PVMSaveFrame *End;
     } RetStack;
 
-    bool SingleStepMode, Disassemble;
+    bool SingleStepMode, Disassemble, Jit;
+    /* with Jit set, the interpreter counts calls and backward branches per target instruction, 
+     * once a target was reached HotThreshold times it runs as native code. 
+     * 0 compiles the whole chunk before running it */
+    U32 HotThreshold;
+    struct {
+        U32 *Counter; /* decoded instruction index -> times left until it is hot */
+        PVMJitProgram *Native;
+    } Tier;
+    /* callptr inline cache statistics of the interpreter, see PVMDecodedIns */
+    struct {
+        U64 Hits, Misses;
+    } CallCache;
+    /* if not NULL, PVMRun translates the chunk to C and runs that, 
+     * the C source and the shared object are written to NativeOutput.c and NativeOutput.so */
+    const char *NativeOutput;
+    /* write and writeln go through this buffer, PVMRun flushes it */
+    PVMOutput Output;
+    /* read and readln parse from this window, PVMRun ties it to Output */
+    PVMInput Input;
+    /* every text file assign handed out, closed by PVMDeinit */
+    PVMFile *Files;
     FILE *LogFile;
     struct {
         int Line;
@@ -51,12 +94,34 @@ typedef enum PVMReturnValue
     PVM_ILLEGAL_INSTRUCTION,
     PVM_DIVISION_BY_0,
     PVM_CALLSTACK_OVERFLOW,
+    PVM_INVALID_INPUT,
+    PVM_FILE_NOT_ASSIGNED,
+    PVM_FILE_NOT_FOUND,
+    PVM_FILE_ACCESS_DENIED,
+    PVM_FILE_NOT_OPEN_FOR_INPUT,
+    PVM_FILE_NOT_OPEN_FOR_OUTPUT,
+    PVM_FILE_NOT_OPEN,
+    PVM_FILE_READ_PAST_EOF,
+    PVM_FILE_SEEK_OUT_OF_RANGE,
 } PVMReturnValue;
 PVMReturnValue PVMInterpret(PascalVM *PVM, PVMChunk *Code);
 
+/* Executes a single decoded instruction that is not a branch, call or return, 
+ * the JIT calls this for instructions it does not compile */
+PVMReturnValue PVMExecuteInstruction(PascalVM *PVM, PVMChunk *Chunk, PVMDecodedIns *Ins);
+
+/* source line of the instruction at StreamOffset, 0 if the chunk has no debug info */
+int PVMGetLine(PVMChunk *Chunk, U32 StreamOffset);
+
+/* sets PVM->Error to the line of the instruction at StreamOffset */
+void PVMSetErrorLocation(PascalVM *PVM, PVMChunk *Chunk, U32 StreamOffset);
+
 /* Same as PVMInterpret, but handles and prints error to stdout */
 bool PVMRun(PascalVM *PVM, PVMChunk *Code);
 
+/* name of the dispatch strategy PVMInterpret was built with */
+const char *PVMGetDispatchStrategy(void);
+
 void PVMDumpState(FILE *f, const PascalVM *PVM, UInt RegPerLine);
 
 
@@ -34,6 +34,8 @@ typedef struct PascalVar PascalVar;
 
 typedef struct StringView StringView;
 
+typedef struct PVMDecodedIns PVMDecodedIns;
+
 
 
 typedef uint8_t U8;
@@ -26,6 +26,7 @@ struct SubroutineData
     PascalVartab Scope;
     U32 StackArgSize;
     U32 HiddenParamCount;
+    bool IsInline;
 };
 
 struct RangeIndex 
@@ -48,6 +49,10 @@ struct VarType
             /* owned by the compiler */
             const VarType *ElementType;
         } StaticArray;
+        struct {
+            /* owned by the compiler, NULL for text */
+            const VarType *ElementType;
+        } File;
         SubroutineData Subroutine;
     } As;
 };
@@ -193,6 +198,11 @@ static inline StringView VarTypeToStringView(VarType Type)
         return Type.As.Record.Name;
     }
 
+    if (TYPE_FILE == Type.Integral && NULL != Type.As.File.ElementType)
+    {
+        return STRVIEW_INIT_CSTR("file", 4);
+    }
+
     const char *IntegralTypeStr = IntegralTypeToStr(Type.Integral);
     return STRVIEW_INIT_CSTR(IntegralTypeStr, strlen(IntegralTypeStr));
 }
@@ -228,6 +238,13 @@ static inline bool VarTypeEqual(const VarType *A, const VarType *B)
         /* has to be the same table that was defined, names don't matter */
         return A->As.Record.Field.Table == B->As.Record.Field.Table;
     }
+    if (TYPE_FILE == A->Integral)
+    {
+        /* text and typed files don't mix */
+        if (NULL == A->As.File.ElementType || NULL == B->As.File.ElementType)
+            return A->As.File.ElementType == B->As.File.ElementType;
+        return VarTypeEqual(A->As.File.ElementType, B->As.File.ElementType);
+    }
     return true;
 }
 
@@ -283,6 +300,15 @@ static inline VarType VarTypeStaticArray(RangeIndex Range, const VarType *Elemen
     };
 }
 
+static inline VarType VarTypeFile(const VarType *ElementType)
+{
+    return (VarType) {
+        .Integral = TYPE_FILE,
+        .Size = sizeof(void*),
+        .As.File.ElementType = ElementType,
+    };
+}
+
 static inline VarType VarTypeSubroutine(
         SubroutineParameterList ParameterList, PascalVartab Scope, const VarType *ReturnType, U32 StackArgSize)
 {
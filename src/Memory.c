@@ -163,7 +163,7 @@ void *GPAReallocate(PascalGPA *GPA, void *Ptr, U32 NewSize)
     GPAHeader* NewPtr = GPAFindFreeNode(GPA, NewSize);
     memcpy(NewPtr->Data, Ptr, PtrHeader->Size);
     GPADeallocateNode(GPA, PtrHeader);
-    return NewPtr;
+    return NewPtr->Data;
 }
 
 
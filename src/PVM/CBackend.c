@@ -0,0 +1,1126 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Common.h"
+#include "Memory.h"
+#include "PVM/CBackend.h"
+#include "PVM/Decoder.h"
+#include "PVM/Guard.h"
+
+
+#if PVM_CBACKEND_AVAILABLE
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+
+/*
+ * The generated C:
+ *  every subroutine becomes a static function, int Sub_<index>(struct PVMCState *),
+ *  the PVM registers become locals (R0-R31, F0-F31, C for the condition flag)
+ *  that are copied from/to PascalVM through PVMCState around calls, returns and errors.
+ *  Calls use the C stack, the PVM's return stack is not touched,
+ *  the call depth is still limited to the return stack's size so that callstack overflow is detected the same way.
+ *  The functions return 0 or a PVMReturnValue.
+ *  Instructions that need the runtime (strings, write) are executed by PVMExecuteInstruction through S->Execute
+ */
+#define CSTATE_DEFINITION \
+struct PVMCState {\
+    uint64_t *R;\
+    void *F;\
+    bool *Condition;\
+    uint32_t *ErrorPC;\
+    uint32_t Depth, MaxDepth;\
+    int (*Execute)(void *Ctx, uint32_t InsIndex);\
+    void *Ctx;\
+}
+CSTATE_DEFINITION;
+/* STRFY() only takes one argument, the definition has commas */
+#define CSTRFY_(...) #__VA_ARGS__
+#define CSTRFY(...) CSTRFY_(__VA_ARGS__)
+
+#define CENTRY_NAME "PascalNativeMain"
+
+/* a subroutine only copies the registers it uses from/to PascalVM */
+#define R_BIT(Reg) ((U64)1 << (Reg))
+#define F_BIT(Reg) ((U64)1 << (PVM_REG_COUNT + (Reg)))
+/* the registers take up all 64 bits, the flag goes with GP which every subroutine uses anyway */
+#define C_BIT R_BIT(PVM_REG_GP)
+#define ALL_BITS (~(U64)0)
+#define FRAME_BITS (R_BIT(PVM_REG_GP) | R_BIT(PVM_REG_FP) | R_BIT(PVM_REG_SP))
+
+/* callptr sites compare against at most this many subroutines before calling through the pointer */
+#define MAX_GUARDED_CALLEES 4
+
+/* enough for the file name and the compiler */
+#define CMD_MAX (3*PATH_MAX + 256)
+/* words of PASCAL_CC */
+#define MAX_CC_ARGS 32
+
+PASCAL_STATIC_ASSERT(sizeof(PVMGPR) == sizeof(uint64_t), "struct PVMCState.R assumes 8 byte registers");
+PASCAL_STATIC_ASSERT(sizeof(PVMFPR) == sizeof(uint64_t), "the generated FReg assumes 8 byte registers");
+PASCAL_STATIC_ASSERT(PVM_REG_COUNT + PVM_FREG_COUNT <= 64, "register masks are 64 bits");
+
+
+typedef int (*CEntry)(struct PVMCState *S);
+
+struct PVMNativeProgram
+{
+    void *Handle;
+    CEntry Entry;
+};
+
+typedef struct CExecuteContext
+{
+    PascalVM *PVM;
+    PVMChunk *Chunk;
+} CExecuteContext;
+
+typedef struct CEmitter
+{
+    FILE *Out;
+    PVMChunk *Chunk;
+    bool *IsStart;      /* first instruction of a subroutine */
+    bool *IsTarget;     /* needs a label */
+    U32 *Function;      /* decoded instruction index -> index of the first instruction of its subroutine */
+    /* indexed by the first instruction of a subroutine, REG_BIT masks of the registers 
+     * the subroutine uses, and the ones it or anything it calls uses */
+    U64 *Use, *Closure;
+    /* the subroutines whose address is taken, CalleeCount > MAX_GUARDED_CALLEES if there are too many to guard */
+    U32 Callees[MAX_GUARDED_CALLEES];
+    U32 CalleeCount;
+    U32 Current;
+} CEmitter;
+
+
+static const char sPrelude[] =
+    "#include <stdint.h>\n"
+    "#include <stdbool.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    CSTRFY(CSTATE_DEFINITION) ";\n"
+    "typedef union FReg { double D; uint64_t U; float S; } FReg;\n"
+    "typedef int (*SubFn)(struct PVMCState *);\n"
+    "\n"
+    "#define LO(r) ((uint32_t)(r))\n"
+    "#define SLO(r) ((int32_t)(uint32_t)(r))\n"
+    "#define SET32(r, v) ((r) = ((r) & 0xFFFFFFFF00000000u) | (uint32_t)(v))\n"
+    "#define P(r, Off) ((unsigned char *)(uintptr_t)((r) + (uint64_t)(Off)))\n"
+    "#define ERROR(Code, PC) do { SAVE_STATE(); *S->ErrorPC = (PC); return (Code); } while (0)\n"
+    "#define EXTERNAL(Index) do {\\\n"
+    "    int Ret_;\\\n"
+    "    SAVE_STATE();\\\n"
+    "    Ret_ = S->Execute(S->Ctx, (Index));\\\n"
+    "    LOAD_STATE();\\\n"
+    "    if (Ret_) return Ret_;\\\n"
+    "} while (0)\n"
+    "\n"
+    "static inline uint64_t Ld8(const void *p) { uint8_t v; memcpy(&v, p, 1); return v; }\n"
+    "static inline uint64_t Ld16(const void *p) { uint16_t v; memcpy(&v, p, 2); return v; }\n"
+    "static inline uint64_t Ld32(const void *p) { uint32_t v; memcpy(&v, p, 4); return v; }\n"
+    "static inline uint64_t Ld64(const void *p) { uint64_t v; memcpy(&v, p, 8); return v; }\n"
+    "static inline void St8(void *p, uint64_t v) { uint8_t x = v; memcpy(p, &x, 1); }\n"
+    "static inline void St16(void *p, uint64_t v) { uint16_t x = v; memcpy(p, &x, 2); }\n"
+    "static inline void St32(void *p, uint64_t v) { uint32_t x = v; memcpy(p, &x, 4); }\n"
+    "static inline void St64(void *p, uint64_t v) { memcpy(p, &v, 8); }\n"
+    "\n";
+
+
+
+static void EmitLine(CEmitter *Emitter, const char *Fmt, ...)
+{
+    va_list Args;
+    va_start(Args, Fmt);
+    fputs("    ", Emitter->Out);
+    vfprintf(Emitter->Out, Fmt, Args);
+    fputc('\n', Emitter->Out);
+    va_end(Args);
+}
+
+static U32 IndexOf(const CEmitter *Emitter, const PVMDecodedIns *Ins)
+{
+    return Ins - Emitter->Chunk->Decoded.Ins;
+}
+
+static bool IsFloatOp(PVMOp Op)
+{
+    return (OP_FADD <= Op && Op <= OP_FSLE64)
+        || OP_FMOV == Op || OP_FMOV64 == Op
+        || OP_F32TOF64 == Op || OP_F64TOF32 == Op;
+}
+
+static bool IsIntToFloatOp(PVMOp Op)
+{
+    return (OP_I64TOF64 <= Op && Op <= OP_U32TOF64)
+        || (OP_LDF32 <= Op && Op <= OP_STF64L);
+}
+
+static U64 RegistersOf(const PVMDecodedIns *Ins)
+{
+    PVMOp Op = PVM_GET_OP(Ins->Opcode);
+    U64 Rd = R_BIT(Ins->Rd), Rs = R_BIT(Ins->Rs);
+    U64 RegList = Ins->As.Imm & 0xFF;
+    switch (Op)
+    {
+    case OP_SYS: return R_BIT(0) | R_BIT(1) | FRAME_BITS;
+    /* Rd is the first register of the list */
+    case OP_PSHL: case OP_POPL:
+    case OP_PSHH: case OP_POPH: return Rd*RegList | R_BIT(PVM_REG_SP);
+    case OP_FPSHL: case OP_FPOPL:
+    case OP_FPSHH: case OP_FPOPH: return F_BIT(Ins->Rd)*RegList | R_BIT(PVM_REG_SP);
+    case OP_VMEMCPY: return Rd | Rs | R_BIT(Ins->As.Imm & 0x1F);
+    case OP_VMEMEQU: return Rd | Rs | R_BIT(Ins->As.Imm & 0x1F) | C_BIT;
+    case OP_F64TOI64: return Rd | F_BIT(Ins->Rs);
+
+    case OP_SEQ: case OP_SLT: case OP_ISLT:
+    case OP_SEQ64: case OP_SLT64: case OP_ISLT64:
+    case OP_STRLT: case OP_STREQ:
+    case OP_GETFLAG: case OP_GETNFLAG: case OP_SETFLAG: case OP_SETNFLAG: 
+        return Rd | Rs | C_BIT;
+    case OP_NEGFLAG: 
+    case OP_BCT: 
+    case OP_BCF: 
+        return C_BIT;
+    case OP_BR:
+    case OP_CALL:
+    case OP_LDRIP:
+        return 0;
+    /* Rs is not a register in these */
+    case OP_MOVI: case OP_MOVQI:
+    case OP_ADDI: case OP_ADDQI: case OP_ADDI64: case OP_ADDQI64:
+    case OP_QSHL: case OP_QSHR: case OP_QASR: case OP_QSHL64: case OP_QSHR64: case OP_QASR64:
+    case OP_BEZ:
+    case OP_BNZ:
+    case OP_BRI:
+    case OP_CALLPTR:
+    case OP_BEQQI: case OP_BNEQI: case OP_BLTQI: case OP_BGEQI: case OP_IBLTQI: case OP_IBGEQI:
+    case OP_BEQQI64: case OP_BNEQI64: case OP_BLTQI64: case OP_BGEQI64: case OP_IBLTQI64: case OP_IBGEQI64:
+        return Rd;
+    case OP_FBEQ: case OP_FBNE: case OP_FBLT: case OP_FBNLT: case OP_FBLE: case OP_FBNLE:
+    case OP_FBEQ64: case OP_FBNE64: case OP_FBLT64: case OP_FBNLT64: case OP_FBLE64: case OP_FBNLE64:
+        return F_BIT(Ins->Rd) | F_BIT(Ins->Rs);
+    case OP_FADD3: case OP_FSUB3: case OP_FMUL3: case OP_FDIV3:
+    case OP_FADD3_64: case OP_FSUB3_64: case OP_FMUL3_64: case OP_FDIV3_64:
+        return F_BIT(Ins->Rd) | F_BIT(Ins->Rs) | F_BIT(Ins->As.Imm & 0x1F);
+    default: break;
+    }
+
+    if (IsFloatOp(Op))
+    {
+        U64 Regs = F_BIT(Ins->Rd) | F_BIT(Ins->Rs);
+        if ((OP_FSEQ <= Op && Op <= OP_FSLE) || (OP_FSEQ64 <= Op && Op <= OP_FSLE64))
+            Regs |= C_BIT;
+        return Regs;
+    }
+    if (IsIntToFloatOp(Op))
+        return F_BIT(Ins->Rd) | Rs;
+    if (PVMIsThreeOperand(Op))
+        return Rd | Rs | R_BIT(Ins->As.Imm & 0x1F);
+    return Rd | Rs;
+}
+
+
+
+/* the code for a branch to Target: an instruction of the same subroutine, 
+ * the start of another one (jumped to without a new frame) or the trailing illegal instruction */
+static void EmitGoto(CEmitter *Emitter, const char *Condition, const PVMDecodedIns *Target)
+{
+    U32 Index = IndexOf(Emitter, Target);
+    if (Index == Emitter->Chunk->Decoded.Count)
+        EmitLine(Emitter, "if (%s) ERROR(%d, %uu);", Condition, PVM_ILLEGAL_INSTRUCTION, Target->StreamOffset);
+    else if (Emitter->Function[Index] != Emitter->Current)
+        EmitLine(Emitter, "if (%s) { SAVE_STATE(); return Sub_%u(S); }", Condition, Index);
+    else EmitLine(Emitter, "if (%s) goto L%u;", Condition, Index);
+}
+
+/* copies the registers in Mask between the locals and PascalVM, on one line */
+static void EmitSync(CEmitter *Emitter, const char *Prefix, U64 Mask, bool Save, const char *Suffix)
+{
+    fputs(Prefix, Emitter->Out);
+    for (UInt i = 0; i < PVM_REG_COUNT; i++)
+    {
+        if (Mask & R_BIT(i))
+            fprintf(Emitter->Out, Save ? "S->R[%u] = R%u; " : "R%u = S->R[%u]; ", i, i);
+    }
+    for (UInt i = 0; i < PVM_FREG_COUNT; i++)
+    {
+        if (Mask & F_BIT(i))
+            fprintf(Emitter->Out, Save ? "((FReg *)S->F)[%u] = F%u; " : "F%u = ((FReg *)S->F)[%u]; ", i, i);
+    }
+    if (Mask & C_BIT)
+        fputs(Save ? "*S->Condition = C; " : "C = *S->Condition; ", Emitter->Out);
+    fputs(Suffix, Emitter->Out);
+}
+
+/* only the registers that both sides use go through PascalVM */
+static void EmitCall(CEmitter *Emitter, const char *Callee, U64 CalleeUses, const PVMDecodedIns *Ins)
+{
+    U64 Use = Emitter->Use[Emitter->Current];
+    EmitLine(Emitter, "{");
+    EmitLine(Emitter, "    uint64_t Fp_ = R%d; int Ret_;", PVM_REG_FP);
+    EmitLine(Emitter, "    if (S->Depth == S->MaxDepth) ERROR(%d, %uu);", PVM_CALLSTACK_OVERFLOW, Ins->StreamOffset);
+    EmitSync(Emitter, "        ", Use & CalleeUses, true, "\n");
+    EmitLine(Emitter, "    S->Depth++;");
+    EmitLine(Emitter, "    Ret_ = %s;", Callee);
+    EmitLine(Emitter, "    S->Depth--;");
+    EmitLine(Emitter, "    if (Ret_) {");
+    EmitSync(Emitter, "            ", Use & ~CalleeUses, true, "\n");
+    EmitLine(Emitter, "        return Ret_;");
+    EmitLine(Emitter, "    }");
+    EmitSync(Emitter, "        ", Use & CalleeUses, false, "\n");
+    EmitLine(Emitter, "    R%d = Fp_;", PVM_REG_FP);
+    EmitLine(Emitter, "}");
+}
+
+static void EmitCPush(CEmitter *Emitter, char Reg, const char *Member, UInt Base, UInt RegList)
+{
+    for (UInt i = 0; i < 8; i++)
+    {
+        if (RegList & (1u << i))
+        {
+            EmitLine(Emitter, "R%d += 8; St64(P(R%d, 0), %c%u%s);",
+                    PVM_REG_SP, PVM_REG_SP, Reg, Base + i, Member
+            );
+        }
+    }
+}
+
+static void EmitCPop(CEmitter *Emitter, char Reg, const char *Member, UInt Base, UInt RegList)
+{
+    for (int i = 7; i >= 0; i--)
+    {
+        if (RegList & (1u << i))
+        {
+            EmitLine(Emitter, "%c%u%s = Ld64(P(R%d, 0)); R%d -= 8;",
+                    Reg, Base + i, Member, PVM_REG_SP, PVM_REG_SP
+            );
+        }
+    }
+}
+
+
+/* returns false if the instruction can't be translated */
+static bool EmitCStatement(CEmitter *Emitter, const PVMDecodedIns *Ins)
+{
+#define LINE(...) EmitLine(Emitter, __VA_ARGS__)
+#define BINARY32(Operator) LINE("SET32(R%u, LO(R%u) " Operator " LO(R%u));", Rd, Rd, Rs)
+#define BINARY64(Operator) LINE("R%u = R%u " Operator " R%u;", Rd, Rd, Rs)
+#define DIVISION_CHECK(Expr) LINE("if (0 == " Expr ") ERROR(%d, %uu);", Rs, PVM_DIVISION_BY_0, Ins->StreamOffset)
+#define FLOAT_BINARY(Operator, Member) LINE("F%u." Member " = F%u." Member " " Operator " F%u." Member ";", Rd, Rd, Rs)
+#define BINARY3_32(Operator) LINE("SET32(R%u, LO(R%u) " Operator " LO(R%u));", Rd, Rs, Rt)
+#define BINARY3_64(Operator) LINE("R%u = R%u " Operator " R%u;", Rd, Rs, Rt)
+#define DIVISION_CHECK3(Expr) LINE("if (0 == " Expr ") ERROR(%d, %uu);", Rt, PVM_DIVISION_BY_0, Ins->StreamOffset)
+#define FLOAT_BINARY3(Operator, Member) LINE("F%u." Member " = F%u." Member " " Operator " F%u." Member ";", Rd, Rs, Rt)
+#define FLOAT_SET_IF(Operator, Member) LINE("C = F%u." Member " " Operator " F%u." Member ";", Rd, Rs)
+#define LOAD(Dst) LINE(Dst ";", Rd, Rs, Offset)
+#define STORE(Size) LINE("St" Size "(P(R%u, %lld), R%u);", Rs, Offset, Rd)
+#define BRANCH_IF(...) do {\
+    char Condition_[64];\
+    snprintf(Condition_, sizeof Condition_, __VA_ARGS__);\
+    EmitGoto(Emitter, Condition_, Ins->As.Target);\
+} while (0)
+
+    UInt Rd = Ins->Rd, Rs = Ins->Rs;
+    UInt Rt = Ins->As.Imm & 0x1F; /* three-operand instructions */
+    long long SmallImm = BitSex64(Rs, 3);
+    long long Offset = (I64)Ins->As.Imm;
+    unsigned long long Imm = Ins->As.Imm;
+    U32 Index = IndexOf(Emitter, Ins);
+    switch (PVM_GET_OP(Ins->Opcode))
+    {
+    case OP_SYS:
+    {
+        switch (PVM_GET_SYS_OP(Ins->Opcode))
+        {
+        case OP_SYS_EXIT:
+        {
+            LINE("if (S->Depth) R%d = R%d - 8;", PVM_REG_SP, PVM_REG_FP);
+            LINE("SAVE_STATE();");
+            LINE("return 0;");
+        } break;
+        case OP_SYS_ENTER:
+        {
+            LINE("R%d = R%d + 8;", PVM_REG_FP, PVM_REG_SP);
+            LINE("R%d += 0x%xu;", PVM_REG_SP, (U32)Imm);
+        } break;
+        case OP_SYS_WRITE:
+        case OP_SYS_READ:
+        case OP_SYS_READLN:
+        case OP_SYS_ASSIGN:
+        case OP_SYS_RESET:
+        case OP_SYS_REWRITE:
+        case OP_SYS_CLOSE:
+        case OP_SYS_WRITE_FILE:
+        case OP_SYS_READ_FILE:
+        case OP_SYS_READLN_FILE:
+        case OP_SYS_EOF:
+        case OP_SYS_EOLN:
+        case OP_SYS_WRITE_RECORD:
+        case OP_SYS_READ_RECORD:
+        case OP_SYS_SEEK:
+        case OP_SYS_FILESIZE:
+        case OP_SYS_FILEPOS: LINE("EXTERNAL(%u);", Index); break;
+        default: LINE("ERROR(%d, %uu);", PVM_ILLEGAL_INSTRUCTION, Ins->StreamOffset); break;
+        }
+    } break;
+
+    case OP_ADD: BINARY32("+"); break;
+    case OP_SUB: BINARY32("-"); break;
+    case OP_MUL:
+    case OP_IMUL: BINARY32("*"); break; /* same low 32 bits */
+    case OP_AND: BINARY32("&"); break;
+    case OP_OR: BINARY32("|"); break;
+    case OP_XOR: BINARY32("^"); break;
+    case OP_DIV: DIVISION_CHECK("LO(R%u)"); BINARY32("/"); break;
+    case OP_MOD: DIVISION_CHECK("LO(R%u)"); BINARY32("%%"); break;
+    case OP_IDIV:
+    {
+        DIVISION_CHECK("LO(R%u)");
+        LINE("SET32(R%u, SLO(R%u) / SLO(R%u));", Rd, Rd, Rs);
+    } break;
+    case OP_NEG: LINE("SET32(R%u, -LO(R%u));", Rd, Rs); break;
+    case OP_NOT: LINE("SET32(R%u, ~LO(R%u));", Rd, Rs); break;
+    case OP_VSHL: LINE("SET32(R%u, LO(R%u) << (LO(R%u) & 0x1F));", Rd, Rd, Rs); break;
+    case OP_VSHR: LINE("SET32(R%u, LO(R%u) >> (LO(R%u) & 0x1F));", Rd, Rd, Rs); break;
+    case OP_VASR: LINE("SET32(R%u, SLO(R%u) >> (LO(R%u) & 0x1F));", Rd, Rd, Rs); break;
+    case OP_QSHL: LINE("SET32(R%u, LO(R%u) << %u);", Rd, Rd, Rs); break;
+    case OP_QSHR: LINE("SET32(R%u, LO(R%u) >> %u);", Rd, Rd, Rs); break;
+    case OP_QASR: LINE("SET32(R%u, SLO(R%u) >> %u);", Rd, Rd, Rs); break;
+    case OP_ADDI:
+    case OP_ADDQI: LINE("SET32(R%u, LO(R%u) + 0x%xu);", Rd, Rd, (U32)Imm); break;
+
+    case OP_ADD64: BINARY64("+"); break;
+    case OP_SUB64: BINARY64("-"); break;
+    case OP_MUL64:
+    case OP_IMUL64: BINARY64("*"); break;
+    case OP_AND64: BINARY64("&"); break;
+    case OP_OR64: BINARY64("|"); break;
+    case OP_XOR64: BINARY64("^"); break;
+    case OP_DIV64: DIVISION_CHECK("R%u"); BINARY64("/"); break;
+    case OP_MOD64: DIVISION_CHECK("R%u"); BINARY64("%%"); break;
+    case OP_IDIV64:
+    {
+        DIVISION_CHECK("R%u");
+        LINE("R%u = (uint64_t)((int64_t)R%u / (int64_t)R%u);", Rd, Rd, Rs);
+    } break;
+    case OP_NEG64: LINE("R%u = -R%u;", Rd, Rs); break;
+    case OP_NOT64: LINE("R%u = ~R%u;", Rd, Rs); break;
+    case OP_VSHL64: LINE("R%u = R%u << (R%u & 0x3F);", Rd, Rd, Rs); break;
+    case OP_VSHR64: LINE("R%u = R%u >> (R%u & 0x3F);", Rd, Rd, Rs); break;
+    case OP_VASR64: LINE("R%u = (uint64_t)((int64_t)R%u >> (R%u & 0x3F));", Rd, Rd, Rs); break;
+    case OP_QSHL64: LINE("R%u <<= %u;", Rd, Rs); break;
+    case OP_QSHR64: LINE("R%u >>= %u;", Rd, Rs); break;
+    case OP_QASR64: LINE("R%u = (uint64_t)((int64_t)R%u >> %u);", Rd, Rd, Rs); break;
+    case OP_ADDI64:
+    case OP_ADDQI64: LINE("R%u += 0x%llxu;", Rd, Imm); break;
+
+    case OP_SEQ: LINE("C = LO(R%u) == LO(R%u);", Rd, Rs); break;
+    case OP_SLT: LINE("C = LO(R%u) < LO(R%u);", Rd, Rs); break;
+    case OP_ISLT: LINE("C = SLO(R%u) < SLO(R%u);", Rd, Rs); break;
+    case OP_SETEZ: LINE("SET32(R%u, 0 == LO(R%u));", Rd, Rs); break;
+    case OP_SEQ64: LINE("C = R%u == R%u;", Rd, Rs); break;
+    case OP_SLT64: LINE("C = R%u < R%u;", Rd, Rs); break;
+    case OP_ISLT64: LINE("C = (int64_t)R%u < (int64_t)R%u;", Rd, Rs); break;
+    case OP_SETEZ64: LINE("R%u = 0 == R%u;", Rd, Rs); break;
+
+    case OP_GETFLAG:
+    case OP_GETNFLAG: LINE("SET32(R%u, C);", Rd); break;
+    case OP_SETFLAG: LINE("C = 0 != LO(R%u);", Rd); break;
+    case OP_SETNFLAG: LINE("C = 0 == LO(R%u);", Rd); break;
+    case OP_NEGFLAG: LINE("C = !C;"); break;
+
+    case OP_BR: EmitGoto(Emitter, "1", Ins->As.Target); break;
+    case OP_BCT: EmitGoto(Emitter, "C", Ins->As.Target); break;
+    case OP_BCF: EmitGoto(Emitter, "!C", Ins->As.Target); break;
+    case OP_BEZ:
+    case OP_BNZ:
+    {
+        char Condition[32];
+        snprintf(Condition, sizeof Condition,
+                OP_BEZ == PVM_GET_OP(Ins->Opcode) ? "0 == LO(R%u)" : "0 != LO(R%u)", Rd
+        );
+        EmitGoto(Emitter, Condition, Ins->As.Target);
+    } break;
+    case OP_BEQ: BRANCH_IF("LO(R%u) == LO(R%u)", Rd, Rs); break;
+    case OP_BNE: BRANCH_IF("LO(R%u) != LO(R%u)", Rd, Rs); break;
+    case OP_BLT: BRANCH_IF("LO(R%u) < LO(R%u)", Rd, Rs); break;
+    case OP_BGE: BRANCH_IF("LO(R%u) >= LO(R%u)", Rd, Rs); break;
+    case OP_IBLT: BRANCH_IF("SLO(R%u) < SLO(R%u)", Rd, Rs); break;
+    case OP_IBGE: BRANCH_IF("SLO(R%u) >= SLO(R%u)", Rd, Rs); break;
+    case OP_BEQ64: BRANCH_IF("R%u == R%u", Rd, Rs); break;
+    case OP_BNE64: BRANCH_IF("R%u != R%u", Rd, Rs); break;
+    case OP_BLT64: BRANCH_IF("R%u < R%u", Rd, Rs); break;
+    case OP_BGE64: BRANCH_IF("R%u >= R%u", Rd, Rs); break;
+    case OP_IBLT64: BRANCH_IF("(int64_t)R%u < (int64_t)R%u", Rd, Rs); break;
+    case OP_IBGE64: BRANCH_IF("(int64_t)R%u >= (int64_t)R%u", Rd, Rs); break;
+    case OP_BEQQI: BRANCH_IF("LO(R%u) == (uint32_t)%lld", Rd, SmallImm); break;
+    case OP_BNEQI: BRANCH_IF("LO(R%u) != (uint32_t)%lld", Rd, SmallImm); break;
+    case OP_BLTQI: BRANCH_IF("LO(R%u) < (uint32_t)%lld", Rd, SmallImm); break;
+    case OP_BGEQI: BRANCH_IF("LO(R%u) >= (uint32_t)%lld", Rd, SmallImm); break;
+    case OP_IBLTQI: BRANCH_IF("SLO(R%u) < %lld", Rd, SmallImm); break;
+    case OP_IBGEQI: BRANCH_IF("SLO(R%u) >= %lld", Rd, SmallImm); break;
+    case OP_BEQQI64: BRANCH_IF("R%u == (uint64_t)%lld", Rd, SmallImm); break;
+    case OP_BNEQI64: BRANCH_IF("R%u != (uint64_t)%lld", Rd, SmallImm); break;
+    case OP_BLTQI64: BRANCH_IF("R%u < (uint64_t)%lld", Rd, SmallImm); break;
+    case OP_BGEQI64: BRANCH_IF("R%u >= (uint64_t)%lld", Rd, SmallImm); break;
+    case OP_IBLTQI64: BRANCH_IF("(int64_t)R%u < %lld", Rd, SmallImm); break;
+    case OP_IBGEQI64: BRANCH_IF("(int64_t)R%u >= %lld", Rd, SmallImm); break;
+    case OP_FBEQ: BRANCH_IF("F%u.S == F%u.S", Rd, Rs); break;
+    case OP_FBNE: BRANCH_IF("!(F%u.S == F%u.S)", Rd, Rs); break;
+    case OP_FBLT: BRANCH_IF("F%u.S < F%u.S", Rd, Rs); break;
+    case OP_FBNLT: BRANCH_IF("!(F%u.S < F%u.S)", Rd, Rs); break;
+    case OP_FBLE: BRANCH_IF("F%u.S <= F%u.S", Rd, Rs); break;
+    case OP_FBNLE: BRANCH_IF("!(F%u.S <= F%u.S)", Rd, Rs); break;
+    case OP_FBEQ64: BRANCH_IF("F%u.D == F%u.D", Rd, Rs); break;
+    case OP_FBNE64: BRANCH_IF("!(F%u.D == F%u.D)", Rd, Rs); break;
+    case OP_FBLT64: BRANCH_IF("F%u.D < F%u.D", Rd, Rs); break;
+    case OP_FBNLT64: BRANCH_IF("!(F%u.D < F%u.D)", Rd, Rs); break;
+    case OP_FBLE64: BRANCH_IF("F%u.D <= F%u.D", Rd, Rs); break;
+    case OP_FBNLE64: BRANCH_IF("!(F%u.D <= F%u.D)", Rd, Rs); break;
+    case OP_BRI:
+    {
+        LINE("R%u += 0x%llxu;", Rd, (unsigned long long)SmallImm);
+        EmitGoto(Emitter, "1", Ins->As.Target);
+    } break;
+    case OP_CALL:
+    {
+        U32 Target = IndexOf(Emitter, Ins->As.Target);
+        if (Target == Emitter->Chunk->Decoded.Count)
+        {
+            LINE("ERROR(%d, %uu);", PVM_ILLEGAL_INSTRUCTION, Ins->As.Target->StreamOffset);
+            break;
+        }
+        char Callee[32];
+        snprintf(Callee, sizeof Callee, "Sub_%u(S)", Target);
+        EmitCall(Emitter, Callee, Emitter->Closure[Target], Ins);
+    } break;
+    case OP_CALLPTR:
+    {
+        /* function pointers only come from ldrip, so the pointer is usually one of the few subroutines 
+         * whose address was taken: a direct call syncs only what the callee uses and can be inlined */
+        char Callee[32];
+        bool Guarded = Emitter->CalleeCount <= MAX_GUARDED_CALLEES;
+        for (U32 i = 0; Guarded && i < Emitter->CalleeCount; i++)
+        {
+            U32 Target = Emitter->Callees[i];
+            LINE("%sif (R%u == (uint64_t)(uintptr_t)&Sub_%u)", i? "else " : "", Rd, Target);
+            snprintf(Callee, sizeof Callee, "Sub_%u(S)", Target);
+            EmitCall(Emitter, Callee, Emitter->Closure[Target], Ins);
+        }
+        if (Guarded && 0 != Emitter->CalleeCount)
+            LINE("else");
+        snprintf(Callee, sizeof Callee, "((SubFn)(uintptr_t)R%u)(S)", Rd);
+        EmitCall(Emitter, Callee, ALL_BITS, Ins);
+    } break;
+    case OP_LDRIP:
+    {
+        U32 Target = IndexOf(Emitter, Ins->As.Target);
+        if (Target == Emitter->Chunk->Decoded.Count)
+            return false;
+        LINE("R%u = (uint64_t)(uintptr_t)&Sub_%u;", Rd, Target);
+    } break;
+
+    case OP_PSHL: EmitCPush(Emitter, 'R', "", Rd, Imm); break;
+    case OP_PSHH: EmitCPush(Emitter, 'R', "", Rd, Imm); break;
+    case OP_FPSHL: EmitCPush(Emitter, 'F', ".U", Rd, Imm); break;
+    case OP_FPSHH: EmitCPush(Emitter, 'F', ".U", Rd, Imm); break;
+    case OP_POPL: EmitCPop(Emitter, 'R', "", Rd, Imm); break;
+    case OP_POPH: EmitCPop(Emitter, 'R', "", Rd, Imm); break;
+    case OP_FPOPL: EmitCPop(Emitter, 'F', ".U", Rd, Imm); break;
+    case OP_FPOPH: EmitCPop(Emitter, 'F', ".U", Rd, Imm); break;
+
+    case OP_FADD: FLOAT_BINARY("+", "S"); break;
+    case OP_FSUB: FLOAT_BINARY("-", "S"); break;
+    case OP_FMUL: FLOAT_BINARY("*", "S"); break;
+    case OP_FDIV: FLOAT_BINARY("/", "S"); break;
+    case OP_FNEG: LINE("F%u.S = -F%u.S;", Rd, Rs); break;
+    case OP_FSEQ: FLOAT_SET_IF("==", "S"); break;
+    case OP_FSLT: FLOAT_SET_IF("<", "S"); break;
+    case OP_FSGT: FLOAT_SET_IF(">", "S"); break;
+    case OP_FSNE: FLOAT_SET_IF("!=", "S"); break;
+    case OP_FSLE: FLOAT_SET_IF("<=", "S"); break;
+    case OP_FSGE: FLOAT_SET_IF(">=", "S"); break;
+    case OP_FADD64: FLOAT_BINARY("+", "D"); break;
+    case OP_FSUB64: FLOAT_BINARY("-", "D"); break;
+    case OP_FMUL64: FLOAT_BINARY("*", "D"); break;
+    case OP_FDIV64: FLOAT_BINARY("/", "D"); break;
+    case OP_FNEG64: LINE("F%u.D = -F%u.D;", Rd, Rs); break;
+    case OP_FSEQ64: FLOAT_SET_IF("==", "D"); break;
+    case OP_FSLT64: FLOAT_SET_IF("<", "D"); break;
+    case OP_FSGT64: FLOAT_SET_IF(">", "D"); break;
+    case OP_FSNE64: FLOAT_SET_IF("!=", "D"); break;
+    case OP_FSLE64: FLOAT_SET_IF("<=", "D"); break;
+    case OP_FSGE64: FLOAT_SET_IF(">=", "D"); break;
+
+    case OP_ADD3: BINARY3_32("+"); break;
+    case OP_SUB3: BINARY3_32("-"); break;
+    case OP_MUL3:
+    case OP_IMUL3: BINARY3_32("*"); break;
+    case OP_AND3: BINARY3_32("&"); break;
+    case OP_OR3: BINARY3_32("|"); break;
+    case OP_XOR3: BINARY3_32("^"); break;
+    case OP_DIV3: DIVISION_CHECK3("LO(R%u)"); BINARY3_32("/"); break;
+    case OP_MOD3: DIVISION_CHECK3("LO(R%u)"); BINARY3_32("%%"); break;
+    case OP_IDIV3:
+    {
+        DIVISION_CHECK3("LO(R%u)");
+        LINE("SET32(R%u, SLO(R%u) / SLO(R%u));", Rd, Rs, Rt);
+    } break;
+    case OP_VSHL3: LINE("SET32(R%u, LO(R%u) << (LO(R%u) & 0x1F));", Rd, Rs, Rt); break;
+    case OP_VSHR3: LINE("SET32(R%u, LO(R%u) >> (LO(R%u) & 0x1F));", Rd, Rs, Rt); break;
+    case OP_VASR3: LINE("SET32(R%u, SLO(R%u) >> (LO(R%u) & 0x1F));", Rd, Rs, Rt); break;
+    case OP_ADD3_64: BINARY3_64("+"); break;
+    case OP_SUB3_64: BINARY3_64("-"); break;
+    case OP_MUL3_64:
+    case OP_IMUL3_64: BINARY3_64("*"); break;
+    case OP_AND3_64: BINARY3_64("&"); break;
+    case OP_OR3_64: BINARY3_64("|"); break;
+    case OP_XOR3_64: BINARY3_64("^"); break;
+    case OP_DIV3_64: DIVISION_CHECK3("R%u"); BINARY3_64("/"); break;
+    case OP_MOD3_64: DIVISION_CHECK3("R%u"); BINARY3_64("%%"); break;
+    case OP_IDIV3_64:
+    {
+        DIVISION_CHECK3("R%u");
+        LINE("R%u = (uint64_t)((int64_t)R%u / (int64_t)R%u);", Rd, Rs, Rt);
+    } break;
+    case OP_VSHL3_64: LINE("R%u = R%u << (R%u & 0x3F);", Rd, Rs, Rt); break;
+    case OP_VSHR3_64: LINE("R%u = R%u >> (R%u & 0x3F);", Rd, Rs, Rt); break;
+    case OP_VASR3_64: LINE("R%u = (uint64_t)((int64_t)R%u >> (R%u & 0x3F));", Rd, Rs, Rt); break;
+    case OP_FADD3: FLOAT_BINARY3("+", "S"); break;
+    case OP_FSUB3: FLOAT_BINARY3("-", "S"); break;
+    case OP_FMUL3: FLOAT_BINARY3("*", "S"); break;
+    case OP_FDIV3: FLOAT_BINARY3("/", "S"); break;
+    case OP_FADD3_64: FLOAT_BINARY3("+", "D"); break;
+    case OP_FSUB3_64: FLOAT_BINARY3("-", "D"); break;
+    case OP_FMUL3_64: FLOAT_BINARY3("*", "D"); break;
+    case OP_FDIV3_64: FLOAT_BINARY3("/", "D"); break;
+
+    case OP_MEMCPY: LINE("memcpy(P(R%u, 0), P(R%u, 0), 0x%xu);", Rd, Rs, (U32)Imm); break;
+    case OP_VMEMCPY: LINE("memcpy(P(R%u, 0), P(R%u, 0), R%u);", Rd, Rs, (UInt)(Imm & 0x1F)); break;
+    case OP_VMEMEQU: LINE("C = 0 == memcmp(P(R%u, 0), P(R%u, 0), R%u);", Rd, Rs, (UInt)(Imm & 0x1F)); break;
+
+    case OP_MOV32: LINE("SET32(R%u, R%u);", Rd, Rs); break;
+    case OP_MOVZEX32_8: LINE("SET32(R%u, (uint8_t)R%u);", Rd, Rs); break;
+    case OP_MOVZEX32_16: LINE("SET32(R%u, (uint16_t)R%u);", Rd, Rs); break;
+    case OP_MOV64: LINE("R%u = R%u;", Rd, Rs); break;
+    case OP_MOVZEX64_8: LINE("R%u = (uint8_t)R%u;", Rd, Rs); break;
+    case OP_MOVZEX64_16: LINE("R%u = (uint16_t)R%u;", Rd, Rs); break;
+    case OP_MOVZEX64_32: LINE("R%u = (uint32_t)R%u;", Rd, Rs); break;
+    case OP_MOVSEX64_32: LINE("R%u = (uint64_t)(int64_t)SLO(R%u);", Rd, Rs); break;
+    case OP_MOVI:
+    case OP_MOVQI: LINE("R%u = 0x%llxu;", Rd, Imm); break;
+    case OP_FMOV: LINE("F%u.S = F%u.S;", Rd, Rs); break;
+    case OP_FMOV64: LINE("F%u.D = F%u.D;", Rd, Rs); break;
+
+    case OP_F32TOF64: LINE("F%u.D = F%u.S;", Rd, Rs); break;
+    case OP_F64TOF32: LINE("F%u.S = (float)F%u.D;", Rd, Rs); break;
+    case OP_F64TOI64: LINE("R%u = (uint64_t)(int64_t)F%u.D;", Rd, Rs); break;
+    case OP_I64TOF64: LINE("F%u.D = (double)(int64_t)R%u;", Rd, Rs); break;
+    case OP_I64TOF32: LINE("F%u.S = (float)(int64_t)R%u;", Rd, Rs); break;
+    case OP_U64TOF64: LINE("F%u.D = (double)R%u;", Rd, Rs); break;
+    case OP_U64TOF32: LINE("F%u.S = (float)R%u;", Rd, Rs); break;
+    case OP_U32TOF32: LINE("F%u.S = (float)LO(R%u);", Rd, Rs); break;
+    case OP_U32TOF64: LINE("F%u.D = (double)LO(R%u);", Rd, Rs); break;
+    case OP_I32TOF32: LINE("F%u.S = (float)SLO(R%u);", Rd, Rs); break;
+    case OP_I32TOF64: LINE("F%u.D = (double)SLO(R%u);", Rd, Rs); break;
+
+    case OP_LD32:
+    case OP_LD32L: LOAD("SET32(R%u, Ld32(P(R%u, %lld)))"); break;
+    case OP_LD64:
+    case OP_LD64L: LOAD("R%u = Ld64(P(R%u, %lld))"); break;
+    case OP_LDZEX32_8:
+    case OP_LDZEX32_8L: LOAD("SET32(R%u, Ld8(P(R%u, %lld)))"); break;
+    case OP_LDZEX32_16:
+    case OP_LDZEX32_16L: LOAD("SET32(R%u, Ld16(P(R%u, %lld)))"); break;
+    case OP_LDZEX64_8:
+    case OP_LDZEX64_8L: LOAD("R%u = Ld8(P(R%u, %lld))"); break;
+    case OP_LDZEX64_16:
+    case OP_LDZEX64_16L: LOAD("R%u = Ld16(P(R%u, %lld))"); break;
+    case OP_LDZEX64_32:
+    case OP_LDZEX64_32L: LOAD("R%u = Ld32(P(R%u, %lld))"); break;
+    case OP_LDSEX32_8:
+    case OP_LDSEX32_8L: LOAD("SET32(R%u, (int8_t)Ld8(P(R%u, %lld)))"); break;
+    case OP_LDSEX32_16:
+    case OP_LDSEX32_16L: LOAD("SET32(R%u, (int16_t)Ld16(P(R%u, %lld)))"); break;
+    case OP_LDSEX64_8:
+    case OP_LDSEX64_8L: LOAD("R%u = (uint64_t)(int64_t)(int8_t)Ld8(P(R%u, %lld))"); break;
+    /* zero extends, same as the interpreter */
+    case OP_LDSEX64_16: LOAD("R%u = Ld16(P(R%u, %lld))"); break;
+    case OP_LDSEX64_16L: LOAD("R%u = (uint64_t)(int64_t)(int16_t)Ld16(P(R%u, %lld))"); break;
+    case OP_LDSEX64_32:
+    case OP_LDSEX64_32L: LOAD("R%u = (uint64_t)(int64_t)(int32_t)Ld32(P(R%u, %lld))"); break;
+    case OP_LEA:
+    case OP_LEAL: LOAD("R%u = R%u + (uint64_t)%lldll"); break;
+
+    case OP_ST8:
+    case OP_ST8L: STORE("8"); break;
+    case OP_ST16:
+    case OP_ST16L: STORE("16"); break;
+    case OP_ST32:
+    case OP_ST32L: STORE("32"); break;
+    case OP_ST64:
+    case OP_ST64L: STORE("64"); break;
+
+    case OP_LDF32:
+    case OP_LDF32L: LINE("memcpy(&F%u.S, P(R%u, %lld), 4);", Rd, Rs, Offset); break;
+    case OP_LDF64:
+    case OP_LDF64L: LINE("memcpy(&F%u.D, P(R%u, %lld), 8);", Rd, Rs, Offset); break;
+    case OP_STF32:
+    case OP_STF32L: LINE("memcpy(P(R%u, %lld), &F%u.S, 4);", Rs, Offset, Rd); break;
+    case OP_STF64:
+    case OP_STF64L: LINE("memcpy(P(R%u, %lld), &F%u.D, 8);", Rs, Offset, Rd); break;
+
+    /* need the PascalString runtime */
+    case OP_SADD:
+    case OP_STRCPY:
+    case OP_STRLT:
+    case OP_STREQ: LINE("EXTERNAL(%u);", Index); break;
+
+    default: LINE("ERROR(%d, %uu);", PVM_ILLEGAL_INSTRUCTION, Ins->StreamOffset); break;
+    }
+    return true;
+
+#undef BRANCH_IF
+#undef STORE
+#undef LOAD
+#undef FLOAT_SET_IF
+#undef FLOAT_BINARY3
+#undef DIVISION_CHECK3
+#undef BINARY3_64
+#undef BINARY3_32
+#undef FLOAT_BINARY
+#undef DIVISION_CHECK
+#undef BINARY64
+#undef BINARY32
+#undef LINE
+}
+
+
+static void EmitStateMacro(CEmitter *Emitter, const char *Name, U64 Mask, bool Save)
+{
+    fprintf(Emitter->Out, "#define %s() do { ", Name);
+    EmitSync(Emitter, "", Mask, Save, "} while (0)\n");
+}
+
+/* Type R0, R1, ..., R<Count - 1>; */
+static void EmitRegisterDecl(CEmitter *Emitter, const char *Type, char Reg, UInt Count)
+{
+    fprintf(Emitter->Out, "    %s", Type);
+    for (UInt i = 0; i < Count; i++)
+        fprintf(Emitter->Out, "%s%c%u", i? ", " : " ", Reg, i);
+    fputs(";\n", Emitter->Out);
+}
+
+static bool EmitSubroutine(CEmitter *Emitter, U32 First)
+{
+    PVMChunk *Chunk = Emitter->Chunk;
+    Emitter->Current = First;
+    fputc('\n', Emitter->Out);
+    EmitStateMacro(Emitter, "LOAD_STATE", Emitter->Use[First], false);
+    EmitStateMacro(Emitter, "SAVE_STATE", Emitter->Use[First], true);
+    fprintf(Emitter->Out, "static int Sub_%u(struct PVMCState *S)\n{\n", First);
+    EmitRegisterDecl(Emitter, "uint64_t", 'R', PVM_REG_COUNT);
+    EmitRegisterDecl(Emitter, "FReg", 'F', PVM_FREG_COUNT);
+    EmitLine(Emitter, "bool C;");
+    EmitLine(Emitter, "LOAD_STATE();");
+
+    U32 i = First;
+    do {
+        const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        if (Emitter->IsTarget[i])
+            fprintf(Emitter->Out, "L%u:;\n", i);
+        fprintf(Emitter->Out, "    /* %u */\n", Ins->StreamOffset);
+        if (!EmitCStatement(Emitter, Ins))
+            return false;
+        i++;
+    } while (i < Chunk->Decoded.Count && !Emitter->IsStart[i]);
+
+    /* falls through to the next subroutine or the trailing illegal instruction */
+    if (i < Chunk->Decoded.Count)
+    {
+        EmitLine(Emitter, "SAVE_STATE();");
+        EmitLine(Emitter, "return Sub_%u(S);", i);
+    }
+    else
+    {
+        EmitLine(Emitter, "ERROR(%d, %uu);", PVM_ILLEGAL_INSTRUCTION, Chunk->Decoded.Ins[i].StreamOffset);
+    }
+    fprintf(Emitter->Out, "}\n#undef SAVE_STATE\n#undef LOAD_STATE\n");
+    return true;
+}
+
+
+static bool IsBranchOp(PVMOp Op)
+{
+    if (PVMIsCompareAndBranch(Op))
+        return true;
+    switch (Op)
+    {
+    case OP_BR:
+    case OP_BCT:
+    case OP_BCF:
+    case OP_BEZ:
+    case OP_BNZ:
+    case OP_BRI:
+        return true;
+    default: return false;
+    }
+}
+
+static void AddCallee(CEmitter *Emitter, U32 Target)
+{
+    for (U32 i = 0; i < Emitter->CalleeCount && i < MAX_GUARDED_CALLEES; i++)
+    {
+        if (Emitter->Callees[i] == Target)
+            return;
+    }
+    if (Emitter->CalleeCount < MAX_GUARDED_CALLEES)
+        Emitter->Callees[Emitter->CalleeCount] = Target;
+    if (Emitter->CalleeCount <= MAX_GUARDED_CALLEES)
+        Emitter->CalleeCount++;
+}
+
+/* returns false if the chunk can't be expressed as C functions */
+static bool EmitProgram(CEmitter *Emitter, U32 EntryPoint)
+{
+    PVMChunk *Chunk = Emitter->Chunk;
+    U32 InsCount = Chunk->Decoded.Count;
+
+    /* subroutines start at the entry point, at call targets, and where the compiler said so */
+    for (U32 i = 0; i <= InsCount; i++)
+    {
+        Emitter->IsStart[i] = false;
+        Emitter->IsTarget[i] = false;
+    }
+    Emitter->IsStart[0] = true;
+    Emitter->IsStart[EntryPoint] = true;
+    for (U32 i = 0; i < Chunk->Debug.Count; i++)
+    {
+        const LineDebugInfo *Info = &Chunk->Debug.Info[i];
+        if (Info->IsSubroutine)
+            Emitter->IsStart[IndexOf(Emitter, PVMDecodedInsAt(Chunk, Info->StreamOffset))] = true;
+    }
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        PVMOp Op = PVM_GET_OP(Ins->Opcode);
+        if (OP_CALL == Op || OP_LDRIP == Op)
+            Emitter->IsStart[IndexOf(Emitter, Ins->As.Target)] = true;
+        else if (IsBranchOp(Op))
+            Emitter->IsTarget[IndexOf(Emitter, Ins->As.Target)] = true;
+        if (OP_LDRIP == Op)
+            AddCallee(Emitter, IndexOf(Emitter, Ins->As.Target));
+    }
+    Emitter->IsStart[InsCount] = false;
+    U32 Current = 0;
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        if (Emitter->IsStart[i])
+        {
+            Current = i;
+            /* FP is restored after every call */
+            Emitter->Use[i] = FRAME_BITS;
+        }
+        Emitter->Function[i] = Current;
+        Emitter->Use[Current] |= RegistersOf(&Chunk->Decoded.Ins[i]);
+    }
+
+    /* what a call can touch: the callee's registers, and those of everything it calls or falls through to */
+    for (U32 i = 0; i < InsCount; i++)
+        Emitter->Closure[i] = Emitter->Use[i];
+    bool Changed;
+    do {
+        Changed = false;
+        for (U32 i = 0; i < InsCount; i++)
+        {
+            const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+            U32 Function = Emitter->Function[i];
+            U64 Closure = Emitter->Closure[Function];
+            U32 Target = IndexOf(Emitter, Ins->As.Target);
+            if (OP_CALL == PVM_GET_OP(Ins->Opcode) && Target < InsCount)
+                Closure |= Emitter->Closure[Target];
+            else if (OP_CALLPTR == PVM_GET_OP(Ins->Opcode))
+                Closure = ALL_BITS;
+            if (i + 1 < InsCount && Emitter->IsStart[i + 1])
+                Closure |= Emitter->Closure[i + 1];
+            if (IsBranchOp(PVM_GET_OP(Ins->Opcode)) && Target < InsCount)
+                Closure |= Emitter->Closure[Emitter->Function[Target]];
+
+            Changed = Changed || Closure != Emitter->Closure[Function];
+            Emitter->Closure[Function] = Closure;
+        }
+    } while (Changed);
+    /* branches out of a subroutine can't be gotos */
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        if (!IsBranchOp(PVM_GET_OP(Ins->Opcode)))
+            continue;
+        U32 Target = IndexOf(Emitter, Ins->As.Target);
+        if (Target < InsCount && Emitter->Function[Target] != Emitter->Function[i] && !Emitter->IsStart[Target])
+            return false;
+    }
+
+
+    fputs(sPrelude, Emitter->Out);
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        if (Emitter->IsStart[i])
+            fprintf(Emitter->Out, "static int Sub_%u(struct PVMCState *S);\n", i);
+    }
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        if (Emitter->IsStart[i] && !EmitSubroutine(Emitter, i))
+            return false;
+    }
+    fprintf(Emitter->Out, "\nint " CENTRY_NAME "(struct PVMCState *S)\n{\n");
+    EmitLine(Emitter, "return Sub_%u(S);", EntryPoint);
+    fprintf(Emitter->Out, "}\n");
+    return true;
+}
+
+
+
+static bool WriteSource(PVMChunk *Chunk, const char *FileName)
+{
+    FILE *Out = fopen(FileName, "w");
+    if (NULL == Out)
+        return false;
+
+    /* superinstructions are for the interpreter */
+    PVMDecodedIns *EntryPoint = PVMDecodeChunk(Chunk, false);
+    U32 InsCount = Chunk->Decoded.Count;
+    CEmitter Emitter = {
+        .Out = Out,
+        .Chunk = Chunk,
+        .IsStart = MemAllocateArray(bool, InsCount + 1),
+        .IsTarget = MemAllocateArray(bool, InsCount + 1),
+        .Function = MemAllocateArray(U32, InsCount + 1),
+        .Use = MemAllocateArray(U64, InsCount + 1),
+        .Closure = MemAllocateArray(U64, InsCount + 1),
+        .CalleeCount = 0,
+    };
+    bool Ok = EmitProgram(&Emitter, IndexOf(&Emitter, EntryPoint));
+
+    MemDeallocateArray(Emitter.Closure);
+    MemDeallocateArray(Emitter.Use);
+    MemDeallocateArray(Emitter.Function);
+    MemDeallocateArray(Emitter.IsTarget);
+    MemDeallocateArray(Emitter.IsStart);
+    Ok = 0 == fclose(Out) && Ok;
+    return Ok;
+}
+
+
+/* Compiler is PASCAL_CC, split at blanks so that it can carry flags, nothing goes through a shell. 
+ * Returns false and says why if the shared object could not be built */
+static bool RunCompiler(PascalVM *PVM, const char *Compiler, const char *Object, const char *Source)
+{
+    static const char *sFlags[] = { "-std=c99", "-O2", "-fPIC", "-shared", "-w", "-o" };
+    char Words[CMD_MAX], Command[CMD_MAX];
+    char *Argv[MAX_CC_ARGS + STATIC_ARRAY_SIZE(sFlags) + 3];
+    UInt Argc = 0;
+
+    if (NULL == Compiler || (int)sizeof Words <= snprintf(Words, sizeof Words, "%s", Compiler))
+        Words[0] = '\0';
+    for (char *Word = strtok(Words, " \t"); NULL != Word && Argc < MAX_CC_ARGS; Word = strtok(NULL, " \t"))
+        Argv[Argc++] = Word;
+    if (0 == Argc)
+        Argv[Argc++] = "cc";
+    for (UInt i = 0; i < STATIC_ARRAY_SIZE(sFlags); i++)
+        Argv[Argc++] = (char *)sFlags[i];
+    Argv[Argc++] = (char *)Object;
+    Argv[Argc++] = (char *)Source;
+    Argv[Argc] = NULL;
+
+    /* only for the messages below */
+    USize Len = 0;
+    Command[0] = '\0';
+    for (UInt i = 0; i < Argc && Len < sizeof Command; i++)
+        Len += snprintf(Command + Len, sizeof Command - Len, i? " %s" : "%s", Argv[i]);
+
+    pid_t Pid;
+    int Status = 0;
+    int Error = posix_spawnp(&Pid, Argv[0], NULL, NULL, Argv, environ);
+    while (0 == Error && -1 == waitpid(Pid, &Status, 0))
+    {
+        if (EINTR != errno)
+            Error = errno;
+    }
+    /* the program still runs, without the C backend, say why */
+    if (0 != Error)
+    {
+        fprintf(PVM->LogFile, "C backend: \"%s\" could not be run (%s), running without it.\n",
+            Command, strerror(Error)
+        );
+        return false;
+    }
+    if (!WIFEXITED(Status))
+    {
+        fprintf(PVM->LogFile, "C backend: \"%s\" was killed by signal %d, running without it.\n",
+            Command, WTERMSIG(Status)
+        );
+        return false;
+    }
+    if (0 != WEXITSTATUS(Status))
+    {
+        fprintf(PVM->LogFile, "C backend: \"%s\" exited with status %d, running without it.\n",
+            Command, WEXITSTATUS(Status)
+        );
+        return false;
+    }
+    return true;
+}
+
+PVMNativeProgram *PVMCBackendLoad(PascalVM *PVM, PVMChunk *Chunk, const char *OutFileName)
+{
+    PASCAL_NONNULL(PVM);
+    PASCAL_NONNULL(Chunk);
+    PASCAL_NONNULL(OutFileName);
+
+    char Source[PATH_MAX], Object[PATH_MAX];
+    /* dlopen searches the library path for names without a slash */
+    const char *Dir = NULL == strchr(OutFileName, '/') ? "./" : "";
+    if ((int)sizeof Source <= snprintf(Source, sizeof Source, "%s%s.c", Dir, OutFileName)
+    || (int)sizeof Object <= snprintf(Object, sizeof Object, "%s%s.so", Dir, OutFileName))
+    {
+        return NULL;
+    }
+    if (!WriteSource(Chunk, Source))
+        return NULL;
+
+    if (!RunCompiler(PVM, getenv("PASCAL_CC"), Object, Source))
+        return NULL;
+    /* the source is kept when the compiler fails, to see what it failed on */
+    unlink(Source);
+
+    void *Handle = dlopen(Object, RTLD_NOW | RTLD_LOCAL);
+    /* a loaded object stays mapped after it's unlinked */
+    unlink(Object);
+    if (NULL == Handle)
+    {
+        fprintf(PVM->LogFile, "C backend: %s, running without it.\n", dlerror());
+        return NULL;
+    }
+    void *EntryAddr = dlsym(Handle, CENTRY_NAME);
+    if (NULL == EntryAddr)
+    {
+        dlclose(Handle);
+        return NULL;
+    }
+
+    PVMNativeProgram *Program = MemAllocate(sizeof *Program);
+    Program->Handle = Handle;
+    memcpy(&Program->Entry, &EntryAddr, sizeof Program->Entry);
+    return Program;
+}
+
+
+static int CBackendExecute(void *Ctx, uint32_t InsIndex)
+{
+    CExecuteContext *Context = Ctx;
+    return PVMExecuteInstruction(Context->PVM, Context->Chunk, &Context->Chunk->Decoded.Ins[InsIndex]);
+}
+
+typedef struct CGuardedEntry
+{
+    CEntry Entry;
+    struct PVMCState *State;
+    PVMReturnValue ReturnValue;
+} CGuardedEntry;
+
+static void CBackendCallEntry(void *Data)
+{
+    CGuardedEntry *Call = Data;
+    Call->ReturnValue = Call->Entry(Call->State);
+}
+
+PVMReturnValue PVMCBackendRun(PascalVM *PVM, PVMChunk *Chunk, PVMNativeProgram *Program)
+{
+    PASCAL_NONNULL(PVM);
+    PASCAL_NONNULL(Chunk);
+    PASCAL_NONNULL(Program);
+
+    /* same initial state as the interpreter */
+    PVM->R[PVM_REG_FP].Ptr = PVM->Stack.Start;
+    PVM->R[PVM_REG_SP].Ptr.Byte = PVM->Stack.Start.Byte - sizeof(PVMGPR);
+    PVM->R[PVM_REG_GP].Ptr.Raw = Chunk->Global.Data.As.Raw;
+
+    CExecuteContext Context = {
+        .PVM = PVM,
+        .Chunk = Chunk,
+    };
+    struct PVMCState State = {
+        .R = (uint64_t *)PVM->R,
+        .F = PVM->F,
+        .Condition = &PVM->Condition,
+        .ErrorPC = &PVM->Error.PC,
+        .Depth = 0,
+        .MaxDepth = PVM->RetStack.End - PVM->RetStack.Val,
+        .Execute = CBackendExecute,
+        .Ctx = &Context,
+    };
+    CGuardedEntry Call = {
+        .Entry = Program->Entry,
+        .State = &State,
+    };
+    if (!PVMGuardedCall(CBackendCallEntry, &Call, NULL))
+    {
+        /* ran off the stack, the generated code does not keep track of where it is */
+        PVM->Error.PC = Chunk->EntryPoint;
+        Call.ReturnValue = PVM_CALLSTACK_OVERFLOW;
+    }
+    if (PVM_NO_ERROR != Call.ReturnValue)
+        PVMSetErrorLocation(PVM, Chunk, PVM->Error.PC);
+    return Call.ReturnValue;
+}
+
+
+void PVMCBackendUnload(PVMNativeProgram *Program)
+{
+    if (NULL == Program)
+        return;
+    dlclose(Program->Handle);
+    MemDeallocate(Program);
+}
+
+
+
+#undef CMD_MAX
+#undef FRAME_BITS
+#undef ALL_BITS
+#undef C_BIT
+#undef F_BIT
+#undef R_BIT
+#undef CENTRY_NAME
+#undef CSTRFY
+#undef CSTRFY_
+#undef CSTATE_DEFINITION
+
+#else
+
+PVMNativeProgram *PVMCBackendLoad(PascalVM *PVM, PVMChunk *Chunk, const char *OutFileName)
+{
+    UNUSED(PVM, Chunk, OutFileName);
+    return NULL;
+}
+
+PVMReturnValue PVMCBackendRun(PascalVM *PVM, PVMChunk *Chunk, PVMNativeProgram *Program)
+{
+    UNUSED(PVM, Chunk, Program);
+    return PVM_ILLEGAL_INSTRUCTION;
+}
+
+void PVMCBackendUnload(PVMNativeProgram *Program)
+{
+    UNUSED(Program);
+}
+
+#endif /* PVM_CBACKEND_AVAILABLE */
+
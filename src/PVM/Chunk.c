@@ -32,6 +32,11 @@ void ChunkDeinit(PVMChunk *Chunk)
     PASCAL_NONNULL(Chunk);
     MemDeallocateArray(Chunk->Code);
     MemDeallocate(Chunk->Global.Data.As.Raw);
+    if (NULL != Chunk->Decoded.Ins)
+    {
+        MemDeallocateArray(Chunk->Decoded.Ins);
+        MemDeallocateArray(Chunk->Decoded.Index);
+    }
     *Chunk = (PVMChunk){ 0 };
 }
 
@@ -80,6 +85,18 @@ U32 ChunkWriteCode(PVMChunk *Chunk, U16 Opcode)
     return Chunk->Count++;
 }
 
+U32 ChunkWriteOp(PVMChunk *Chunk, U32 Opcode)
+{
+    PASCAL_NONNULL(Chunk);
+    if (PVM_EXT_OF(Opcode))
+    {
+        U32 Addr = ChunkWriteCode(Chunk, PVM_EXT_PREFIX(PVM_EXT_OF(Opcode)));
+        ChunkWriteCode(Chunk, Opcode);
+        return Addr;
+    }
+    return ChunkWriteCode(Chunk, Opcode);
+}
+
 U32 ChunkWriteMovImm(PVMChunk *Chunk, UInt Reg, U64 Imm)
 {
     PASCAL_NONNULL(Chunk);
@@ -87,41 +104,41 @@ U32 ChunkWriteMovImm(PVMChunk *Chunk, UInt Reg, U64 Imm)
     int Count = 0;
     if (IS_SMALL_IMM(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_OP(MOVQI, Reg, Imm));
+        Addr = ChunkWriteOp(Chunk, PVM_OP(MOVQI, Reg, Imm));
     }
     else if (IN_I16(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, I16));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, I16));
         Count = 1;
     }
     else if (IN_U16(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, U16));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, U16));
         Count = 1;
     }
     else if (IN_I32(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, I32));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, I32));
         Count = 2;
     }
     else if (IN_U32(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, U32));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, U32));
         Count = 2;
     }
     else if (IN_I48(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, I48));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, I48));
         Count = 3;
     }
     else if (IN_U48(Imm))
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, U48));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, U48));
         Count = 3;
     }
     else 
     {
-        Addr = ChunkWriteCode(Chunk, PVM_MOVI(Reg, U64));
+        Addr = ChunkWriteOp(Chunk, PVM_MOVI(Reg, U64));
         Count = 4;
     }
 
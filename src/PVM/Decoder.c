@@ -0,0 +1,353 @@
+
+
+#include "Common.h"
+#include "Memory.h"
+#include "PVM/Decoder.h"
+
+
+
+typedef struct ImmInfo 
+{
+    UInt Count;     /* in halfwords */
+    UInt SexIndex;  /* Sign EXtend, 0 if unsigned */
+} ImmInfo;
+
+
+static ImmInfo GetImmInfo(PVMImmType ImmType)
+{
+    ImmInfo Info = { 0 };
+    switch (ImmType)
+    {
+    case IMMTYPE_I16: Info.SexIndex = 15; FALLTHROUGH;
+    case IMMTYPE_U16: Info.Count = 1; break;
+    case IMMTYPE_I32: Info.SexIndex = 31; FALLTHROUGH;
+    case IMMTYPE_U32: Info.Count = 2; break;
+    case IMMTYPE_I48: Info.SexIndex = 47; FALLTHROUGH;
+    case IMMTYPE_U48: Info.Count = 3; break;
+    case IMMTYPE_U64: Info.Count = 4; break;
+    }
+    return Info;
+}
+
+static U64 ReadImm(const U16 *Code, ImmInfo Info)
+{
+    U64 Imm = 0;
+    for (UInt i = 0; i < Info.Count; i++)
+    {
+        Imm |= (U64)Code[i] << i*16;
+    }
+    if (Info.SexIndex)
+        Imm = BitSex64(Imm, Info.SexIndex);
+    return Imm;
+}
+
+
+/* size of the instruction at Addr in halfwords */
+static U32 InsSize(const U16 *Code, U32 Addr)
+{
+    U16 Opcode = Code[Addr];
+    if (OP_EXT == PVM_GET_OP(Opcode))
+        return 1 + InsSize(Code, Addr + 1);
+    if (PVMIsCompareAndBranch(PVM_GET_OP(Opcode)))
+        return PVM_CMP_BRANCH_INS_SIZE;
+    if (PVMIsThreeOperand(PVM_GET_OP(Opcode)))
+        return 2;
+    switch (PVM_GET_OP(Opcode))
+    {
+    case OP_SYS: return OP_SYS_ENTER == PVM_GET_SYS_OP(Opcode) ? 3 : 1;
+
+    case OP_ADDI:
+    case OP_ADDI64:
+    case OP_MOVI:
+    case OP_LDRIP:
+        return 1 + GetImmInfo(PVM_GET_IMMTYPE(Opcode)).Count;
+
+    case OP_BR:
+    case OP_CALL:
+    case OP_BCT:
+    case OP_BCF:
+    case OP_BEZ:
+    case OP_BNZ:
+    case OP_BRI:
+    case OP_VMEMCPY:
+    case OP_VMEMEQU:
+        return 2;
+
+    case OP_MEMCPY: return 3;
+
+    case OP_LD32: case OP_LD64:
+    case OP_LDZEX32_8: case OP_LDZEX32_16:
+    case OP_LDZEX64_8: case OP_LDZEX64_16: case OP_LDZEX64_32:
+    case OP_LDSEX32_8: case OP_LDSEX32_16:
+    case OP_LDSEX64_8: case OP_LDSEX64_16: case OP_LDSEX64_32:
+    case OP_LEA:
+    case OP_ST8: case OP_ST16: case OP_ST32: case OP_ST64:
+    case OP_LDF32: case OP_STF32: case OP_LDF64: case OP_STF64:
+        return 2;
+
+    case OP_LD32L: case OP_LD64L:
+    case OP_LDZEX32_8L: case OP_LDZEX32_16L:
+    case OP_LDZEX64_8L: case OP_LDZEX64_16L: case OP_LDZEX64_32L:
+    case OP_LDSEX32_8L: case OP_LDSEX32_16L:
+    case OP_LDSEX64_8L: case OP_LDSEX64_16L: case OP_LDSEX64_32L:
+    case OP_LEAL:
+    case OP_ST8L: case OP_ST16L: case OP_ST32L: case OP_ST64L:
+    case OP_LDF32L: case OP_STF32L: case OP_LDF64L: case OP_STF64L:
+        return 3;
+
+    default: return 1;
+    }
+}
+
+
+PVMDecodedIns *PVMDecodedInsAt(const PVMChunk *Chunk, U32 StreamOffset)
+{
+    PASCAL_NONNULL(Chunk);
+    if (StreamOffset >= Chunk->Count)
+        return &Chunk->Decoded.Ins[Chunk->Decoded.Count];
+    return &Chunk->Decoded.Ins[Chunk->Decoded.Index[StreamOffset]];
+}
+
+
+/* Code is the instruction after its OP_EXT prefix, Ext is the prefix's bits */
+static void DecodeOperands(PVMChunk *Chunk, PVMDecodedIns *Ins, const U16 *Code, UInt Ext)
+{
+    U16 Opcode = Code[0];
+    UInt ExtRt = (Ext & PVM_EXT_T)? PVM_EXT_REG : 0;
+    U32 Next = Ins->StreamOffset + InsSize(Chunk->Code, Ins->StreamOffset);
+    if (PVMIsCompareAndBranch(PVM_GET_OP(Opcode)))
+    {
+        /* Rs stays as is, the QI versions sign extend it themselves like bri */
+        I32 Offset = ReadImm(Code + 1, GetImmInfo(IMMTYPE_I32));
+        Ins->As.Target = PVMDecodedInsAt(Chunk, Next + Offset);
+        return;
+    }
+    if (PVMIsThreeOperand(PVM_GET_OP(Opcode)))
+    {
+        Ins->As.Imm = PVM_GET_RT(Code[1]) + ExtRt;
+        return;
+    }
+    switch (PVM_GET_OP(Opcode))
+    {
+    case OP_SYS:
+    {
+        if (OP_SYS_ENTER == PVM_GET_SYS_OP(Opcode))
+            Ins->As.Imm = ReadImm(Code + 1, GetImmInfo(IMMTYPE_U32));
+    } break;
+
+    case OP_ADDI:
+    case OP_ADDI64:
+    case OP_MOVI:
+    {
+        Ins->As.Imm = ReadImm(Code + 1, GetImmInfo(PVM_GET_IMMTYPE(Opcode)));
+    } break;
+    case OP_ADDQI:
+    case OP_ADDQI64:
+    case OP_MOVQI:
+    {
+        Ins->As.SImm = BitSex64(PVM_GET_RS(Opcode), 3);
+    } break;
+
+    case OP_LDRIP:
+    {
+        I64 Offset = ReadImm(Code + 1, GetImmInfo(PVM_GET_IMMTYPE(Opcode)));
+        Ins->As.Target = PVMDecodedInsAt(Chunk, Next + Offset);
+    } break;
+    case OP_CALLPTR:
+    {
+        /* empty inline cache */
+        Ins->As.Target = NULL;
+        Ins->Rs = 0;
+    } break;
+    case OP_BR:
+    case OP_CALL:
+    case OP_BCT:
+    case OP_BCF:
+    {
+        I32 Offset = BitSex32Safe(((U32)Code[1] << 8) | ((U32)Opcode & 0xFF), 23);
+        Ins->As.Target = PVMDecodedInsAt(Chunk, Next + Offset);
+    } break;
+    case OP_BEZ:
+    case OP_BNZ:
+    {
+        I32 Offset = BitSex32Safe(((U32)Code[1] << 4) | ((U32)Opcode & 0xF), 19);
+        Ins->As.Target = PVMDecodedInsAt(Chunk, Next + Offset);
+    } break;
+    case OP_BRI:
+    {
+        I32 Offset = (I16)Code[1];
+        Ins->As.Target = PVMDecodedInsAt(Chunk, Next + Offset);
+    } break;
+
+    case OP_MEMCPY:
+    {
+        Ins->As.Imm = ReadImm(Code + 1, GetImmInfo(IMMTYPE_U32));
+    } break;
+    case OP_VMEMCPY:
+    case OP_VMEMEQU:
+    {
+        /* size register */
+        Ins->As.Imm = PVM_GET_RD(Code[1]) + ExtRt;
+    } break;
+
+    case OP_PSHL: case OP_POPL: 
+    case OP_FPSHL: case OP_FPOPL: 
+    case OP_PSHH: case OP_POPH:
+    case OP_FPSHH: case OP_FPOPH:
+    {
+        /* Rd is the register of the list's first bit */
+        PVMOp Op = PVM_GET_OP(Opcode);
+        bool IsHigh = OP_PSHH == Op || OP_POPH == Op || OP_FPSHH == Op || OP_FPOPH == Op;
+        Ins->As.Imm = PVM_GET_REGLIST(Opcode);
+        Ins->Rd = (IsHigh? 8 : 0) + ((Ext & PVM_EXT_S)? PVM_EXT_REG : 0);
+        Ins->Rs = 0;
+    } break;
+
+    default:
+    {
+        /* memory offsets, the prefix does not count */
+        U32 Size = InsSize(Chunk->Code, Code - Chunk->Code);
+        if (Size == 2)
+            Ins->As.Imm = ReadImm(Code + 1, GetImmInfo(IMMTYPE_I16));
+        else if (Size == 3)
+            Ins->As.Imm = ReadImm(Code + 1, GetImmInfo(IMMTYPE_I32));
+    } break;
+    }
+}
+
+
+/* in PVMFusedOp order */
+static const struct {
+    U8 First, Second, Fused;
+} sFusedOps[] = {
+#define PVM_FUSE(First, Second) { OP_ ## First, OP_ ## Second, OP_ ## First ## _ ## Second },
+    PVM_FUSED_OPS(PVM_FUSE)
+#undef PVM_FUSE
+};
+
+static void FuseInstructions(PVMChunk *Chunk)
+{
+    /* the second instruction is left as is, 
+     * so branching to it or returning to it still works. 
+     * Pairs don't overlap: in ld, ld, islt, bcf we want ld_ld and islt_bcf */
+    for (U32 i = 0; i + 1 < Chunk->Decoded.Count; i++)
+    {
+        PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        PVMOp First = PVM_GET_OP(Ins[0].Opcode);
+        PVMOp Second = PVM_GET_OP(Ins[1].Opcode);
+        for (UInt k = 0; k < STATIC_ARRAY_SIZE(sFusedOps); k++)
+        {
+            if (sFusedOps[k].First == First && sFusedOps[k].Second == Second)
+            {
+                Ins->Opcode = ((U16)sFusedOps[k].Fused << 8) | (Ins->Opcode & 0xFF);
+                i++;
+                break;
+            }
+        }
+    }
+}
+
+
+PVMDecodedIns *PVMDecodeChunk(PVMChunk *Chunk, bool Fuse)
+{
+    PASCAL_NONNULL(Chunk);
+
+    /* find where every instruction starts */
+    U32 IndexCount = Chunk->Count + 1;
+    if (Chunk->Decoded.IndexCap < IndexCount)
+    {
+        MemDeallocateArray(Chunk->Decoded.Index);
+        Chunk->Decoded.IndexCap = IndexCount;
+        Chunk->Decoded.Index = MemAllocateArray(*Chunk->Decoded.Index, IndexCount);
+    }
+    U32 InsCount = 0;
+    U32 Addr = 0;
+    while (Addr < Chunk->Count)
+    {
+        U32 Size = InsSize(Chunk->Code, Addr);
+        for (U32 i = 0; i < Size && Addr + i < IndexCount; i++)
+        {
+            /* middle of an instruction, patched below */
+            Chunk->Decoded.Index[Addr + i] = UINT32_MAX;
+        }
+        Chunk->Decoded.Index[Addr] = InsCount++;
+        Addr += Size;
+    }
+    Chunk->Decoded.Index[Chunk->Count] = InsCount;
+    for (U32 i = 0; i < Chunk->Count; i++)
+    {
+        if (UINT32_MAX == Chunk->Decoded.Index[i])
+            Chunk->Decoded.Index[i] = InsCount;
+    }
+
+
+    /* +1 for the trailing illegal instruction */
+    if (Chunk->Decoded.Cap < InsCount + 1)
+    {
+        MemDeallocateArray(Chunk->Decoded.Ins);
+        Chunk->Decoded.Cap = InsCount + 1;
+        Chunk->Decoded.Ins = MemAllocateArray(*Chunk->Decoded.Ins, InsCount + 1);
+    }
+    Chunk->Decoded.Count = InsCount;
+
+
+    /* decode */
+    PVMDecodedIns *Ins = Chunk->Decoded.Ins;
+    Addr = 0;
+    while (Addr < Chunk->Count)
+    {
+        /* the prefix is not an instruction of its own */
+        U32 OpcodeAddr = Addr;
+        UInt Ext = 0;
+        if (OP_EXT == PVM_GET_OP(Chunk->Code[Addr]) && Addr + 1 < Chunk->Count)
+        {
+            Ext = PVM_GET_EXT(Chunk->Code[Addr]);
+            OpcodeAddr++;
+        }
+
+        U16 Opcode = Chunk->Code[OpcodeAddr];
+        *Ins = (PVMDecodedIns) {
+            .StreamOffset = Addr,
+            .Opcode = Opcode,
+            .Rd = PVM_GET_RD(Opcode) + ((Ext & PVM_EXT_D)? PVM_EXT_REG : 0),
+            .Rs = PVM_GET_RS(Opcode) + ((Ext & PVM_EXT_S)? PVM_EXT_REG : 0),
+        };
+        DecodeOperands(Chunk, Ins, &Chunk->Code[OpcodeAddr], Ext);
+        Addr += InsSize(Chunk->Code, Addr);
+        Ins++;
+    }
+    /* 0xFF is not an opcode */
+    *Ins = (PVMDecodedIns) {
+        .StreamOffset = Chunk->Count,
+        .Opcode = 0xFFFF,
+    };
+
+    if (Fuse)
+        FuseInstructions(Chunk);
+    return PVMDecodedInsAt(Chunk, Chunk->EntryPoint);
+}
+
+
+U32 PVMInstructionSize(const U16 *Code, U32 Addr)
+{
+    return InsSize(Code, Addr);
+}
+
+bool PVMIsCompareAndBranch(PVMOp Op)
+{
+    return OP_BEQ <= Op && Op <= OP_FBNLE64;
+}
+
+bool PVMIsThreeOperand(PVMOp Op)
+{
+    return OP_ADD3 <= Op && Op <= OP_FDIV3_64;
+}
+
+PVMOp PVMDecodedOp(const PVMDecodedIns *Ins)
+{
+    UInt Op = PVM_GET_OP(Ins->Opcode);
+    if (OP_FUSED_BASE < Op && Op < OP_FUSED_END)
+        return sFusedOps[Op - OP_FUSED_BASE - 1].First;
+    return Op;
+}
+
@@ -9,13 +9,127 @@ static const char *sIntReg[PVM_REG_COUNT] = {
     [PVM_REG_GP] = "rgp", 
     [PVM_REG_FP] = "rfp",
     [PVM_REG_SP] = "rsp", 
+    "r16", "r17", "r18", "r19", "r20", "r21", "r22", "r23", 
+    "r24", "r25", "r26", "r27", "r28", "r29", "r30", "r31",
 };
 
 static const char *sFltReg[PVM_FREG_COUNT] = {
     "f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7", 
     "f8", "f9", "f10", "f11", "f12", "f13", "f14", "f15",
+    "f16", "f17", "f18", "f19", "f20", "f21", "f22", "f23", 
+    "f24", "f25", "f26", "f27", "f28", "f29", "f30", "f31",
 };
 
+/* indexed by PVMOp, the names the disassembler prints */
+static const char *sMnemonic[] = {
+    [OP_SADD] = "sadd", [OP_ADD] = "add", [OP_SUB] = "sub", [OP_MUL] = "mul", [OP_IMUL] = "imul",
+    [OP_DIV] = "div", [OP_IDIV] = "idiv", [OP_MOD] = "mod", [OP_NEG] = "neg", [OP_NOT] = "not",
+    [OP_AND] = "and", [OP_OR] = "or", [OP_XOR] = "xor", [OP_VSHL] = "vshl", [OP_VSHR] = "vshr",
+    [OP_VASR] = "vasr", [OP_QSHL] = "qshl", [OP_QSHR] = "qshr", [OP_QASR] = "qasr",
+
+    [OP_ADDI] = "addi", [OP_ADDQI] = "addqi",
+
+    [OP_BEZ] = "bez", [OP_BNZ] = "bnz", [OP_BR] = "br", [OP_CALL] = "call", [OP_CALLPTR] = "callptr",
+    [OP_BCT] = "bct", [OP_BCF] = "bcf", [OP_BRI] = "bri", [OP_LDRIP] = "ldra",
+
+    [OP_STRLT] = "strlt", [OP_STREQ] = "streq", [OP_STRCPY] = "strcpy", [OP_MEMCPY] = "memcpy",
+    [OP_VMEMCPY] = "vmemcpy", [OP_VMEMEQU] = "vmemequ",
+
+    [OP_SEQ] = "seq", [OP_SLT] = "slt", [OP_ISLT] = "islt", [OP_SETEZ] = "setez",
+
+    [OP_PSHL] = "pshl", [OP_PSHH] = "pshh", [OP_POPL] = "popl", [OP_POPH] = "poph", [OP_FPSHL] = "fpshl",
+    [OP_FPSHH] = "fpshh", [OP_FPOPL] = "fpopl", [OP_FPOPH] = "fpoph",
+
+    [OP_LD32] = "ld32", [OP_LD64] = "ld64", [OP_LDZEX32_8] = "ldzex32_8", [OP_LDZEX32_16] = "ldzex32_16",
+    [OP_LDZEX64_8] = "ldzex64_8", [OP_LDZEX64_16] = "ldzex64_16", [OP_LDZEX64_32] = "ldzex64_32",
+    [OP_LDSEX32_8] = "ldsex32_8", [OP_LDSEX32_16] = "ldsex32_16", [OP_LDSEX64_8] = "ldsex64_8",
+    [OP_LDSEX64_16] = "ldsex64_16", [OP_LDSEX64_32] = "ldsex64_32",
+
+    [OP_LD32L] = "ld32l", [OP_LD64L] = "ld64l", [OP_LDZEX32_8L] = "ldzex32_8l",
+    [OP_LDZEX32_16L] = "ldzex32_16l", [OP_LDZEX64_8L] = "ldzex64_8l", [OP_LDZEX64_16L] = "ldzex64_16l",
+    [OP_LDZEX64_32L] = "ldzex64_32l", [OP_LDSEX32_8L] = "ldsex32_8l", [OP_LDSEX32_16L] = "ldsex32_16l",
+    [OP_LDSEX64_8L] = "ldsex64_8l", [OP_LDSEX64_16L] = "ldsex64_16l", [OP_LDSEX64_32L] = "ldsex64_32l",
+
+    [OP_LEA] = "lea", [OP_LEAL] = "leal",
+
+    [OP_ST64] = "st64", [OP_ST32] = "st32", [OP_ST16] = "st16", [OP_ST8] = "st8", [OP_ST64L] = "st64l",
+    [OP_ST32L] = "st32l", [OP_ST16L] = "st16l", [OP_ST8L] = "st8l",
+
+    [OP_LDF32] = "ldf32", [OP_STF32] = "stf32", [OP_LDF32L] = "ldf32l", [OP_STF32L] = "stf32l",
+
+    [OP_LDF64] = "ldf64", [OP_STF64] = "stf64", [OP_LDF64L] = "ldf64l", [OP_STF64L] = "stf64l",
+
+    [OP_FADD] = "fadd", [OP_FSUB] = "fsub", [OP_FDIV] = "fdiv", [OP_FMUL] = "fmul", [OP_FNEG] = "fneg",
+    [OP_FSEQ] = "fseq", [OP_FSLT] = "fslt", [OP_FSGT] = "fsgt", [OP_FSNE] = "fsne", [OP_FSLE] = "fsle",
+    [OP_FSGE] = "fsge",
+
+    [OP_FADD64] = "fadd64", [OP_FSUB64] = "fsub64", [OP_FDIV64] = "fdiv64", [OP_FMUL64] = "fmul64",
+    [OP_FNEG64] = "fneg64", [OP_FSEQ64] = "fseq64", [OP_FSLT64] = "fslt64", [OP_FSGT64] = "fsgt64",
+    [OP_FSNE64] = "fsne64", [OP_FSLE64] = "fsle64", [OP_FSGE64] = "fsge64",
+
+    [OP_GETFLAG] = "getflag", [OP_GETNFLAG] = "getnflag", [OP_SETFLAG] = "setflag", [OP_SETNFLAG] = "setnflag",
+    [OP_NEGFLAG] = "negflag",
+
+    [OP_MOV32] = "mov32", [OP_MOVZEX32_8] = "movzex32_8", [OP_MOVZEX32_16] = "movzex32_16",
+    [OP_MOV64] = "mov64", [OP_MOVZEX64_8] = "movzex64_8", [OP_MOVZEX64_16] = "movzex64_16",
+    [OP_MOVZEX64_32] = "movzex64_32", [OP_MOVSEX64_32] = "movsex64_32",
+
+    [OP_FMOV] = "fmov", [OP_FMOV64] = "fmov64", [OP_MOVI] = "movi", [OP_MOVQI] = "movqi",
+
+    [OP_F64TOF32] = "f64tof32", [OP_F32TOF64] = "f32tof64", [OP_F64TOI64] = "f64toi64",
+    [OP_I64TOF32] = "i64tof32", [OP_I64TOF64] = "i64tof64", [OP_U64TOF64] = "u64tof64",
+    [OP_U64TOF32] = "u64tof32", [OP_I32TOF32] = "i32tof32", [OP_I32TOF64] = "i32tof64",
+    [OP_U32TOF64] = "u32tof64", [OP_U32TOF32] = "u32tof32",
+
+    [OP_ADD64] = "add64", [OP_SUB64] = "sub64", [OP_MUL64] = "mul64", [OP_IMUL64] = "imul64",
+    [OP_DIV64] = "div64", [OP_IDIV64] = "idiv64", [OP_MOD64] = "mod64", [OP_NEG64] = "neg64",
+    [OP_NOT64] = "not64", [OP_AND64] = "and64", [OP_OR64] = "or64", [OP_XOR64] = "xor64",
+    [OP_VSHL64] = "vshl64", [OP_VSHR64] = "vshr64", [OP_VASR64] = "vasr64", [OP_QSHL64] = "qshl",
+    [OP_QSHR64] = "qshr", [OP_QASR64] = "qasr", [OP_ADDI64] = "addi64", [OP_ADDQI64] = "addqi64",
+
+    [OP_SEQ64] = "seq64", [OP_SLT64] = "slt64", [OP_ISLT64] = "islt64", [OP_SETEZ64] = "setez64",
+
+    [OP_BEQ] = "beq", [OP_BNE] = "bne", [OP_BLT] = "blt", [OP_BGE] = "bge", [OP_IBLT] = "iblt",
+    [OP_IBGE] = "ibge", [OP_BEQ64] = "beq64", [OP_BNE64] = "bne64", [OP_BLT64] = "blt64", [OP_BGE64] = "bge64",
+    [OP_IBLT64] = "iblt64", [OP_IBGE64] = "ibge64",
+
+    [OP_BEQQI] = "beqqi", [OP_BNEQI] = "bneqi", [OP_BLTQI] = "bltqi", [OP_BGEQI] = "bgeqi",
+    [OP_IBLTQI] = "ibltqi", [OP_IBGEQI] = "ibgeqi", [OP_BEQQI64] = "beqqi64", [OP_BNEQI64] = "bneqi64",
+    [OP_BLTQI64] = "bltqi64", [OP_BGEQI64] = "bgeqi64", [OP_IBLTQI64] = "ibltqi64", [OP_IBGEQI64] = "ibgeqi64",
+
+    [OP_FBEQ] = "fbeq", [OP_FBNE] = "fbne", [OP_FBLT] = "fblt", [OP_FBNLT] = "fbnlt", [OP_FBLE] = "fble",
+    [OP_FBNLE] = "fbnle", [OP_FBEQ64] = "fbeq64", [OP_FBNE64] = "fbne64", [OP_FBLT64] = "fblt64",
+    [OP_FBNLT64] = "fbnlt64", [OP_FBLE64] = "fble64", [OP_FBNLE64] = "fbnle64",
+
+    [OP_ADD3] = "add3", [OP_SUB3] = "sub3", [OP_MUL3] = "mul3", [OP_IMUL3] = "imul3", [OP_DIV3] = "div3",
+    [OP_IDIV3] = "idiv3", [OP_MOD3] = "mod3", [OP_AND3] = "and3", [OP_OR3] = "or3", [OP_XOR3] = "xor3",
+    [OP_VSHL3] = "vshl3", [OP_VSHR3] = "vshr3", [OP_VASR3] = "vasr3", [OP_ADD3_64] = "add3_64",
+    [OP_SUB3_64] = "sub3_64", [OP_MUL3_64] = "mul3_64", [OP_IMUL3_64] = "imul3_64", [OP_DIV3_64] = "div3_64",
+    [OP_IDIV3_64] = "idiv3_64", [OP_MOD3_64] = "mod3_64", [OP_AND3_64] = "and3_64", [OP_OR3_64] = "or3_64",
+    [OP_XOR3_64] = "xor3_64", [OP_VSHL3_64] = "vshl3_64", [OP_VSHR3_64] = "vshr3_64",
+    [OP_VASR3_64] = "vasr3_64", [OP_FADD3] = "fadd3", [OP_FSUB3] = "fsub3", [OP_FMUL3] = "fmul3",
+    [OP_FDIV3] = "fdiv3", [OP_FADD3_64] = "fadd3_64", [OP_FSUB3_64] = "fsub3_64", [OP_FMUL3_64] = "fmul3_64",
+    [OP_FDIV3_64] = "fdiv3_64",
+
+    [OP_EXT] = "ext",
+};
+
+/* indexed by PVMSysOp */
+static const char *sSysMnemonic[] = {
+    [OP_SYS_EXIT] = "exit", [OP_SYS_ENTER] = "enter", [OP_SYS_WRITE] = "write", [OP_SYS_READ] = "read",
+    [OP_SYS_READLN] = "readln", [OP_SYS_ASSIGN] = "assign", [OP_SYS_RESET] = "reset",
+    [OP_SYS_REWRITE] = "rewrite", [OP_SYS_CLOSE] = "close", [OP_SYS_WRITE_FILE] = "fwrite",
+    [OP_SYS_READ_FILE] = "fread", [OP_SYS_READLN_FILE] = "freadln", [OP_SYS_EOF] = "eof",
+    [OP_SYS_EOLN] = "eoln", [OP_SYS_WRITE_RECORD] = "rwrite", [OP_SYS_READ_RECORD] = "rread",
+    [OP_SYS_SEEK] = "seek", [OP_SYS_FILESIZE] = "filesize", [OP_SYS_FILEPOS] = "filepos",
+};
+
+/* bits of the OP_EXT prefix of the instruction being disassembled */
+static UInt sExt = 0;
+#define EXT_RD(Opcode) (PVM_GET_RD(Opcode) + ((sExt & PVM_EXT_D)? PVM_EXT_REG : 0))
+#define EXT_RS(Opcode) (PVM_GET_RS(Opcode) + ((sExt & PVM_EXT_S)? PVM_EXT_REG : 0))
+#define EXT_RT(SecondHalf) (PVM_GET_RT(SecondHalf) + ((sExt & PVM_EXT_T)? PVM_EXT_REG : 0))
+
 static const UInt sBytesPerLine = 4;
 static const UInt sAddrPad = 9;
 static const UInt sMnemonicPad = 13;
@@ -29,6 +143,18 @@ typedef struct ImmediateInfo
 } ImmediateInfo;
 
 
+const char *PVMMnemonic(U16 Opcode)
+{
+    UInt Op = PVM_GET_OP(Opcode);
+    const char *Mnemonic = NULL;
+    if (OP_SYS == Op && PVM_GET_SYS_OP(Opcode) < STATIC_ARRAY_SIZE(sSysMnemonic))
+        Mnemonic = sSysMnemonic[PVM_GET_SYS_OP(Opcode)];
+    else if (OP_SYS != Op && Op < STATIC_ARRAY_SIZE(sMnemonic))
+        Mnemonic = sMnemonic[Op];
+    return NULL == Mnemonic ? "???" : Mnemonic;
+}
+
+
 void PVMDisasm(FILE *f, const PVMChunk *Chunk, const char *Name)
 {
     const char *Fmt = "=====================";
@@ -89,8 +215,8 @@ static void PrintComment(FILE *f, int Pad, const char *Fmt, ...)
 
 static void DisasmRdRs(FILE *f, const char *Mnemonic, const char *RegSet[], U16 Opcode)
 {
-    const char *Rd = RegSet[PVM_GET_RD(Opcode)];
-    const char *Rs = RegSet[PVM_GET_RS(Opcode)];
+    const char *Rd = RegSet[EXT_RD(Opcode)];
+    const char *Rs = RegSet[EXT_RS(Opcode)];
 
     int Pad = Print2Bytes(f, Opcode);
     PrintPaddedMnemonic(f, Pad, Mnemonic);
@@ -99,8 +225,8 @@ static void DisasmRdRs(FILE *f, const char *Mnemonic, const char *RegSet[], U16
 
 static void DisasmInter(FILE *f, const char *Mnemonic, const char **RdSet, const char **RsSet, U16 Opcode)
 {
-    const char *Rd = RdSet[PVM_GET_RD(Opcode)];
-    const char *Rs = RsSet[PVM_GET_RS(Opcode)];
+    const char *Rd = RdSet[EXT_RD(Opcode)];
+    const char *Rs = RsSet[EXT_RS(Opcode)];
 
     int Pad = Print2Bytes(f, Opcode);
     PrintPaddedMnemonic(f, Pad, Mnemonic);
@@ -109,8 +235,8 @@ static void DisasmInter(FILE *f, const char *Mnemonic, const char **RdSet, const
 
 static void DisasmFscc(FILE *f, const char *Mnemonic, U16 Opcode)
 {
-    const char *Fd = sFltReg[PVM_GET_RD(Opcode)];
-    const char *Fs = sFltReg[PVM_GET_RS(Opcode)];
+    const char *Fd = sFltReg[EXT_RD(Opcode)];
+    const char *Fs = sFltReg[EXT_RS(Opcode)];
 
     int Pad = Print2Bytes(f, Opcode);
     PrintPaddedMnemonic(f, Pad, Mnemonic);
@@ -119,7 +245,7 @@ static void DisasmFscc(FILE *f, const char *Mnemonic, U16 Opcode)
 
 static U32 DisasmBcc(FILE *f, const char *Mnemonic, U16 Opcode, const PVMChunk *Chunk, U32 Addr)
 {
-    const char *Rd = sIntReg[PVM_GET_RD(Opcode)];
+    const char *Rd = sIntReg[EXT_RD(Opcode)];
     I32 BrOffset = BitSex32Safe(
             ((U32)(Opcode & 0xF)) | ((U32)Chunk->Code[Addr + 1] << 4), 
             19
@@ -175,7 +301,7 @@ static U32 DisasmBri(FILE *f, const char *Mnemonic, U16 Opcode, const PVMChunk *
     const LineDebugInfo *Info = ChunkGetConstDebugInfo(Chunk, Location);
 
     PrintPaddedMnemonic(f, Pad, Mnemonic);
-    Pad = fprintf(f, "%s, [%u]", sIntReg[PVM_GET_RD(Opcode)], Location);
+    Pad = fprintf(f, "%s, [%u]", sIntReg[EXT_RD(Opcode)], Location);
     if (NULL != Info)
     {
         PrintComment(f, Pad, "line %d: '%.*s'\n", Info->Line[0], Info->SrcLen[0], Info->Src[0]);
@@ -188,6 +314,35 @@ static U32 DisasmBri(FILE *f, const char *Mnemonic, U16 Opcode, const PVMChunk *
 }
 
 
+/* 0xCCDS 0xIIII 0xIIII, S is a register or a small immediate */
+static U32 DisasmCmpBr(FILE *f, const char *Mnemonic, const char *RegSet[], bool SmallImm, 
+        U16 Opcode, const PVMChunk *Chunk, U32 Addr)
+{
+    I32 BrOffset = (U32)Chunk->Code[Addr + 1] | ((U32)Chunk->Code[Addr + 2] << 16);
+
+    int Pad = Print2Bytes(f, Opcode);
+    Pad += Print2Bytes(f, Chunk->Code[Addr + 1]);
+    Addr += 3;
+    PrintPaddedMnemonic(f, Pad, Mnemonic);
+    if (SmallImm)
+    {
+        fprintf(f, "%s, %d, [%u]", 
+            RegSet[EXT_RD(Opcode)], BIT_SEX32(PVM_GET_RS(Opcode), 3), 2*(Addr + BrOffset)
+        );
+    }
+    else 
+    {
+        fprintf(f, "%s, %s, [%u]", 
+            RegSet[EXT_RD(Opcode)], RegSet[EXT_RS(Opcode)], 2*(Addr + BrOffset)
+        );
+    }
+    fprintf(f, "\n%*s  ", sAddrPad, "");
+    Print2Bytes(f, Chunk->Code[Addr - 1]);
+    fputc('\n', f);
+    return Addr;
+}
+
+
 static void DisasmMnemonic(FILE *f, const char *Mnemonic, U16 Opcode)
 {
     int Pad = Print2Bytes(f, Opcode);
@@ -241,12 +396,15 @@ static void PrintRegList(char *Buffer, USize BufSize,
 }
 
 
-static void DisasmRegList(FILE *f, const char *Mnemonic, U16 Opcode, const char **Registers)
+/* Base is the register of bit 0 without the prefix */
+static void DisasmRegList(FILE *f, const char *Mnemonic, U16 Opcode, const char **Registers, UInt Base)
 {
     char RegisterListStr[256] = { 0 };
+    if (sExt & PVM_EXT_S)
+        Base += PVM_EXT_REG;
     PrintRegList(RegisterListStr, sizeof RegisterListStr, 
-            PVM_GET_REGLIST(Opcode), 0, PVM_REG_COUNT / 2,
-            Registers
+            PVM_GET_REGLIST(Opcode), 0, 8,
+            &Registers[Base]
     );
 
     int Pad = Print2Bytes(f, Opcode);
@@ -311,7 +469,7 @@ static U32 DisasmRdImm(FILE *f, const char *Mnemonic, const PVMChunk *Chunk, U32
     );
 
     /* display instruction */
-    const char *Rd = sIntReg[PVM_GET_RD(Opcode)];
+    const char *Rd = sIntReg[EXT_RD(Opcode)];
     int Pad = Print2Bytes(f, Opcode);
     Pad += Print2Bytes(f, Info.Imm & 0xFFFF);
 
@@ -328,8 +486,8 @@ static U32 DisasmMem(FILE *f,
 {
     ImmediateInfo Info = GetImmFromImmType(Chunk, Addr + 1, ImmType);
 
-    const char *Rd = RegSet[PVM_GET_RD(Opcode)];
-    const char *Rs = sIntReg[PVM_GET_RS(Opcode)];
+    const char *Rd = RegSet[EXT_RD(Opcode)];
+    const char *Rs = sIntReg[EXT_RS(Opcode)];
     int Pad = Print2Bytes(f, Opcode);
     Pad += Print2Bytes(f, Info.Imm & 0xFFFF);
 
@@ -342,7 +500,7 @@ static U32 DisasmMem(FILE *f,
 
 static void DisasmRdSmallImm(FILE *f, const char *Mnemonic, U16 Opcode, bool IsSigned)
 {
-    const char *Rd = sIntReg[PVM_GET_RD(Opcode)];
+    const char *Rd = sIntReg[EXT_RD(Opcode)];
     int Pad = Print2Bytes(f, Opcode);
     PrintPaddedMnemonic(f, Pad, Mnemonic);
     if (IsSigned)
@@ -364,7 +522,7 @@ static U32 DisasmRdRsImm32(FILE *f, const char *Mnemonic, U16 Opcode, const PVMC
     PrintPaddedMnemonic(f, Pad, Mnemonic);
 
     fprintf(f, "%s, %s, %u", 
-            sIntReg[PVM_GET_RD(Opcode)], sIntReg[PVM_GET_RS(Opcode)], (U32)Info.Imm
+            sIntReg[EXT_RD(Opcode)], sIntReg[EXT_RS(Opcode)], (U32)Info.Imm
     );
     PrintImmBytes(f, Info);
     return Info.Addr;
@@ -372,18 +530,18 @@ static U32 DisasmRdRsImm32(FILE *f, const char *Mnemonic, U16 Opcode, const PVMC
 
 static void DisasmSingleOperand(FILE *f, const char *Mnemonic, U16 Opcode)
 {
-    const char *Rd = sIntReg[PVM_GET_RD(Opcode)];
+    const char *Rd = sIntReg[EXT_RD(Opcode)];
     int Pad = Print2Bytes(f, Opcode);
     PrintPaddedMnemonic(f, Pad, Mnemonic);
     fprintf(f, "%s\n", Rd);
 }
 
-static U32 Disasm3Reg(FILE *f, const char *Mnemonic, U16 Opcode, const PVMChunk *Chunk, U32 Addr)
+static U32 Disasm3Reg(FILE *f, const char *Mnemonic, const char *RegSet[], U16 Opcode, const PVMChunk *Chunk, U32 Addr)
 {
     U16 OtherHalf = Chunk->Code[Addr + 1];
-    const char *R0 = sIntReg[PVM_GET_RD(Opcode)];
-    const char *R1 = sIntReg[PVM_GET_RS(Opcode)];
-    const char *R2 = sIntReg[PVM_GET_RD(OtherHalf)];
+    const char *R0 = RegSet[EXT_RD(Opcode)];
+    const char *R1 = RegSet[EXT_RS(Opcode)];
+    const char *R2 = RegSet[EXT_RT(OtherHalf)];
     int Pad = Print2Bytes(f, Opcode);
     Pad += Print2Bytes(f, OtherHalf);
 
@@ -395,15 +553,80 @@ static U32 Disasm3Reg(FILE *f, const char *Mnemonic, U16 Opcode, const PVMChunk
 
 static U32 DisasmSysOp(FILE *f, const PVMChunk *Chunk, U32 Addr, U16 Opcode)
 {
+    const char *Mnemonic = PVMMnemonic(Opcode);
     switch (PVM_GET_SYS_OP(Opcode))
     {
     case OP_SYS_EXIT:
     {
-        DisasmMnemonic(f, "exit", Opcode);
+        DisasmMnemonic(f, Mnemonic, Opcode);
     } break;
     case OP_SYS_WRITE:
     {
-        DisasmMnemonic(f, "write", Opcode);
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_READ:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_READLN:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_ASSIGN:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_RESET:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_REWRITE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_CLOSE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_WRITE_FILE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_READ_FILE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_READLN_FILE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_EOF:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_EOLN:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_WRITE_RECORD:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_READ_RECORD:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_SEEK:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_FILESIZE:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
+    } break;
+    case OP_SYS_FILEPOS:
+    {
+        DisasmMnemonic(f, Mnemonic, Opcode);
     } break;
     case OP_SYS_ENTER:
     {
@@ -412,7 +635,7 @@ static U32 DisasmSysOp(FILE *f, const PVMChunk *Chunk, U32 Addr, U16 Opcode)
         int Pad = Print2Bytes(f, Opcode);
         Pad += Print2Bytes(f, Info.Imm);
 
-        PrintPaddedMnemonic(f, Pad, "enter");
+        PrintPaddedMnemonic(f, Pad, Mnemonic);
         fprintf(f, "rsp + %u", 
                 (U32)Info.Imm
         );
@@ -433,209 +656,303 @@ U32 PVMDisasmSingleInstruction(FILE *f, const PVMChunk *Chunk, U32 Addr)
     U16 Opcode = Chunk->Code[Addr];
     fprintf(f, "%*u: ", sAddrPad, Addr*2);
 
+    if (OP_EXT == PVM_GET_OP(Opcode) && Addr + 1 < Chunk->Count)
+    {
+        int Pad = Print2Bytes(f, Opcode);
+        PrintPaddedMnemonic(f, Pad, PVMMnemonic(Opcode));
+        fprintf(f, "%s%s%s\n", 
+                (Opcode & PVM_EXT_D)? "d" : "", 
+                (Opcode & PVM_EXT_S)? "s" : "", 
+                (Opcode & PVM_EXT_T)? "t" : ""
+        );
+        sExt = PVM_GET_EXT(Opcode);
+        U32 Next = PVMDisasmSingleInstruction(f, Chunk, Addr + 1);
+        sExt = 0;
+        return Next;
+    }
+
+    const char *Mnemonic = PVMMnemonic(Opcode);
     switch (PVM_GET_OP(Opcode))
     {
-    default: DisasmMnemonic(f, "???", Opcode); break;
+    default: DisasmMnemonic(f, Mnemonic, Opcode); break;
     case OP_SYS:
     {
         return DisasmSysOp(f, Chunk, Addr, Opcode);
     } break;
-    case OP_SADD: DisasmRdRs(f, "sadd", sIntReg, Opcode); break;
-    case OP_ADD: DisasmRdRs(f, "add", sIntReg, Opcode); break;
-    case OP_SUB: DisasmRdRs(f, "sub", sIntReg, Opcode); break;
-    case OP_MUL: DisasmRdRs(f, "mul", sIntReg, Opcode); break;
-    case OP_IMUL: DisasmRdRs(f, "imul", sIntReg, Opcode); break;
-    case OP_DIV: DisasmRdRs(f, "div", sIntReg, Opcode); break;
-    case OP_IDIV: DisasmRdRs(f, "idiv", sIntReg, Opcode); break;
-    case OP_MOD: DisasmRdRs(f, "mod", sIntReg, Opcode); break;
-    case OP_NEG: DisasmRdRs(f, "neg", sIntReg, Opcode); break;
-    case OP_NOT: DisasmRdRs(f, "not", sIntReg, Opcode); break;
-    case OP_AND: DisasmRdRs(f, "and", sIntReg, Opcode); break;
-    case OP_OR:  DisasmRdRs(f, "or", sIntReg, Opcode); break;
-    case OP_XOR: DisasmRdRs(f, "xor", sIntReg, Opcode); break;
-    case OP_VSHL: DisasmRdRs(f, "vshl", sIntReg, Opcode); break;
-    case OP_VSHR: DisasmRdRs(f, "vshr", sIntReg, Opcode); break;
-    case OP_VASR: DisasmRdRs(f, "vasr", sIntReg, Opcode); break;
-    case OP_QSHL: DisasmRdSmallImm(f, "qshl", Opcode, false); break;
-    case OP_QSHR: DisasmRdSmallImm(f, "qshr", Opcode, false); break;
-    case OP_QASR: DisasmRdSmallImm(f, "qasr", Opcode, false); break;
-
-    case OP_ADDI: return DisasmRdImm(f, "addi", Chunk, Addr, Opcode);
-    case OP_ADDQI: DisasmRdSmallImm(f, "addqi", Opcode, true); break;
-
-
-    case OP_BEZ: return DisasmBcc(f, "bez", Opcode, Chunk, Addr);
-    case OP_BNZ: return DisasmBcc(f, "bnz", Opcode, Chunk, Addr);
-    case OP_BR: return DisasmBr(f, "br", Opcode, Chunk, Addr);
-    case OP_CALL: return DisasmBr(f, "call", Opcode, Chunk, Addr);
-    case OP_CALLPTR: DisasmSingleOperand(f, "callptr", Opcode); break;
-    case OP_BCT: return DisasmBr(f, "bct", Opcode, Chunk, Addr);
-    case OP_BCF: return DisasmBr(f, "bcf", Opcode, Chunk, Addr);
-    case OP_BRI: return DisasmBri(f, "bri", Opcode, Chunk, Addr);
-    case OP_LDRIP: return DisasmRdImm(f, "ldra", Chunk, Addr, Opcode);
-
-
-    case OP_STRLT: DisasmRdRs(f, "strlt", sIntReg, Opcode); break;
-    case OP_STREQ: DisasmRdRs(f, "streq", sIntReg, Opcode); break;
-    case OP_STRCPY: DisasmRdRs(f, "strcpy", sIntReg, Opcode); break;
-    case OP_MEMCPY: return DisasmRdRsImm32(f, "memcpy", Opcode, Chunk, Addr);
-    case OP_VMEMCPY: return Disasm3Reg(f, "vmemcpy", Opcode, Chunk, Addr);
-    case OP_VMEMEQU: return Disasm3Reg(f, "vmemequ", Opcode, Chunk, Addr);
-
-    case OP_SEQ: DisasmRdRs(f, "seq", sIntReg, Opcode); break;
-    case OP_SLT: DisasmRdRs(f, "slt", sIntReg, Opcode); break;
-    case OP_ISLT: DisasmRdRs(f, "islt", sIntReg, Opcode); break;
-    case OP_SETEZ: DisasmRdRs(f, "setez", sIntReg, Opcode); break;
-
-
-    case OP_PSHL: DisasmRegList(f, "pshl", Opcode, sIntReg); break;
-    case OP_PSHH: DisasmRegList(f, "pshh", Opcode, &sIntReg[PVM_REG_COUNT/2]); break;
-    case OP_POPL: DisasmRegList(f, "popl", Opcode, sIntReg); break;
-    case OP_POPH: DisasmRegList(f, "poph", Opcode, &sIntReg[PVM_REG_COUNT/2]); break;
-    case OP_FPSHL: DisasmRegList(f, "fpshl", Opcode, sFltReg); break;
-    case OP_FPSHH: DisasmRegList(f, "fpshh", Opcode, &sFltReg[PVM_FREG_COUNT/2]); break;
-    case OP_FPOPL: DisasmRegList(f, "fpopl", Opcode, sFltReg); break;
-    case OP_FPOPH: DisasmRegList(f, "fpshh", Opcode, &sFltReg[PVM_FREG_COUNT/2]); break;
-
-
-    case OP_LD32: return DisasmMem(f, "ld32", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LD64: return DisasmMem(f, "ld64", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDZEX32_8: return DisasmMem(f, "ldzex32_8", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDZEX32_16: return DisasmMem(f, "ldzex32_16", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDZEX64_8: return DisasmMem(f, "ldzex64_8", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDZEX64_16: return DisasmMem(f, "ldzex64_16", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDZEX64_32: return DisasmMem(f, "ldzex64_32", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDSEX32_8: return DisasmMem(f, "ldsex32_8", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDSEX32_16: return DisasmMem(f, "ldsex32_16", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDSEX64_8: return DisasmMem(f, "ldsex64_8", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDSEX64_16: return DisasmMem(f, "ldsex64_16", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDSEX64_32: return DisasmMem(f, "ldsex64_32", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-
-    case OP_LD32L: return DisasmMem(f, "ld32l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LD64L: return DisasmMem(f, "ld64l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDZEX32_8L: return DisasmMem(f, "ldzex32_8l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDZEX32_16L: return DisasmMem(f, "ldzex32_16l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDZEX64_8L: return DisasmMem(f, "ldzex64_8l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDZEX64_16L: return DisasmMem(f, "ldzex64_16l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDZEX64_32L: return DisasmMem(f, "ldzex64_32l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDSEX32_8L: return DisasmMem(f, "ldsex32_8l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDSEX32_16L: return DisasmMem(f, "ldsex32_16l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDSEX64_8L: return DisasmMem(f, "ldsex64_8l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDSEX64_16L: return DisasmMem(f, "ldsex64_16l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_LDSEX64_32L: return DisasmMem(f, "ldsex64_32l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-
-    case OP_LEA: return DisasmMem(f, "lea", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LEAL: return DisasmMem(f, "leal", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-
-
-    case OP_ST64: return DisasmMem(f, "st64", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_ST32: return DisasmMem(f, "st32", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_ST16: return DisasmMem(f, "st16", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_ST8: return DisasmMem(f, "st8", sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_ST64L: return DisasmMem(f, "st64l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_ST32L: return DisasmMem(f, "st32l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_ST16L: return DisasmMem(f, "st16l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_ST8L: return DisasmMem(f, "st8l", sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-
-
-    case OP_LDF32: return DisasmMem(f, "ldf32", sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_STF32: return DisasmMem(f, "stf32", sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDF32L: return DisasmMem(f, "ldf32l", sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_STF32L: return DisasmMem(f, "stf32l", sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_SADD: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_ADD: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SUB: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MUL: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_IMUL: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_DIV: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_IDIV: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOD: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_NEG: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_NOT: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_AND: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_OR:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_XOR: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VSHL: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VSHR: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VASR: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_QSHL: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+    case OP_QSHR: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+    case OP_QASR: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+
+    case OP_ADDI: return DisasmRdImm(f, Mnemonic, Chunk, Addr, Opcode);
+    case OP_ADDQI: DisasmRdSmallImm(f, Mnemonic, Opcode, true); break;
+
+
+    case OP_BEZ: return DisasmBcc(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_BNZ: return DisasmBcc(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_BR: return DisasmBr(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_CALL: return DisasmBr(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_CALLPTR: DisasmSingleOperand(f, Mnemonic, Opcode); break;
+    case OP_BCT: return DisasmBr(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_BCF: return DisasmBr(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_BRI: return DisasmBri(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_LDRIP: return DisasmRdImm(f, Mnemonic, Chunk, Addr, Opcode);
+
+
+    case OP_STRLT: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_STREQ: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_STRCPY: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MEMCPY: return DisasmRdRsImm32(f, Mnemonic, Opcode, Chunk, Addr);
+    case OP_VMEMCPY: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VMEMEQU: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+
+    case OP_SEQ: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SLT: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_ISLT: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SETEZ: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+
+
+    case OP_PSHL: DisasmRegList(f, Mnemonic, Opcode, sIntReg, 0); break;
+    case OP_PSHH: DisasmRegList(f, Mnemonic, Opcode, sIntReg, 8); break;
+    case OP_POPL: DisasmRegList(f, Mnemonic, Opcode, sIntReg, 0); break;
+    case OP_POPH: DisasmRegList(f, Mnemonic, Opcode, sIntReg, 8); break;
+    case OP_FPSHL: DisasmRegList(f, Mnemonic, Opcode, sFltReg, 0); break;
+    case OP_FPSHH: DisasmRegList(f, Mnemonic, Opcode, sFltReg, 8); break;
+    case OP_FPOPL: DisasmRegList(f, Mnemonic, Opcode, sFltReg, 0); break;
+    case OP_FPOPH: DisasmRegList(f, Mnemonic, Opcode, sFltReg, 8); break;
+
+
+    case OP_LD32: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LD64: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDZEX32_8: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDZEX32_16: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDZEX64_8: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDZEX64_16: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDZEX64_32: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDSEX32_8: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDSEX32_16: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDSEX64_8: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDSEX64_16: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDSEX64_32: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+
+    case OP_LD32L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LD64L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDZEX32_8L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDZEX32_16L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDZEX64_8L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDZEX64_16L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDZEX64_32L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDSEX32_8L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDSEX32_16L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDSEX64_8L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDSEX64_16L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDSEX64_32L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+
+    case OP_LEA: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LEAL: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+
+
+    case OP_ST64: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_ST32: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_ST16: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_ST8: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_ST64L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_ST32L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_ST16L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_ST8L: return DisasmMem(f, Mnemonic, sIntReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+
+
+    case OP_LDF32: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_STF32: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDF32L: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_STF32L: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
  
-    case OP_LDF64: return DisasmMem(f, "ldf64", sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_STF64: return DisasmMem(f, "stf64", sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
-    case OP_LDF64L: return DisasmMem(f, "ldf64l", sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
-    case OP_STF64L: return DisasmMem(f, "stf64l", sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_LDF64: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_STF64: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I16, Chunk, Addr);
+    case OP_LDF64L: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
+    case OP_STF64L: return DisasmMem(f, Mnemonic, sFltReg, Opcode, IMMTYPE_I32, Chunk, Addr);
        
 
 
-    case OP_FADD: DisasmRdRs(f, "fadd", sFltReg, Opcode); break;
-    case OP_FSUB: DisasmRdRs(f, "fsub", sFltReg, Opcode); break;
-    case OP_FDIV: DisasmRdRs(f, "fdiv", sFltReg, Opcode); break;
-    case OP_FMUL: DisasmRdRs(f, "fmul", sFltReg, Opcode); break;
-    case OP_FNEG: DisasmRdRs(f, "fneg", sFltReg, Opcode); break;
-    case OP_FSEQ: DisasmFscc(f, "fseq", Opcode); break;
-    case OP_FSLT: DisasmFscc(f, "fslt", Opcode); break;
-    case OP_FSGT: DisasmFscc(f, "fsgt", Opcode); break;
-    case OP_FSNE: DisasmFscc(f, "fsne", Opcode); break;
-    case OP_FSLE: DisasmFscc(f, "fsle", Opcode); break;
-    case OP_FSGE: DisasmFscc(f, "fsge", Opcode); break;
-
-    case OP_FADD64: DisasmRdRs(f, "fadd64", sFltReg, Opcode); break;
-    case OP_FSUB64: DisasmRdRs(f, "fsub64", sFltReg, Opcode); break;
-    case OP_FDIV64: DisasmRdRs(f, "fdiv64", sFltReg, Opcode); break;
-    case OP_FMUL64: DisasmRdRs(f, "fmul64", sFltReg, Opcode); break;
-    case OP_FNEG64: DisasmRdRs(f, "fneg64", sFltReg, Opcode); break;
-    case OP_FSEQ64: DisasmFscc(f, "fseq64", Opcode); break;
-    case OP_FSLT64: DisasmFscc(f, "fslt64", Opcode); break;
-    case OP_FSGT64: DisasmFscc(f, "fsgt64", Opcode); break;
-    case OP_FSNE64: DisasmFscc(f, "fsne64", Opcode); break;
-    case OP_FSLE64: DisasmFscc(f, "fsle64", Opcode); break;
-    case OP_FSGE64: DisasmFscc(f, "fsge64", Opcode); break;
-
-    case OP_GETFLAG: DisasmSingleOperand(f, "getflag", Opcode); break;
-    case OP_GETNFLAG: DisasmSingleOperand(f, "getnflag", Opcode); break;
-    case OP_SETFLAG: DisasmSingleOperand(f, "setflag", Opcode); break;
-    case OP_SETNFLAG: DisasmSingleOperand(f, "setnflag", Opcode); break;
-    case OP_NEGFLAG: DisasmMnemonic(f, "negflag", Opcode); break;
-
-
-
-    case OP_MOV32: DisasmRdRs(f, "mov32", sIntReg, Opcode); break;
-    case OP_MOVZEX32_8: DisasmRdRs(f, "movzex32_8", sIntReg, Opcode); break;
-    case OP_MOVZEX32_16: DisasmRdRs(f, "movzex32_16", sIntReg, Opcode); break;
-    case OP_MOV64: DisasmRdRs(f, "mov64", sIntReg, Opcode); break;
-    case OP_MOVZEX64_8: DisasmRdRs(f, "movzex64_8", sIntReg, Opcode); break;
-    case OP_MOVZEX64_16: DisasmRdRs(f, "movzex64_16", sIntReg, Opcode); break;
-    case OP_MOVZEX64_32: DisasmRdRs(f, "movzex64_32", sIntReg, Opcode); break;
-    case OP_MOVSEX64_32: DisasmRdRs(f, "movsex64_32", sIntReg, Opcode); break;
-
-    case OP_FMOV: DisasmRdRs(f, "fmov", sFltReg, Opcode); break;
-    case OP_FMOV64: DisasmRdRs(f, "fmov64", sFltReg, Opcode); break;
-    case OP_MOVI: return DisasmRdImm(f, "movi", Chunk, Addr, Opcode);
-    case OP_MOVQI: DisasmRdSmallImm(f, "movqi", Opcode, true); break;
-
-    case OP_F64TOF32: DisasmRdRs(f, "f64tof32", sFltReg, Opcode); break;
-    case OP_F32TOF64: DisasmRdRs(f, "f32tof64", sFltReg, Opcode); break;
-    case OP_F64TOI64: DisasmInter(f, "f64toi64", sIntReg, sFltReg, Opcode); break;
-    case OP_I64TOF32: DisasmInter(f, "i64tof32", sFltReg, sIntReg, Opcode); break;
-    case OP_I64TOF64: DisasmInter(f, "i64tof64", sFltReg, sIntReg, Opcode); break;
-    case OP_U64TOF64: DisasmInter(f, "u64tof64", sFltReg, sIntReg, Opcode); break;
-    case OP_U64TOF32: DisasmInter(f, "u64tof32", sFltReg, sIntReg, Opcode); break;
-    case OP_I32TOF32: DisasmInter(f, "i32tof32", sFltReg, sIntReg, Opcode); break;
-    case OP_I32TOF64: DisasmInter(f, "i32tof64", sFltReg, sIntReg, Opcode); break;
-    case OP_U32TOF64: DisasmInter(f, "u32tof64", sFltReg, sIntReg, Opcode); break;
-    case OP_U32TOF32: DisasmInter(f, "u32tof32", sFltReg, sIntReg, Opcode); break;
-
-
-    case OP_ADD64:  DisasmRdRs(f, "add64", sIntReg, Opcode); break;
-    case OP_SUB64:  DisasmRdRs(f, "sub64", sIntReg, Opcode); break;
-    case OP_MUL64:  DisasmRdRs(f, "mul64", sIntReg, Opcode); break;
-    case OP_IMUL64: DisasmRdRs(f, "imul64", sIntReg, Opcode); break;
-    case OP_DIV64:  DisasmRdRs(f, "div64", sIntReg, Opcode); break;
-    case OP_IDIV64: DisasmRdRs(f, "idiv64", sIntReg, Opcode); break;
-    case OP_MOD64:  DisasmRdRs(f, "mod64", sIntReg, Opcode); break;
-    case OP_NEG64:  DisasmRdRs(f, "neg64", sIntReg, Opcode); break;
-    case OP_NOT64:  DisasmRdRs(f, "not64", sIntReg, Opcode); break;
-    case OP_AND64:  DisasmRdRs(f, "and64", sIntReg, Opcode); break;
-    case OP_OR64:   DisasmRdRs(f, "or64", sIntReg, Opcode); break;
-    case OP_XOR64:  DisasmRdRs(f, "xor64", sIntReg, Opcode); break;
-    case OP_VSHL64: DisasmRdRs(f, "vshl64", sIntReg, Opcode); break;
-    case OP_VSHR64: DisasmRdRs(f, "vshr64", sIntReg, Opcode); break;
-    case OP_VASR64: DisasmRdRs(f, "vasr64", sIntReg, Opcode); break;
-    case OP_QSHL64: DisasmRdSmallImm(f, "qshl", Opcode, false); break;
-    case OP_QSHR64: DisasmRdSmallImm(f, "qshr", Opcode, false); break;
-    case OP_QASR64: DisasmRdSmallImm(f, "qasr", Opcode, false); break;
-    case OP_ADDI64: return DisasmRdImm(f, "addi64", Chunk, Addr, Opcode);
-    case OP_ADDQI64: DisasmRdSmallImm(f, "addqi64", Opcode, false); break;
-
-    case OP_SEQ64: DisasmRdRs(f, "seq64", sIntReg, Opcode); break;
-    case OP_SLT64: DisasmRdRs(f, "slt64", sIntReg, Opcode); break;
-    case OP_ISLT64: DisasmRdRs(f, "islt64", sIntReg, Opcode); break;
-    case OP_SETEZ64: DisasmRdRs(f, "setez64", sIntReg, Opcode); break;
+    case OP_FADD: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FSUB: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FDIV: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FMUL: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FNEG: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FSEQ: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSLT: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSGT: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSNE: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSLE: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSGE: DisasmFscc(f, Mnemonic, Opcode); break;
+
+    case OP_FADD64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FSUB64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FDIV64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FMUL64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FNEG64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FSEQ64: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSLT64: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSGT64: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSNE64: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSLE64: DisasmFscc(f, Mnemonic, Opcode); break;
+    case OP_FSGE64: DisasmFscc(f, Mnemonic, Opcode); break;
+
+    case OP_GETFLAG: DisasmSingleOperand(f, Mnemonic, Opcode); break;
+    case OP_GETNFLAG: DisasmSingleOperand(f, Mnemonic, Opcode); break;
+    case OP_SETFLAG: DisasmSingleOperand(f, Mnemonic, Opcode); break;
+    case OP_SETNFLAG: DisasmSingleOperand(f, Mnemonic, Opcode); break;
+    case OP_NEGFLAG: DisasmMnemonic(f, Mnemonic, Opcode); break;
+
+
+
+    case OP_MOV32: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVZEX32_8: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVZEX32_16: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOV64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVZEX64_8: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVZEX64_16: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVZEX64_32: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOVSEX64_32: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+
+    case OP_FMOV: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_FMOV64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_MOVI: return DisasmRdImm(f, Mnemonic, Chunk, Addr, Opcode);
+    case OP_MOVQI: DisasmRdSmallImm(f, Mnemonic, Opcode, true); break;
+
+    case OP_F64TOF32: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_F32TOF64: DisasmRdRs(f, Mnemonic, sFltReg, Opcode); break;
+    case OP_F64TOI64: DisasmInter(f, Mnemonic, sIntReg, sFltReg, Opcode); break;
+    case OP_I64TOF32: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_I64TOF64: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_U64TOF64: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_U64TOF32: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_I32TOF32: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_I32TOF64: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_U32TOF64: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+    case OP_U32TOF32: DisasmInter(f, Mnemonic, sFltReg, sIntReg, Opcode); break;
+
+
+    case OP_ADD64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SUB64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MUL64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_IMUL64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_DIV64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_IDIV64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_MOD64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_NEG64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_NOT64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_AND64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_OR64:   DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_XOR64:  DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VSHL64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VSHR64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_VASR64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_QSHL64: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+    case OP_QSHR64: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+    case OP_QASR64: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+    case OP_ADDI64: return DisasmRdImm(f, Mnemonic, Chunk, Addr, Opcode);
+    case OP_ADDQI64: DisasmRdSmallImm(f, Mnemonic, Opcode, false); break;
+
+    case OP_SEQ64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SLT64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_ISLT64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+    case OP_SETEZ64: DisasmRdRs(f, Mnemonic, sIntReg, Opcode); break;
+
+    case OP_BEQ: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BNE: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BLT: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BGE: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_IBLT: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_IBGE: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BEQ64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BNE64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BLT64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_BGE64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_IBLT64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+    case OP_IBGE64: return DisasmCmpBr(f, Mnemonic, sIntReg, false, Opcode, Chunk, Addr);
+
+    case OP_BEQQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BNEQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BLTQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BGEQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_IBLTQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_IBGEQI: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BEQQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BNEQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BLTQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_BGEQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_IBLTQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+    case OP_IBGEQI64: return DisasmCmpBr(f, Mnemonic, sIntReg, true, Opcode, Chunk, Addr);
+
+    case OP_FBEQ: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNE: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBLT: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNLT: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBLE: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNLE: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBEQ64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNE64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBLT64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNLT64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBLE64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+    case OP_FBNLE64: return DisasmCmpBr(f, Mnemonic, sFltReg, false, Opcode, Chunk, Addr);
+
+    case OP_ADD3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_SUB3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_MUL3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_IMUL3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_DIV3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_IDIV3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_MOD3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_AND3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_OR3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_XOR3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VSHL3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VSHR3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VASR3: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_ADD3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_SUB3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_MUL3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_IMUL3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_DIV3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_IDIV3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_MOD3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_AND3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_OR3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_XOR3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VSHL3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VSHR3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_VASR3_64: return Disasm3Reg(f, Mnemonic, sIntReg, Opcode, Chunk, Addr);
+    case OP_FADD3: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FSUB3: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FMUL3: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FDIV3: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FADD3_64: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FSUB3_64: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FMUL3_64: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
+    case OP_FDIV3_64: return Disasm3Reg(f, Mnemonic, sFltReg, Opcode, Chunk, Addr);
     }
     return Addr + 1;
 }
 
 
+#undef EXT_RT
+#undef EXT_RS
+#undef EXT_RD
+
@@ -0,0 +1,111 @@
+#include <stdio.h>
+
+#include "Common.h"
+#include "PVM/Elf.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif /* unix */
+
+
+#define SEGMENT_ALIGN 0x1000
+#define PT_LOAD 1
+#define PT_GNU_STACK 0x6474E551
+#define PF_X 1
+#define PF_W 2
+#define PF_R 4
+
+
+
+static U8 *Put(U8 *At, U64 Value, UInt Size)
+{
+    /* ELF64 for x86-64 is little endian regardless of the host */
+    for (UInt i = 0; i < Size; i++)
+    {
+        At[i] = Value & 0xFF;
+        Value >>= 8;
+    }
+    return At + Size;
+}
+
+static U8 *PutSegment(U8 *At, U32 Type, U32 Flags, U64 Offset, U64 Addr, U64 FileSize, U64 MemSize)
+{
+    At = Put(At, Type, 4);
+    At = Put(At, Flags, 4);
+    At = Put(At, Offset, 8);
+    At = Put(At, Addr, 8);      /* p_vaddr */
+    At = Put(At, Addr, 8);      /* p_paddr */
+    At = Put(At, FileSize, 8);
+    At = Put(At, MemSize, 8);
+    At = Put(At, PT_LOAD == Type ? SEGMENT_ALIGN : 16, 8);
+    return At;
+}
+
+
+
+bool ElfWriteExecutable(const char *FileName, const ElfImage *Image)
+{
+    PASCAL_NONNULL(FileName);
+    PASCAL_NONNULL(Image);
+
+    U64 TextEnd = ELF_HEADER_SIZE + (U64)Image->TextSize;
+    U64 DataOffset = (TextEnd + SEGMENT_ALIGN - 1) & ~(U64)(SEGMENT_ALIGN - 1);
+
+    U8 Header[ELF_HEADER_SIZE] = { 0x7F, 'E', 'L', 'F',
+        2,  /* ELFCLASS64 */
+        1,  /* ELFDATA2LSB */
+        1,  /* EV_CURRENT */
+        0,  /* ELFOSABI_SYSV */
+    };
+    U8 *At = Header + 16;
+    At = Put(At, 2, 2);                                 /* e_type: ET_EXEC */
+    At = Put(At, 62, 2);                                /* e_machine: EM_X86_64 */
+    At = Put(At, 1, 4);                                 /* e_version */
+    At = Put(At, ELF_CODE_ADDR + Image->EntryOffset, 8);/* e_entry */
+    At = Put(At, 64, 8);                                /* e_phoff */
+    At = Put(At, 0, 8);                                 /* e_shoff, no sections */
+    At = Put(At, 0, 4);                                 /* e_flags */
+    At = Put(At, 64, 2);                                /* e_ehsize */
+    At = Put(At, 56, 2);                                /* e_phentsize */
+    At = Put(At, 3, 2);                                 /* e_phnum */
+    At = Put(At, 64, 2);                                /* e_shentsize */
+    At = Put(At, 0, 2);                                 /* e_shnum */
+    At = Put(At, 0, 2);                                 /* e_shstrndx */
+
+    At = PutSegment(At, PT_LOAD, PF_R | PF_X, 0, ELF_TEXT_ADDR, TextEnd, TextEnd);
+    At = PutSegment(At, PT_LOAD, PF_R | PF_W, DataOffset, ELF_DATA_ADDR,
+        Image->DataSize, (U64)Image->DataSize + Image->BssSize
+    );
+    At = PutSegment(At, PT_GNU_STACK, PF_R | PF_W, 0, 0, 0, 0);
+    PASCAL_ASSERT(At == Header + ELF_HEADER_SIZE, "ELF_HEADER_SIZE does not match the headers");
+
+
+    FILE *Out = fopen(FileName, "wb");
+    if (NULL == Out)
+        return false;
+
+    bool Ok = 1 == fwrite(Header, sizeof Header, 1, Out);
+    if (Ok && Image->TextSize)
+        Ok = 1 == fwrite(Image->Text, Image->TextSize, 1, Out);
+    for (U64 i = TextEnd; Ok && i < DataOffset; i++)
+        Ok = EOF != fputc(0, Out);
+    if (Ok && Image->DataSize)
+        Ok = 1 == fwrite(Image->Data, Image->DataSize, 1, Out);
+    Ok = (0 == fclose(Out)) && Ok;
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (Ok)
+        Ok = 0 == chmod(FileName, 0755);
+#endif /* unix */
+    return Ok;
+}
+
+
+
+#undef PF_R
+#undef PF_W
+#undef PF_X
+#undef PT_GNU_STACK
+#undef PT_LOAD
+#undef SEGMENT_ALIGN
+
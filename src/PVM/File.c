@@ -0,0 +1,316 @@
+#include <string.h>
+
+#include "Memory.h"
+#include "PVM/File.h"
+
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  define FILE_MMAP 1
+#else
+#  define FILE_MMAP 0
+#endif /* unix */
+
+
+
+/* the output buffer is bigger than the memory pool can afford */
+static U8 *AllocateBuffer(USize *Capacity)
+{
+#if FILE_MMAP
+    U8 *Buffer = mmap(NULL, PVM_FILE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED != Buffer)
+    {
+        *Capacity = PVM_FILE_BUFFER_SIZE;
+        return Buffer;
+    }
+#endif /* FILE_MMAP */
+    *Capacity = PVM_OUTPUT_MAX_BUFFER_SIZE;
+    return MemAllocate(PVM_OUTPUT_MAX_BUFFER_SIZE);
+}
+
+static void DeallocateBuffer(U8 *Buffer, USize Capacity)
+{
+#if FILE_MMAP
+    if (PVM_FILE_BUFFER_SIZE == Capacity)
+    {
+        munmap(Buffer, Capacity);
+        return;
+    }
+#endif /* FILE_MMAP */
+    UNUSED(Capacity);
+    MemDeallocate(Buffer);
+}
+
+
+#if FILE_MMAP
+static void UnmapWindow(PVMFile *File)
+{
+    if (NULL != File->Window)
+        munmap(File->Window, File->WindowSize);
+    File->Window = NULL;
+    File->WindowOffset = 0;
+    File->WindowSize = 0;
+}
+
+/* Length bytes of the file at Offset, all of them within Reserved */
+static U8 *FileWindow(PVMFile *File, U64 Offset, USize Length)
+{
+    if (NULL != File->Window 
+    && File->WindowOffset <= Offset && Offset + Length <= File->WindowOffset + File->WindowSize)
+    {
+        return File->Window + (Offset - File->WindowOffset);
+    }
+
+    UnmapWindow(File);
+    U64 Start = Offset & ~(U64)(PVM_FILE_WINDOW_ALIGN - 1);
+    USize Size = PVM_FILE_WINDOW_SIZE;
+    if (Offset + Length - Start > Size) /* a record bigger than the window */
+        Size = Offset + Length - Start;
+
+    int Prot = File->ReadOnly? PROT_READ : PROT_READ | PROT_WRITE;
+    U8 *Window = mmap(NULL, Size, Prot, MAP_SHARED, fileno(File->File), Start);
+    if (MAP_FAILED == Window)
+        return NULL;
+    File->Window = Window;
+    File->WindowOffset = Start;
+    File->WindowSize = Size;
+    return Window + (Offset - Start);
+}
+#endif /* FILE_MMAP */
+
+static bool OpenRecords(PVMFile *File, U32 RecordSize, bool Truncate)
+{
+    File->ReadOnly = false;
+    File->File = fopen(File->Name, Truncate? "w+b" : "r+b");
+    if (NULL == File->File && !Truncate)
+    {
+        File->ReadOnly = true;
+        File->File = fopen(File->Name, "rb");
+    }
+    if (NULL == File->File)
+        return false;
+
+    U64 Size = 0;
+#if FILE_MMAP
+    struct stat Stat;
+    if (0 == fstat(fileno(File->File), &Stat))
+        Size = Stat.st_size;
+#else
+    long End = 0 == fseek(File->File, 0, SEEK_END)? ftell(File->File) : -1;
+    if (End > 0)
+        Size = End;
+#endif /* FILE_MMAP */
+
+    File->Mode = PVM_FILE_RECORDS;
+    File->RecordSize = RecordSize;
+    File->Size = Size;
+    File->Reserved = Size;
+    File->Position = 0;
+    return true;
+}
+
+
+
+PVMFile *PVMFileFind(PVMFile *List, const PVMFile *Handle)
+{
+    if (NULL == Handle)
+        return NULL;
+    for (PVMFile *File = List; NULL != File; File = File->Next)
+    {
+        if (Handle == File)
+            return File;
+    }
+    return NULL;
+}
+
+
+PVMFile *PVMFileAssign(PVMFile **List, const PVMFile *Handle, const PascalStr *Name)
+{
+    PASCAL_NONNULL(List);
+    PASCAL_NONNULL(Name);
+
+    PVMFile *File = PVMFileFind(*List, Handle);
+    if (NULL == File)
+    {
+        File = MemAllocate(sizeof *File);
+        *File = (PVMFile) {
+            .Next = *List,
+            .File = NULL,
+            .Mode = PVM_FILE_CLOSED,
+            .In = PVMInputInit(PVM_INPUT_BUFFER_SIZE),
+            .Out = PVMOutputInit(0),
+            .OutBuffer = NULL,
+            .Window = NULL,
+        };
+        *List = File;
+    }
+    else PVMFileClose(File);
+
+    USize Len = PStrGetLen(Name);
+    memcpy(File->Name, PStrGetConstPtr(Name), Len);
+    File->Name[Len] = '\0';
+    return File;
+}
+
+
+bool PVMFileReset(PVMFile *File, U32 RecordSize)
+{
+    PASCAL_NONNULL(File);
+    PVMFileClose(File);
+    if (0 != RecordSize)
+        return OpenRecords(File, RecordSize, false);
+
+    File->File = fopen(File->Name, "rb");
+    if (NULL == File->File)
+        return false;
+
+    File->Mode = PVM_FILE_INPUT;
+    PVMInputSetFile(&File->In, File->File);
+    return true;
+}
+
+bool PVMFileRewrite(PVMFile *File, U32 RecordSize)
+{
+    PASCAL_NONNULL(File);
+    PVMFileClose(File);
+    if (0 != RecordSize)
+        return OpenRecords(File, RecordSize, true);
+
+    File->File = fopen(File->Name, "wb");
+    if (NULL == File->File)
+        return false;
+
+    USize Capacity;
+    File->Mode = PVM_FILE_OUTPUT;
+    File->OutBuffer = AllocateBuffer(&Capacity);
+    File->Out = PVMOutputInitWithBuffer(File->OutBuffer, Capacity);
+    PVMOutputSetFile(&File->Out, File->File);
+    return true;
+}
+
+
+bool PVMFileReadRecord(PVMFile *File, void *Dst)
+{
+    PASCAL_NONNULL(File);
+    PASCAL_NONNULL(Dst);
+    PASCAL_ASSERT(PVM_FILE_RECORDS == File->Mode, "Not a typed file");
+
+    U32 RecordSize = File->RecordSize;
+    if (File->Position + RecordSize > File->Size)
+        return false;
+#if FILE_MMAP
+    const U8 *Src = FileWindow(File, File->Position, RecordSize);
+    if (NULL == Src)
+        return false;
+    memcpy(Dst, Src, RecordSize);
+#else
+    if (0 != fseek(File->File, File->Position, SEEK_SET)
+    || 1 != fread(Dst, RecordSize, 1, File->File))
+    {
+        return false;
+    }
+#endif /* FILE_MMAP */
+    File->Position += RecordSize;
+    return true;
+}
+
+bool PVMFileWriteRecord(PVMFile *File, const void *Src)
+{
+    PASCAL_NONNULL(File);
+    PASCAL_NONNULL(Src);
+    PASCAL_ASSERT(PVM_FILE_RECORDS == File->Mode, "Not a typed file");
+    if (File->ReadOnly)
+        return false;
+
+    U32 RecordSize = File->RecordSize;
+    U64 End = File->Position + RecordSize;
+#if FILE_MMAP
+    if (End > File->Reserved)
+    {
+        /* mapped pages past the end of the file cannot be touched, grow it first */
+        U64 Reserved = (End + PVM_FILE_GROW_SIZE - 1) & ~(U64)(PVM_FILE_GROW_SIZE - 1);
+        if (0 != ftruncate(fileno(File->File), Reserved))
+            return false;
+        File->Reserved = Reserved;
+    }
+    U8 *Dst = FileWindow(File, File->Position, RecordSize);
+    if (NULL == Dst)
+        return false;
+    memcpy(Dst, Src, RecordSize);
+#else
+    if (0 != fseek(File->File, File->Position, SEEK_SET)
+    || 1 != fwrite(Src, RecordSize, 1, File->File))
+    {
+        return false;
+    }
+#endif /* FILE_MMAP */
+    File->Position = End;
+    if (End > File->Size)
+        File->Size = End;
+    return true;
+}
+
+bool PVMFileSeek(PVMFile *File, I64 Record)
+{
+    PASCAL_NONNULL(File);
+    PASCAL_ASSERT(PVM_FILE_RECORDS == File->Mode, "Not a typed file");
+    if (Record < 0 || (U64)Record > File->Size / File->RecordSize)
+        return false;
+    File->Position = (U64)Record * File->RecordSize;
+    return true;
+}
+
+
+void PVMFileClose(PVMFile *File)
+{
+    PASCAL_NONNULL(File);
+    switch (File->Mode)
+    {
+    case PVM_FILE_CLOSED: return;
+    case PVM_FILE_INPUT:
+    {
+        PVMInputDeinit(&File->In);
+    } break;
+    case PVM_FILE_OUTPUT:
+    {
+        USize Capacity = File->Out.Capacity;
+        PVMOutputDeinit(&File->Out);
+        DeallocateBuffer(File->OutBuffer, Capacity);
+        File->OutBuffer = NULL;
+    } break;
+    case PVM_FILE_RECORDS:
+    {
+#if FILE_MMAP
+        UnmapWindow(File);
+        if (File->Reserved != File->Size && 0 != ftruncate(fileno(File->File), File->Size))
+        {
+            /* nothing to report it to, the file keeps its zeroed tail */
+        }
+#endif /* FILE_MMAP */
+        File->RecordSize = 0;
+    } break;
+    }
+    fclose(File->File);
+    File->File = NULL;
+    File->Mode = PVM_FILE_CLOSED;
+}
+
+void PVMFileCloseAll(PVMFile **List)
+{
+    PASCAL_NONNULL(List);
+    PVMFile *File = *List;
+    while (NULL != File)
+    {
+        PVMFile *Next = File->Next;
+        PVMFileClose(File);
+        MemDeallocate(File);
+        File = Next;
+    }
+    *List = NULL;
+}
+
+
+#undef FILE_MMAP
+
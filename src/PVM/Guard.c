@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Common.h"
+#include "Memory.h"
+#include "Pascal.h"
+#include "PVM/Guard.h"
+
+
+#if PVM_GUARD_PAGES
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+
+/* a PascalVM has 2 stacks, the repl and the file runner only ever have one PascalVM */
+#define MAX_GUARDED_BLOCKS 8
+
+typedef struct GuardRange
+{
+    const U8 *Start, *End;
+} GuardRange;
+
+static GuardRange sGuardRanges[MAX_GUARDED_BLOCKS];
+static struct sigaction sGuardOldAction;
+static bool sGuardHandlerInstalled;
+/* the innermost PVMGuardedCall */
+static sigjmp_buf *sGuardJump;
+static const void *sGuardFaultAt;
+
+
+
+static USize GuardPageSize(void)
+{
+    long PageSize = sysconf(_SC_PAGESIZE);
+    return PageSize > 0 ? (USize)PageSize : 4096;
+}
+
+/* the block is placed so that it ends right where the guard pages start, 
+ * with at least a page in front of it: SP starts below the stack and 
+ * a stray access there must not land in the guard pages of the block mapped before */
+static USize GuardLeadingBytes(USize Size)
+{
+    USize PageSize = GuardPageSize();
+    USize Rounded = (Size + PageSize - 1) / PageSize * PageSize;
+    return Rounded - Size + PageSize;
+}
+
+static USize GuardMappingSize(USize Size)
+{
+    USize PageSize = GuardPageSize();
+    USize Guard = (PVM_GUARD_SIZE + PageSize - 1) / PageSize * PageSize;
+    return GuardLeadingBytes(Size) + Size + Guard;
+}
+
+
+static const void *GuardFaultingInstruction(void *Context)
+{
+#if defined(__linux__) && defined(__x86_64__)
+    /* REG_RIP needs _GNU_SOURCE, the layout of gregs is part of the kernel's ABI */
+    const ucontext_t *Uc = Context;
+    return (const void *)(uintptr_t)Uc->uc_mcontext.gregs[16];
+#else
+    UNUSED(Context);
+    return NULL;
+#endif /* linux x86-64 */
+}
+
+static void GuardSignalHandler(int Signal, siginfo_t *Info, void *Context)
+{
+    UNUSED(Signal);
+    const U8 *Addr = Info->si_addr;
+    if (NULL != sGuardJump)
+    {
+        for (UInt i = 0; i < MAX_GUARDED_BLOCKS; i++)
+        {
+            if (sGuardRanges[i].Start <= Addr && Addr < sGuardRanges[i].End)
+            {
+                sGuardFaultAt = GuardFaultingInstruction(Context);
+                siglongjmp(*sGuardJump, 1);
+            }
+        }
+    }
+
+    /* not ours, the faulting instruction is retried with the previous handler */
+    sigaction(SIGSEGV, &sGuardOldAction, NULL);
+    sGuardHandlerInstalled = false;
+}
+
+static void GuardInstallHandler(void)
+{
+    if (sGuardHandlerInstalled)
+        return;
+
+    struct sigaction Action = { 0 };
+    Action.sa_sigaction = GuardSignalHandler;
+    Action.sa_flags = SA_SIGINFO;
+    sigemptyset(&Action.sa_mask);
+    sGuardHandlerInstalled = 0 == sigaction(SIGSEGV, &Action, &sGuardOldAction);
+}
+
+
+
+void *PVMGuardAllocate(USize Size)
+{
+    USize Leading = GuardLeadingBytes(Size);
+    USize MappingSize = GuardMappingSize(Size);
+    U8 *Mapping = mmap(NULL, MappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == Mapping)
+    {
+        fprintf(stderr, "Out of memory while requesting %zu bytes\n", MappingSize);
+        exit(PASCAL_EXIT_FAILURE);
+    }
+
+    U8 *Guard = Mapping + Leading + Size;
+    USize GuardSize = MappingSize - Leading - Size;
+    if (0 != mprotect(Guard, GuardSize, PROT_NONE))
+    {
+        fprintf(stderr, "Unable to protect the guard pages of the PVM's stack\n");
+        exit(PASCAL_EXIT_FAILURE);
+    }
+    for (UInt i = 0; i < MAX_GUARDED_BLOCKS; i++)
+    {
+        if (NULL == sGuardRanges[i].Start)
+        {
+            sGuardRanges[i] = (GuardRange) { .Start = Guard, .End = Guard + GuardSize };
+            break;
+        }
+    }
+    return Mapping + Leading;
+}
+
+void PVMGuardDeallocate(void *Ptr, USize Size)
+{
+    if (NULL == Ptr)
+        return;
+
+    U8 *Guard = (U8 *)Ptr + Size;
+    for (UInt i = 0; i < MAX_GUARDED_BLOCKS; i++)
+    {
+        if (Guard == sGuardRanges[i].Start)
+            sGuardRanges[i] = (GuardRange) { 0 };
+    }
+    munmap((U8 *)Ptr - GuardLeadingBytes(Size), GuardMappingSize(Size));
+}
+
+
+bool PVMGuardedCall(void (*Fn)(void *Data), void *Data, const void **FaultAt)
+{
+    PASCAL_NONNULL(Fn);
+
+    GuardInstallHandler();
+    sigjmp_buf Jump;
+    sigjmp_buf *Outer = sGuardJump;
+    if (0 != sigsetjmp(Jump, 1))
+    {
+        sGuardJump = Outer;
+        if (NULL != FaultAt)
+            *FaultAt = sGuardFaultAt;
+        return false;
+    }
+
+    sGuardJump = &Jump;
+    Fn(Data);
+    sGuardJump = Outer;
+    return true;
+}
+
+
+#undef MAX_GUARDED_BLOCKS
+
+#else
+
+void *PVMGuardAllocate(USize Size)
+{
+    return MemAllocateZero(Size);
+}
+
+void PVMGuardDeallocate(void *Ptr, USize Size)
+{
+    UNUSED(Size);
+    MemDeallocate(Ptr);
+}
+
+bool PVMGuardedCall(void (*Fn)(void *Data), void *Data, const void **FaultAt)
+{
+    PASCAL_NONNULL(Fn);
+    UNUSED(FaultAt);
+    Fn(Data);
+    return true;
+}
+
+#endif /* PVM_GUARD_PAGES */
+
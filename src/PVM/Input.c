@@ -0,0 +1,456 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Memory.h"
+#include "PascalString.h"
+#include "PVM/Input.h"
+
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  define INPUT_MMAP 1
+#  define IS_TERMINAL(File) (0 != isatty(fileno(File)))
+#elif defined(_WIN32)
+#  include <io.h>
+#  define INPUT_MMAP 0
+#  define IS_TERMINAL(File) (0 != _isatty(_fileno(File)))
+#else
+#  define INPUT_MMAP 0
+#  define IS_TERMINAL(File) true
+#endif /* unix */
+
+#define MIN_CAPACITY (PSTR_MAX_LEN + PVM_INPUT_MAX_NUMBER)
+#define IS_SPACE(Ch) (' ' == (Ch) || '\n' == (Ch) || '\t' == (Ch) || '\r' == (Ch) || '\v' == (Ch) || '\f' == (Ch))
+#define IS_DIGIT(Ch) ((unsigned)(Ch) - '0' < 10)
+
+
+
+PVMInput PVMInputInit(USize Capacity)
+{
+    PVMInput In = {
+        .File = NULL,
+        .Curr = NULL,
+        .End = NULL,
+        .Buffer = NULL,
+        .Capacity = Capacity < MIN_CAPACITY ? MIN_CAPACITY : Capacity,
+        .Mapping = NULL,
+        .MappingSize = 0,
+        .Eof = false,
+        .LineByLine = false,
+        .Tie = NULL,
+    };
+    return In;
+}
+
+
+/* gives the unparsed part of a mapped file back to its FILE */
+static void InputRelease(PVMInput *In)
+{
+#if INPUT_MMAP
+    if (NULL != In->Mapping)
+    {
+        fseeko(In->File, In->Curr - In->Mapping, SEEK_SET);
+        munmap(In->Mapping, In->MappingSize);
+        In->Mapping = NULL;
+        In->MappingSize = 0;
+    }
+#endif /* INPUT_MMAP */
+    In->Curr = NULL;
+    In->End = NULL;
+    In->Eof = false;
+}
+
+void PVMInputDeinit(PVMInput *In)
+{
+    PASCAL_NONNULL(In);
+    InputRelease(In);
+    MemDeallocate(In->Buffer);
+    PVMOutput *Tie = In->Tie;
+    *In = PVMInputInit(In->Capacity);
+    In->Tie = Tie;
+}
+
+
+void PVMInputSetFile(PVMInput *In, FILE *File)
+{
+    PASCAL_NONNULL(In);
+    PASCAL_NONNULL(File);
+    if (File == In->File)
+        return;
+
+    InputRelease(In);
+    In->File = File;
+#if INPUT_MMAP
+    struct stat Stat;
+    off_t Pos = ftello(File);
+    if (0 == fstat(fileno(File), &Stat) && S_ISREG(Stat.st_mode)
+    && Stat.st_size > 0 && 0 <= Pos && Pos <= Stat.st_size)
+    {
+        USize Size = Stat.st_size;
+        U8 *Mapping = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fileno(File), 0);
+        if (MAP_FAILED != Mapping)
+        {
+            madvise(Mapping, Size, MADV_SEQUENTIAL);
+            In->Mapping = Mapping;
+            In->MappingSize = Size;
+            In->Curr = Mapping + Pos;
+            In->End = Mapping + Size;
+            In->Eof = true;
+            In->LineByLine = false;
+            return;
+        }
+    }
+#endif /* INPUT_MMAP */
+    In->LineByLine = IS_TERMINAL(File);
+}
+
+
+/* makes at least Want bytes from Curr contiguous unless the input ends first, returns how many there are */
+static USize InputFill(PVMInput *In, USize Want)
+{
+    USize Left = In->End - In->Curr;
+    if (Left >= Want || In->Eof)
+        return Left;
+
+    /* whoever is at the other end may be waiting for a prompt */
+    if (NULL != In->Tie)
+        PVMOutputFlush(In->Tie);
+    if (NULL == In->Buffer)
+        In->Buffer = MemAllocate(In->Capacity);
+    if (Left)
+        memmove(In->Buffer, In->Curr, Left);
+
+    while (Left < Want && !In->Eof)
+    {
+        U8 *Free = In->Buffer + Left;
+        USize Room = In->Capacity - Left;
+        USize Count = 0;
+        if (In->LineByLine)
+        {
+            int Ch;
+            while (Count < Room && EOF != (Ch = getc(In->File)))
+            {
+                Free[Count++] = Ch;
+                if ('\n' == Ch)
+                    break;
+            }
+        }
+        else
+        {
+            Count = fread(Free, 1, Room, In->File);
+        }
+        In->Eof = 0 == Count;
+        Left += Count;
+    }
+    In->Curr = In->Buffer;
+    In->End = In->Buffer + Left;
+    return Left;
+}
+
+/* the next unparsed byte, -1 at the end of the input */
+static int InputPeek(PVMInput *In)
+{
+    if (In->Curr == In->End && 0 == InputFill(In, 1))
+        return -1;
+    return *In->Curr;
+}
+
+static void InputSkipSpace(PVMInput *In)
+{
+    int Ch;
+    while (-1 != (Ch = InputPeek(In)) && IS_SPACE(Ch))
+        In->Curr++;
+}
+
+/* a number has to end at a space or the end of the input */
+static bool InputNumberEnds(const PVMInput *In, const U8 *At)
+{
+    return At == In->End || IS_SPACE(*At);
+}
+
+
+
+/* fails if the value does not fit in Type */
+static bool ParseInteger(PVMInput *In, IntegralType Type, U64 *Value)
+{
+    InputSkipSpace(In);
+    InputFill(In, PVM_INPUT_MAX_NUMBER);
+    const U8 *Ptr = In->Curr;
+    const U8 *End = In->End;
+    *Value = 0;
+    /* nothing left reads 0 */
+    if (Ptr == End)
+        return true;
+
+    bool Negative = '-' == *Ptr;
+    if (Negative || '+' == *Ptr)
+        Ptr++;
+    const U8 *Digits = Ptr;
+    /* the magnitude of the most negative value is one more than the largest value */
+    UInt Bits = 8*IntegralTypeSize(Type);
+    U64 Max = IntegralTypeIsSigned(Type)
+        ? ((U64)1 << (Bits - 1)) - 1 + Negative
+        : Negative ? 0 : ~(U64)0 >> (64 - Bits);
+    U64 Result = 0;
+    while (Ptr < End && IS_DIGIT(*Ptr))
+    {
+        U64 Digit = *Ptr - '0';
+        if (Digit > Max || Result > (Max - Digit) / 10)
+            return false;
+        Result = Result*10 + Digit;
+        Ptr++;
+    }
+    if (Ptr == Digits || !InputNumberEnds(In, Ptr))
+        return false;
+
+    In->Curr = Ptr;
+    *Value = Negative ? -Result : Result;
+    return true;
+}
+
+
+/* parsed straight from the window when the value is exact in a double,
+ * i.e. an integer below 2^53 times or divided by a power of 10 that is exact itself,
+ * everything else is copied out for strtod */
+static bool ParseFloat(PVMInput *In, F64 *Value)
+{
+    static const F64 sPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    InputSkipSpace(In);
+    InputFill(In, PVM_INPUT_MAX_NUMBER);
+    const U8 *Start = In->Curr;
+    const U8 *Ptr = Start;
+    const U8 *End = In->End;
+    if (End - Start > PVM_INPUT_MAX_NUMBER)
+        End = Start + PVM_INPUT_MAX_NUMBER;
+    *Value = 0;
+    if (Ptr == End)
+        return true;
+
+    bool Negative = '-' == *Ptr;
+    if (Negative || '+' == *Ptr)
+        Ptr++;
+
+    /* 19 significant digits fit in a U64, the rest only count towards the exponent */
+    U64 Mantissa = 0;
+    UInt Significant = 0;
+    int Exponent = 0;
+    bool Inexact = false;
+    UInt DigitCount = 0;
+    for (bool Fraction = false; Ptr < End; Ptr++)
+    {
+        if ('.' == *Ptr && !Fraction)
+        {
+            Fraction = true;
+            continue;
+        }
+        if (!IS_DIGIT(*Ptr))
+            break;
+
+        DigitCount++;
+        if (0 == Mantissa && '0' == *Ptr)
+        {
+            Exponent -= Fraction;
+        }
+        else if (Significant < 19)
+        {
+            Mantissa = Mantissa*10 + (*Ptr - '0');
+            Significant++;
+            Exponent -= Fraction;
+        }
+        else
+        {
+            Inexact |= '0' != *Ptr;
+            Exponent += !Fraction;
+        }
+    }
+    if (0 == DigitCount)
+        return false;
+
+    if (Ptr < End && ('e' == *Ptr || 'E' == *Ptr))
+    {
+        Ptr++;
+        bool NegativeExponent = Ptr < End && '-' == *Ptr;
+        if (Ptr < End && ('-' == *Ptr || '+' == *Ptr))
+            Ptr++;
+        if (Ptr == End || !IS_DIGIT(*Ptr))
+            return false;
+
+        int Exp = 0;
+        for (; Ptr < End && IS_DIGIT(*Ptr); Ptr++)
+        {
+            if (Exp < 100000)
+                Exp = Exp*10 + (*Ptr - '0');
+        }
+        Exponent += NegativeExponent ? -Exp : Exp;
+    }
+    if (!InputNumberEnds(In, Ptr))
+        return false;
+    In->Curr = Ptr;
+
+    F64 Result;
+    if (0 == Mantissa)
+    {
+        Result = 0;
+    }
+    else if (!Inexact && Mantissa <= (U64)1 << 53 && -22 <= Exponent && Exponent <= 22)
+    {
+        Result = (F64)Mantissa;
+        if (Exponent < 0)
+            Result /= sPow10[-Exponent];
+        else Result *= sPow10[Exponent];
+    }
+    else
+    {
+        char Text[PVM_INPUT_MAX_NUMBER + 1];
+        USize Len = Ptr - Start;
+        memcpy(Text, Start, Len);
+        Text[Len] = '\0';
+        *Value = strtod(Text, NULL);
+        return true;
+    }
+    *Value = Negative ? -Result : Result;
+    return true;
+}
+
+
+/* the rest of the line up to the string's capacity, the newline stays */
+static void ReadString(PVMInput *In, PascalStr *Str)
+{
+    U8 *Dst = PStrGetPtr(Str);
+    USize Len = 0;
+    int Ch;
+    while (Len < PSTR_MAX_LEN && -1 != (Ch = InputPeek(In)) && '\n' != Ch)
+    {
+        USize Count = In->End - In->Curr;
+        if (Count > PSTR_MAX_LEN - Len)
+            Count = PSTR_MAX_LEN - Len;
+        const U8 *Newline = memchr(In->Curr, '\n', Count);
+        if (NULL != Newline)
+            Count = Newline - In->Curr;
+
+        memcpy(Dst + Len, In->Curr, Count);
+        In->Curr += Count;
+        Len += Count;
+    }
+    /* \r\n */
+    if (Len && '\r' == Dst[Len - 1] && '\n' == InputPeek(In))
+        Len--;
+    PStrSetLen(Str, Len);
+}
+
+
+bool PVMInputValue(PVMInput *In, IntegralType Type, void *Dst)
+{
+    PASCAL_NONNULL(In);
+    PASCAL_NONNULL(Dst);
+
+#define STORE(CType, Value) do {\
+    CType Tmp_ = (CType)(Value);\
+    memcpy(Dst, &Tmp_, sizeof Tmp_);\
+} while (0)
+
+    switch (Type)
+    {
+    case TYPE_STRING: ReadString(In, Dst); break;
+    case TYPE_CHAR:
+    {
+        int Ch = InputPeek(In);
+        if (-1 == Ch)
+        {
+            Ch = PVM_INPUT_EOF_CHAR;
+        }
+        else In->Curr++;
+        STORE(U8, Ch);
+    } break;
+
+    case TYPE_I8:
+    case TYPE_I16:
+    case TYPE_I32:
+    case TYPE_I64:
+    case TYPE_U8:
+    case TYPE_U16:
+    case TYPE_U32:
+    case TYPE_U64:
+    {
+        U64 Value;
+        if (!ParseInteger(In, Type, &Value))
+            return false;
+        switch (IntegralTypeSize(Type))
+        {
+        case 1: STORE(U8, Value); break;
+        case 2: STORE(U16, Value); break;
+        case 4: STORE(U32, Value); break;
+        case 8: STORE(U64, Value); break;
+        }
+    } break;
+
+    case TYPE_F32:
+    case TYPE_F64:
+    {
+        F64 Value;
+        if (!ParseFloat(In, &Value))
+            return false;
+        if (TYPE_F32 == Type)
+            STORE(F32, Value);
+        else STORE(F64, Value);
+    } break;
+
+    case TYPE_FUNCTION:
+    case TYPE_BOOLEAN:
+    case TYPE_POINTER:
+    case TYPE_COUNT:
+    case TYPE_RECORD:
+    case TYPE_STATIC_ARRAY:
+    case TYPE_FILE:
+    case TYPE_INVALID:
+    {
+        PASCAL_UNREACHABLE("Invalid type in %s", __func__);
+    } break;
+    }
+    return true;
+
+#undef STORE
+}
+
+
+void PVMInputSkipLine(PVMInput *In)
+{
+    PASCAL_NONNULL(In);
+    while (-1 != InputPeek(In))
+    {
+        const U8 *Newline = memchr(In->Curr, '\n', In->End - In->Curr);
+        if (NULL != Newline)
+        {
+            In->Curr = Newline + 1;
+            return;
+        }
+        In->Curr = In->End;
+    }
+}
+
+bool PVMInputEof(PVMInput *In)
+{
+    PASCAL_NONNULL(In);
+    return -1 == InputPeek(In);
+}
+
+bool PVMInputEoln(PVMInput *In)
+{
+    PASCAL_NONNULL(In);
+    int Ch = InputPeek(In);
+    return -1 == Ch || '\n' == Ch || '\r' == Ch;
+}
+
+
+#undef INPUT_MMAP
+#undef IS_TERMINAL
+#undef MIN_CAPACITY
+#undef IS_SPACE
+#undef IS_DIGIT
+
@@ -0,0 +1,1810 @@
+
+
+#include <stddef.h>
+
+#include "Common.h"
+#include "Memory.h"
+#include "PVM/Jit.h"
+#include "PVM/Decoder.h"
+#include "PVM/Disassembler.h"
+#include "PVM/Elf.h"
+#include "PVM/Guard.h"
+
+
+#if PVM_JIT_AVAILABLE
+#include <sys/mman.h>
+
+
+/*
+ * Register usage of the generated code:
+ *  rbx         PascalVM *, registers that are not pinned and all of F are accessed through it
+ *  r8-r11      R0-R3
+ *  rsi, rdi    R4, R5
+ *  r12         GP
+ *  r13         FP
+ *  r15         SP
+ *  r14         host rsp on entry, used to get out of the code from any call depth
+ *  rbp         holds rsp while a C function is called (the stack has to be 16 byte aligned)
+ *  rax, rcx, rdx   scratch
+ * The pinned registers are written back to PVM->R before calling into C and when leaving the code.
+ * PVM calls use the host's call/ret, the return stack of the PVM is still maintained
+ * so that callstack overflow is detected the same way the interpreter does
+ */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define R8  8
+#define R9  9
+#define R10 10
+#define R11 11
+#define R12 12
+#define R13 13
+#define R15 15
+#define NOT_PINNED 0xFF
+
+/* EmitOp flags */
+#define JIT_32 0
+#define JIT_64 0x01     /* REX.W */
+#define JIT_16 0x02     /* operand size prefix */
+#define JIT_BYTE 0x04   /* a byte register is involved, spl/bpl/sil/dil need a REX prefix */
+
+#define R_DISP(Reg) (I32)(offsetof(PascalVM, R) + (Reg)*sizeof(PVMGPR))
+#define F_DISP(Reg) (I32)(offsetof(PascalVM, F) + (Reg)*sizeof(PVMFPR))
+#define CONDITION_DISP (I32)offsetof(PascalVM, Condition)
+#define RETSTACK_VAL_DISP (I32)offsetof(PascalVM, RetStack.Val)
+#define RETSTACK_START_DISP (I32)offsetof(PascalVM, RetStack.Start)
+#define RETSTACK_END_DISP (I32)offsetof(PascalVM, RetStack.End)
+#define STACK_END_DISP (I32)offsetof(PascalVM, Stack.End)
+#define ERROR_PC_DISP (I32)offsetof(PascalVM, Error.PC)
+#define ERROR_LINE_DISP (I32)offsetof(PascalVM, Error.Line)
+
+/* x86 condition codes */
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_B 0x2
+#define CC_AE 0x3
+#define CC_A 0x7
+#define CC_P 0xA
+#define CC_L 0xC
+#define CC_NONE 0xFF
+
+/* the longest instruction sequence (pshl of 8 registers) is well below this */
+#define MAX_NATIVE_SIZE_PER_INS 192
+#define ERROR_EXIT_SIZE 20
+
+PASCAL_STATIC_ASSERT(sizeof(PVMFPR) == sizeof(PVMGPR), "push/pop assumes 8 byte registers");
+
+static const U8 sPinned[PVM_REG_COUNT] = {
+    R8, R9, R10, R11, RSI, RDI,
+    NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED,
+    [PVM_REG_GP] = R12,
+    [PVM_REG_FP] = R13,
+    [PVM_REG_SP] = R15,
+    NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED,
+    NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED, NOT_PINNED,
+};
+
+
+/* an x86 r/m operand: a host register, or [Reg + Disp] */
+typedef struct JitRM
+{
+    bool IsReg;
+    U8 Reg;
+    I32 Disp;
+} JitRM;
+#define RM_REG(Reg_) (JitRM) { .IsReg = true, .Reg = Reg_ }
+#define RM_MEM(Base_, Disp_) (JitRM) { .IsReg = false, .Reg = Base_, .Disp = Disp_ }
+
+typedef struct JitFixup
+{
+    U32 At;             /* where the rel32 is */
+    U32 TargetIndex;    /* index into Chunk->Decoded.Ins */
+} JitFixup;
+
+typedef struct JitEmitter
+{
+    U8 *Code;
+    USize Count, Cap;
+
+    PVMChunk *Chunk;
+    U32 *NativeOffset; /* decoded instruction index -> offset into Code */
+    JitFixup *Fixup;
+    U32 FixupCount;
+    bool *IsTarget;
+
+    U32 ExitStub, ExitOkStub, SaveStub, LoadStub;
+    UInt LastCC; /* condition of the last compare if the host flags still hold it */
+
+    /* the code goes into an executable instead of running in this process, it cannot call into the host */
+    bool Standalone;
+    U32 WriteStub;
+    const PVMDecodedIns *Unsupported; /* first instruction that would have needed the host */
+} JitEmitter;
+
+typedef PVMReturnValue (*JitEntry)(PascalVM *PVM, void *NativeEntryPoint);
+typedef PVMReturnValue (*JitExternal)(PascalVM *PVM, PVMChunk *Chunk, PVMDecodedIns *Ins);
+
+
+
+static void Emit8(JitEmitter *Emitter, UInt Byte)
+{
+    PASCAL_ASSERT(Emitter->Count < Emitter->Cap, "JIT buffer is too small");
+    Emitter->Code[Emitter->Count++] = Byte;
+}
+
+static void Emit32(JitEmitter *Emitter, U32 DWord)
+{
+    for (UInt i = 0; i < 4; i++)
+        Emit8(Emitter, (DWord >> i*8) & 0xFF);
+}
+
+static void Emit64(JitEmitter *Emitter, U64 QWord)
+{
+    Emit32(Emitter, QWord);
+    Emit32(Emitter, QWord >> 32);
+}
+
+static void EmitBytes(JitEmitter *Emitter, UInt Count, const U8 *Bytes)
+{
+    for (UInt i = 0; i < Count; i++)
+        Emit8(Emitter, Bytes[i]);
+}
+#define EMIT(Emitter, ...) EmitBytes(Emitter, sizeof((U8[]){__VA_ARGS__}), (const U8[]){__VA_ARGS__})
+
+static void PatchRel32(JitEmitter *Emitter, U32 At, U32 Target)
+{
+    I32 Rel = (I32)Target - (I32)(At + 4);
+    memcpy(&Emitter->Code[At], &Rel, sizeof Rel);
+}
+
+/* Op Reg, Rm; Reg is a host register or the /digit of Op, memory operands always use a disp32 */
+static void EmitOp(JitEmitter *Emitter, UInt Flags, UInt OpLen, const U8 *Op, UInt Reg, JitRM Rm)
+{
+    if (Flags & JIT_16)
+        Emit8(Emitter, 0x66);
+
+    UInt Rex = 0x40
+        | ((Flags & JIT_64) ? 0x08 : 0)
+        | ((Reg >> 3) & 1) << 2
+        | ((Rm.Reg >> 3) & 1);
+    bool NeedsRex = (Flags & JIT_BYTE)
+        && ((Reg >= 4 && Reg < 8) || (Rm.IsReg && Rm.Reg >= 4 && Rm.Reg < 8));
+    if (0x40 != Rex || NeedsRex)
+        Emit8(Emitter, Rex);
+
+    EmitBytes(Emitter, OpLen, Op);
+    if (Rm.IsReg)
+    {
+        Emit8(Emitter, 0xC0 | (Reg & 7) << 3 | (Rm.Reg & 7));
+    }
+    else
+    {
+        Emit8(Emitter, 0x80 | (Reg & 7) << 3 | (Rm.Reg & 7));
+        if (4 == (Rm.Reg & 7)) /* rsp and r12 need a SIB byte */
+            Emit8(Emitter, 0x24);
+        Emit32(Emitter, Rm.Disp);
+    }
+}
+#define EMIT_OP(Emitter, Flags, Reg, Rm, ...)\
+    EmitOp(Emitter, Flags, sizeof((U8[]){__VA_ARGS__}), (const U8[]){__VA_ARGS__}, Reg, Rm)
+
+static JitRM RegRM(UInt PvmReg)
+{
+    if (NOT_PINNED != sPinned[PvmReg])
+        return RM_REG(sPinned[PvmReg]);
+    return RM_MEM(RBX, R_DISP(PvmReg));
+}
+
+/* host register that R[PvmReg] is in, loaded into Scratch if it is not pinned */
+static UInt RegIn(JitEmitter *Emitter, UInt Flags, UInt PvmReg, UInt Scratch)
+{
+    if (NOT_PINNED != sPinned[PvmReg])
+        return sPinned[PvmReg];
+    EMIT_OP(Emitter, Flags, Scratch, RegRM(PvmReg), 0x8B);
+    return Scratch;
+}
+
+/* host register that R[PvmReg] should be computed into, RegOut() writes it back if needed */
+static UInt RegDst(UInt PvmReg, UInt Scratch)
+{
+    if (NOT_PINNED != sPinned[PvmReg])
+        return sPinned[PvmReg];
+    return Scratch;
+}
+
+static void RegOut(JitEmitter *Emitter, UInt Flags, UInt PvmReg, UInt Reg)
+{
+    if (Reg != sPinned[PvmReg])
+        EMIT_OP(Emitter, Flags, Reg, RegRM(PvmReg), 0x89);
+}
+
+static void EmitRel32(JitEmitter *Emitter, U32 NativeTarget)
+{
+    Emit32(Emitter, 0);
+    PatchRel32(Emitter, Emitter->Count - 4, NativeTarget);
+}
+
+static void EmitJmp(JitEmitter *Emitter, U32 NativeTarget)
+{
+    Emit8(Emitter, 0xE9);
+    EmitRel32(Emitter, NativeTarget);
+}
+
+static void EmitCallStub(JitEmitter *Emitter, U32 NativeTarget)
+{
+    Emit8(Emitter, 0xE8);
+    EmitRel32(Emitter, NativeTarget);
+}
+
+static void EmitJccTo(JitEmitter *Emitter, UInt CC, U32 NativeTarget)
+{
+    EMIT(Emitter, 0x0F, 0x80 | CC);
+    EmitRel32(Emitter, NativeTarget);
+}
+
+/* a rel32 to a PVM instruction, resolved once every instruction has been emitted */
+static void EmitFixup(JitEmitter *Emitter, const PVMDecodedIns *Target)
+{
+    Emitter->Fixup[Emitter->FixupCount++] = (JitFixup) {
+        .At = Emitter->Count,
+        .TargetIndex = Target - Emitter->Chunk->Decoded.Ins,
+    };
+    Emit32(Emitter, 0);
+}
+
+/* records where the error happened and leaves the generated code, ERROR_EXIT_SIZE bytes */
+static void EmitErrorExit(JitEmitter *Emitter, PVMReturnValue Error, U32 StreamOffset)
+{
+    USize Start = Emitter->Count;
+    if (Emitter->Standalone)
+    {
+        /* the debug info does not go into the executable, look the line up now */
+        EMIT_OP(Emitter, JIT_32, 0, RM_MEM(RBX, ERROR_LINE_DISP), 0xC7);
+        Emit32(Emitter, PVMGetLine(Emitter->Chunk, StreamOffset));
+    }
+    else
+    {
+        EMIT_OP(Emitter, JIT_32, 0, RM_MEM(RBX, ERROR_PC_DISP), 0xC7);
+        Emit32(Emitter, StreamOffset);
+    }
+    Emit8(Emitter, 0xB8); /* mov eax, imm32 */
+    Emit32(Emitter, Error);
+    EmitJmp(Emitter, Emitter->ExitStub);
+    PASCAL_ASSERT(Emitter->Count - Start == ERROR_EXIT_SIZE, "ERROR_EXIT_SIZE does not match");
+}
+
+/* the entry point, exit path and register spilling, the code starts with these */
+static void EmitStubs(JitEmitter *Emitter)
+{
+    /* PVMReturnValue Entry(PascalVM *rdi, void *rsi) */
+    EMIT(Emitter,
+        0x53,                       /* push rbx */
+        0x55,                       /* push rbp */
+        0x41, 0x54,                 /* push r12 */
+        0x41, 0x55,                 /* push r13 */
+        0x41, 0x56,                 /* push r14 */
+        0x41, 0x57,                 /* push r15 */
+        0x48, 0x83, 0xEC, 0x08,     /* sub rsp, 8 */
+        0x48, 0x89, 0xFB,           /* mov rbx, rdi */
+        0x48, 0x89, 0xF2,           /* mov rdx, rsi */
+        0x49, 0x89, 0xE6,           /* mov r14, rsp */
+        0xE8, 0, 0, 0, 0            /* call LoadStub, patched below */
+    );
+    U32 CallLoad = Emitter->Count;
+    /* returning from the frame it was entered in is the same as exiting */
+    EMIT(Emitter,
+        0xFF, 0xD2,                 /* call rdx */
+        0xE9, 0, 0, 0, 0            /* jmp ExitOkStub, patched below */
+    );
+    U32 JmpExitOk = Emitter->Count;
+
+    /* the pinned registers -> PVM->R */
+    Emitter->SaveStub = Emitter->Count;
+    for (UInt i = 0; i < PVM_REG_COUNT; i++)
+    {
+        if (NOT_PINNED != sPinned[i])
+            EMIT_OP(Emitter, JIT_64, sPinned[i], RM_MEM(RBX, R_DISP(i)), 0x89);
+    }
+    Emit8(Emitter, 0xC3);
+
+    /* PVM->R -> the pinned registers */
+    Emitter->LoadStub = Emitter->Count;
+    for (UInt i = 0; i < PVM_REG_COUNT; i++)
+    {
+        if (NOT_PINNED != sPinned[i])
+            EMIT_OP(Emitter, JIT_64, sPinned[i], RM_MEM(RBX, R_DISP(i)), 0x8B);
+    }
+    Emit8(Emitter, 0xC3);
+    PatchRel32(Emitter, CallLoad - 4, Emitter->LoadStub);
+
+    Emitter->ExitOkStub = Emitter->Count;
+    PatchRel32(Emitter, JmpExitOk - 4, Emitter->ExitOkStub);
+    EMIT(Emitter, 0x31, 0xC0);      /* xor eax, eax */
+
+    /* eax has the return value */
+    Emitter->ExitStub = Emitter->Count;
+    EmitCallStub(Emitter, Emitter->SaveStub);
+    EMIT(Emitter,
+        0x4C, 0x89, 0xF4,           /* mov rsp, r14 */
+        0x48, 0x83, 0xC4, 0x08,     /* add rsp, 8 */
+        0x41, 0x5F,                 /* pop r15 */
+        0x41, 0x5E,                 /* pop r14 */
+        0x41, 0x5D,                 /* pop r13 */
+        0x41, 0x5C,                 /* pop r12 */
+        0x5D,                       /* pop rbp */
+        0x5B,                       /* pop rbx */
+        0xC3                        /* ret */
+    );
+}
+
+
+
+static void EmitCallExternal(JitEmitter *Emitter, JitExternal Function, const PVMDecodedIns *Ins)
+{
+    if (Emitter->Standalone)
+    {
+        if (NULL == Emitter->Unsupported)
+            Emitter->Unsupported = Ins;
+        return;
+    }
+    PASCAL_ASSERT(PVMDecodedOp(Ins) == PVM_GET_OP(Ins->Opcode), "superinstruction would run both halves");
+    U64 FunctionAddr;
+    memcpy(&FunctionAddr, &Function, sizeof FunctionAddr);
+
+    EmitCallStub(Emitter, Emitter->SaveStub);
+    EMIT(Emitter, 0x48, 0x89, 0xDF);    /* mov rdi, rbx */
+    EMIT(Emitter, 0x48, 0xBE);          /* mov rsi, imm64 */
+    Emit64(Emitter, (uintptr_t)Emitter->Chunk);
+    EMIT(Emitter, 0x48, 0xBA);          /* mov rdx, imm64 */
+    Emit64(Emitter, (uintptr_t)Ins);
+    EMIT(Emitter, 0x48, 0xB8);          /* mov rax, imm64 */
+    Emit64(Emitter, FunctionAddr);
+    EMIT(Emitter,
+        0x48, 0x89, 0xE5,               /* mov rbp, rsp */
+        0x48, 0x83, 0xE4, 0xF0,         /* and rsp, -16 */
+        0xFF, 0xD0,                     /* call rax */
+        0x48, 0x89, 0xEC                /* mov rsp, rbp */
+    );
+    EmitCallStub(Emitter, Emitter->LoadStub);
+    EMIT(Emitter, 0x85, 0xC0);          /* test eax, eax */
+    /* PVMExecuteInstruction already filled in the error info */
+    EmitJccTo(Emitter, CC_NE, Emitter->ExitStub);
+}
+
+/* pushes a frame on the PVM's return stack, the host call comes after this.
+ * Running off the end faults in the guard pages, PVMJitEnter reports it, 
+ * executables have no signal handler and compare against the end instead */
+static void EmitSaveFrame(JitEmitter *Emitter, U32 StreamOffset)
+{
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_VAL_DISP), 0x8B);
+    if (Emitter->Standalone)
+    {
+        EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_END_DISP), 0x3B); /* cmp rax, [End] */
+        EMIT(Emitter, 0x75, ERROR_EXIT_SIZE); /* jne */
+        EmitErrorExit(Emitter, PVM_CALLSTACK_OVERFLOW, StreamOffset);
+    }
+    UInt Fp = RegIn(Emitter, JIT_64, PVM_REG_FP, RCX);
+    EMIT_OP(Emitter, JIT_64, Fp, RM_MEM(RAX, offsetof(PVMSaveFrame, FP)), 0x89);
+    EMIT_OP(Emitter, JIT_64, 0, RM_MEM(RBX, RETSTACK_VAL_DISP), 0x83); /* add qword [Val], sizeof(PVMSaveFrame) */
+    Emit8(Emitter, sizeof(PVMSaveFrame));
+}
+
+static void EmitReturn(JitEmitter *Emitter)
+{
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_VAL_DISP), 0x8B);
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_START_DISP), 0x3B);
+    /* global scope, exit */
+    EmitJccTo(Emitter, CC_E, Emitter->ExitOkStub);
+
+    /* stack scope, return */
+    EMIT(Emitter, 0x48, 0x83, 0xE8, sizeof(PVMSaveFrame)); /* sub rax, imm8 */
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_VAL_DISP), 0x89);
+    UInt Fp = RegIn(Emitter, JIT_64, PVM_REG_FP, RCX);
+    EMIT_OP(Emitter, JIT_64, RCX, RM_MEM(Fp, -(I32)sizeof(PVMGPR)), 0x8D); /* lea rcx, [Fp - 8] */
+    RegOut(Emitter, JIT_64, PVM_REG_SP, RCX);
+    UInt NewFp = RegDst(PVM_REG_FP, RCX);
+    EMIT_OP(Emitter, JIT_64, NewFp, RM_MEM(RAX, offsetof(PVMSaveFrame, FP)), 0x8B);
+    RegOut(Emitter, JIT_64, PVM_REG_FP, NewFp);
+    Emit8(Emitter, 0xC3);
+}
+
+/* same as PVM_PROBE_FRAME in PVM.c */
+static void EmitEnter(JitEmitter *Emitter, U32 FrameSize, U32 StreamOffset)
+{
+    UInt Sp = RegIn(Emitter, JIT_64, PVM_REG_SP, RAX);
+    UInt Fp = RegDst(PVM_REG_FP, RCX);
+    EMIT_OP(Emitter, JIT_64, Fp, RM_MEM(Sp, sizeof(PVMGPR)), 0x8D); /* lea Fp, [Sp + 8] */
+    RegOut(Emitter, JIT_64, PVM_REG_FP, Fp);
+    EMIT_OP(Emitter, JIT_64, 0, RegRM(PVM_REG_SP), 0x81); /* add Sp, imm32 */
+    Emit32(Emitter, FrameSize);
+
+    Sp = RegIn(Emitter, JIT_64, PVM_REG_SP, RAX);
+    if (Emitter->Standalone || FrameSize > PVM_GUARD_SIZE)
+    {
+        EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(Sp, sizeof(PVMGPR)), 0x8D);    /* lea rax, [Sp + 8] */
+        EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, STACK_END_DISP), 0x3B);   /* cmp rax, [End] */
+        EMIT(Emitter, 0x76, ERROR_EXIT_SIZE); /* jbe */
+        EmitErrorExit(Emitter, PVM_CALLSTACK_OVERFLOW, StreamOffset);
+    }
+    else if (FrameSize)
+    {
+        EMIT_OP(Emitter, JIT_32, RAX, RM_MEM(Sp, 0), 0x8B); /* mov eax, [Sp], faults past the end */
+    }
+}
+
+/* same order as PUSH_MULTIPLE and POP_MULTIPLE in PVM.c, Base is 0, 8, 16 or 24 */
+static void EmitPushMultiple(JitEmitter *Emitter, bool Float, UInt Base, UInt RegList)
+{
+    EMIT_OP(Emitter, JIT_64, RAX, RegRM(PVM_REG_SP), 0x8B);
+    for (UInt i = 0; i < 8; i++)
+    {
+        if (0 == (RegList & (1u << i)))
+            continue;
+
+        EMIT(Emitter, 0x48, 0x83, 0xC0, sizeof(PVMGPR)); /* add rax, 8 */
+        UInt Value = RCX;
+        if (Float)
+            EMIT_OP(Emitter, JIT_64, RCX, RM_MEM(RBX, F_DISP(Base + i)), 0x8B);
+        else Value = RegIn(Emitter, JIT_64, Base + i, RCX);
+        EMIT_OP(Emitter, JIT_64, Value, RM_MEM(RAX, 0), 0x89);
+    }
+    RegOut(Emitter, JIT_64, PVM_REG_SP, RAX);
+}
+
+static void EmitPopMultiple(JitEmitter *Emitter, bool Float, UInt Base, UInt RegList)
+{
+    EMIT_OP(Emitter, JIT_64, RAX, RegRM(PVM_REG_SP), 0x8B);
+    for (UInt i = 8; i-- > 0; )
+    {
+        if (0 == (RegList & (1u << i)))
+            continue;
+
+        JitRM Dst = Float
+            ? RM_MEM(RBX, F_DISP(Base + i))
+            : RegRM(Base + i);
+        UInt Value = Dst.IsReg? Dst.Reg : RCX;
+        EMIT_OP(Emitter, JIT_64, Value, RM_MEM(RAX, 0), 0x8B);
+        if (!Dst.IsReg)
+            EMIT_OP(Emitter, JIT_64, Value, Dst, 0x89);
+        EMIT(Emitter, 0x48, 0x83, 0xE8, sizeof(PVMGPR)); /* sub rax, 8 */
+    }
+    RegOut(Emitter, JIT_64, PVM_REG_SP, RAX);
+}
+
+/* 
+ * 32 bit ops on a host register clear its upper half while the interpreter leaves it alone,
+ * the compiler uses 32 bit add/sub to adjust the stack (e.g. addiu16 rsp), 
+ * so those are done in 64 bits on the pinned GP, FP and SP, the lower half comes out the same.
+ * Doing the same for R0-R5 was measured to be a lot slower for no gain
+ */
+static UInt AddSubFlags(UInt PvmReg)
+{
+    return PvmReg >= PVM_REG_GP && NOT_PINNED != sPinned[PvmReg] ? JIT_64 : JIT_32;
+}
+
+/* R[Rd] op= R[Rs], Op is the 'op r/m, r' form */
+static void EmitBinary(JitEmitter *Emitter, UInt Flags, U8 Op, const PVMDecodedIns *Ins)
+{
+    UInt Src = RegIn(Emitter, Flags, Ins->Rs, RAX);
+    EMIT_OP(Emitter, Flags, Src, RegRM(Ins->Rd), Op);
+}
+
+static void EmitMul(JitEmitter *Emitter, UInt Flags, const PVMDecodedIns *Ins)
+{
+    UInt Dst = RegIn(Emitter, Flags, Ins->Rd, RAX);
+    EMIT_OP(Emitter, Flags, Dst, RegRM(Ins->Rs), 0x0F, 0xAF); /* imul Dst, Rs */
+    RegOut(Emitter, Flags, Ins->Rd, Dst);
+}
+
+/* R[Rd] = R[Rs] op R[Rt], Op is the 'op r, r/m' form. 
+ * Computed in rax if Rd is Rt, copying Rs into it would lose Rt */
+static void EmitBinary3(JitEmitter *Emitter, UInt Flags, const U8 *Op, UInt OpLen, const PVMDecodedIns *Ins)
+{
+    UInt Rt = Ins->As.Imm;
+    UInt Dst = Rt == Ins->Rd ? RAX : RegDst(Ins->Rd, RAX);
+    EMIT_OP(Emitter, Flags, Dst, RegRM(Ins->Rs), 0x8B);
+    EmitOp(Emitter, Flags, OpLen, Op, Dst, RegRM(Rt));
+    RegOut(Emitter, Flags, Ins->Rd, Dst);
+}
+#define EMIT_BINARY3(Emitter, Flags, Ins, ...)\
+    EmitBinary3(Emitter, Flags, (const U8[]){__VA_ARGS__}, sizeof((U8[]){__VA_ARGS__}), Ins)
+
+/* R[Rd] = R[Lhs] / R[Rhs] (or the remainder), Lhs is Rd and Rhs is Rs unless Ins is a three-operand instruction */
+static void EmitDiv(JitEmitter *Emitter, UInt Flags, bool Signed, bool Remainder, const PVMDecodedIns *Ins)
+{
+    bool ThreeOperand = PVMIsThreeOperand(PVMDecodedOp(Ins));
+    UInt Lhs = ThreeOperand ? Ins->Rs : Ins->Rd;
+    UInt Rhs = ThreeOperand ? (UInt)Ins->As.Imm : Ins->Rs;
+    UInt Divisor = RegIn(Emitter, Flags, Rhs, RCX);
+    EMIT_OP(Emitter, Flags, Divisor, RM_REG(Divisor), 0x85); /* test Divisor, Divisor */
+    EMIT(Emitter, 0x75, ERROR_EXIT_SIZE); /* jne */
+    EmitErrorExit(Emitter, PVM_DIVISION_BY_0, Ins->StreamOffset);
+
+    EMIT_OP(Emitter, Flags, RAX, RegRM(Lhs), 0x8B);
+    if (Signed)
+    {
+        if (Flags & JIT_64)
+            Emit8(Emitter, 0x48);
+        Emit8(Emitter, 0x99);                                   /* cdq/cqo */
+        EMIT_OP(Emitter, Flags, 7, RM_REG(Divisor), 0xF7);      /* idiv Divisor */
+    }
+    else
+    {
+        EMIT(Emitter, 0x31, 0xD2);                              /* xor edx, edx */
+        EMIT_OP(Emitter, Flags, 6, RM_REG(Divisor), 0xF7);      /* div Divisor */
+    }
+    EMIT_OP(Emitter, Flags, Remainder ? RDX : RAX, RegRM(Ins->Rd), 0x89);
+}
+
+/* Condition = R[Rd] cc R[Rs], leaves the host flags set for a following branch */
+static void EmitCompare(JitEmitter *Emitter, UInt Flags, UInt CC, const PVMDecodedIns *Ins)
+{
+    UInt Lhs = RegIn(Emitter, Flags, Ins->Rd, RAX);
+    EMIT_OP(Emitter, Flags, Lhs, RegRM(Ins->Rs), 0x3B); /* cmp Lhs, Rs */
+    EMIT_OP(Emitter, JIT_32, 0, RM_MEM(RBX, CONDITION_DISP), 0x0F, 0x90 | CC); /* setcc [Condition] */
+    Emitter->LastCC = CC;
+}
+
+/* OpExt is the /digit of the shift group */
+static void EmitShiftImm(JitEmitter *Emitter, UInt Flags, UInt OpExt, const PVMDecodedIns *Ins)
+{
+    EMIT_OP(Emitter, Flags, OpExt, RegRM(Ins->Rd), 0xC1);
+    Emit8(Emitter, Ins->Rs);
+}
+
+static void EmitShiftReg(JitEmitter *Emitter, UInt Flags, UInt OpExt, const PVMDecodedIns *Ins)
+{
+    if (PVMIsThreeOperand(PVMDecodedOp(Ins)))
+    {
+        /* the count is in cl before Rd is written, Rd can be Rt */
+        EMIT_OP(Emitter, JIT_32, RCX, RegRM(Ins->As.Imm), 0x8B);
+        UInt Dst = RegDst(Ins->Rd, RAX);
+        EMIT_OP(Emitter, Flags, Dst, RegRM(Ins->Rs), 0x8B);
+        EMIT_OP(Emitter, Flags, OpExt, RM_REG(Dst), 0xD3);
+        RegOut(Emitter, Flags, Ins->Rd, Dst);
+        return;
+    }
+    EMIT_OP(Emitter, JIT_32, RCX, RegRM(Ins->Rs), 0x8B);
+    EMIT_OP(Emitter, Flags, OpExt, RegRM(Ins->Rd), 0xD3);
+}
+
+/* OpExt: 3 for neg, 2 for not */
+static void EmitUnary(JitEmitter *Emitter, UInt Flags, UInt OpExt, const PVMDecodedIns *Ins)
+{
+    UInt Dst = RegDst(Ins->Rd, RAX);
+    EMIT_OP(Emitter, Flags, Dst, RegRM(Ins->Rs), 0x8B);
+    EMIT_OP(Emitter, Flags, OpExt, RM_REG(Dst), 0xF7);
+    RegOut(Emitter, Flags, Ins->Rd, Dst);
+}
+
+static void EmitSetEz(JitEmitter *Emitter, UInt Flags, const PVMDecodedIns *Ins)
+{
+    EMIT(Emitter, 0x31, 0xC0);                              /* xor eax, eax */
+    EMIT_OP(Emitter, Flags, 7, RegRM(Ins->Rs), 0x83);       /* cmp Rs, 0 */
+    Emit8(Emitter, 0);
+    EMIT(Emitter, 0x0F, 0x94, 0xC0);                        /* sete al */
+    EMIT_OP(Emitter, Flags, RAX, RegRM(Ins->Rd), 0x89);
+}
+
+/* R[Rd] = Op [R[Rs] + offset], DstFlags is the size of Rd that is written */
+static void EmitLoad(JitEmitter *Emitter, UInt Flags, const U8 *Op, UInt OpLen, UInt DstFlags, const PVMDecodedIns *Ins)
+{
+    UInt Base = RegIn(Emitter, JIT_64, Ins->Rs, RAX);
+    UInt Dst = RegDst(Ins->Rd, RAX);
+    EmitOp(Emitter, Flags, OpLen, Op, Dst, RM_MEM(Base, (I32)Ins->As.Imm));
+    RegOut(Emitter, DstFlags, Ins->Rd, Dst);
+}
+#define EMIT_LOAD(Emitter, Flags, DstFlags, Ins, ...)\
+    EmitLoad(Emitter, Flags, (const U8[]){__VA_ARGS__}, sizeof((U8[]){__VA_ARGS__}), DstFlags, Ins)
+
+/* [R[Rs] + offset] = R[Rd] */
+static void EmitStore(JitEmitter *Emitter, UInt Flags, U8 Op, const PVMDecodedIns *Ins)
+{
+    UInt Base = RegIn(Emitter, JIT_64, Ins->Rs, RAX);
+    UInt Value = RegIn(Emitter, JIT_64, Ins->Rd, RCX);
+    EMIT_OP(Emitter, Flags, Value, RM_MEM(Base, (I32)Ins->As.Imm), Op);
+}
+
+/* memcpy(R[Rd], R[Rs], Size) with rep movsb, Size is R[Imm] or Imm itself */
+static void EmitMemcpy(JitEmitter *Emitter, bool SizeInReg, const PVMDecodedIns *Ins)
+{
+    EMIT_OP(Emitter, JIT_64, RAX, RegRM(Ins->Rd), 0x8B);
+    EMIT_OP(Emitter, JIT_64, RDX, RegRM(Ins->Rs), 0x8B);
+    if (SizeInReg)
+    {
+        EMIT_OP(Emitter, JIT_64, RCX, RegRM(Ins->As.Imm), 0x8B);
+    }
+    else
+    {
+        Emit8(Emitter, 0xB9); /* mov ecx, imm32 */
+        Emit32(Emitter, Ins->As.Imm);
+    }
+    EMIT(Emitter,
+        0x56,                   /* push rsi, R4 */
+        0x57,                   /* push rdi, R5 */
+        0x48, 0x89, 0xC7,       /* mov rdi, rax */
+        0x48, 0x89, 0xD6,       /* mov rsi, rdx */
+        0xF3, 0xA4,             /* rep movsb */
+        0x5F,                   /* pop rdi */
+        0x5E                    /* pop rsi */
+    );
+}
+
+/* R[Rd] = Op R[Rs], DstFlags is the size of Rd that is written */
+static void EmitMove(JitEmitter *Emitter, UInt Flags, const U8 *Op, UInt OpLen, UInt DstFlags, const PVMDecodedIns *Ins)
+{
+    UInt Dst = RegDst(Ins->Rd, RAX);
+    EmitOp(Emitter, Flags, OpLen, Op, Dst, RegRM(Ins->Rs));
+    RegOut(Emitter, DstFlags, Ins->Rd, Dst);
+}
+#define EMIT_MOVE(Emitter, Flags, DstFlags, Ins, ...)\
+    EmitMove(Emitter, Flags, (const U8[]){__VA_ARGS__}, sizeof((U8[]){__VA_ARGS__}), DstFlags, Ins)
+
+/* R[Rd] = Imm (64 bits) */
+static void EmitMovImm(JitEmitter *Emitter, UInt PvmReg, U64 Imm)
+{
+    if ((I64)Imm == (I32)Imm)
+    {
+        EMIT_OP(Emitter, JIT_64, 0, RegRM(PvmReg), 0xC7);
+        Emit32(Emitter, Imm);
+    }
+    else
+    {
+        UInt Dst = RegDst(PvmReg, RAX);
+        EMIT(Emitter, 0x48 | (Dst >> 3), 0xB8 | (Dst & 7)); /* mov Dst, imm64 */
+        Emit64(Emitter, Imm);
+        RegOut(Emitter, JIT_64, PvmReg, Dst);
+    }
+}
+
+static void EmitAddImm(JitEmitter *Emitter, UInt Flags, UInt PvmReg, U64 Imm)
+{
+    if ((I64)Imm == (I8)Imm || (!(Flags & JIT_64) && (I32)Imm == (I8)Imm))
+    {
+        EMIT_OP(Emitter, Flags, 0, RegRM(PvmReg), 0x83);
+        Emit8(Emitter, Imm);
+    }
+    else if (!(Flags & JIT_64) || (I64)Imm == (I32)Imm)
+    {
+        EMIT_OP(Emitter, Flags, 0, RegRM(PvmReg), 0x81);
+        Emit32(Emitter, Imm);
+    }
+    else
+    {
+        EMIT(Emitter, 0x48, 0xB8);
+        Emit64(Emitter, Imm);
+        EMIT_OP(Emitter, JIT_64, RAX, RegRM(PvmReg), 0x01);
+    }
+}
+
+/* branch on the condition flag, reuses the host flags when the compare was right before */
+static void EmitBranchOnCondition(JitEmitter *Emitter, UInt LastCC, bool IfTrue, const PVMDecodedIns *Ins)
+{
+    UInt CC = LastCC;
+    if (CC_NONE == CC)
+    {
+        EMIT_OP(Emitter, JIT_32, 7, RM_MEM(RBX, CONDITION_DISP), 0x80); /* cmp byte [Condition], 0 */
+        Emit8(Emitter, 0);
+        CC = CC_NE;
+    }
+    EMIT(Emitter, 0x0F, 0x80 | (IfTrue ? CC : CC ^ 1));
+    EmitFixup(Emitter, Ins->As.Target);
+}
+
+static void EmitBranchOnReg(JitEmitter *Emitter, UInt CC, const PVMDecodedIns *Ins)
+{
+    EMIT_OP(Emitter, JIT_32, 7, RegRM(Ins->Rd), 0x83); /* cmp dword Rd, 0 */
+    Emit8(Emitter, 0);
+    EMIT(Emitter, 0x0F, 0x80 | CC);
+    EmitFixup(Emitter, Ins->As.Target);
+}
+
+/* branch if R[Rd] cc R[Rs], or cc the immediate in Rs, the condition flag is left alone */
+static void EmitCompareAndBranch(JitEmitter *Emitter, UInt Flags, UInt CC, bool SmallImm, const PVMDecodedIns *Ins)
+{
+    if (SmallImm)
+    {
+        EMIT_OP(Emitter, Flags, 7, RegRM(Ins->Rd), 0x83); /* cmp Rd, imm8 */
+        Emit8(Emitter, BitSex64(Ins->Rs, 3));
+    }
+    else
+    {
+        UInt Lhs = RegIn(Emitter, Flags, Ins->Rd, RAX);
+        EMIT_OP(Emitter, Flags, Lhs, RegRM(Ins->Rs), 0x3B); /* cmp Lhs, Rs */
+    }
+    EMIT(Emitter, 0x0F, 0x80 | CC);
+    EmitFixup(Emitter, Ins->As.Target);
+}
+
+/* 
+ * branch if F[Rd] == F[Rs] (Cmp = CC_E), F[Rd] < F[Rs] (CC_B) or F[Rd] <= F[Rs] (CC_AE), 
+ * or if it's false when IfTrue is false: NaNs only take those 
+ */
+static void EmitFloatCompareAndBranch(JitEmitter *Emitter, bool Double, UInt Cmp, bool IfTrue, const PVMDecodedIns *Ins)
+{
+    UInt Lhs = Ins->Rd, Rhs = Ins->Rs;
+    if (CC_E != Cmp)
+    {
+        /* ucomis sets CF for unordered, so compare the other way around to only branch on ordered */
+        Lhs = Ins->Rs;
+        Rhs = Ins->Rd;
+    }
+    Emit8(Emitter, Double ? 0xF2 : 0xF3);
+    EMIT_OP(Emitter, JIT_32, 0, RM_MEM(RBX, F_DISP(Lhs)), 0x0F, 0x10);  /* movss/movsd xmm0, Lhs */
+    EMIT_OP(Emitter, Double ? JIT_16 : JIT_32, 0, RM_MEM(RBX, F_DISP(Rhs)), 0x0F, 0x2E); /* ucomiss/ucomisd xmm0, Rhs */
+
+    UInt CC = CC_B == Cmp ? CC_A : Cmp;
+    if (CC_E == Cmp)
+    {
+        /* unordered sets ZF too */
+        if (IfTrue)
+            EMIT(Emitter, 0x7A, 6); /* jp over the je */
+        else
+        {
+            EMIT(Emitter, 0x0F, 0x80 | CC_P);
+            EmitFixup(Emitter, Ins->As.Target);
+        }
+    }
+    EMIT(Emitter, 0x0F, 0x80 | (IfTrue ? CC : CC ^ 1));
+    EmitFixup(Emitter, Ins->As.Target);
+}
+
+
+
+static void EmitInstruction(JitEmitter *Emitter, PVMDecodedIns *Ins)
+{
+    UInt LastCC = Emitter->LastCC;
+    Emitter->LastCC = CC_NONE;
+    /* the interpreter's superinstructions are compiled one half at a time */
+    switch (PVMDecodedOp(Ins))
+    {
+    case OP_SYS:
+    {
+        switch (PVM_GET_SYS_OP(Ins->Opcode))
+        {
+        case OP_SYS_EXIT: EmitReturn(Emitter); break;
+        case OP_SYS_ENTER: EmitEnter(Emitter, Ins->As.Imm, Ins->StreamOffset); break;
+        case OP_SYS_WRITE:
+        {
+            if (Emitter->Standalone)
+            {
+                /* the stub tells the files apart by the FILE * the compiler put in R1 */
+                EMIT(Emitter, 0x48, 0xB8); /* mov rax, imm64 */
+                Emit64(Emitter, (uintptr_t)stderr);
+                EmitCallStub(Emitter, Emitter->WriteStub);
+            }
+            else EmitCallExternal(Emitter, PVMExecuteInstruction, Ins);
+        } break;
+        default: EmitCallExternal(Emitter, PVMExecuteInstruction, Ins); break;
+        }
+    } break;
+
+    case OP_ADD: EmitBinary(Emitter, AddSubFlags(Ins->Rd), 0x01, Ins); break;
+    case OP_SUB: EmitBinary(Emitter, AddSubFlags(Ins->Rd), 0x29, Ins); break;
+    case OP_AND: EmitBinary(Emitter, JIT_32, 0x21, Ins); break;
+    case OP_OR:  EmitBinary(Emitter, JIT_32, 0x09, Ins); break;
+    case OP_XOR: EmitBinary(Emitter, JIT_32, 0x31, Ins); break;
+    case OP_ADD64: EmitBinary(Emitter, JIT_64, 0x01, Ins); break;
+    case OP_SUB64: EmitBinary(Emitter, JIT_64, 0x29, Ins); break;
+    case OP_AND64: EmitBinary(Emitter, JIT_64, 0x21, Ins); break;
+    case OP_OR64:  EmitBinary(Emitter, JIT_64, 0x09, Ins); break;
+    case OP_XOR64: EmitBinary(Emitter, JIT_64, 0x31, Ins); break;
+    case OP_MUL:
+    case OP_IMUL: EmitMul(Emitter, JIT_32, Ins); break;
+    case OP_MUL64:
+    case OP_IMUL64: EmitMul(Emitter, JIT_64, Ins); break;
+    case OP_DIV:  EmitDiv(Emitter, JIT_32, false, false, Ins); break;
+    case OP_IDIV: EmitDiv(Emitter, JIT_32, true, false, Ins); break;
+    case OP_MOD:  EmitDiv(Emitter, JIT_32, false, true, Ins); break;
+    case OP_DIV64:  EmitDiv(Emitter, JIT_64, false, false, Ins); break;
+    case OP_IDIV64: EmitDiv(Emitter, JIT_64, true, false, Ins); break;
+    case OP_MOD64:  EmitDiv(Emitter, JIT_64, false, true, Ins); break;
+    case OP_ADD3: EMIT_BINARY3(Emitter, AddSubFlags(Ins->Rd), Ins, 0x03); break;
+    case OP_SUB3: EMIT_BINARY3(Emitter, AddSubFlags(Ins->Rd), Ins, 0x2B); break;
+    case OP_AND3: EMIT_BINARY3(Emitter, JIT_32, Ins, 0x23); break;
+    case OP_OR3:  EMIT_BINARY3(Emitter, JIT_32, Ins, 0x0B); break;
+    case OP_XOR3: EMIT_BINARY3(Emitter, JIT_32, Ins, 0x33); break;
+    case OP_MUL3:
+    case OP_IMUL3: EMIT_BINARY3(Emitter, JIT_32, Ins, 0x0F, 0xAF); break;
+    case OP_ADD3_64: EMIT_BINARY3(Emitter, JIT_64, Ins, 0x03); break;
+    case OP_SUB3_64: EMIT_BINARY3(Emitter, JIT_64, Ins, 0x2B); break;
+    case OP_AND3_64: EMIT_BINARY3(Emitter, JIT_64, Ins, 0x23); break;
+    case OP_OR3_64:  EMIT_BINARY3(Emitter, JIT_64, Ins, 0x0B); break;
+    case OP_XOR3_64: EMIT_BINARY3(Emitter, JIT_64, Ins, 0x33); break;
+    case OP_MUL3_64:
+    case OP_IMUL3_64: EMIT_BINARY3(Emitter, JIT_64, Ins, 0x0F, 0xAF); break;
+    case OP_DIV3:  EmitDiv(Emitter, JIT_32, false, false, Ins); break;
+    case OP_IDIV3: EmitDiv(Emitter, JIT_32, true, false, Ins); break;
+    case OP_MOD3:  EmitDiv(Emitter, JIT_32, false, true, Ins); break;
+    case OP_DIV3_64:  EmitDiv(Emitter, JIT_64, false, false, Ins); break;
+    case OP_IDIV3_64: EmitDiv(Emitter, JIT_64, true, false, Ins); break;
+    case OP_MOD3_64:  EmitDiv(Emitter, JIT_64, false, true, Ins); break;
+    case OP_NEG: EmitUnary(Emitter, JIT_32, 3, Ins); break;
+    case OP_NOT: EmitUnary(Emitter, JIT_32, 2, Ins); break;
+    case OP_NEG64: EmitUnary(Emitter, JIT_64, 3, Ins); break;
+    case OP_NOT64: EmitUnary(Emitter, JIT_64, 2, Ins); break;
+
+    case OP_QSHL: EmitShiftImm(Emitter, JIT_32, 4, Ins); break;
+    case OP_QSHR: EmitShiftImm(Emitter, JIT_32, 5, Ins); break;
+    case OP_QASR: EmitShiftImm(Emitter, JIT_32, 7, Ins); break;
+    case OP_VSHL: EmitShiftReg(Emitter, JIT_32, 4, Ins); break;
+    case OP_VSHR: EmitShiftReg(Emitter, JIT_32, 5, Ins); break;
+    case OP_VASR: EmitShiftReg(Emitter, JIT_32, 7, Ins); break;
+    case OP_QSHL64: EmitShiftImm(Emitter, JIT_64, 4, Ins); break;
+    case OP_QSHR64: EmitShiftImm(Emitter, JIT_64, 5, Ins); break;
+    case OP_QASR64: EmitShiftImm(Emitter, JIT_64, 7, Ins); break;
+    case OP_VSHL64: EmitShiftReg(Emitter, JIT_64, 4, Ins); break;
+    case OP_VSHR64: EmitShiftReg(Emitter, JIT_64, 5, Ins); break;
+    case OP_VASR64: EmitShiftReg(Emitter, JIT_64, 7, Ins); break;
+    case OP_VSHL3: EmitShiftReg(Emitter, JIT_32, 4, Ins); break;
+    case OP_VSHR3: EmitShiftReg(Emitter, JIT_32, 5, Ins); break;
+    case OP_VASR3: EmitShiftReg(Emitter, JIT_32, 7, Ins); break;
+    case OP_VSHL3_64: EmitShiftReg(Emitter, JIT_64, 4, Ins); break;
+    case OP_VSHR3_64: EmitShiftReg(Emitter, JIT_64, 5, Ins); break;
+    case OP_VASR3_64: EmitShiftReg(Emitter, JIT_64, 7, Ins); break;
+
+    case OP_ADDI:
+    case OP_ADDQI: EmitAddImm(Emitter, AddSubFlags(Ins->Rd), Ins->Rd, (I32)Ins->As.Imm); break;
+    case OP_ADDI64:
+    case OP_ADDQI64: EmitAddImm(Emitter, JIT_64, Ins->Rd, Ins->As.Imm); break;
+
+    case OP_SEQ:  EmitCompare(Emitter, JIT_32, CC_E, Ins); break;
+    case OP_SLT:  EmitCompare(Emitter, JIT_32, CC_B, Ins); break;
+    case OP_ISLT: EmitCompare(Emitter, JIT_32, CC_L, Ins); break;
+    case OP_SEQ64:  EmitCompare(Emitter, JIT_64, CC_E, Ins); break;
+    case OP_SLT64:  EmitCompare(Emitter, JIT_64, CC_B, Ins); break;
+    case OP_ISLT64: EmitCompare(Emitter, JIT_64, CC_L, Ins); break;
+    case OP_SETEZ: EmitSetEz(Emitter, JIT_32, Ins); break;
+    case OP_SETEZ64: EmitSetEz(Emitter, JIT_64, Ins); break;
+
+    case OP_GETFLAG:
+    case OP_GETNFLAG:
+    {
+        /* the interpreter does not negate GETNFLAG either */
+        UInt Dst = RegDst(Ins->Rd, RAX);
+        EMIT_OP(Emitter, JIT_32, Dst, RM_MEM(RBX, CONDITION_DISP), 0x0F, 0xB6); /* movzx Dst, byte [Condition] */
+        RegOut(Emitter, JIT_32, Ins->Rd, Dst);
+    } break;
+    case OP_SETFLAG:
+    case OP_SETNFLAG:
+    {
+        UInt CC = OP_SETFLAG == PVMDecodedOp(Ins) ? CC_NE : CC_E;
+        EMIT_OP(Emitter, JIT_32, 7, RegRM(Ins->Rd), 0x83); /* cmp dword Rd, 0 */
+        Emit8(Emitter, 0);
+        EMIT_OP(Emitter, JIT_32, 0, RM_MEM(RBX, CONDITION_DISP), 0x0F, 0x90 | CC);
+        Emitter->LastCC = CC;
+    } break;
+    case OP_NEGFLAG:
+    {
+        EMIT_OP(Emitter, JIT_32, 6, RM_MEM(RBX, CONDITION_DISP), 0x80); /* xor byte [Condition], 1 */
+        Emit8(Emitter, 1);
+    } break;
+
+
+    case OP_BR:
+    {
+        Emit8(Emitter, 0xE9);
+        EmitFixup(Emitter, Ins->As.Target);
+    } break;
+    case OP_BCT: EmitBranchOnCondition(Emitter, LastCC, true, Ins); break;
+    case OP_BCF: EmitBranchOnCondition(Emitter, LastCC, false, Ins); break;
+    case OP_BEZ: EmitBranchOnReg(Emitter, CC_E, Ins); break;
+    case OP_BNZ: EmitBranchOnReg(Emitter, CC_NE, Ins); break;
+
+    case OP_BEQ:  EmitCompareAndBranch(Emitter, JIT_32, CC_E, false, Ins); break;
+    case OP_BNE:  EmitCompareAndBranch(Emitter, JIT_32, CC_NE, false, Ins); break;
+    case OP_BLT:  EmitCompareAndBranch(Emitter, JIT_32, CC_B, false, Ins); break;
+    case OP_BGE:  EmitCompareAndBranch(Emitter, JIT_32, CC_B ^ 1, false, Ins); break;
+    case OP_IBLT: EmitCompareAndBranch(Emitter, JIT_32, CC_L, false, Ins); break;
+    case OP_IBGE: EmitCompareAndBranch(Emitter, JIT_32, CC_L ^ 1, false, Ins); break;
+    case OP_BEQ64:  EmitCompareAndBranch(Emitter, JIT_64, CC_E, false, Ins); break;
+    case OP_BNE64:  EmitCompareAndBranch(Emitter, JIT_64, CC_NE, false, Ins); break;
+    case OP_BLT64:  EmitCompareAndBranch(Emitter, JIT_64, CC_B, false, Ins); break;
+    case OP_BGE64:  EmitCompareAndBranch(Emitter, JIT_64, CC_B ^ 1, false, Ins); break;
+    case OP_IBLT64: EmitCompareAndBranch(Emitter, JIT_64, CC_L, false, Ins); break;
+    case OP_IBGE64: EmitCompareAndBranch(Emitter, JIT_64, CC_L ^ 1, false, Ins); break;
+    case OP_BEQQI:  EmitCompareAndBranch(Emitter, JIT_32, CC_E, true, Ins); break;
+    case OP_BNEQI:  EmitCompareAndBranch(Emitter, JIT_32, CC_NE, true, Ins); break;
+    case OP_BLTQI:  EmitCompareAndBranch(Emitter, JIT_32, CC_B, true, Ins); break;
+    case OP_BGEQI:  EmitCompareAndBranch(Emitter, JIT_32, CC_B ^ 1, true, Ins); break;
+    case OP_IBLTQI: EmitCompareAndBranch(Emitter, JIT_32, CC_L, true, Ins); break;
+    case OP_IBGEQI: EmitCompareAndBranch(Emitter, JIT_32, CC_L ^ 1, true, Ins); break;
+    case OP_BEQQI64:  EmitCompareAndBranch(Emitter, JIT_64, CC_E, true, Ins); break;
+    case OP_BNEQI64:  EmitCompareAndBranch(Emitter, JIT_64, CC_NE, true, Ins); break;
+    case OP_BLTQI64:  EmitCompareAndBranch(Emitter, JIT_64, CC_B, true, Ins); break;
+    case OP_BGEQI64:  EmitCompareAndBranch(Emitter, JIT_64, CC_B ^ 1, true, Ins); break;
+    case OP_IBLTQI64: EmitCompareAndBranch(Emitter, JIT_64, CC_L, true, Ins); break;
+    case OP_IBGEQI64: EmitCompareAndBranch(Emitter, JIT_64, CC_L ^ 1, true, Ins); break;
+    case OP_FBEQ:  EmitFloatCompareAndBranch(Emitter, false, CC_E, true, Ins); break;
+    case OP_FBNE:  EmitFloatCompareAndBranch(Emitter, false, CC_E, false, Ins); break;
+    case OP_FBLT:  EmitFloatCompareAndBranch(Emitter, false, CC_B, true, Ins); break;
+    case OP_FBNLT: EmitFloatCompareAndBranch(Emitter, false, CC_B, false, Ins); break;
+    case OP_FBLE:  EmitFloatCompareAndBranch(Emitter, false, CC_AE, true, Ins); break;
+    case OP_FBNLE: EmitFloatCompareAndBranch(Emitter, false, CC_AE, false, Ins); break;
+    case OP_FBEQ64:  EmitFloatCompareAndBranch(Emitter, true, CC_E, true, Ins); break;
+    case OP_FBNE64:  EmitFloatCompareAndBranch(Emitter, true, CC_E, false, Ins); break;
+    case OP_FBLT64:  EmitFloatCompareAndBranch(Emitter, true, CC_B, true, Ins); break;
+    case OP_FBNLT64: EmitFloatCompareAndBranch(Emitter, true, CC_B, false, Ins); break;
+    case OP_FBLE64:  EmitFloatCompareAndBranch(Emitter, true, CC_AE, true, Ins); break;
+    case OP_FBNLE64: EmitFloatCompareAndBranch(Emitter, true, CC_AE, false, Ins); break;
+    case OP_BRI:
+    {
+        EMIT_OP(Emitter, JIT_64, 0, RegRM(Ins->Rd), 0x83); /* add qword Rd, imm8 */
+        Emit8(Emitter, BitSex64(Ins->Rs, 3));
+        Emit8(Emitter, 0xE9);
+        EmitFixup(Emitter, Ins->As.Target);
+    } break;
+    case OP_CALL:
+    {
+        EmitSaveFrame(Emitter, Ins->StreamOffset);
+        Emit8(Emitter, 0xE8);
+        EmitFixup(Emitter, Ins->As.Target);
+    } break;
+    case OP_CALLPTR:
+    {
+        EmitSaveFrame(Emitter, Ins->StreamOffset);
+        EMIT_OP(Emitter, JIT_32, 2, RegRM(Ins->Rd), 0xFF); /* call Rd */
+    } break;
+    case OP_LDRIP:
+    {
+        /* function pointers are native addresses in jitted code */
+        UInt Dst = RegDst(Ins->Rd, RAX);
+        EMIT(Emitter, 0x48 | (Dst >> 3) << 2, 0x8D, 0x05 | (Dst & 7) << 3); /* lea Dst, [rip + rel32] */
+        EmitFixup(Emitter, Ins->As.Target);
+        RegOut(Emitter, JIT_64, Ins->Rd, Dst);
+    } break;
+
+
+    /* Rd is the first register of the list */
+    case OP_PSHL: EmitPushMultiple(Emitter, false, Ins->Rd, Ins->As.Imm); break;
+    case OP_POPL: EmitPopMultiple(Emitter, false, Ins->Rd, Ins->As.Imm); break;
+    case OP_FPSHL: EmitPushMultiple(Emitter, true, Ins->Rd, Ins->As.Imm); break;
+    case OP_FPOPL: EmitPopMultiple(Emitter, true, Ins->Rd, Ins->As.Imm); break;
+    case OP_FPSHH: EmitPushMultiple(Emitter, true, Ins->Rd, Ins->As.Imm); break;
+    case OP_FPOPH: EmitPopMultiple(Emitter, true, Ins->Rd, Ins->As.Imm); break;
+    case OP_PSHH:
+    case OP_POPH:
+    {
+        /* SP itself in the list, let the interpreter deal with it */
+        if (8 == Ins->Rd && (Ins->As.Imm & (1u << (PVM_REG_SP - 8))))
+            EmitCallExternal(Emitter, PVMExecuteInstruction, Ins);
+        else if (OP_PSHH == PVMDecodedOp(Ins))
+            EmitPushMultiple(Emitter, false, Ins->Rd, Ins->As.Imm);
+        else EmitPopMultiple(Emitter, false, Ins->Rd, Ins->As.Imm);
+    } break;
+
+
+    case OP_MOV32: EMIT_MOVE(Emitter, JIT_32, JIT_32, Ins, 0x8B); break;
+    case OP_MOVZEX32_8: EMIT_MOVE(Emitter, JIT_BYTE, JIT_32, Ins, 0x0F, 0xB6); break;
+    case OP_MOVZEX32_16: EMIT_MOVE(Emitter, JIT_32, JIT_32, Ins, 0x0F, 0xB7); break;
+    case OP_MOV64: EMIT_MOVE(Emitter, JIT_64, JIT_64, Ins, 0x8B); break;
+    case OP_MOVZEX64_8: EMIT_MOVE(Emitter, JIT_BYTE, JIT_64, Ins, 0x0F, 0xB6); break;
+    case OP_MOVZEX64_16: EMIT_MOVE(Emitter, JIT_32, JIT_64, Ins, 0x0F, 0xB7); break;
+    case OP_MOVZEX64_32: EMIT_MOVE(Emitter, JIT_32, JIT_64, Ins, 0x8B); break;
+    case OP_MOVSEX64_32: EMIT_MOVE(Emitter, JIT_64, JIT_64, Ins, 0x63); break;
+    case OP_MOVI:
+    case OP_MOVQI: EmitMovImm(Emitter, Ins->Rd, Ins->As.Imm); break;
+
+
+    case OP_LD32:
+    case OP_LD32L: EMIT_LOAD(Emitter, JIT_32, JIT_32, Ins, 0x8B); break;
+    case OP_LD64:
+    case OP_LD64L: EMIT_LOAD(Emitter, JIT_64, JIT_64, Ins, 0x8B); break;
+    case OP_LDZEX32_8:
+    case OP_LDZEX32_8L: EMIT_LOAD(Emitter, JIT_32, JIT_32, Ins, 0x0F, 0xB6); break;
+    case OP_LDZEX32_16:
+    case OP_LDZEX32_16L: EMIT_LOAD(Emitter, JIT_32, JIT_32, Ins, 0x0F, 0xB7); break;
+    case OP_LDZEX64_8:
+    case OP_LDZEX64_8L: EMIT_LOAD(Emitter, JIT_32, JIT_64, Ins, 0x0F, 0xB6); break;
+    case OP_LDZEX64_16:
+    case OP_LDZEX64_16L: EMIT_LOAD(Emitter, JIT_32, JIT_64, Ins, 0x0F, 0xB7); break;
+    case OP_LDZEX64_32:
+    case OP_LDZEX64_32L: EMIT_LOAD(Emitter, JIT_32, JIT_64, Ins, 0x8B); break;
+    case OP_LDSEX32_8:
+    case OP_LDSEX32_8L: EMIT_LOAD(Emitter, JIT_32, JIT_32, Ins, 0x0F, 0xBE); break;
+    case OP_LDSEX32_16:
+    case OP_LDSEX32_16L: EMIT_LOAD(Emitter, JIT_32, JIT_32, Ins, 0x0F, 0xBF); break;
+    case OP_LDSEX64_8:
+    case OP_LDSEX64_8L: EMIT_LOAD(Emitter, JIT_64, JIT_64, Ins, 0x0F, 0xBE); break;
+    case OP_LDSEX64_16:
+    case OP_LDSEX64_16L: EMIT_LOAD(Emitter, JIT_64, JIT_64, Ins, 0x0F, 0xBF); break;
+    case OP_LDSEX64_32:
+    case OP_LDSEX64_32L: EMIT_LOAD(Emitter, JIT_64, JIT_64, Ins, 0x63); break;
+    case OP_LEA:
+    case OP_LEAL: EMIT_LOAD(Emitter, JIT_64, JIT_64, Ins, 0x8D); break;
+
+    case OP_ST8:
+    case OP_ST8L: EmitStore(Emitter, JIT_BYTE, 0x88, Ins); break;
+    case OP_ST16:
+    case OP_ST16L: EmitStore(Emitter, JIT_16, 0x89, Ins); break;
+    case OP_ST32:
+    case OP_ST32L: EmitStore(Emitter, JIT_32, 0x89, Ins); break;
+    case OP_ST64:
+    case OP_ST64L: EmitStore(Emitter, JIT_64, 0x89, Ins); break;
+
+    case OP_MEMCPY: EmitMemcpy(Emitter, false, Ins); break;
+    case OP_VMEMCPY: EmitMemcpy(Emitter, true, Ins); break;
+
+    /* floats, strings, conversions: not worth compiling yet */
+    default: EmitCallExternal(Emitter, PVMExecuteInstruction, Ins); break;
+    }
+}
+
+
+static bool IsBranch(PVMOp Op)
+{
+    if (PVMIsCompareAndBranch(Op))
+        return true;
+    switch (Op)
+    {
+    case OP_BR:
+    case OP_BCT:
+    case OP_BCF:
+    case OP_BEZ:
+    case OP_BNZ:
+    case OP_BRI:
+    case OP_CALL:
+    case OP_LDRIP:
+        return true;
+    default: return false;
+    }
+}
+
+
+
+/* compiles Chunk->Decoded after what is already in Emitter->Code,
+ * Emitter->NativeOffset is left for the caller to deallocate */
+static void EmitChunk(JitEmitter *Emitter)
+{
+    PVMChunk *Chunk = Emitter->Chunk;
+    U32 InsCount = Chunk->Decoded.Count;
+    Emitter->NativeOffset = MemAllocateArray(U32, InsCount + 1);
+    Emitter->Fixup = MemAllocateArray(JitFixup, InsCount + 1);
+    Emitter->IsTarget = MemAllocateArray(bool, InsCount + 1);
+    Emitter->FixupCount = 0;
+
+    for (U32 i = 0; i <= InsCount; i++)
+        Emitter->IsTarget[i] = false;
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        if (IsBranch(PVMDecodedOp(Ins)))
+            Emitter->IsTarget[Ins->As.Target - Chunk->Decoded.Ins] = true;
+    }
+
+    for (U32 i = 0; i < InsCount; i++)
+    {
+        /* the host flags are not known when coming from elsewhere */
+        if (Emitter->IsTarget[i])
+            Emitter->LastCC = CC_NONE;
+
+        USize Start = Emitter->Count;
+        Emitter->NativeOffset[i] = Start;
+        EmitInstruction(Emitter, &Chunk->Decoded.Ins[i]);
+        PASCAL_ASSERT(Emitter->Count - Start <= MAX_NATIVE_SIZE_PER_INS, "MAX_NATIVE_SIZE_PER_INS is too small");
+    }
+    /* the trailing illegal instruction */
+    Emitter->NativeOffset[InsCount] = Emitter->Count;
+    EmitErrorExit(Emitter, PVM_ILLEGAL_INSTRUCTION, Chunk->Decoded.Ins[InsCount].StreamOffset);
+
+    for (U32 i = 0; i < Emitter->FixupCount; i++)
+    {
+        PatchRel32(Emitter, Emitter->Fixup[i].At, Emitter->NativeOffset[Emitter->Fixup[i].TargetIndex]);
+    }
+    MemDeallocateArray(Emitter->IsTarget);
+    MemDeallocateArray(Emitter->Fixup);
+    Emitter->IsTarget = NULL;
+    Emitter->Fixup = NULL;
+}
+
+
+
+struct PVMJitProgram
+{
+    U8 *Code;
+    USize Size;
+    U32 *NativeOffset; /* decoded instruction index -> offset into Code */
+    PVMChunk *Chunk;
+};
+
+
+PVMJitProgram *PVMJitCompile(PVMChunk *Chunk)
+{
+    PASCAL_NONNULL(Chunk);
+    PASCAL_NONNULL(Chunk->Decoded.Ins);
+
+    U32 InsCount = Chunk->Decoded.Count;
+    USize Cap = 512 + ((USize)InsCount + 1)*MAX_NATIVE_SIZE_PER_INS;
+    U8 *Code = mmap(NULL, Cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == Code)
+        return NULL;
+
+    JitEmitter Emitter = {
+        .Code = Code,
+        .Cap = Cap,
+        .Chunk = Chunk,
+        .LastCC = CC_NONE,
+    };
+    EmitStubs(&Emitter);
+    EmitChunk(&Emitter);
+    if (0 != mprotect(Code, Cap, PROT_READ | PROT_EXEC))
+    {
+        MemDeallocateArray(Emitter.NativeOffset);
+        munmap(Code, Cap);
+        return NULL;
+    }
+
+    PVMJitProgram *Program = MemAllocate(sizeof *Program);
+    *Program = (PVMJitProgram) {
+        .Code = Code,
+        .Size = Cap,
+        .NativeOffset = Emitter.NativeOffset,
+        .Chunk = Chunk,
+    };
+    return Program;
+}
+
+typedef struct JitGuardedEntry
+{
+    JitEntry Entry;
+    PascalVM *PVM;
+    U8 *NativeAt;
+    PVMReturnValue ReturnValue;
+} JitGuardedEntry;
+
+static void JitCallEntry(void *Data)
+{
+    JitGuardedEntry *Call = Data;
+    Call->ReturnValue = Call->Entry(Call->PVM, Call->NativeAt);
+}
+
+/* the instruction whose native code contains Addr, or NULL if Addr is not in an instruction's code */
+static const PVMDecodedIns *JitInstructionAt(const PVMJitProgram *Program, const void *Addr)
+{
+    const U8 *NativeAddr = Addr;
+    U32 Count = Program->Chunk->Decoded.Count;
+    if (NULL == NativeAddr
+    || NativeAddr < Program->Code + Program->NativeOffset[0]
+    || NativeAddr >= Program->Code + Program->NativeOffset[Count])
+        return NULL;
+
+    /* native code is in the same order as the instructions */
+    USize Offset = NativeAddr - Program->Code;
+    U32 Low = 0, High = Count;
+    while (High - Low > 1)
+    {
+        U32 Mid = Low + (High - Low)/2;
+        if (Program->NativeOffset[Mid] <= Offset)
+            Low = Mid;
+        else High = Mid;
+    }
+    return &Program->Chunk->Decoded.Ins[Low];
+}
+
+PVMReturnValue PVMJitEnter(PascalVM *PVM, PVMJitProgram *Program, const PVMDecodedIns *At)
+{
+    PASCAL_NONNULL(PVM);
+    PASCAL_NONNULL(Program);
+    PASCAL_NONNULL(At);
+
+    /* EmitStubs() put the entry point at the start */
+    JitGuardedEntry Call = {
+        .PVM = PVM,
+        .NativeAt = Program->Code + Program->NativeOffset[At - Program->Chunk->Decoded.Ins],
+    };
+    void *EntryAddr = Program->Code;
+    memcpy(&Call.Entry, &EntryAddr, sizeof Call.Entry);
+
+    const void *FaultAt;
+    if (!PVMGuardedCall(JitCallEntry, &Call, &FaultAt))
+    {
+        /* ran off one of the stacks, unless that happened in C code called by an instruction 
+         * the address of the faulting instruction tells which one it was */
+        const PVMDecodedIns *Faulted = JitInstructionAt(Program, FaultAt);
+        PVM->Error.PC = (NULL == Faulted ? At : Faulted)->StreamOffset;
+        Call.ReturnValue = PVM_CALLSTACK_OVERFLOW;
+    }
+    if (PVM_NO_ERROR != Call.ReturnValue)
+        PVMSetErrorLocation(PVM, Program->Chunk, PVM->Error.PC);
+    return Call.ReturnValue;
+}
+
+void PVMJitFree(PVMJitProgram *Program)
+{
+    if (NULL == Program)
+        return;
+    munmap(Program->Code, Program->Size);
+    MemDeallocateArray(Program->NativeOffset);
+    MemDeallocate(Program);
+}
+
+
+bool PVMJitRun(PascalVM *PVM, PVMChunk *Chunk, PVMReturnValue *ReturnValue)
+{
+    PASCAL_NONNULL(PVM);
+    PASCAL_NONNULL(Chunk);
+    PASCAL_NONNULL(ReturnValue);
+
+    /* superinstructions are for the interpreter */
+    PVMDecodedIns *EntryPoint = PVMDecodeChunk(Chunk, false);
+    PVMJitProgram *Program = PVMJitCompile(Chunk);
+    if (NULL == Program)
+        return false;
+
+    /* same initial state as the interpreter */
+    PVM->R[PVM_REG_FP].Ptr = PVM->Stack.Start;
+    PVM->R[PVM_REG_SP].Ptr.Byte = PVM->Stack.Start.Byte - sizeof(PVMGPR);
+    PVM->R[PVM_REG_GP].Ptr.Raw = Chunk->Global.Data.As.Raw;
+
+    *ReturnValue = PVMJitEnter(PVM, Program, EntryPoint);
+    PVMJitFree(Program);
+    return true;
+}
+
+
+/*
+ * write/writeln for executables, there is no libc to call.
+ * Called with R0 = argument count, R1 = the FILE * the compiler passed and rax = the compiler's stderr:
+ * the output goes to fd 2 if they are the same, to fd 1 otherwise.
+ * Formats (Value, Type) pairs the same way PVMOutputValue does into a 4k buffer on the host stack
+ * and writes it with the write syscall, pops the arguments like the interpreter does.
+ * Floats are printed as %f by hand: integer part, then the fraction rounded to 6 digits,
+ * values >= 2^63 only have their 17 significant digits right
+ */
+static void EmitWriteStub(JitEmitter *Emitter)
+{
+    Emitter->WriteStub = Emitter->Count;
+    EMIT(Emitter,
+        0x53,                                   /* push rbx */
+        0x55,                                   /* push rbp */
+        0x56,                                   /* push rsi */
+        0x57,                                   /* push rdi */
+        0x41, 0x50,                             /* push r8 */
+        0x41, 0x51,                             /* push r9 */
+        0x41, 0x52,                             /* push r10 */
+        0x41, 0x53,                             /* push r11 */
+        0x31, 0xED,                             /* xor ebp, ebp */
+        0x49, 0x39, 0xC1,                       /* cmp r9, rax */
+        0x40, 0x0F, 0x94, 0xC5,                 /* sete bpl */
+        0xFF, 0xC5,                             /* inc ebp */
+        0x48, 0x81, 0xEC, 0x40, 0x10, 0x00, 0x00, /* sub rsp, 4160 */
+        0x48, 0x89, 0xE3,                       /* mov rbx, rsp */
+        0x48, 0x89, 0xE7,                       /* mov rdi, rsp */
+        0x45, 0x89, 0xC1,                       /* mov r9d, r8d */
+        0x4C, 0x89, 0xC8,                       /* mov rax, r9 */
+        0x48, 0xC1, 0xE0, 0x04,                 /* shl rax, 4 */
+        0x4C, 0x89, 0xFE,                       /* mov rsi, r15 */
+        0x48, 0x29, 0xC6,                       /* sub rsi, rax */
+        0x48, 0x83, 0xC6, 0x08,                 /* add rsi, 8 */
+        0x4C, 0x8D, 0x7E, 0xF8,                 /* lea r15, [rsi - 8] */
+        /* .Lnext: */
+        0x45, 0x85, 0xC9,                       /* test r9d, r9d */
+        0x0F, 0x84, 0x80, 0x02, 0x00, 0x00,     /* jz .Ldone */
+        0x48, 0x8D, 0x83, 0x74, 0x0E, 0x00, 0x00, /* lea rax, [rbx + 3700] */
+        0x48, 0x39, 0xC7,                       /* cmp rdi, rax */
+        0x72, 0x05,                             /* jb .Lfetch */
+        0xE8, 0xC2, 0x02, 0x00, 0x00,           /* call .Lflush */
+        /* .Lfetch: */
+        0x48, 0x8B, 0x06,                       /* mov rax, [rsi] */
+        0x48, 0x8B, 0x4E, 0x08,                 /* mov rcx, [rsi + 8] */
+        0x48, 0x83, 0xC6, 0x10,                 /* add rsi, 16 */
+        0x41, 0xFF, 0xC9,                       /* dec r9d */
+        0x83, 0xF9, TYPE_STRING,                /* cmp ecx, TYPE_STRING */
+        0x0F, 0x84, 0xAF, 0x00, 0x00, 0x00,     /* je .Lstring */
+        0x83, 0xF9, TYPE_CHAR,                  /* cmp ecx, TYPE_CHAR */
+        0x74, 0x7A,                             /* je .Lchar */
+        0x83, 0xF9, TYPE_BOOLEAN,               /* cmp ecx, TYPE_BOOLEAN */
+        0x74, 0x7F,                             /* je .Lbool */
+        0x83, 0xF9, TYPE_POINTER,               /* cmp ecx, TYPE_POINTER */
+        0x0F, 0x84, 0xB8, 0x00, 0x00, 0x00,     /* je .Lpointer */
+        0x83, 0xF9, TYPE_F32,                   /* cmp ecx, TYPE_F32 */
+        0x0F, 0x84, 0xF9, 0x00, 0x00, 0x00,     /* je .Lf32 */
+        0x83, 0xF9, TYPE_F64,                   /* cmp ecx, TYPE_F64 */
+        0x0F, 0x84, 0xFD, 0x00, 0x00, 0x00,     /* je .Lf64 */
+        0x83, 0xF9, TYPE_I8,                    /* cmp ecx, TYPE_I8 */
+        0x74, 0x20,                             /* je .Li8 */
+        0x83, 0xF9, TYPE_I16,                   /* cmp ecx, TYPE_I16 */
+        0x74, 0x21,                             /* je .Li16 */
+        0x83, 0xF9, TYPE_I32,                   /* cmp ecx, TYPE_I32 */
+        0x74, 0x22,                             /* je .Li32 */
+        0x83, 0xF9, TYPE_I64,                   /* cmp ecx, TYPE_I64 */
+        0x74, 0x20,                             /* je .Lsigned */
+        0x83, 0xF9, TYPE_U8,                    /* cmp ecx, TYPE_U8 */
+        0x74, 0x2B,                             /* je .Lu8 */
+        0x83, 0xF9, TYPE_U16,                   /* cmp ecx, TYPE_U16 */
+        0x74, 0x2B,                             /* je .Lu16 */
+        0x83, 0xF9, TYPE_U32,                   /* cmp ecx, TYPE_U32 */
+        0x74, 0x2B,                             /* je .Lu32 */
+        0xEB, 0x2B,                             /* jmp .Lunsigned */
+        /* .Li8: */
+        0x48, 0x0F, 0xBE, 0xC0,                 /* movsx rax, al */
+        0xEB, 0x09,                             /* jmp .Lsigned */
+        /* .Li16: */
+        0x48, 0x0F, 0xBF, 0xC0,                 /* movsx rax, ax */
+        0xEB, 0x03,                             /* jmp .Lsigned */
+        /* .Li32: */
+        0x48, 0x63, 0xC0,                       /* movsxd rax, eax */
+        /* .Lsigned: */
+        0x48, 0x85, 0xC0,                       /* test rax, rax */
+        0x79, 0x17,                             /* jns .Lunsigned */
+        0xC6, 0x07, 0x2D,                       /* mov byte ptr [rdi], 0x2D */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0x48, 0xF7, 0xD8,                       /* neg rax */
+        0xEB, 0x0C,                             /* jmp .Lunsigned */
+        /* .Lu8: */
+        0x0F, 0xB6, 0xC0,                       /* movzx eax, al */
+        0xEB, 0x07,                             /* jmp .Lunsigned */
+        /* .Lu16: */
+        0x0F, 0xB7, 0xC0,                       /* movzx eax, ax */
+        0xEB, 0x02,                             /* jmp .Lunsigned */
+        /* .Lu32: */
+        0x89, 0xC0,                             /* mov eax, eax */
+        /* .Lunsigned: */
+        0xE8, 0xF7, 0x01, 0x00, 0x00,           /* call .Lputu */
+        0xE9, 0x50, 0xFF, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lchar: */
+        0x88, 0x07,                             /* mov [rdi], al */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0xE9, 0x46, 0xFF, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lbool: */
+        0x85, 0xC0,                             /* test eax, eax */
+        0x74, 0x0F,                             /* jz .Lfalse */
+        0xC7, 0x07, 0x54, 0x52, 0x55, 0x45,     /* mov dword ptr [rdi], 0x45555254 */
+        0x48, 0x83, 0xC7, 0x04,                 /* add rdi, 4 */
+        0xE9, 0x33, 0xFF, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lfalse: */
+        0xC7, 0x07, 0x46, 0x41, 0x4C, 0x53,     /* mov dword ptr [rdi], 0x534C4146 */
+        0xC6, 0x47, 0x04, 0x45,                 /* mov byte ptr [rdi + 4], 0x45 */
+        0x48, 0x83, 0xC7, 0x05,                 /* add rdi, 5 */
+        0xE9, 0x20, 0xFF, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lstring: */
+        0x0F, 0xB6, 0x08,                       /* movzx ecx, byte ptr [rax] */
+        0x48, 0xFF, 0xC0,                       /* inc rax */
+        /* .Lchars: */
+        0x85, 0xC9,                             /* test ecx, ecx */
+        0x0F, 0x84, 0x12, 0xFF, 0xFF, 0xFF,     /* jz .Lnext */
+        0x8A, 0x10,                             /* mov dl, [rax] */
+        0x88, 0x17,                             /* mov [rdi], dl */
+        0x48, 0xFF, 0xC0,                       /* inc rax */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0xFF, 0xC9,                             /* dec ecx */
+        0xEB, 0xEA,                             /* jmp .Lchars */
+        /* .Lpointer: */
+        0x48, 0x85, 0xC0,                       /* test rax, rax */
+        0x75, 0x0F,                             /* jnz .Lhex */
+        0xC7, 0x07, 0x6E, 0x69, 0x6C, 0x00,     /* mov dword ptr [rdi], 0x6C696E */
+        0x48, 0x83, 0xC7, 0x03,                 /* add rdi, 3 */
+        0xE9, 0xF0, 0xFE, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lhex: */
+        0x66, 0xC7, 0x07, 0x30, 0x78,           /* mov word ptr [rdi], 0x7830 */
+        0x48, 0x83, 0xC7, 0x02,                 /* add rdi, 2 */
+        0x4C, 0x8D, 0x93, 0x40, 0x10, 0x00, 0x00, /* lea r10, [rbx + 4160] */
+        /* .Lhexdigits: */
+        0x89, 0xC2,                             /* mov edx, eax */
+        0x83, 0xE2, 0x0F,                       /* and edx, 15 */
+        0x83, 0xFA, 0x0A,                       /* cmp edx, 10 */
+        0x72, 0x03,                             /* jb .Lhexdigit */
+        0x83, 0xC2, 0x27,                       /* add edx, 39 */
+        /* .Lhexdigit: */
+        0x83, 0xC2, 0x30,                       /* add edx, 0x30 */
+        0x49, 0xFF, 0xCA,                       /* dec r10 */
+        0x41, 0x88, 0x12,                       /* mov [r10], dl */
+        0x48, 0xC1, 0xE8, 0x04,                 /* shr rax, 4 */
+        0x75, 0xE4,                             /* jnz .Lhexdigits */
+        0xE8, 0x81, 0x01, 0x00, 0x00,           /* call .Lcopy */
+        0xE9, 0xBA, 0xFE, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lf32: */
+        0x66, 0x0F, 0x6E, 0xC0,                 /* movd xmm0, eax */
+        0xF3, 0x0F, 0x5A, 0xC0,                 /* cvtss2sd xmm0, xmm0 */
+        0x66, 0x48, 0x0F, 0x7E, 0xC0,           /* movq rax, xmm0 */
+        /* .Lf64: */
+        0x48, 0x85, 0xC0,                       /* test rax, rax */
+        0x79, 0x0B,                             /* jns .Lpositive */
+        0xC6, 0x07, 0x2D,                       /* mov byte ptr [rdi], 0x2D */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0x48, 0x0F, 0xBA, 0xF0, 0x3F,           /* btr rax, 63 */
+        /* .Lpositive: */
+        0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x7F, /* mov rcx, 0x7FF0000000000000 */
+        0x48, 0x89, 0xC2,                       /* mov rdx, rax */
+        0x48, 0x21, 0xCA,                       /* and rdx, rcx */
+        0x48, 0x39, 0xCA,                       /* cmp rdx, rcx */
+        0x75, 0x2D,                             /* jne .Lfinite */
+        0x48, 0xBA, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00, /* mov rdx, 0x000FFFFFFFFFFFFF */
+        0x48, 0x85, 0xD0,                       /* test rax, rdx */
+        0x74, 0x0F,                             /* jz .Linf */
+        0xC7, 0x07, 0x6E, 0x61, 0x6E, 0x00,     /* mov dword ptr [rdi], 0x6E616E */
+        0x48, 0x83, 0xC7, 0x03,                 /* add rdi, 3 */
+        0xE9, 0x6A, 0xFE, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Linf: */
+        0xC7, 0x07, 0x69, 0x6E, 0x66, 0x00,     /* mov dword ptr [rdi], 0x666E69 */
+        0x48, 0x83, 0xC7, 0x03,                 /* add rdi, 3 */
+        0xE9, 0x5B, 0xFE, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lfinite: */
+        0x66, 0x48, 0x0F, 0x6E, 0xC0,           /* movq xmm0, rax */
+        0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x43, /* mov rcx, 0x43E0000000000000 */
+        0x48, 0x39, 0xC8,                       /* cmp rax, rcx */
+        0x73, 0x74,                             /* jae .Lhuge */
+        0xF2, 0x48, 0x0F, 0x2C, 0xC0,           /* cvttsd2si rax, xmm0 */
+        0xF2, 0x48, 0x0F, 0x2A, 0xC8,           /* cvtsi2sd xmm1, rax */
+        0xF2, 0x0F, 0x5C, 0xC1,                 /* subsd xmm0, xmm1 */
+        0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x80, 0x84, 0x2E, 0x41, /* mov rcx, 0x412E848000000000 */
+        0x66, 0x48, 0x0F, 0x6E, 0xC9,           /* movq xmm1, rcx */
+        0xF2, 0x0F, 0x59, 0xC1,                 /* mulsd xmm0, xmm1 */
+        0xF2, 0x48, 0x0F, 0x2D, 0xC8,           /* cvtsd2si rcx, xmm0 */
+        0x48, 0x81, 0xF9, 0x40, 0x42, 0x0F, 0x00, /* cmp rcx, 1000000 */
+        0x72, 0x0A,                             /* jb .Lnocarry */
+        0x48, 0xFF, 0xC0,                       /* inc rax */
+        0x48, 0x81, 0xE9, 0x40, 0x42, 0x0F, 0x00, /* sub rcx, 1000000 */
+        /* .Lnocarry: */
+        0x51,                                   /* push rcx */
+        0xE8, 0xAA, 0x00, 0x00, 0x00,           /* call .Lputu */
+        0x58,                                   /* pop rax */
+        0xC6, 0x07, 0x2E,                       /* mov byte ptr [rdi], 0x2E */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0x4C, 0x8D, 0x93, 0x40, 0x10, 0x00, 0x00, /* lea r10, [rbx + 4160] */
+        0xB9, 0x06, 0x00, 0x00, 0x00,           /* mov ecx, 6 */
+        0x41, 0xB8, 0x0A, 0x00, 0x00, 0x00,     /* mov r8d, 10 */
+        /* .Lfraction: */
+        0x31, 0xD2,                             /* xor edx, edx */
+        0x49, 0xF7, 0xF0,                       /* div r8 */
+        0x80, 0xC2, 0x30,                       /* add dl, 0x30 */
+        0x49, 0xFF, 0xCA,                       /* dec r10 */
+        0x41, 0x88, 0x12,                       /* mov [r10], dl */
+        0xFF, 0xC9,                             /* dec ecx */
+        0x75, 0xEE,                             /* jnz .Lfraction */
+        0xE8, 0x9A, 0x00, 0x00, 0x00,           /* call .Lcopy */
+        0xE9, 0xD3, 0xFD, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Lhuge: */
+        0x45, 0x31, 0xC0,                       /* xor r8d, r8d */
+        0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0x40, /* mov rcx, 0x4024000000000000 */
+        0x66, 0x48, 0x0F, 0x6E, 0xC9,           /* movq xmm1, rcx */
+        0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0x43, /* mov rcx, 0x43E0000000000000 */
+        /* .Lscale: */
+        0xF2, 0x0F, 0x5E, 0xC1,                 /* divsd xmm0, xmm1 */
+        0x41, 0xFF, 0xC0,                       /* inc r8d */
+        0x66, 0x48, 0x0F, 0x7E, 0xC0,           /* movq rax, xmm0 */
+        0x48, 0x39, 0xC8,                       /* cmp rax, rcx */
+        0x73, 0xEF,                             /* jae .Lscale */
+        0x41, 0x50,                             /* push r8 */
+        0xF2, 0x48, 0x0F, 0x2C, 0xC0,           /* cvttsd2si rax, xmm0 */
+        0xE8, 0x3C, 0x00, 0x00, 0x00,           /* call .Lputu */
+        0x41, 0x58,                             /* pop r8 */
+        /* .Lzeros: */
+        0xC6, 0x07, 0x30,                       /* mov byte ptr [rdi], 0x30 */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0x41, 0xFF, 0xC8,                       /* dec r8d */
+        0x75, 0xF5,                             /* jnz .Lzeros */
+        0xC7, 0x07, 0x2E, 0x30, 0x30, 0x30,     /* mov dword ptr [rdi], 0x3030302E */
+        0xC7, 0x47, 0x03, 0x30, 0x30, 0x30, 0x30, /* mov dword ptr [rdi + 3], 0x30303030 */
+        0x48, 0x83, 0xC7, 0x07,                 /* add rdi, 7 */
+        0xE9, 0x77, 0xFD, 0xFF, 0xFF,           /* jmp .Lnext */
+        /* .Ldone: */
+        0xE8, 0x4E, 0x00, 0x00, 0x00,           /* call .Lflush */
+        0x48, 0x81, 0xC4, 0x40, 0x10, 0x00, 0x00, /* add rsp, 4160 */
+        0x41, 0x5B,                             /* pop r11 */
+        0x41, 0x5A,                             /* pop r10 */
+        0x41, 0x59,                             /* pop r9 */
+        0x41, 0x58,                             /* pop r8 */
+        0x5F,                                   /* pop rdi */
+        0x5E,                                   /* pop rsi */
+        0x5D,                                   /* pop rbp */
+        0x5B,                                   /* pop rbx */
+        0xC3,                                   /* ret */
+        /* .Lputu: */
+        0x4C, 0x8D, 0x93, 0x40, 0x10, 0x00, 0x00, /* lea r10, [rbx + 4160] */
+        0x41, 0xB8, 0x0A, 0x00, 0x00, 0x00,     /* mov r8d, 10 */
+        /* .Ldigits: */
+        0x31, 0xD2,                             /* xor edx, edx */
+        0x49, 0xF7, 0xF0,                       /* div r8 */
+        0x80, 0xC2, 0x30,                       /* add dl, 0x30 */
+        0x49, 0xFF, 0xCA,                       /* dec r10 */
+        0x41, 0x88, 0x12,                       /* mov [r10], dl */
+        0x48, 0x85, 0xC0,                       /* test rax, rax */
+        0x75, 0xED,                             /* jnz .Ldigits */
+        /* .Lcopy: */
+        0x48, 0x8D, 0x93, 0x40, 0x10, 0x00, 0x00, /* lea rdx, [rbx + 4160] */
+        /* .Lcopyloop: */
+        0x49, 0x39, 0xD2,                       /* cmp r10, rdx */
+        0x73, 0x0D,                             /* jae .Lcopydone */
+        0x41, 0x8A, 0x0A,                       /* mov cl, [r10] */
+        0x88, 0x0F,                             /* mov [rdi], cl */
+        0x49, 0xFF, 0xC2,                       /* inc r10 */
+        0x48, 0xFF, 0xC7,                       /* inc rdi */
+        0xEB, 0xEE,                             /* jmp .Lcopyloop */
+        /* .Lcopydone: */
+        0xC3,                                   /* ret */
+        /* .Lflush: */
+        0x56,                                   /* push rsi */
+        0x48, 0x89, 0xFA,                       /* mov rdx, rdi */
+        0x48, 0x29, 0xDA,                       /* sub rdx, rbx */
+        0x48, 0x89, 0xDE,                       /* mov rsi, rbx */
+        /* .Lwrite: */
+        0x48, 0x85, 0xD2,                       /* test rdx, rdx */
+        0x7E, 0x16,                             /* jle .Lwritten */
+        0x89, 0xEF,                             /* mov edi, ebp */
+        0xB8, 0x01, 0x00, 0x00, 0x00,           /* mov eax, 1 */
+        0x0F, 0x05,                             /* syscall */
+        0x48, 0x85, 0xC0,                       /* test rax, rax */
+        0x7E, 0x08,                             /* jle .Lwritten */
+        0x48, 0x01, 0xC6,                       /* add rsi, rax */
+        0x48, 0x29, 0xC2,                       /* sub rdx, rax */
+        0xEB, 0xE5,                             /* jmp .Lwrite */
+        /* .Lwritten: */
+        0x48, 0x89, 0xDF,                       /* mov rdi, rbx */
+        0x5E,                                   /* pop rsi */
+        0xC3                                    /* ret */
+    );
+}
+
+static void EmitPascalStr(JitEmitter *Emitter, const char *Str)
+{
+    USize Len = strlen(Str);
+    Emit8(Emitter, Len);
+    EmitBytes(Emitter, Len, (const U8 *)Str);
+}
+
+/* patches a rip-relative lea that ends at Next to point at Target */
+static void PatchLea(JitEmitter *Emitter, U32 Next, U32 Target)
+{
+    PatchRel32(Emitter, Next - 4, Target);
+}
+
+
+/* addresses in the executable's data segment */
+typedef struct JitImageLayout
+{
+    U32 Global, PVM, RetStack, RetStackEnd, Stack, StackEnd;
+} JitImageLayout;
+
+/*
+ * _start: sets up the PascalVM in .bss the same way PVMInit and the interpreter do, runs the code,
+ * then exits with 0, or reports the error like PVMRun does and exits with 1
+ */
+static U32 EmitStart(JitEmitter *Emitter, U32 NativeEntryPoint, const JitImageLayout *Layout)
+{
+    static const struct {
+        PVMReturnValue Error;
+        const char *Msg;
+    } sErrors[] = {
+        { PVM_CALLSTACK_OVERFLOW, "]:\n\tCallstack overflow\n" },
+        { PVM_DIVISION_BY_0, "]:\n\tInteger division by 0\n" },
+    };
+    U32 Lea[STATIC_ARRAY_SIZE(sErrors)];
+    U32 LeaHeader, LeaIllegal;
+
+    U32 Start = Emitter->Count;
+    Emit8(Emitter, 0xBB);                   /* mov ebx, imm32 */
+    Emit32(Emitter, Layout->PVM);
+    Emit8(Emitter, 0xB8);                   /* mov eax, imm32 */
+    Emit32(Emitter, Layout->RetStack);
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_VAL_DISP), 0x89);
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, RETSTACK_START_DISP), 0x89);
+    EMIT_OP(Emitter, JIT_64, 0, RM_MEM(RBX, RETSTACK_END_DISP), 0xC7);     /* mov qword [End], imm32 */
+    Emit32(Emitter, Layout->RetStackEnd);
+    EMIT_OP(Emitter, JIT_64, 0, RM_MEM(RBX, STACK_END_DISP), 0xC7);
+    Emit32(Emitter, Layout->StackEnd);
+    Emit8(Emitter, 0xB8);
+    Emit32(Emitter, Layout->Stack);
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, R_DISP(PVM_REG_FP)), 0x89);
+    EMIT(Emitter, 0x48, 0x83, 0xE8, sizeof(PVMGPR)); /* sub rax, imm8 */
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, R_DISP(PVM_REG_SP)), 0x89);
+    Emit8(Emitter, 0xB8);
+    Emit32(Emitter, Layout->Global);
+    EMIT_OP(Emitter, JIT_64, RAX, RM_MEM(RBX, R_DISP(PVM_REG_GP)), 0x89);
+
+    EMIT(Emitter,
+        0x48, 0x89, 0xDF,                   /* mov rdi, rbx */
+        0x48, 0x8D, 0x35, 0, 0, 0, 0        /* lea rsi, [rip + NativeEntryPoint] */
+    );
+    PatchLea(Emitter, Emitter->Count, NativeEntryPoint);
+    /* EmitStubs() put the entry point at the start */
+    EmitCallStub(Emitter, 0);
+    EMIT(Emitter,
+        0x85, 0xC0,                         /* test eax, eax */
+        0x75, 0x09,                         /* jnz error */
+        0x31, 0xFF,                         /* xor edi, edi */
+        0xB8, 0xE7, 0x00, 0x00, 0x00,       /* mov eax, SYS_exit_group */
+        0x0F, 0x05                          /* syscall */
+    );
+
+    /* error: write("Runtime Error: [line ", Line, Msg) to stderr, from the bottom of the PVM stack */
+    EMIT(Emitter, 0x41, 0xBF);                      /* mov r15d, imm32 */
+    Emit32(Emitter, Layout->Stack + 5*sizeof(PVMGPR));
+    EMIT(Emitter, 0x48, 0x8D, 0x0D, 0, 0, 0, 0);    /* lea rcx, [rip + Header] */
+    LeaHeader = Emitter->Count;
+    EMIT(Emitter,
+        0x49, 0x89, 0x4F, 0xD8,                     /* mov [r15 - 40], rcx */
+        0x49, 0xC7, 0x47, 0xE0, TYPE_STRING, 0, 0, 0/* mov qword [r15 - 32], TYPE_STRING */
+    );
+    EMIT_OP(Emitter, JIT_64, RCX, RM_MEM(RBX, ERROR_LINE_DISP), 0x63); /* movsxd rcx, [Error.Line] */
+    EMIT(Emitter,
+        0x49, 0x89, 0x4F, 0xE8,                     /* mov [r15 - 24], rcx */
+        0x49, 0xC7, 0x47, 0xF0, TYPE_I32, 0, 0, 0,  /* mov qword [r15 - 16], TYPE_I32 */
+        0x48, 0x8D, 0x0D, 0, 0, 0, 0                /* lea rcx, [rip + IllegalInstruction] */
+    );
+    LeaIllegal = Emitter->Count;
+    for (UInt i = 0; i < STATIC_ARRAY_SIZE(sErrors); i++)
+    {
+        EMIT(Emitter, 0x48, 0x8D, 0x15, 0, 0, 0, 0);    /* lea rdx, [rip + Msg] */
+        Lea[i] = Emitter->Count;
+        EMIT(Emitter,
+            0x83, 0xF8, sErrors[i].Error,               /* cmp eax, Error */
+            0x48, 0x0F, 0x44, 0xCA                      /* cmove rcx, rdx */
+        );
+    }
+    EMIT(Emitter,
+        0x49, 0x89, 0x4F, 0xF8,                     /* mov [r15 - 8], rcx */
+        0x49, 0xC7, 0x07, TYPE_STRING, 0, 0, 0,     /* mov qword [r15], TYPE_STRING */
+        0x41, 0xB8, 0x03, 0x00, 0x00, 0x00,         /* mov r8d, 3 */
+        0x31, 0xC0,                                 /* xor eax, eax */
+        0x45, 0x31, 0xC9                            /* xor r9d, r9d: same as rax, stderr */
+    );
+    EmitCallStub(Emitter, Emitter->WriteStub);
+    EMIT(Emitter,
+        0xBF, 0x01, 0x00, 0x00, 0x00,               /* mov edi, 1 */
+        0xB8, 0xE7, 0x00, 0x00, 0x00,               /* mov eax, SYS_exit_group */
+        0x0F, 0x05                                  /* syscall */
+    );
+
+    PatchLea(Emitter, LeaHeader, Emitter->Count);
+    EmitPascalStr(Emitter, "Runtime Error: [line ");
+    PatchLea(Emitter, LeaIllegal, Emitter->Count);
+    EmitPascalStr(Emitter, "]:\n\tIllegalInstruction\n");
+    for (UInt i = 0; i < STATIC_ARRAY_SIZE(sErrors); i++)
+    {
+        PatchLea(Emitter, Lea[i], Emitter->Count);
+        EmitPascalStr(Emitter, sErrors[i].Msg);
+    }
+    return Start;
+}
+
+
+static U32 AlignUp16(USize Value)
+{
+    return (Value + 15) & ~(USize)15;
+}
+
+bool PVMJitWriteExecutable(PVMChunk *Chunk, const char *FileName, U32 StackSize, UInt RetStackSize, FILE *LogFile)
+{
+    PASCAL_NONNULL(Chunk);
+    PASCAL_NONNULL(FileName);
+    PASCAL_NONNULL(LogFile);
+
+    PVMDecodedIns *EntryPoint = PVMDecodeChunk(Chunk, false);
+    U32 InsCount = Chunk->Decoded.Count;
+
+    USize Cap = 4096 + ((USize)InsCount + 1)*MAX_NATIVE_SIZE_PER_INS;
+    JitEmitter Emitter = {
+        .Code = MemAllocateArray(U8, Cap),
+        .Cap = Cap,
+        .Chunk = Chunk,
+        .LastCC = CC_NONE,
+        .Standalone = true,
+    };
+    EmitStubs(&Emitter);
+    EmitWriteStub(&Emitter);
+    EmitChunk(&Emitter);
+    U32 NativeEntryPoint = Emitter.NativeOffset[EntryPoint - Chunk->Decoded.Ins];
+    MemDeallocateArray(Emitter.NativeOffset);
+    if (NULL != Emitter.Unsupported)
+    {
+        fprintf(LogFile, "Cannot write an executable, this instruction needs the virtual machine:\n");
+        PVMDisasmSingleInstruction(LogFile, Chunk, Emitter.Unsupported->StreamOffset);
+        MemDeallocateArray(Emitter.Code);
+        return false;
+    }
+
+    /* .data: the global variables, .bss: PascalVM, the return stack, the stack */
+    JitImageLayout Layout = {
+        .Global = ELF_DATA_ADDR,
+        .PVM = ELF_DATA_ADDR + AlignUp16(Chunk->Global.Count),
+    };
+    Layout.RetStack = Layout.PVM + AlignUp16(sizeof(PascalVM));
+    Layout.RetStackEnd = Layout.RetStack + (USize)RetStackSize * sizeof(PVMSaveFrame);
+    Layout.Stack = AlignUp16(Layout.RetStackEnd);
+    USize End = Layout.Stack + (USize)StackSize*sizeof(PVMGPR);
+    PASCAL_ASSERT(End < INT32_MAX, "data segment does not fit in 31 bits");
+    Layout.StackEnd = End;
+
+    ElfImage Image = {
+        .Text = Emitter.Code,
+        .EntryOffset = EmitStart(&Emitter, NativeEntryPoint, &Layout),
+        .Data = Chunk->Global.Data.As.Raw,
+        .DataSize = Chunk->Global.Count,
+        .BssSize = End - Layout.PVM,
+    };
+    Image.TextSize = Emitter.Count;
+    PASCAL_ASSERT(Emitter.Count <= Emitter.Cap, "Code buffer overflow");
+
+    bool Ok = ElfWriteExecutable(FileName, &Image);
+    if (!Ok)
+        fprintf(LogFile, "Unable to write '%s'\n", FileName);
+    MemDeallocateArray(Emitter.Code);
+    return Ok;
+}
+
+
+
+#undef EMIT_MOVE
+#undef EMIT_BINARY3
+#undef EMIT_LOAD
+#undef EMIT_OP
+#undef EMIT
+#undef RM_MEM
+#undef RM_REG
+#undef ERROR_EXIT_SIZE
+#undef MAX_NATIVE_SIZE_PER_INS
+#undef CC_NONE
+#undef CC_L
+#undef CC_P
+#undef CC_A
+#undef CC_AE
+#undef CC_B
+#undef CC_NE
+#undef CC_E
+#undef ERROR_LINE_DISP
+#undef ERROR_PC_DISP
+#undef STACK_END_DISP
+#undef RETSTACK_END_DISP
+#undef RETSTACK_START_DISP
+#undef RETSTACK_VAL_DISP
+#undef CONDITION_DISP
+#undef F_DISP
+#undef R_DISP
+#undef JIT_BYTE
+#undef JIT_16
+#undef JIT_64
+#undef JIT_32
+#undef NOT_PINNED
+#undef R15
+#undef R13
+#undef R12
+#undef R11
+#undef R10
+#undef R9
+#undef R8
+#undef RDI
+#undef RSI
+#undef RBX
+#undef RDX
+#undef RCX
+#undef RAX
+
+#else
+
+bool PVMJitRun(PascalVM *PVM, PVMChunk *Chunk, PVMReturnValue *ReturnValue)
+{
+    UNUSED(PVM, Chunk, ReturnValue);
+    return false;
+}
+
+PVMJitProgram *PVMJitCompile(PVMChunk *Chunk)
+{
+    UNUSED(Chunk);
+    return NULL;
+}
+
+PVMReturnValue PVMJitEnter(PascalVM *PVM, PVMJitProgram *Program, const PVMDecodedIns *At)
+{
+    UNUSED(PVM, Program, At);
+    PASCAL_UNREACHABLE("PVMJitCompile() never returns a program without the JIT");
+    return PVM_ILLEGAL_INSTRUCTION;
+}
+
+void PVMJitFree(PVMJitProgram *Program)
+{
+    UNUSED(Program);
+}
+
+bool PVMJitWriteExecutable(PVMChunk *Chunk, const char *FileName, U32 StackSize, UInt RetStackSize, FILE *LogFile)
+{
+    UNUSED(Chunk, FileName, StackSize, RetStackSize);
+    fprintf(LogFile, "Writing executables is only supported on x86-64 Linux\n");
+    return false;
+}
+
+#endif /* PVM_JIT_AVAILABLE */
+
@@ -0,0 +1,610 @@
+#include <string.h>
+
+#include "Memory.h"
+#include "PascalString.h"
+#include "PVM/Output.h"
+
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <unistd.h>
+#  define IS_TERMINAL(File) (0 != isatty(fileno(File)))
+#elif defined(_WIN32)
+#  include <io.h>
+#  define IS_TERMINAL(File) (0 != _isatty(_fileno(File)))
+#else
+#  define IS_TERMINAL(File) true
+#endif /* unix */
+
+#if PVM_OUTPUT_ASYNC
+#  include <errno.h>
+#  include <pthread.h>
+#  include <sys/mman.h>
+#  include <sys/uio.h>
+#endif /* PVM_OUTPUT_ASYNC */
+
+/* also fits the longest string */
+#define MIN_CAPACITY (PVM_OUTPUT_MAX_VALUE + PSTR_MAX_LEN + 1)
+/* fraction bits of the fixed point number the digits after the decimal point are generated from, 
+ * fits any fraction that does not round to 0 with room for multiplying by 10 */
+#define FRAC_BITS 76
+
+
+static const char sDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+
+
+#if PVM_OUTPUT_ASYNC
+
+#define LOAD(Ptr, Order) __atomic_load_n(Ptr, __ATOMIC_##Order)
+#define STORE(Ptr, Value, Order) __atomic_store_n(Ptr, Value, __ATOMIC_##Order)
+
+/*
+ * Head and Tail only ever grow, Head - Tail bytes starting at Data[Tail % Capacity] are waiting to be written.
+ * The VM is the only one to move Head, the writer thread the only one to move Tail. 
+ * Whoever finds the ring empty (writer) or full (VM) sets its Waiting flag under Lock and sleeps on its condition, 
+ * the other side only takes Lock to wake it up when it sees the flag
+ */
+struct PVMOutputRing
+{
+    U8 *Data; /* mapped, the ring can be bigger than the memory pool */
+    USize Capacity; /* power of 2 */
+    U64 Head, Tail;
+    int Fd; /* only changes while the ring is empty */
+    int WriterWaiting, VMWaiting, Stop;
+
+    pthread_mutex_t Lock;
+    pthread_cond_t HasData, HasSpace;
+    pthread_t Writer;
+};
+
+
+static void RingWake(PVMOutputRing *Ring, int *Waiting, pthread_cond_t *Cond)
+{
+    if (!LOAD(Waiting, SEQ_CST))
+        return;
+    pthread_mutex_lock(&Ring->Lock);
+    pthread_cond_signal(Cond);
+    pthread_mutex_unlock(&Ring->Lock);
+}
+
+static void *RingWriter(void *Arg)
+{
+    PVMOutputRing *Ring = Arg;
+    U64 Tail = Ring->Tail;
+    while (1)
+    {
+        U64 Head = LOAD(&Ring->Head, ACQUIRE);
+        if (Head == Tail)
+        {
+            if (LOAD(&Ring->Stop, ACQUIRE))
+                break;
+
+            pthread_mutex_lock(&Ring->Lock);
+            STORE(&Ring->WriterWaiting, 1, SEQ_CST);
+            while (LOAD(&Ring->Head, SEQ_CST) == Tail && !LOAD(&Ring->Stop, SEQ_CST))
+                pthread_cond_wait(&Ring->HasData, &Ring->Lock);
+            STORE(&Ring->WriterWaiting, 0, RELAXED);
+            pthread_mutex_unlock(&Ring->Lock);
+            continue;
+        }
+
+        /* everything that is there in one go, the ring may have wrapped around */
+        USize Start = Tail & (Ring->Capacity - 1);
+        USize Len = Head - Tail;
+        struct iovec Chunk[2] = {
+            { .iov_base = Ring->Data + Start, .iov_len = Len },
+        };
+        int ChunkCount = 1;
+        if (Start + Len > Ring->Capacity)
+        {
+            Chunk[0].iov_len = Ring->Capacity - Start;
+            Chunk[1] = (struct iovec) { .iov_base = Ring->Data, .iov_len = Len - Chunk[0].iov_len };
+            ChunkCount = 2;
+        }
+        ssize_t Written = writev(Ring->Fd, Chunk, ChunkCount);
+        if (Written < 0 && EINTR == errno)
+            continue;
+        /* the output is lost like it would be with fwrite, but the VM must not wait for it forever */
+        Tail += Written < 0 ? Len : (USize)Written;
+
+        STORE(&Ring->Tail, Tail, SEQ_CST);
+        RingWake(Ring, &Ring->VMWaiting, &Ring->HasSpace);
+    }
+    return NULL;
+}
+
+/* returns once the writer has written everything up to Until */
+static void RingWaitTail(PVMOutputRing *Ring, U64 Until)
+{
+    if (LOAD(&Ring->Tail, ACQUIRE) >= Until)
+        return;
+
+    pthread_mutex_lock(&Ring->Lock);
+    STORE(&Ring->VMWaiting, 1, SEQ_CST);
+    while (LOAD(&Ring->Tail, SEQ_CST) < Until)
+        pthread_cond_wait(&Ring->HasSpace, &Ring->Lock);
+    STORE(&Ring->VMWaiting, 0, RELAXED);
+    pthread_mutex_unlock(&Ring->Lock);
+}
+
+static void RingPush(PVMOutputRing *Ring, const U8 *Data, USize Len)
+{
+    U64 Head = Ring->Head;
+    while (Len > 0)
+    {
+        /* block only when full */
+        RingWaitTail(Ring, Head + 1 > Ring->Capacity ? Head + 1 - Ring->Capacity : 0);
+        USize Free = Ring->Capacity - (Head - LOAD(&Ring->Tail, ACQUIRE));
+        USize Count = Len < Free ? Len : Free;
+
+        USize Start = Head & (Ring->Capacity - 1);
+        USize First = Ring->Capacity - Start;
+        if (First > Count)
+            First = Count;
+        memcpy(Ring->Data + Start, Data, First);
+        memcpy(Ring->Data, Data + First, Count - First);
+
+        Data += Count;
+        Len -= Count;
+        Head += Count;
+        STORE(&Ring->Head, Head, SEQ_CST);
+        RingWake(Ring, &Ring->WriterWaiting, &Ring->HasData);
+    }
+}
+
+static void RingDrain(PVMOutputRing *Ring)
+{
+    RingWaitTail(Ring, Ring->Head);
+}
+
+static void RingFree(PVMOutputRing *Ring)
+{
+    pthread_cond_destroy(&Ring->HasSpace);
+    pthread_cond_destroy(&Ring->HasData);
+    pthread_mutex_destroy(&Ring->Lock);
+    munmap(Ring->Data, Ring->Capacity);
+    MemDeallocate(Ring);
+}
+
+static void RingStop(PVMOutputRing *Ring)
+{
+    RingDrain(Ring);
+    STORE(&Ring->Stop, 1, SEQ_CST);
+    pthread_mutex_lock(&Ring->Lock);
+    pthread_cond_signal(&Ring->HasData);
+    pthread_mutex_unlock(&Ring->Lock);
+    pthread_join(Ring->Writer, NULL);
+    RingFree(Ring);
+}
+
+#undef LOAD
+#undef STORE
+
+#endif /* PVM_OUTPUT_ASYNC */
+
+
+
+
+PVMOutput PVMOutputInit(USize Capacity)
+{
+    PVMOutput Out = {
+        .File = NULL,
+        .Buffer = NULL,
+        .Count = 0,
+        .Capacity = Capacity < MIN_CAPACITY 
+            ? MIN_CAPACITY 
+            : Capacity > PVM_OUTPUT_MAX_BUFFER_SIZE
+            ? PVM_OUTPUT_MAX_BUFFER_SIZE 
+            : Capacity,
+        .LineBuffered = false,
+        .OwnsBuffer = true,
+        .Ring = NULL,
+    };
+    return Out;
+}
+
+PVMOutput PVMOutputInitWithBuffer(U8 *Buffer, USize Capacity)
+{
+    PASCAL_NONNULL(Buffer);
+    PASCAL_ASSERT(Capacity >= MIN_CAPACITY, "Output buffer of %zu bytes is too small", (size_t)Capacity);
+    PVMOutput Out = PVMOutputInit(0);
+    Out.Buffer = Buffer;
+    Out.Capacity = Capacity;
+    Out.OwnsBuffer = false;
+    return Out;
+}
+
+void PVMOutputDeinit(PVMOutput *Out)
+{
+    PASCAL_NONNULL(Out);
+    PVMOutputFlush(Out);
+#if PVM_OUTPUT_ASYNC
+    if (NULL != Out->Ring)
+        RingStop(Out->Ring);
+#endif /* PVM_OUTPUT_ASYNC */
+    if (Out->OwnsBuffer)
+        MemDeallocate(Out->Buffer);
+    *Out = PVMOutputInit(Out->Capacity);
+}
+
+bool PVMOutputStartWriter(PVMOutput *Out, USize RingCapacity)
+{
+    PASCAL_NONNULL(Out);
+#if PVM_OUTPUT_ASYNC
+    if (NULL != Out->Ring)
+        return true;
+
+    USize Capacity = 4096;
+    if (0 == RingCapacity)
+        RingCapacity = PVM_OUTPUT_RING_SIZE;
+    while (Capacity < RingCapacity)
+        Capacity *= 2;
+
+    U8 *Data = mmap(NULL, Capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == Data)
+        return false;
+    PVMOutputRing *Ring = MemAllocateZero(sizeof *Ring);
+    Ring->Data = Data;
+    Ring->Capacity = Capacity;
+    Ring->Fd = -1;
+    pthread_mutex_init(&Ring->Lock, NULL);
+    pthread_cond_init(&Ring->HasData, NULL);
+    pthread_cond_init(&Ring->HasSpace, NULL);
+    if (0 != pthread_create(&Ring->Writer, NULL, RingWriter, Ring))
+    {
+        RingFree(Ring);
+        return false;
+    }
+
+    /* what was buffered so far still goes to the old FILE, the ring writes to the next one */
+    PVMOutputFlush(Out);
+    Out->File = NULL;
+    Out->Ring = Ring;
+    return true;
+#else
+    (void)RingCapacity;
+    return false;
+#endif /* PVM_OUTPUT_ASYNC */
+}
+
+
+/* hands the buffer over to the FILE or the ring */
+static void OutputCommit(PVMOutput *Out)
+{
+    if (0 == Out->Count)
+        return;
+#if PVM_OUTPUT_ASYNC
+    if (NULL != Out->Ring)
+    {
+        RingPush(Out->Ring, Out->Buffer, Out->Count);
+        Out->Count = 0;
+        return;
+    }
+#endif /* PVM_OUTPUT_ASYNC */
+    fwrite(Out->Buffer, 1, Out->Count, Out->File);
+    fflush(Out->File);
+    Out->Count = 0;
+}
+
+
+void PVMOutputSetFile(PVMOutput *Out, FILE *File)
+{
+    PASCAL_NONNULL(Out);
+    PASCAL_NONNULL(File);
+    if (NULL == Out->Buffer)
+        Out->Buffer = MemAllocate(Out->Capacity);
+    if (File != Out->File)
+    {
+        PVMOutputFlush(Out);
+        Out->File = File;
+        Out->LineBuffered = IS_TERMINAL(File);
+#if PVM_OUTPUT_ASYNC
+        if (NULL != Out->Ring)
+        {
+            /* anything the FILE still buffers came first, the ring is empty */
+            fflush(File);
+            Out->Ring->Fd = fileno(File);
+        }
+#endif /* PVM_OUTPUT_ASYNC */
+    }
+}
+
+void PVMOutputFlush(PVMOutput *Out)
+{
+    PASCAL_NONNULL(Out);
+    OutputCommit(Out);
+#if PVM_OUTPUT_ASYNC
+    if (NULL != Out->Ring)
+        RingDrain(Out->Ring);
+#endif /* PVM_OUTPUT_ASYNC */
+}
+
+void PVMOutputEndWrite(PVMOutput *Out)
+{
+    PASCAL_NONNULL(Out);
+    if (Out->LineBuffered && NULL != memchr(Out->Buffer, '\n', Out->Count))
+        OutputCommit(Out);
+}
+
+
+
+
+/* the formatters write at Out and return the end, Out has room for PVM_OUTPUT_MAX_VALUE bytes */
+
+static U8 *FormatUnsigned(U8 *Out, U64 Value)
+{
+    U8 Tmp[20];
+    U8 *Digit = Tmp + sizeof Tmp;
+    while (Value >= 100)
+    {
+        const char *Pair = &sDigitPairs[(Value % 100) * 2];
+        Value /= 100;
+        *--Digit = Pair[1];
+        *--Digit = Pair[0];
+    }
+    if (Value >= 10)
+    {
+        *--Digit = sDigitPairs[Value*2 + 1];
+        *--Digit = sDigitPairs[Value*2];
+    }
+    else
+    {
+        *--Digit = '0' + Value;
+    }
+
+    USize Len = Tmp + sizeof Tmp - Digit;
+    memcpy(Out, Digit, Len);
+    return Out + Len;
+}
+
+static U8 *FormatSigned(U8 *Out, I64 Value)
+{
+    U64 Magnitude = Value;
+    if (Value < 0)
+    {
+        *Out++ = '-';
+        Magnitude = -Magnitude;
+    }
+    return FormatUnsigned(Out, Magnitude);
+}
+
+/* same as %p */
+static U8 *FormatPointer(U8 *Out, const void *Ptr)
+{
+    if (NULL == Ptr)
+    {
+        memcpy(Out, "nil", 3);
+        return Out + 3;
+    }
+
+    U8 Tmp[16];
+    U8 *Digit = Tmp + sizeof Tmp;
+    uintptr_t Value = (uintptr_t)Ptr;
+    do {
+        *--Digit = "0123456789abcdef"[Value & 0xF];
+        Value >>= 4;
+    } while (Value);
+
+    USize Len = Tmp + sizeof Tmp - Digit;
+    memcpy(Out, "0x", 2);
+    memcpy(Out + 2, Digit, Len);
+    return Out + 2 + Len;
+}
+
+/* Mantissa * 2^Shift exactly, for doubles that don't fit in 64 bits */
+static U8 *FormatBigInteger(U8 *Out, U64 Mantissa, UInt Shift)
+{
+    /* 32 bit limbs, least significant first: 2^(53 + 971) needs 33 of them */
+    U32 Limb[34] = { 0 };
+    UInt Word = Shift / 32;
+    UInt Bit = Shift % 32;
+    U64 Low = (Mantissa & 0xFFFFFFFF) << Bit;
+    U64 High = (Mantissa >> 32) << Bit;
+    U64 Mid = (Low >> 32) + (High & 0xFFFFFFFF);
+    Limb[Word] = (U32)Low;
+    Limb[Word + 1] = (U32)Mid;
+    Limb[Word + 2] = (U32)((High >> 32) + (Mid >> 32));
+    UInt Count = Word + 3;
+
+    /* 9 decimal digits at a time, least significant first */
+    U32 Chunk[40];
+    UInt ChunkCount = 0;
+    while (Count > 0 && 0 == Limb[Count - 1])
+        Count--;
+    while (Count > 0)
+    {
+        U64 Remainder = 0;
+        for (UInt i = Count; i-- > 0; )
+        {
+            U64 Current = (Remainder << 32) | Limb[i];
+            Limb[i] = (U32)(Current / 1000000000);
+            Remainder = Current % 1000000000;
+        }
+        Chunk[ChunkCount++] = (U32)Remainder;
+        while (Count > 0 && 0 == Limb[Count - 1])
+            Count--;
+    }
+
+    Out = FormatUnsigned(Out, Chunk[--ChunkCount]);
+    while (ChunkCount-- > 0)
+    {
+        U32 Value = Chunk[ChunkCount];
+        for (int i = 8; i >= 0; i--)
+        {
+            Out[i] = '0' + Value % 10;
+            Value /= 10;
+        }
+        Out += 9;
+    }
+    return Out;
+}
+
+/* same as %f: the exact value rounded half to even to 6 digits after the decimal point */
+static U8 *FormatDouble(U8 *Out, F64 Value)
+{
+    U64 Bits;
+    memcpy(&Bits, &Value, sizeof Bits);
+    if (Bits >> 63)
+        *Out++ = '-';
+
+    UInt Exponent = (Bits >> 52) & 0x7FF;
+    U64 Mantissa = Bits & (((U64)1 << 52) - 1);
+    if (0x7FF == Exponent)
+    {
+        memcpy(Out, Mantissa ? "nan" : "inf", 3);
+        return Out + 3;
+    }
+    int Shift = -1074;
+    if (0 != Exponent)
+    {
+        Mantissa |= (U64)1 << 52;
+        Shift = (int)Exponent - 1075;
+    }
+
+    /* no fraction */
+    if (Shift >= 0)
+    {
+        Out = Shift <= 11
+            ? FormatUnsigned(Out, Mantissa << Shift)
+            : FormatBigInteger(Out, Mantissa, Shift);
+        memcpy(Out, ".000000", 7);
+        return Out + 7;
+    }
+
+    UInt FracBitCount = -Shift;
+    U64 Integer = 0;
+    U64 Frac = Mantissa;
+    if (FracBitCount < 64)
+    {
+        Integer = Mantissa >> FracBitCount;
+        Frac = Mantissa & (((U64)1 << FracBitCount) - 1);
+    }
+
+    /* anything below 2^-21 rounds to 0.000000 */
+    U8 Digit[6] = { 0 };
+    if (FracBitCount < 53 + 21)
+    {
+        /* the fraction exactly as a fixed point number with FRAC_BITS fraction bits, 
+         * split into Hi and the low 32 bits in Lo so that multiplying by 10 does not overflow */
+        UInt Scale = FRAC_BITS - FracBitCount;
+        U64 Hi, Lo;
+        if (Scale >= 32)
+        {
+            Hi = Frac << (Scale - 32);
+            Lo = 0;
+        }
+        else
+        {
+            Hi = Frac >> (32 - Scale);
+            Lo = (Frac << Scale) & 0xFFFFFFFF;
+        }
+
+        const U64 HiMask = ((U64)1 << (FRAC_BITS - 32)) - 1;
+        for (UInt i = 0; i < sizeof Digit; i++)
+        {
+            Lo *= 10;
+            Hi = Hi*10 + (Lo >> 32);
+            Lo &= 0xFFFFFFFF;
+            Digit[i] = Hi >> (FRAC_BITS - 32);
+            Hi &= HiMask;
+        }
+
+        /* round half to even */
+        const U64 HiHalf = (U64)1 << (FRAC_BITS - 33);
+        if (Hi > HiHalf || (Hi == HiHalf && (0 != Lo || (Digit[5] & 1))))
+        {
+            int i = 5;
+            while (i >= 0 && 9 == Digit[i])
+                Digit[i--] = 0;
+            if (i >= 0)
+                Digit[i]++;
+            else Integer++;
+        }
+    }
+
+    Out = FormatUnsigned(Out, Integer);
+    *Out++ = '.';
+    for (UInt i = 0; i < sizeof Digit; i++)
+        *Out++ = '0' + Digit[i];
+    return Out;
+}
+
+
+void PVMOutputValue(PVMOutput *Out, IntegralType Type, PVMGPR Value)
+{
+    PASCAL_NONNULL(Out);
+    PASCAL_NONNULL(Out->Buffer);
+    if (Out->Capacity - Out->Count < PVM_OUTPUT_MAX_VALUE + PSTR_MAX_LEN)
+        OutputCommit(Out);
+
+    U8 *End = Out->Buffer + Out->Count;
+    switch (Type)
+    {
+    case TYPE_STRING:
+    {
+        const PascalStr *PStr = Value.Ptr.Raw;
+        USize Len = PStrGetLen(PStr);
+        memcpy(End, PStrGetConstPtr(PStr), Len);
+        End += Len;
+    } break;
+    case TYPE_CHAR: *End++ = (U8)Value.SWord.First; break;
+
+    case TYPE_I8:  End = FormatSigned(End, Value.SByte[PVM_LEAST_SIGNIF_BYTE]); break;
+    case TYPE_I16: End = FormatSigned(End, Value.SHalf.First); break;
+    case TYPE_I32: End = FormatSigned(End, Value.SWord.First); break;
+    case TYPE_I64: End = FormatSigned(End, Value.SDWord); break;
+
+    case TYPE_U8:  End = FormatUnsigned(End, Value.Byte[PVM_LEAST_SIGNIF_BYTE]); break;
+    case TYPE_U16: End = FormatUnsigned(End, Value.Half.First); break;
+    case TYPE_U32: End = FormatUnsigned(End, Value.Word.First); break;
+    case TYPE_U64: End = FormatUnsigned(End, Value.DWord); break;
+
+    case TYPE_BOOLEAN:
+    {
+        if (Value.Word.First)
+        {
+            memcpy(End, "TRUE", 4);
+            End += 4;
+        }
+        else
+        {
+            memcpy(End, "FALSE", 5);
+            End += 5;
+        }
+    } break;
+    case TYPE_POINTER: End = FormatPointer(End, Value.Ptr.Raw); break;
+    case TYPE_F64:
+    {
+        F64 f64;
+        memcpy(&f64, &Value, sizeof f64);
+        End = FormatDouble(End, f64);
+    } break;
+    case TYPE_F32:
+    {
+        PVMFPR FltReg;
+        memcpy(&FltReg, &Value, sizeof FltReg);
+        End = FormatDouble(End, FltReg.Single);
+    } break;
+
+    case TYPE_FUNCTION:
+    case TYPE_COUNT:
+    case TYPE_RECORD:
+    case TYPE_STATIC_ARRAY:
+    case TYPE_FILE:
+    case TYPE_INVALID:
+    {
+        PASCAL_UNREACHABLE("Invalid type in %s", __func__);
+    } break;
+    }
+    Out->Count = End - Out->Buffer;
+}
+
+
+#undef IS_TERMINAL
+#undef MIN_CAPACITY
+#undef FRAC_BITS
+
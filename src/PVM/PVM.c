@@ -8,6 +8,10 @@
 #include "PVM/PVM.h"
 #include "PVM/Disassembler.h"
 #include "PVM/Debugger.h"
+#include "PVM/Decoder.h"
+#include "PVM/Guard.h"
+#include "PVM/Jit.h"
+#include "PVM/CBackend.h"
 #include "PascalString.h"
 
 
@@ -17,24 +21,37 @@ PascalVM PVMInit(U32 StackSize, UInt RetStackSize)
         .F = { 0 },
         .R = { 0 },
         .Condition = false,
-        .Stack.Start.Raw = MemAllocateArray(PVM.Stack.Start.DWord[0], StackSize),
-        .RetStack.Start = MemAllocateArray(PVM.RetStack.Start[0], RetStackSize),
-        .RetStack.SizeLeft = RetStackSize,
+        .Stack.Start.Raw = PVMGuardAllocate(StackSize * sizeof PVM.Stack.Start.DWord[0]),
+        .RetStack.Start = PVMGuardAllocate(RetStackSize * sizeof PVM.RetStack.Start[0]),
 
         .LogFile = stderr,
         .Error = { 0 }, 
         .SingleStepMode = false,
         .Disassemble = false,
+        .Jit = false,
+        .HotThreshold = 1000,
+        .Tier = { 0 },
+        .CallCache = { 0 },
+        .NativeOutput = NULL,
+        .Output = PVMOutputInit(PVM_OUTPUT_BUFFER_SIZE),
+        .Input = PVMInputInit(PVM_INPUT_BUFFER_SIZE),
+        .Files = NULL,
     };
     PVM.Stack.End.Raw = PVM.Stack.Start.DWord + StackSize;
     PVM.RetStack.Val = PVM.RetStack.Start;
+    PVM.RetStack.End = PVM.RetStack.Start + RetStackSize;
     return PVM;
 }
 
 void PVMDeinit(PascalVM *PVM)
 {
-    MemDeallocateArray(PVM->Stack.Start.Raw);
-    MemDeallocateArray(PVM->RetStack.Start);
+    PVMFileCloseAll(&PVM->Files);
+    PVMInputDeinit(&PVM->Input);
+    PVMOutputDeinit(&PVM->Output);
+    PVMGuardDeallocate(PVM->Stack.Start.Raw, (USize)(PVM->Stack.End.Byte - PVM->Stack.Start.Byte));
+    PVMGuardDeallocate(PVM->RetStack.Start, 
+            (USize)(PVM->RetStack.End - PVM->RetStack.Start) * sizeof PVM->RetStack.Start[0]
+    );
     *PVM = (PascalVM){ 0 };
 }
 
@@ -51,93 +68,79 @@ static void RuntimeError(const PascalVM *PVM, const char *Fmt, ...)
     va_end(Args);
 }
 
-static const PascalStr *RuntimeTypeToStr(IntegralType Type, PVMGPR Data)
+/* the file behind the text variable that R1 of a file sys op points to, NULL if it was never assigned */
+static PVMFile *PVMFileOf(PascalVM *PVM, PVMGPR R1)
 {
-#define INTEGER_TO_STR(Fmt, RegType) do {\
-    int Len = snprintf(Str, PSTR_MAX_LEN, Fmt, Data RegType);\
-    PStrSetLen(&Tmp, Len);\
-} while (0)
-
-    static PascalStr Tmp;
-    char *Str = (char *)PStrGetPtr(&Tmp);
-    PStrSetLen(&Tmp, 0);
+    PVMFile *Handle;
+    memcpy(&Handle, R1.Ptr.Raw, sizeof Handle);
+    return PVMFileFind(PVM->Files, Handle);
+}
 
-    switch (Type)
-    {
-    case TYPE_STRING: return Data.Ptr.Raw;
+#ifdef PVM_PROFILE
+/* how many times the second opcode was executed right after the first one, 
+ * see test/benchmark/pairs.sh */
+static U64 sPairCount[256][256];
 
-    case TYPE_CHAR:
-    {
-        int Len = snprintf(Str, PSTR_MAX_LEN, "%c", Data.SWord.First);
-        PStrSetLen(&Tmp, Len);
-    } break;
-    case TYPE_I8:  INTEGER_TO_STR("%"PRIi8, .SByte[PVM_LEAST_SIGNIF_BYTE]); break;
-    case TYPE_I16: INTEGER_TO_STR("%"PRIi16, .SHalf.First); break;
-    case TYPE_I32: INTEGER_TO_STR("%"PRIi32, .SWord.First); break;
-    case TYPE_I64: INTEGER_TO_STR("%"PRIi64, .SDWord); break;
-
-    case TYPE_U8:  INTEGER_TO_STR("%"PRIu8, .Byte[PVM_LEAST_SIGNIF_BYTE]); break;
-    case TYPE_U16: INTEGER_TO_STR("%"PRIu16, .Half.First); break;
-    case TYPE_U32: INTEGER_TO_STR("%"PRIu32, .Word.First); break;
-    case TYPE_U64: INTEGER_TO_STR("%"PRIu64, .DWord); break;
-
-    case TYPE_BOOLEAN:
-    {
-        if (Data.Word.First)
-        {
-            Tmp = PStrCopy((const U8*)"TRUE", sizeof("TRUE") - 1);
-        }
-        else
-        {
-            Tmp = PStrCopy((const U8*)"FALSE", sizeof("FALSE") - 1);
-        }
-    } break;
-    case TYPE_POINTER:
+static void PVMDumpPairProfile(FILE *f)
+{
+    static const char *const sOpName[256] = {
+#define PVM_HANDLER(Op, ...) [Op] = #Op,
+#include "Handlers.inc"
+#undef PVM_HANDLER
+    };
+    for (UInt First = 0; First < 256; First++)
     {
-        int Len;
-        if (NULL == Data.Ptr.Raw)
-        {
-            Len = snprintf(Str, PSTR_MAX_LEN, "nil");
-        }
-        else
-        { 
-            Len = snprintf(Str, PSTR_MAX_LEN, "%p", Data.Ptr.Raw);
+        for (UInt Second = 0; Second < 256; Second++)
+        {
+            if (0 == sPairCount[First][Second])
+                continue;
+            fprintf(f, "Pair: %s %s %llu\n", 
+                    sOpName[First] ? sOpName[First] : "???", 
+                    sOpName[Second] ? sOpName[Second] : "???", 
+                    (unsigned long long)sPairCount[First][Second]
+            );
         }
-        PStrSetLen(&Tmp, Len);
-    } break;
-    case TYPE_F64:
-    { 
-        F64 f64;
-        memcpy(&f64, &Data, sizeof f64);
-        int Len = snprintf(Str, PSTR_MAX_LEN, "%f", f64);
-        PStrSetLen(&Tmp, Len);
-    } break;
-    case TYPE_F32:
-    {
-        PVMFPR FltReg;
-        memcpy(&FltReg, &Data, sizeof FltReg);
-        F32 f32 = FltReg.Single;
-        int Len = snprintf(Str, PSTR_MAX_LEN, "%f", f32);
-        PStrSetLen(&Tmp, Len);
-    } break;
-
-    case TYPE_FUNCTION:
-    case TYPE_COUNT:
-    case TYPE_RECORD:
-    case TYPE_STATIC_ARRAY:
-    case TYPE_INVALID:
-    {
-        PASCAL_UNREACHABLE("Invalid type in %s", __func__);
-    } break;
-
     }
+}
+#  define PVM_PROFILE_PAIR(Prev, Curr) sPairCount[PVM_GET_OP((Prev)->Opcode)][PVM_GET_OP((Curr)->Opcode)]++
+/* superinstructions would hide the pairs we're trying to count */
+#  define PVM_FUSE_ALLOWED false
+#else
+#  define PVM_PROFILE_PAIR(Prev, Curr) (void)0
+#  define PVM_FUSE_ALLOWED true
+#endif /* PVM_PROFILE */
 
-    return &Tmp;
 
-#undef INTEGER_TO_STR
+/* which callptr sites only ever saw one callee, only the interpreter fills the inline caches */
+static void PVMDumpCallSites(FILE *f, const PascalVM *PVM, const PVMChunk *Chunk)
+{
+    if (0 == PVM->CallCache.Hits + PVM->CallCache.Misses)
+        return;
+
+    U32 SiteCount[PVM_CALLSITE_POLYMORPHIC + 1] = { 0 };
+    for (U32 i = 0; i < Chunk->Decoded.Count; i++)
+    {
+        const PVMDecodedIns *Ins = &Chunk->Decoded.Ins[i];
+        if (OP_CALLPTR == PVMDecodedOp(Ins))
+            SiteCount[Ins->Rs]++;
+    }
+    fprintf(f, "Call sites: %u monomorphic, %u polymorphic, %u never called\n"
+               "Call cache: %llu hits, %llu misses\n",
+            SiteCount[1], SiteCount[PVM_CALLSITE_POLYMORPHIC], SiteCount[0],
+            (unsigned long long)PVM->CallCache.Hits, (unsigned long long)PVM->CallCache.Misses
+    );
 }
 
 
+/* runs Interpret, a fault in the guard pages of the stacks becomes PVM_CALLSTACK_OVERFLOW */
+static PVMReturnValue PVMInterpretGuarded(PascalVM *PVM, PVMChunk *Chunk, 
+        PVMReturnValue (*Interpret)(PascalVM *, PVMChunk *)
+);
+/* tiered execution, defined with the interpreters below */
+static PVMReturnValue PVMInterpretTiered(PascalVM *PVM, PVMChunk *Chunk);
+static bool PVMCanTierUp(PVMChunk *Chunk);
+static void PVMTierDeinit(PascalVM *PVM);
+
 bool PVMRun(PascalVM *PVM, PVMChunk *Chunk)
 {
     if (PVM->Disassemble)
@@ -148,12 +151,49 @@ bool PVMRun(PascalVM *PVM, PVMChunk *Chunk)
     }
 
     bool NoError = false;
+    const char *Strategy = "jit";
+    PVMReturnValue Ret;
+    /* the debugger needs the interpreter, 
+     * the C compiler is run before the clock starts */
+    PVMNativeProgram *Native = NULL;
+    if (NULL != PVM->NativeOutput && !PVM->SingleStepMode)
+        Native = PVMCBackendLoad(PVM, Chunk, PVM->NativeOutput);
+    /* the JIT either takes over hot code from the interpreter or compiles everything up front */
+    bool Tiered = NULL == Native && PVM->Jit && PVM_JIT_AVAILABLE && !PVM->SingleStepMode
+        && 0 != PVM->HotThreshold && PVMCanTierUp(Chunk);
+    PVM->CallCache.Hits = 0;
+    PVM->CallCache.Misses = 0;
+    PVM->Input.Tie = &PVM->Output;
     double Start = clock();
-    PVMReturnValue Ret = PVMInterpret(PVM, Chunk);
+    if (NULL != Native)
+    {
+        Strategy = "c";
+        Ret = PVMCBackendRun(PVM, Chunk, Native);
+    }
+    else if (Tiered)
+    {
+        Ret = PVMInterpretGuarded(PVM, Chunk, PVMInterpretTiered);
+        Strategy = NULL == PVM->Tier.Native ? PVMGetDispatchStrategy() : "tiered";
+    }
+    else if (!PVM->Jit || PVM->SingleStepMode || !PVMJitRun(PVM, Chunk, &Ret))
+    {
+        Strategy = PVMGetDispatchStrategy();
+        Ret = PVMInterpretGuarded(PVM, Chunk, PVMInterpret);
+    }
+    PVMOutputFlush(&PVM->Output);
     double End = clock();
+    PVMCBackendUnload(Native);
+    PVMTierDeinit(PVM);
 
     if (PVM->Disassemble)
+    {
         PVMDumpState(PVM->LogFile, PVM, 4);
+        PVMDumpCallSites(PVM->LogFile, PVM, Chunk);
+    }
+#ifdef PVM_PROFILE
+    if (NULL != PVM->LogFile)
+        PVMDumpPairProfile(PVM->LogFile);
+#endif /* PVM_PROFILE */
 
 
     if (NULL != PVM->LogFile)
@@ -163,7 +203,9 @@ bool PVMRun(PascalVM *PVM, PVMChunk *Chunk)
         case PVM_NO_ERROR:
         {
             fprintf(PVM->LogFile, "Finished execution.\n"
-                    "Time elapsed: %f ms\n", (End - Start) * 1000 / CLOCKS_PER_SEC
+                    "Dispatch: %s\n"
+                    "Time elapsed: %f ms\n", 
+                    Strategy, (End - Start) * 1000 / CLOCKS_PER_SEC
             );
             NoError = true;
         } break;
@@ -179,6 +221,42 @@ bool PVMRun(PascalVM *PVM, PVMChunk *Chunk)
         {
             RuntimeError(PVM, "IllegalInstruction");
         } break;
+        case PVM_INVALID_INPUT:
+        {
+            RuntimeError(PVM, "Invalid numeric format");
+        } break;
+        case PVM_FILE_NOT_ASSIGNED:
+        {
+            RuntimeError(PVM, "File not assigned");
+        } break;
+        case PVM_FILE_NOT_FOUND:
+        {
+            RuntimeError(PVM, "File not found");
+        } break;
+        case PVM_FILE_ACCESS_DENIED:
+        {
+            RuntimeError(PVM, "File access denied");
+        } break;
+        case PVM_FILE_NOT_OPEN_FOR_INPUT:
+        {
+            RuntimeError(PVM, "File not open for input");
+        } break;
+        case PVM_FILE_NOT_OPEN_FOR_OUTPUT:
+        {
+            RuntimeError(PVM, "File not open for output");
+        } break;
+        case PVM_FILE_NOT_OPEN:
+        {
+            RuntimeError(PVM, "File not open");
+        } break;
+        case PVM_FILE_READ_PAST_EOF:
+        {
+            RuntimeError(PVM, "Read past end of file");
+        } break;
+        case PVM_FILE_SEEK_OUT_OF_RANGE:
+        {
+            RuntimeError(PVM, "Seek out of range");
+        } break;
         }
     }
     return NoError;
@@ -187,54 +265,98 @@ bool PVMRun(PascalVM *PVM, PVMChunk *Chunk)
 
 
 
-PVMReturnValue PVMInterpret(PascalVM *PVM, PVMChunk *Chunk)
-{
-#define FP() PVM->R[PVM_REG_FP]
-#define SP() PVM->R[PVM_REG_SP]
 
-#define ASSIGNMENT 
 
-#define INTEGER_BINARY_OP(Operator, Opc, RegType)\
-    PVM->R[PVM_GET_RD(Opc)]RegType GLUE(Operator,=) PVM->R[PVM_GET_RS(Opc)]RegType
-#define INTEGER_SET_IF(Operator, Opc, RegType)\
-    PVM->Condition = PVM->R[PVM_GET_RD(Opc)]RegType Operator PVM->R[PVM_GET_RS(Opc)]RegType
 
-#define GET_BR_IMM(Opc, IP) \
-    BitSex32Safe(((U32)*IP++ << 8) | (((U32)(Opc) & 0xFF)), 23) /* sign extend at bit 23 */
-#define GET_BCC_IMM(Opc, IP) \
-    BitSex32Safe(((U32)*IP++ << 4) | (((U32)(Opc) & 0xF)), 19) /* sign extend at bit 19 */
 
-#define FLOAT_BINARY_OP(Operator, Opc, RegType)\
-    PVM->F[PVM_GET_RD(Opc)]RegType GLUE(Operator,=) PVM->F[PVM_GET_RS(Opc)]RegType
-#define FLOAT_SET_IF(Operator, Opc, RegType)\
-    PVM->Condition = PVM->F[PVM_GET_RD(Opc)]RegType Operator PVM->F[PVM_GET_RS(Opc)]RegType
+/* R, F and Condition are declared by the interpreter, see Interpreter.inc */
+#define FP() R[PVM_REG_FP]
+#define SP() R[PVM_REG_SP]
+
+#define ASSIGNMENT 
+
+#define INTEGER_BINARY_OP(Operator, Ins, RegType)\
+    R[(Ins)->Rd]RegType GLUE(Operator,=) R[(Ins)->Rs]RegType
+#define INTEGER_SET_IF(Operator, Ins, RegType)\
+    Condition = R[(Ins)->Rd]RegType Operator R[(Ins)->Rs]RegType
+
+#define FLOAT_BINARY_OP(Operator, Ins, RegType)\
+    F[(Ins)->Rd]RegType GLUE(Operator,=) F[(Ins)->Rs]RegType
+#define FLOAT_SET_IF(Operator, Ins, RegType)\
+    Condition = F[(Ins)->Rd]RegType Operator F[(Ins)->Rs]RegType
+
+/* three-operand versions, Rt was decoded into As.Imm */
+#define INTEGER_BINARY_OP3(Operator, Ins, RegType)\
+    R[(Ins)->Rd]RegType = R[(Ins)->Rs]RegType Operator R[(Ins)->As.Imm]RegType
+#define INTEGER_SHIFT_OP3(Operator, Ins, RegType, Mask)\
+    R[(Ins)->Rd]RegType = R[(Ins)->Rs]RegType Operator (R[(Ins)->As.Imm]RegType & (Mask))
+#define FLOAT_BINARY_OP3(Operator, Ins, RegType)\
+    F[(Ins)->Rd]RegType = F[(Ins)->Rs]RegType Operator F[(Ins)->As.Imm]RegType
+
+/* compare and branch, the QI versions have a sign extended 4 bit immediate in Rs */
+#define BRANCH_IF(Ins, Expr) do {\
+    if (Expr) {\
+        IP = (Ins)->As.Target;\
+        PVM_HOT_BRANCH(IP);\
+    }\
+} while (0)
+#define INTEGER_BRANCH_IF(Operator, Ins, RegType)\
+    BRANCH_IF(Ins, R[(Ins)->Rd]RegType Operator R[(Ins)->Rs]RegType)
+#define INTEGER_BRANCH_IF_QI(Operator, Ins, RegType, ImmType)\
+    BRANCH_IF(Ins, R[(Ins)->Rd]RegType Operator (ImmType)BitSex64((Ins)->Rs, 3))
+#define FLOAT_BRANCH_IF(Operator, Ins, RegType)\
+    BRANCH_IF(Ins, F[(Ins)->Rd]RegType Operator F[(Ins)->Rs]RegType)
+#define FLOAT_BRANCH_IF_NOT(Operator, Ins, RegType)\
+    BRANCH_IF(Ins, !(F[(Ins)->Rd]RegType Operator F[(Ins)->Rs]RegType))
+
+#if PVM_GUARD_PAGES
+/* overflowing either stack faults in its guard pages, PVMInterpretGuarded reports it */
+#  define PVM_CHECK_STACK() (void)0
+#  define PVM_CHECK_RETSTACK() (void)0
+/* touches the top of a new frame, so that a frame that does not fit faults right away 
+ * instead of leaving SP past the guard pages */
+#  define PVM_PROBE_FRAME(FrameSize) do {\
+    if ((FrameSize) > PVM_GUARD_SIZE)\
+        PVM_CHECK_STACK_END();\
+    else if (FrameSize)\
+        (void)*(volatile U8 *)SP().Ptr.Raw;\
+} while (0)
+#else
+#  define PVM_CHECK_STACK() PVM_CHECK_STACK_END()
+#  define PVM_CHECK_RETSTACK() do {\
+    if (PVM->RetStack.Val == PVM->RetStack.End)\
+        PVM_EXIT(PVM_CALLSTACK_OVERFLOW);\
+} while (0)
+#  define PVM_PROBE_FRAME(FrameSize) PVM_CHECK_STACK_END()
+#endif /* PVM_GUARD_PAGES */
+#define PVM_CHECK_STACK_END() do {\
+    if (SP().Ptr.Byte + sizeof(PVMGPR) > PVM->Stack.End.Byte)\
+        PVM_EXIT(PVM_CALLSTACK_OVERFLOW);\
+} while (0)
 
-/* starting from R(Base) to R(Base + 8) */
-#define PUSH_MULTIPLE(RegType, Base, Top, RegList) do{\
+/* starting from R(Base) to R(Base + 7) */
+#define PUSH_MULTIPLE(RegType, Base, RegList) do{\
     UInt RegList_ = RegList;\
-    UInt Base_ = Base;\
-    UInt i = Base_;\
-    while (RegList_ && i < Top) {\
+    UInt i = Base;\
+    while (RegList_) {\
         if (RegList_ & 1) {\
-            *(++SP().Ptr.DWord) = PVM->RegType[i].DWord;\
-            /* TODO: check stack */\
+            *(++SP().Ptr.DWord) = RegType[i].DWord;\
         }\
         i++;\
         RegList_ >>= 1;\
     }\
+    PVM_CHECK_STACK();\
 } while (0)
 
-/* starting from R(Base + 8) to R(Base) */
-#define POP_MULTIPLE(RegType, Base, Top, RegList) do{\
+/* starting from R(Base + 7) to R(Base) */
+#define POP_MULTIPLE(RegType, Base, RegList) do{\
     UInt RegList_ = RegList;\
-    UInt Base_ = Base;\
-    UInt i = Base_;\
-    while (RegList_ && i < Top) {\
+    UInt i = (Base) + 7;\
+    while (RegList_) {\
         if (RegList_ & 0x80) {\
-            PVM->RegType[(Base + (PVM_REG_COUNT/2)-1) - i].DWord = *(SP().Ptr.DWord--);\
-            /* TODO: check stack */\
+            RegType[i].DWord = *(SP().Ptr.DWord--);\
         }\
-        i++;\
+        i--;\
         RegList_ = (RegList_ << 1) & 0xFF;\
     }\
 } while (0)
@@ -245,618 +367,289 @@ PVMReturnValue PVMInterpret(PascalVM *PVM, PVMChunk *Chunk)
     }\
 } while(0)
 
-#define MOVE_INTEGER(Opc, DestSize, SrcSize)\
-    PVM->R[PVM_GET_RD(Opc)]DestSize = PVM->R[PVM_GET_RS(Opc)]SrcSize
-#define MOVE_FLOAT(Opc, DestSize, SrcSize)\
-    PVM->F[PVM_GET_RD(Opc)]DestSize = PVM->F[PVM_GET_RS(Opc)]SrcSize
-#define MOVE_INTER(Opc, Rd, RdSize, Rs, RsSize)\
-    PVM->Rd[PVM_GET_RD(Opc)]RdSize = PVM->Rs[PVM_GET_RS(Opc)]RsSize
+#define MOVE_INTEGER(Ins, DestSize, SrcSize)\
+    R[(Ins)->Rd]DestSize = R[(Ins)->Rs]SrcSize
+#define MOVE_FLOAT(Ins, DestSize, SrcSize)\
+    F[(Ins)->Rd]DestSize = F[(Ins)->Rs]SrcSize
+#define MOVE_INTER(Ins, Rd_, RdSize, Rs_, RsSize)\
+    Rd_[(Ins)->Rd]RdSize = Rs_[(Ins)->Rs]RsSize
 
-#define LOAD_INTEGER(Opc, ImmType, IP, DestSize, AddrMode, Type, Cast)\
-do {\
-    U64 Offset = 0;\
-    GET_SEX_IMM(Offset, ImmType, IP);\
-    memcpy(&PVM->R[PVM_GET_RD(Opc)]DestSize, PVM->R[PVM_GET_RS(Opcode)]AddrMode + Offset, sizeof Type);\
-    PVM->R[PVM_GET_RD(Opcode)]DestSize = (Cast PVM->R[PVM_GET_RD(Opcode)]DestSize);\
-} while(0)
-#define STORE_INTEGER(Opc, ImmType, IP, SrcSize, AddrMode)\
+/* the offset was sign extended by the decoder */
+#define LOAD_INTEGER(Ins, DestSize, AddrMode, Type, Cast)\
 do {\
-    U64 Offset = 0;\
-    GET_SEX_IMM(Offset, ImmType, IP);\
-    memcpy(PVM->R[PVM_GET_RS(Opcode)]AddrMode + Offset, &PVM->R[PVM_GET_RD(Opc)]SrcSize, sizeof PVM->R[0]SrcSize);\
+    memcpy(&R[(Ins)->Rd]DestSize, R[(Ins)->Rs]AddrMode + (Ins)->As.Imm, sizeof Type);\
+    R[(Ins)->Rd]DestSize = (Cast R[(Ins)->Rd]DestSize);\
 } while(0)
+#define STORE_INTEGER(Ins, SrcSize, AddrMode)\
+    memcpy(R[(Ins)->Rs]AddrMode + (Ins)->As.Imm, &R[(Ins)->Rd]SrcSize, sizeof R[0]SrcSize)
+
+#define LOAD_FLOAT(Ins, DestSize, AddrMode)\
+    memcpy(&F[(Ins)->Rd]DestSize, R[(Ins)->Rs]AddrMode + (Ins)->As.Imm, sizeof F[0]DestSize)
+#define STORE_FLOAT(Ins, SrcSize, AddrMode)\
+    memcpy(R[(Ins)->Rs]AddrMode + (Ins)->As.Imm, &F[(Ins)->Rd]SrcSize, sizeof F[0]SrcSize)
+
+#define PVM_INIT_REGISTERS(PVM, Chunk) do {\
+    FP().Ptr = (PVM)->Stack.Start;\
+    SP().Ptr.Byte = (PVM)->Stack.Start.Byte - sizeof(PVMGPR);\
+    R[PVM_REG_GP].Ptr.Raw = (Chunk)->Global.Data.As.Raw;\
+} while (0)
 
-#define LOAD_FLOAT(Opc, ImmType, IP, DestSize, AddrMode)\
-do {\
-    U64 Offset = 0;\
-    GET_SEX_IMM(Offset, ImmType, IP);\
-    memcpy(&PVM->F[PVM_GET_RD(Opc)]DestSize, PVM->R[PVM_GET_RS(Opcode)]AddrMode + Offset, sizeof PVM->F[0]DestSize);\
-} while(0)
-#define STORE_FLOAT(Opc, ImmType, IP, SrcSize, AddrMode)\
-do {\
-    U64 Offset = 0;\
-    GET_SEX_IMM(Offset, ImmType, IP);\
-    memcpy(PVM->R[PVM_GET_RS(Opcode)]AddrMode + Offset, &PVM->F[PVM_GET_RD(Opc)]SrcSize, sizeof PVM->F[0]SrcSize);\
-} while(0)
 
-#define GET_SEX_IMM(U64_OutVariable, ImmType, IP)\
-do {\
-    UInt Count = 0;\
-    UInt SexIndex = 0; /* Sign EXtend */\
-    switch (ImmType) {\
-    case IMMTYPE_I16: SexIndex = 15; FALLTHROUGH;\
-    case IMMTYPE_U16: Count = 1; break;\
-    case IMMTYPE_I32: SexIndex = 31; FALLTHROUGH;\
-    case IMMTYPE_U32: Count = 2; break;\
-    case IMMTYPE_I48: SexIndex = 47; FALLTHROUGH;\
-    case IMMTYPE_U48: Count = 3; break;\
-    case IMMTYPE_U64: Count = 4; break;\
-    }\
-    for (UInt i = 0; i < Count; i++) {\
-        U64_OutVariable |= (U64)*IP++ << i*16;\
-    }\
-    if (SexIndex)\
-        U64_OutVariable = BitSex64(U64_OutVariable, SexIndex);\
-} while(0)
 
+int PVMGetLine(PVMChunk *Chunk, U32 StreamOffset)
+{
+    LineDebugInfo *Info = ChunkGetDebugInfo(Chunk, StreamOffset);
+    if (NULL == Info)
+    {
+        return 0;
+    }
 
+    if (Info->Count > 0)
+    {
+        return Info->Line[Info->Count - 1];
+    }
+    return Info->Line[0];
+}
 
-    U16 *IP = Chunk->Code + Chunk->EntryPoint;
-    FP().Ptr = PVM->Stack.Start;
-    SP().Ptr.Byte = PVM->Stack.Start.Byte - sizeof(PVMGPR);
-    PVM->R[PVM_REG_GP].Ptr.Raw = Chunk->Global.Data.As.Raw;
-    PVMReturnValue ReturnValue = PVM_NO_ERROR;
-    U32 StreamOffset = 0;
+void PVMSetErrorLocation(PascalVM *PVM, PVMChunk *Chunk, U32 StreamOffset)
+{
+    PVM->Error.Line = PVMGetLine(Chunk, StreamOffset);
+    PVM->Error.PC = StreamOffset;
+}
+
+static PVMReturnValue PVMInterpretExit(PascalVM *PVM, PVMChunk *Chunk, const PVMDecodedIns *Ins, PVMReturnValue ReturnValue)
+{
+    PVMSetErrorLocation(PVM, Chunk, Ins->StreamOffset);
+    return ReturnValue;
+}
 
-    while (1)
+
+static void PVMTierInit(PascalVM *PVM, PVMChunk *Chunk)
+{
+    MemDeallocateArray(PVM->Tier.Counter);
+    PVM->Tier.Counter = MemAllocateArray(U32, Chunk->Decoded.Count + 1);
+    for (U32 i = 0; i <= Chunk->Decoded.Count; i++)
+        PVM->Tier.Counter[i] = PVM->HotThreshold;
+}
+
+static void PVMTierDeinit(PascalVM *PVM)
+{
+    PVMJitFree(PVM->Tier.Native);
+    MemDeallocateArray(PVM->Tier.Counter);
+    PVM->Tier.Native = NULL;
+    PVM->Tier.Counter = NULL;
+}
+
+/* 
+ * Target got hot in the tiered interpreter, runs native code from there until its frame returns.
+ * Returns the instruction to go on interpreting at, Target itself if the chunk could not be compiled, 
+ * or NULL if the program finished or failed with *ReturnValue
+ */
+static PVMDecodedIns *PVMTierUp(PascalVM *PVM, PVMChunk *Chunk, PVMDecodedIns *Target, PVMReturnValue *ReturnValue)
+{
+    /* compiled once, every hot target after that only has to jump in */
+    if (NULL == PVM->Tier.Native)
+        PVM->Tier.Native = PVMJitCompile(Chunk);
+    if (NULL == PVM->Tier.Native)
     {
-        if (PVM->SingleStepMode)
-        {
-            PVMDebugPause(PVM, Chunk, IP);
-        }
+        PVM->Tier.Counter[Target - Chunk->Decoded.Ins] = UINT32_MAX;
+        return Target;
+    }
 
-        UInt Opcode = *IP++;
-        switch (PVM_GET_OP(Opcode))
-        {
-        case OP_SYS:
-        {
-            switch (PVM_GET_SYS_OP(Opcode))
-            {
-            case OP_SYS_EXIT:
-            {
-                /* global scope, exit */
-                if (PVM->RetStack.Val == PVM->RetStack.Start)
-                    goto Exit;
-
-                /* stack scope, return */
-                PVM->RetStack.Val--;
-                IP = PVM->RetStack.Val->IP;
-                SP().Ptr.Byte = FP().Ptr.Byte - sizeof(PVMGPR);
-                FP().Ptr = PVM->RetStack.Val->FP;
-                PVM->RetStack.SizeLeft++;
-            } break;
-            case OP_SYS_ENTER:
-            {
-                /* save frame */
-                FP().Ptr.Byte = SP().Ptr.Byte + sizeof(PVMGPR);
-                U32 StackSize = 0;
-                GET_SEX_IMM(StackSize, IMMTYPE_U32, IP);
-                SP().Ptr.Byte += StackSize;
-
-                if (SP().Ptr.Byte >= PVM->Stack.End.Byte)
-                {
-                    /* TODO: check stack */
-                }
-            } break;
-            case OP_SYS_WRITE:
-            {
-                U32 ArgCount = PVM->R[0].Word.First;
-                PVMGPR *Ptr = SP().Ptr.Raw;
-
-                /* TODO: make this more clear */
-                Ptr -= ArgCount*2 - 1;
-                PVMGPR *Cleanup = Ptr;
-                PASCAL_ASSERT((void*)Ptr >= FP().Ptr.Raw, "Unreachable: %d", ArgCount);
-
-                FILE *OutFile = PVM->R[1].Ptr.Raw;
-                PASCAL_NONNULL(OutFile);
-                for (U32 i = 0; i < ArgCount; i++)
-                {
-                    PVMGPR Value = (*Ptr++);
-                    IntegralType Type = (*Ptr++).DWord;
-                    const PascalStr *PStr = RuntimeTypeToStr(Type, Value);
-                    fprintf(OutFile, "%.*s", 
-                            (int)PStrGetLen(PStr), PStrGetConstPtr(PStr)
-                    );
-                }
-                /* callee does the cleanup */
-                SP().Ptr.Raw = Cleanup - 1;
-                PASCAL_ASSERT((void*)Ptr >= FP().Ptr.Raw, "Unreachable: %d", ArgCount);
-            } break;
-            }
-        } break;
+    bool Global = PVM->RetStack.Val == PVM->RetStack.Start;
+    *ReturnValue = PVMJitEnter(PVM, PVM->Tier.Native, Target);
+    if (PVM_NO_ERROR != *ReturnValue || Global)
+        return NULL;
+    /* the native code returned from the frame, the return address the interpreter saved is still there */
+    return PVM->RetStack.Val->IP;
+}
 
-        case OP_ADD: INTEGER_BINARY_OP(+, Opcode, .Word.First); break;
-        case OP_SUB: INTEGER_BINARY_OP(-, Opcode, .Word.First); break;
-        case OP_MUL: INTEGER_BINARY_OP(*, Opcode, .Word.First); break;
-        case OP_IMUL: INTEGER_BINARY_OP(*, Opcode, .SWord.First); break;
-        case OP_AND: INTEGER_BINARY_OP(&, Opcode, .Word.First); break;
-        case OP_OR:  INTEGER_BINARY_OP(|, Opcode, .Word.First); break;
-        case OP_XOR: INTEGER_BINARY_OP(^, Opcode, .Word.First); break;
-        case OP_DIV:
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].Word.First)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(/, Opcode, .Word.First);
-        } break;
-        case OP_IDIV:
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].SWord.First)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(/, Opcode, .SWord.First);
-        } break;
-        case OP_MOD:
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].Word.First)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(%, Opcode, .Word.First);
-        } break;
-        case OP_NEG:
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First = -PVM->R[PVM_GET_RS(Opcode)].Word.First;
-        } break;
-        case OP_NOT:
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First = ~PVM->R[PVM_GET_RS(Opcode)].Word.First;
-        } break;
-        case OP_VSHL: INTEGER_BINARY_OP(<<, Opcode, .Word.First) & 0x1F; break;
-        case OP_VSHR: INTEGER_BINARY_OP(>>, Opcode, .Word.First) & 0x1F; break;
-        case OP_VASR: INTEGER_BINARY_OP(>>, Opcode, .SWord.First) & 0x1F; break;
-        case OP_QSHL: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First <<= PVM_GET_RS(Opcode);
-        } break;
-        case OP_QSHR: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First >>= PVM_GET_RS(Opcode);
-        } break;
-        case OP_QASR: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].SWord.First >>= PVM_GET_RS(Opcode);
-        } break;
-        case OP_ADDQI:
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First += BIT_SEX32(PVM_GET_RS(Opcode), 3); 
-        } break;
-        case OP_ADDI:
-        {
-            U32 Imm = 0;
-            GET_SEX_IMM(Imm, PVM_GET_RS(Opcode), IP);
-            PVM->R[PVM_GET_RD(Opcode)].Word.First += Imm;
-        } break;
-        
-        case OP_SADD: 
-        {
-            PascalStr *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            PascalStr *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            PascalStr *TmpStr = &PVM->TmpStr;
-
-            /* We take the addr of TmpStr and put it into Rd because later on,
-             * the compiler should have emitted code to copy the string pointed by Rd to wherever
-             *
-             * This is a shitty way to do ensure that dst is not modified and is unsafe
-             */
-            /* TODO: this does not work in an expr like: a + b + (a + b) */
-            /* TODO: something better? */
-            if (TmpStr != Dst)
-            {
-                /* reset TmpStr */
-                PStrSetLen(TmpStr, 0);
-                PStrCopyInto(TmpStr, Dst);
-                PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw = TmpStr;
-            }
-            PStrConcat(TmpStr, Src);
-        } break;
-        case OP_STRCPY:
-        {
-            PascalStr *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            const PascalStr *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            if (Src != Dst)
-            {
-                PStrCopyInto(Dst, Src);
-            }
-        } break;
-        case OP_MEMCPY:
-        {
-            void *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            const void *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            U32 Size = 0;
-            GET_SEX_IMM(Size, IMMTYPE_U32, IP);
-            memcpy(Dst, Src, Size);
-        } break;
-        case OP_VMEMCPY:
-        {
-            void *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            const void *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            U16 OtherHalf = *IP++;
-            U64 Size = PVM->R[PVM_GET_RD(OtherHalf)].DWord;
-            memcpy(Dst, Src, Size);
-        } break;
-        case OP_VMEMEQU:
-        {
-            void *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            const void *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            U16 OtherHalf = *IP++;
-            U64 Size = PVM->R[PVM_GET_RD(OtherHalf)].DWord;
-            PVM->Condition = 0 == memcmp(Dst, Src, Size);
-        } break;
-        case OP_STRLT:
-        {
-            PascalStr *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            PascalStr *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            PVM->Condition = PStrIsLess(Dst, Src);
-        } break;
-        case OP_STREQ:
-        {
-            PascalStr *Dst = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-            PascalStr *Src = PVM->R[PVM_GET_RS(Opcode)].Ptr.Raw;
-            PVM->Condition = PStrEqu(Src, Dst);
-        } break;
-        case OP_SETEZ: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].Word.First = 0 == PVM->R[PVM_GET_RS(Opcode)].Word.First;
-        } break;
-        case OP_SEQ: INTEGER_SET_IF(==, Opcode, .Word.First); break;
-        case OP_SLT: INTEGER_SET_IF(<, Opcode, .Word.First); break;
-        case OP_ISLT: INTEGER_SET_IF(<, Opcode, .SWord.First); break;
+/* function pointers are decoded instructions to the interpreter but native addresses to jitted code */
+static bool PVMCanTierUp(PVMChunk *Chunk)
+{
+    PVMDecodeChunk(Chunk, false);
+    for (U32 i = 0; i < Chunk->Decoded.Count; i++)
+    {
+        if (OP_LDRIP == PVM_GET_OP(Chunk->Decoded.Ins[i].Opcode))
+            return false;
+    }
+    return true;
+}
 
 
-        case OP_BR:
-        {
-            I32 Offset = GET_BR_IMM(Opcode, IP);
-            /* TODO: bound chk */
-            IP += Offset;
-            PASCAL_ASSERT(IP < Chunk->Code + Chunk->Count, "Unreachable");
-        } break;
-        case OP_CALL:
-        {
-            if (0 == PVM->RetStack.SizeLeft)
-                goto CallStackOverflow;
 
-            I32 Offset = GET_BR_IMM(Opcode, IP);
-            /* save frame */
-            PVM->RetStack.Val->IP = IP;
-            PVM->RetStack.Val->FP = FP().Ptr;
-            PVM->RetStack.Val++;
-            PVM->RetStack.SizeLeft--;
+#if PVM_DISPATCH == PVM_DISPATCH_SWITCH
 
-            /* TODO: bound chk */
+const char *PVMGetDispatchStrategy(void)
+{
+    return "switch";
+}
 
-            IP += Offset;
-        } break;
-        case OP_CALLPTR:
-        {
-            if (0 == PVM->RetStack.SizeLeft)
-                goto CallStackOverflow;
+#elif PVM_DISPATCH == PVM_DISPATCH_THREADED
 
-            PVM->RetStack.Val->IP = IP;
-            PVM->RetStack.Val->FP = FP().Ptr;
-            PVM->RetStack.Val++;
-            PVM->RetStack.SizeLeft--;
+const char *PVMGetDispatchStrategy(void)
+{
+    return "threaded";
+}
 
-            /* TODO: bound chk */
+#elif PVM_DISPATCH == PVM_DISPATCH_TAILCALL
 
-            IP = PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw;
-        } break;
-        case OP_BEZ:
-        {
-            I32 Offset = GET_BCC_IMM(Opcode, IP);
-            if (0 == PVM->R[PVM_GET_RD(Opcode)].Word.First)
-            {
-                /* TODO: bound chk */
-                IP += Offset;
-            }
-        } break;
-        case OP_BNZ:
-        {
-            I32 Offset = GET_BCC_IMM(Opcode, IP);
-            if (PVM->R[PVM_GET_RD(Opcode)].Word.First)
-            {
-                /* TODO: bound chk */
-                IP += Offset;
-            }
-        } break;
-        case OP_BCT:
-        {
-            I32 Offset = GET_BR_IMM(Opcode, IP);
-            if (PVM->Condition)
-            {
-                /* TODO: bound chk */
-                IP += Offset;
-            }
-        } break;
-        case OP_BCF:
-        {
-            I32 Offset = GET_BR_IMM(Opcode, IP);
-            if (!PVM->Condition)
-            {
-                /* TODO: bound check */
-                IP += Offset;
-            }
-        } break;
-        case OP_BRI:
-        {
-            I32 Offset = (I16)*IP++;
-            /* TODO: bound check */
-            IP += Offset;
-            PVM->R[PVM_GET_RD(Opcode)].DWord += BitSex64(PVM_GET_RS(Opcode), 3);
-        } break;
-        case OP_LDRIP:
-        {
-            I32 Offset = 0; 
-            GET_SEX_IMM(Offset, PVM_GET_IMMTYPE(Opcode), IP);
-            PVM->R[PVM_GET_RD(Opcode)].Ptr.Raw = IP + Offset;
-        } break;
+const char *PVMGetDispatchStrategy(void)
+{
+    return "tailcall";
+}
 
+/* 
+ * Without musttail (gcc < 15), we rely on the optimizer to turn the calls into jumps, 
+ * so this strategy will blow the C stack on unoptimized builds 
+ */
+#if defined(__has_attribute) && __has_attribute(musttail)
+#  define PVM_MUSTTAIL __attribute__((musttail))
+#else
+#  define PVM_MUSTTAIL
+#endif /* musttail */
 
-        case OP_PSHL: PUSH_MULTIPLE(R, 0, 8, PVM_GET_REGLIST(Opcode)); break;
-        case OP_POPL: POP_MULTIPLE(R, 0, 8, PVM_GET_REGLIST(Opcode)); break;
-        case OP_PSHH: PUSH_MULTIPLE(R, 8, 16, PVM_GET_REGLIST(Opcode)); break;
-        case OP_POPH: POP_MULTIPLE(R, 8, 16, PVM_GET_REGLIST(Opcode)); break;
-        case OP_FPSHL: PUSH_MULTIPLE(F, 0, 8, PVM_GET_REGLIST(Opcode)); break;
-        case OP_FPOPL: POP_MULTIPLE(F, 0, 8, PVM_GET_REGLIST(Opcode)); break;
-        case OP_FPSHH: PUSH_MULTIPLE(F, 8, 16, PVM_GET_REGLIST(Opcode)); break;
-        case OP_FPOPH: POP_MULTIPLE(F, 8, 16, PVM_GET_REGLIST(Opcode)); break;
+/* the condition flag is passed around so that it stays in a register */
+#define PVM_HANDLER_PARAMS PascalVM *PVM, PVMChunk *Chunk, PVMDecodedIns *IP, PVMDecodedIns *Ins, bool Condition
+typedef PVMReturnValue (*PVMHandler)(PVM_HANDLER_PARAMS);
 
+#else
+#  error "Unknown PVM_DISPATCH strategy"
+#endif /* PVM_DISPATCH */
 
-        case OP_FADD: FLOAT_BINARY_OP(+, Opcode, .Single); break;
-        case OP_FSUB: FLOAT_BINARY_OP(-, Opcode, .Single); break;
-        case OP_FMUL: FLOAT_BINARY_OP(*, Opcode, .Single); break;
-        case OP_FDIV: FLOAT_BINARY_OP(/, Opcode, .Single); break;
-        case OP_FNEG:
-        {
-            PVM->F[PVM_GET_RD(Opcode)].Single = -PVM->F[PVM_GET_RS(Opcode)].Single;
-        } break;
-        case OP_FSEQ: FLOAT_SET_IF(==, Opcode, .Single); break;
-        case OP_FSLT: FLOAT_SET_IF(<, Opcode, .Single); break;
-        case OP_FSGT: FLOAT_SET_IF(>, Opcode, .Single); break;
-        case OP_FSNE: FLOAT_SET_IF(!=, Opcode, .Single); break;
-        case OP_FSLE: FLOAT_SET_IF(<=, Opcode, .Single); break;
-        case OP_FSGE: FLOAT_SET_IF(>=, Opcode, .Single); break;
-
-        case OP_FADD64: FLOAT_BINARY_OP(+, Opcode, .Double); break;
-        case OP_FSUB64: FLOAT_BINARY_OP(-, Opcode, .Double); break;
-        case OP_FMUL64: FLOAT_BINARY_OP(*, Opcode, .Double); break;
-        case OP_FDIV64: FLOAT_BINARY_OP(/, Opcode, .Double); break;
-        case OP_FNEG64:
-        {
-            PVM->F[PVM_GET_RD(Opcode)].Double = -PVM->F[PVM_GET_RS(Opcode)].Double;
-        } break;
-        case OP_FSEQ64: FLOAT_SET_IF(==, Opcode, .Double); break;
-        case OP_FSLT64: FLOAT_SET_IF(<, Opcode, .Double); break;
-        case OP_FSGT64: FLOAT_SET_IF(>, Opcode, .Double); break;
-        case OP_FSNE64: FLOAT_SET_IF(!=, Opcode, .Double); break;
-        case OP_FSLE64: FLOAT_SET_IF(<=, Opcode, .Double); break;
-        case OP_FSGE64: FLOAT_SET_IF(>=, Opcode, .Double); break;
-
-        case OP_GETFLAG: PVM->R[PVM_GET_RD(Opcode)].Word.First = PVM->Condition; break;
-        case OP_GETNFLAG: PVM->R[PVM_GET_RD(Opcode)].Word.First = PVM->Condition; break;
-        case OP_SETFLAG: PVM->Condition = 0 != PVM->R[PVM_GET_RD(Opcode)].Word.First; break;
-        case OP_SETNFLAG: PVM->Condition = 0 == PVM->R[PVM_GET_RD(Opcode)].Word.First; break;
-        case OP_NEGFLAG: PVM->Condition = !PVM->Condition; break;
-
-
-        case OP_MOV32:       MOVE_INTEGER(Opcode, .Word.First, .Word.First); break;
-        case OP_MOVZEX32_8:  MOVE_INTEGER(Opcode, .Word.First, .Byte[PVM_LEAST_SIGNIF_BYTE]); break;
-        case OP_MOVZEX32_16: MOVE_INTEGER(Opcode, .Word.First, .Half.First); break;
-        case OP_MOV64:       MOVE_INTEGER(Opcode, .DWord, .DWord); break;
-        case OP_MOVZEX64_8:  MOVE_INTEGER(Opcode, .DWord, .Byte[PVM_LEAST_SIGNIF_BYTE]); break;
-        case OP_MOVZEX64_16: MOVE_INTEGER(Opcode, .DWord, .Half.First); break;
-        case OP_MOVZEX64_32: MOVE_INTEGER(Opcode, .DWord, .Word.First); break;
-        case OP_MOVSEX64_32: MOVE_INTEGER(Opcode, .SDWord, .SWord.First); break;
-        case OP_MOVI:
-        {
-            U64 Imm = 0;
-            GET_SEX_IMM(Imm, PVM_GET_IMMTYPE(Opcode), IP);
-            PVM->R[PVM_GET_RD(Opcode)].DWord = Imm;
-        } break;
-        case OP_MOVQI:
-        {
-            I32 Imm = BIT_SEX32(PVM_GET_RS(Opcode), 3);
-            PVM->R[PVM_GET_RD(Opcode)].SDWord = Imm;
-        } break;
-        case OP_FMOV:   MOVE_FLOAT(Opcode, .Single, .Single); break;
-        case OP_FMOV64: MOVE_FLOAT(Opcode, .Double, .Double); break;
-
-
-        case OP_F32TOF64:   MOVE_FLOAT(Opcode, .Double, .Single); break;
-        case OP_F64TOF32:   MOVE_FLOAT(Opcode, .Single, .Double); break;
-        case OP_F64TOI64:   MOVE_INTER(Opcode, R, .SDWord, F, .Double); break;
-        case OP_I64TOF64:   MOVE_INTER(Opcode, F, .Double, R, .SDWord); break;
-        case OP_I64TOF32:   MOVE_INTER(Opcode, F, .Single, R, .SDWord); break;
-        case OP_U64TOF64:   MOVE_INTER(Opcode, F, .Double, R, .DWord); break;
-        case OP_U64TOF32:   MOVE_INTER(Opcode, F, .Single, R, .DWord); break;
-        case OP_U32TOF32:   MOVE_INTER(Opcode, F, .Single, R, .Word.First); break;
-        case OP_U32TOF64:   MOVE_INTER(Opcode, F, .Double, R, .Word.First); break;
-        case OP_I32TOF32:   MOVE_INTER(Opcode, F, .Single, R, .SWord.First); break;
-        case OP_I32TOF64:   MOVE_INTER(Opcode, F, .Double, R, .SWord.First); break;
-
-
-        case OP_LD32:       LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .Word.First,  .Ptr.Byte, (U32), (U32)); break;
-        case OP_LD64:       LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .DWord,       .Ptr.Byte, (U64), (U64)); break;
-        case OP_LDZEX32_8:  LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .Word.First,  .Ptr.Byte, (U8),  (U32)(U8)); break;
-        case OP_LDZEX32_16: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .Word.First,  .Ptr.Byte, (U16), (U32)(U16)); break;
-        case OP_LDZEX64_8:  LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .DWord,       .Ptr.Byte, (U8),  (U64)(U8)); break;
-        case OP_LDZEX64_16: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .DWord,       .Ptr.Byte, (U16), (U64)(U16)); break;
-        case OP_LDZEX64_32: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .DWord,       .Ptr.Byte, (U32), (U64)(U32)); break;
-        case OP_LDSEX32_8:  LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .SWord.First, .Ptr.Byte, (U8),  (I32)(I8)); break;
-        case OP_LDSEX32_16: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .SWord.First, .Ptr.Byte, (U16), (I32)(I16)); break;
-        case OP_LDSEX64_8:  LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .SDWord,      .Ptr.Byte, (U8),  (I64)(I8)); break;
-        case OP_LDSEX64_16: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .SDWord,      .Ptr.Byte, (U16), (I64)(I32)); break;
-        case OP_LDSEX64_32: LOAD_INTEGER(Opcode, IMMTYPE_I16, IP, .SDWord,      .Ptr.Byte, (U32), (I64)(I32)); break;
-
-        case OP_LD32L:       LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .Word.First, .Ptr.Byte, (U32), (U32)); break;
-        case OP_LD64L:       LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .DWord,      .Ptr.Byte, (U64), (U64)); break;
-        case OP_LDZEX32_8L:  LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .Word.First, .Ptr.Byte, (U8),  (U32)(U8)); break;
-        case OP_LDZEX32_16L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .Word.First, .Ptr.Byte, (U16), (U32)(U16)); break;
-        case OP_LDZEX64_8L:  LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .DWord,      .Ptr.Byte, (U8),  (U64)(U8)); break;
-        case OP_LDZEX64_16L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .DWord,      .Ptr.Byte, (U16), (U64)(U16)); break;
-        case OP_LDZEX64_32L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .DWord,      .Ptr.Byte, (U32), (U64)(U32)); break;
-        case OP_LDSEX32_8L:  LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .SWord.First,.Ptr.Byte, (U8),  (I32)(I8)); break;
-        case OP_LDSEX32_16L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .SWord.First,.Ptr.Byte, (U16), (I32)(I16)); break;
-        case OP_LDSEX64_8L:  LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .SDWord,     .Ptr.Byte, (U8),  (I64)(I8)); break;
-        case OP_LDSEX64_16L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .SDWord,     .Ptr.Byte, (U16), (I64)(I16)); break;
-        case OP_LDSEX64_32L: LOAD_INTEGER(Opcode, IMMTYPE_I32, IP, .SDWord,     .Ptr.Byte, (U32), (I64)(I32)); break;
-
-        case OP_LEA:
-        {
-            U64 Offset = 0;
-            GET_SEX_IMM(Offset, IMMTYPE_I16, IP);
-            PVM->R[PVM_GET_RD(Opcode)].Ptr.UInt = PVM->R[PVM_GET_RS(Opcode)].Ptr.UInt + Offset;
-        } break;
-        case OP_LEAL:
-        {
-            U64 Offset = 0;
-            GET_SEX_IMM(Offset, IMMTYPE_I32, IP);
-            PVM->R[PVM_GET_RD(Opcode)].Ptr.UInt = PVM->R[PVM_GET_RS(Opcode)].Ptr.UInt + Offset;
-        } break;
 
-        case OP_ST8:  STORE_INTEGER(Opcode, IMMTYPE_I16, IP, .Byte[PVM_LEAST_SIGNIF_BYTE], .Ptr.Byte); break;
-        case OP_ST16: STORE_INTEGER(Opcode, IMMTYPE_I16, IP, .Half.First, .Ptr.Byte); break;
-        case OP_ST32: STORE_INTEGER(Opcode, IMMTYPE_I16, IP, .Word.First, .Ptr.Byte); break;
-        case OP_ST64: STORE_INTEGER(Opcode, IMMTYPE_I16, IP, .DWord, .Ptr.Byte); break;
-        case OP_ST8L:  STORE_INTEGER(Opcode, IMMTYPE_I32, IP, .Byte[PVM_LEAST_SIGNIF_BYTE], .Ptr.Byte); break;
-        case OP_ST16L: STORE_INTEGER(Opcode, IMMTYPE_I32, IP, .Half.First, .Ptr.Byte); break;
-        case OP_ST32L: STORE_INTEGER(Opcode, IMMTYPE_I32, IP, .Word.First, .Ptr.Byte); break;
-        case OP_ST64L: STORE_INTEGER(Opcode, IMMTYPE_I32, IP, .DWord, .Ptr.Byte); break;
-
-        case OP_LDF32: LOAD_FLOAT(Opcode, IMMTYPE_I16, IP, .Single, .Ptr.Byte); break;
-        case OP_STF32: STORE_FLOAT(Opcode, IMMTYPE_I16, IP, .Single, .Ptr.Byte); break;
-        case OP_LDF64: LOAD_FLOAT(Opcode, IMMTYPE_I16, IP, .Double, .Ptr.Byte); break;
-        case OP_STF64: STORE_FLOAT(Opcode, IMMTYPE_I16, IP, .Double, .Ptr.Byte); break;
-        case OP_LDF32L: LOAD_FLOAT(Opcode, IMMTYPE_I32, IP, .Single, .Ptr.Byte); break;
-        case OP_STF32L: STORE_FLOAT(Opcode, IMMTYPE_I32, IP, .Single, .Ptr.Byte); break;
-        case OP_LDF64L: LOAD_FLOAT(Opcode, IMMTYPE_I32, IP, .Double, .Ptr.Byte); break;
-        case OP_STF64L: STORE_FLOAT(Opcode, IMMTYPE_I32, IP, .Double, .Ptr.Byte); break;
-
-
-        case OP_ADD64: INTEGER_BINARY_OP(+, Opcode, .DWord); break;
-        case OP_SUB64: INTEGER_BINARY_OP(-, Opcode, .DWord); break;
-        case OP_MUL64: INTEGER_BINARY_OP(*, Opcode, .DWord); break;
-        case OP_IMUL64: INTEGER_BINARY_OP(*, Opcode, .SDWord); break;
-        case OP_AND64: INTEGER_BINARY_OP(&, Opcode, .DWord); break;
-        case OP_OR64:  INTEGER_BINARY_OP(|, Opcode, .DWord); break;
-        case OP_XOR64: INTEGER_BINARY_OP(^, Opcode, .DWord); break;
-        case OP_DIV64: 
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].DWord)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(/, Opcode, .DWord);
-        } break;
-        case OP_IDIV64: 
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].DWord)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(/, Opcode, .SDWord);
-        } break;
-        case OP_MOD64:
-        {
-            if (0 == PVM->R[PVM_GET_RS(Opcode)].DWord)
-                goto DivisionBy0;
-            INTEGER_BINARY_OP(%, Opcode, .DWord);
-        } break;
-        case OP_NEG64: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].DWord = -PVM->R[PVM_GET_RS(Opcode)].DWord;
-        } break;
-        case OP_NOT64:
-        {
-            PVM->R[PVM_GET_RD(Opcode)].DWord = ~PVM->R[PVM_GET_RS(Opcode)].DWord;
-        } break;
-        case OP_VSHL64: INTEGER_BINARY_OP(<<, Opcode, .DWord) & 0x3F; break;
-        case OP_VSHR64: INTEGER_BINARY_OP(>>, Opcode, .DWord) & 0x3F; break;
-        case OP_VASR64: INTEGER_BINARY_OP(>>, Opcode, .SDWord) & 0x3F; break;
-        case OP_QSHL64: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].DWord <<= PVM_GET_RS(Opcode);
-        } break;
-        case OP_QSHR64: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].DWord >>= PVM_GET_RS(Opcode);
-        } break;
-        case OP_QASR64: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].SDWord >>= PVM_GET_RS(Opcode);
-        } break;
-        case OP_ADDQI64:
-        {
-            PVM->R[PVM_GET_RD(Opcode)].SDWord += BitSex64(PVM_GET_RS(Opcode), 3); 
-        } break;
-        case OP_ADDI64:
-        {
-            U64 Imm = 0;
-            GET_SEX_IMM(Imm, PVM_GET_RS(Opcode), IP);
-            PVM->R[PVM_GET_RD(Opcode)].DWord += Imm;
-        } break;
+/* same handlers, instantiated three times */
+#define PVM_INTERPRETER PVMInterpretProduction
+#define PVM_INTERPRETER_DEBUG 0
+#define PVM_INTERPRETER_TIERED 0
+#include "Interpreter.inc"
 
-        case OP_SETEZ64: 
-        {
-            PVM->R[PVM_GET_RD(Opcode)].DWord = 0 == PVM->R[PVM_GET_RS(Opcode)].DWord;
-        } break;
-        case OP_SEQ64: INTEGER_SET_IF(==, Opcode, .DWord); break;
-        case OP_SLT64: INTEGER_SET_IF(<, Opcode, .DWord); break;
-        case OP_ISLT64: INTEGER_SET_IF(<, Opcode, .SDWord); break;
+#define PVM_INTERPRETER PVMInterpretTiered
+#define PVM_INTERPRETER_DEBUG 0
+#define PVM_INTERPRETER_TIERED 1
+#include "Interpreter.inc"
 
-        default:
-        {
-            goto IllegalInstruction;
-        } break;
-        }
-    }
-DivisionBy0:
-    ReturnValue = PVM_DIVISION_BY_0;
-    goto Exit;
-CallStackOverflow:
-    ReturnValue = PVM_CALLSTACK_OVERFLOW;
-    goto Exit;
-IllegalInstruction:
-    ReturnValue = PVM_ILLEGAL_INSTRUCTION;
-    goto Exit;
+#define PVM_INTERPRETER PVMInterpretDebug
+#define PVM_INTERPRETER_DEBUG 1
+#define PVM_INTERPRETER_TIERED 0
+#include "Interpreter.inc"
 
-Exit:
-    StreamOffset = IP - Chunk->Code;
-    LineDebugInfo *Info = ChunkGetDebugInfo(Chunk, StreamOffset);
-    if (NULL == Info)
-    {
-        return ReturnValue;
-    }
 
-    if (Info->Count > 0)
-    {
-        PVM->Error.Line = Info->Line[Info->Count - 1];
-    }
-    else 
+PVMReturnValue PVMInterpret(PascalVM *PVM, PVMChunk *Chunk)
+{
+    /* the production interpreter does not pay for any of the debugger's hooks */
+    if (PVM->SingleStepMode)
+        return PVMInterpretDebug(PVM, Chunk);
+    return PVMInterpretProduction(PVM, Chunk);
+}
+
+
+typedef struct PVMGuardedInterpreter
+{
+    PascalVM *PVM;
+    PVMChunk *Chunk;
+    PVMReturnValue (*Interpret)(PascalVM *, PVMChunk *);
+    PVMReturnValue ReturnValue;
+} PVMGuardedInterpreter;
+
+static void PVMCallInterpreter(void *Data)
+{
+    PVMGuardedInterpreter *Call = Data;
+    Call->ReturnValue = Call->Interpret(Call->PVM, Call->Chunk);
+}
+
+static PVMReturnValue PVMInterpretGuarded(PascalVM *PVM, PVMChunk *Chunk,
+        PVMReturnValue (*Interpret)(PascalVM *, PVMChunk *))
+{
+    PVMGuardedInterpreter Call = {
+        .PVM = PVM,
+        .Chunk = Chunk,
+        .Interpret = Interpret,
+    };
+    if (PVMGuardedCall(PVMCallInterpreter, &Call, NULL))
+        return Call.ReturnValue;
+
+    /* the instruction being interpreted is lost,
+     * the call that made the innermost frame is reported instead */
+    U32 StreamOffset = Chunk->EntryPoint;
+    if (PVM->RetStack.Val > PVM->RetStack.Start)
+        StreamOffset = (PVM->RetStack.Val[-1].IP - 1)->StreamOffset;
+    PVMSetErrorLocation(PVM, Chunk, StreamOffset);
+    return PVM_CALLSTACK_OVERFLOW;
+}
+
+
+PVMReturnValue PVMExecuteInstruction(PascalVM *PVM, PVMChunk *Chunk, PVMDecodedIns *Ins)
+{
+#define PVM_EXIT(RetVal) do { ReturnValue = RetVal; goto Exit; } while (0)
+#define PVM_HANDLER(Op, ...) case Op: { __VA_ARGS__ } break;
+#define PVM_HOT_CALL(Target) (void)0
+#define PVM_HOT_BRANCH(Target) (void)0
+
+    PVMGPR *const R = PVM->R;
+    PVMFPR *const F = PVM->F;
+    bool Condition = PVM->Condition;
+    PVMDecodedIns *IP = Ins + 1; /* only written by branches, which the caller does not give us */
+    PVMReturnValue ReturnValue = PVM_NO_ERROR;
+
+    switch ((UInt)PVM_GET_OP(Ins->Opcode))
     {
-        PVM->Error.Line = Info->Line[0];
+#include "Handlers.inc"
+    default: PVM_EXIT(PVM_ILLEGAL_INSTRUCTION); break;
     }
-    PVM->Error.PC = StreamOffset;
+    UNUSED(IP);
+
+Exit:
+    PVM->Condition = Condition;
+    if (PVM_NO_ERROR != ReturnValue)
+        return PVMInterpretExit(PVM, Chunk, Ins, ReturnValue);
     return ReturnValue;
 
+#undef PVM_HOT_BRANCH
+#undef PVM_HOT_CALL
+#undef PVM_HANDLER
+#undef PVM_EXIT
+}
+
+
+#if PVM_DISPATCH == PVM_DISPATCH_TAILCALL
+#  undef PVM_HANDLER_PARAMS
+#  undef PVM_MUSTTAIL
+#endif /* PVM_DISPATCH_TAILCALL */
+
+
+#undef PVM_INIT_REGISTERS
+#undef PVM_FUSE_ALLOWED
+#undef PVM_PROFILE_PAIR
 #undef LOAD_FLOAT
-#undef STORE_INTEGER
+#undef STORE_FLOAT
 #undef STORE_INTEGER
 #undef LOAD_INTEGER
+#undef MOVE_INTER
+#undef MOVE_FLOAT
+#undef MOVE_INTEGER
 #undef VERIFY_STACK_ADDR
 #undef PUSH_MULTIPLE
 #undef POP_MULTIPLE
+#undef PVM_CHECK_STACK_END
+#undef PVM_PROBE_FRAME
+#undef PVM_CHECK_RETSTACK
+#undef PVM_CHECK_STACK
+#undef FLOAT_BRANCH_IF_NOT
+#undef FLOAT_BRANCH_IF
+#undef INTEGER_BRANCH_IF_QI
+#undef INTEGER_BRANCH_IF
+#undef BRANCH_IF
+#undef FLOAT_BINARY_OP3
+#undef INTEGER_SHIFT_OP3
+#undef INTEGER_BINARY_OP3
 #undef FLOAT_SET_IF
 #undef FLOAT_BINARY_OP
-#undef GET_BR_IMM
-#undef GET_BCC_IMM
 #undef INTEGER_SET_IF
 #undef INTEGER_BINARY_OP
 #undef ASSIGNMENT
-}
+#undef SP
+#undef FP
 
 
 void PVMDumpState(FILE *f, const PascalVM *PVM, UInt RegPerLine)
@@ -877,7 +670,7 @@ void PVMDumpState(FILE *f, const PascalVM *PVM, UInt RegPerLine)
 
     fprintf(f, "\n===================== F%d REGISTERS ======================\n", (int)sizeof(PVM->F[0])*8);
     fprintf(f, "[Fnn: Double|Single]\n");
-    for (UInt i = 0; i < PVM_REG_COUNT; i++)
+    for (UInt i = 0; i < PVM_FREG_COUNT; i++)
     {
         if (i % RegPerLine == 0)
         {
@@ -887,7 +680,10 @@ void PVMDumpState(FILE *f, const PascalVM *PVM, UInt RegPerLine)
     }
 
     fprintf(f, "\n===================== STACK ======================");
-    for (PVMPTR Sp = PVM->Stack.Start; Sp.DWord <= PVM->R[PVM_REG_SP].Ptr.DWord; Sp.DWord++)
+    /* SP is past the end after a stack overflow */
+    for (PVMPTR Sp = PVM->Stack.Start; 
+        Sp.DWord <= PVM->R[PVM_REG_SP].Ptr.DWord && Sp.DWord < PVM->Stack.End.DWord; 
+        Sp.DWord++)
     {
         fprintf(f, "\nS: %8p: [0x%08llx]", Sp.Raw, *Sp.DWord);
         int Pad = sizeof(" <- SP");
@@ -1,4 +1,5 @@
 
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "Common.h"
@@ -7,6 +8,7 @@
 #include "Memory.h"
 
 #include "PVM/PVM.h"
+#include "PVM/Jit.h"
 #include "Compiler/Compiler.h"
 
 
@@ -30,14 +32,47 @@ int PascalRunFile(const U8 *InFileName, const U8 *OutFileName)
         .CompMode = PASCAL_COMPMODE_PROGRAM, 
         .CallConv = CALLCONV_MSX64 
     };
+    /* optimization level, each subroutine goes through the IR when it is not 0 */
+    if (NULL != getenv("PASCAL_OPT"))
+        Flags.OptLevel = strtoul(getenv("PASCAL_OPT"), NULL, 10);
+    /* print the IR of every subroutine that was optimized */
+    Flags.DumpIr = NULL != getenv("PASCAL_IR_DUMP");
+    /* two-operand instructions and moves only, what test/benchmark/op3.sh compares against */
+    Flags.NoThreeOperand = NULL != getenv("PASCAL_NOOP3");
     PVMChunk Chunk = ChunkInit(1024);
     PascalCompiler Compiler = PascalCompilerInit(Flags, &Predefined, stderr, &Chunk);
     if (PascalCompileProgram(&Compiler, Source))
     {
-        PascalVM PVM = PVMInit(1024, 128);
-        //PVM.SingleStepMode = true;
-        PVM.Disassemble = true;
-        PVMRun(&PVM, &Chunk);
+        /* how often each peephole rule applied */
+        if (NULL != getenv("PASCAL_PEEPHOLE_STATS"))
+            PeepholeReport(&Compiler.Peephole, stderr);
+        /* compile to a standalone executable at OutFileName instead of running */
+        if (NULL != getenv("PASCAL_ELF"))
+        {
+            if (!PVMJitWriteExecutable(&Chunk, (const char *)OutFileName, 1024, 128, stderr))
+                Status = PASCAL_EXIT_FAILURE;
+        }
+        else
+        {
+            PascalVM PVM = PVMInit(1024, 128);
+            //PVM.SingleStepMode = true;
+            PVM.Disassemble = true;
+            PVM.Jit = NULL == getenv("PASCAL_NOJIT");
+            /* how often a subroutine or loop has to run before it is compiled, 0 compiles everything first */
+            if (NULL != getenv("PASCAL_JIT_THRESHOLD"))
+                PVM.HotThreshold = strtoul(getenv("PASCAL_JIT_THRESHOLD"), NULL, 10);
+            /* compile to C through OutFileName.c */
+            if (NULL != getenv("PASCAL_CBACKEND"))
+                PVM.NativeOutput = (const char *)OutFileName;
+            /* size in bytes of the buffer write and writeln format into */
+            if (NULL != getenv("PASCAL_OUTPUT_BUFFER"))
+                PVM.Output = PVMOutputInit(strtoul(getenv("PASCAL_OUTPUT_BUFFER"), NULL, 10));
+            /* hand the output to a writer thread with a ring of that many bytes, 0 for the default size */
+            if (NULL != getenv("PASCAL_ASYNC_OUTPUT"))
+                PVMOutputStartWriter(&PVM.Output, strtoul(getenv("PASCAL_ASYNC_OUTPUT"), NULL, 10));
+            PVMRun(&PVM, &Chunk);
+            PVMDeinit(&PVM);
+        }
     }
     else
     {
@@ -120,6 +120,14 @@ static bool GetCommandLine(const char *Prompt, PascalVM *PVM, PascalCompiler *Co
                     fprintf(Out, "Enabled disassembly.\n");
                 PVM->Disassemble = !PVM->Disassemble;
             }
+            else if (STREQU(&Buf[1], "Jit"))
+            {
+                if (PVM->Jit)
+                    fprintf(Out, "Disabled JIT.\n");
+                else 
+                    fprintf(Out, "Enabled JIT.\n");
+                PVM->Jit = !PVM->Jit;
+            }
             else 
             {
                 fprintf(Out, "Unknown Repl command: '%s'\n", &Buf[1]);
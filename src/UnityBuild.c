@@ -16,6 +16,13 @@
 #include "Compiler/Data.h"
 #include "Compiler/Expr.h"
 #include "Compiler/VarList.h"
+#include "Compiler/Ir.h"
+#include "Compiler/ConstProp.h"
+#include "Compiler/Peephole.h"
+#include "Compiler/RegAlloc.h"
+#include "Compiler/Promote.h"
+#include "Compiler/Link.h"
+#include "Compiler/Inline.h"
 #include "Compiler/Builtins.h"
 
 #include "PVM/Isa.h"
@@ -23,6 +30,14 @@
 #include "PVM/Chunk.h"
 #include "PVM/Debugger.h"
 #include "PVM/Disassembler.h"
+#include "PVM/Decoder.h"
+#include "PVM/Jit.h"
+#include "PVM/CBackend.h"
+#include "PVM/Elf.h"
+#include "PVM/Guard.h"
+#include "PVM/Output.h"
+#include "PVM/Input.h"
+#include "PVM/File.h"
 
 
 
@@ -43,11 +58,26 @@
 #include "Compiler/Data.c"
 #include "Compiler/Expr.c"
 #include "Compiler/VarList.c"
+#include "Compiler/Ir.c"
+#include "Compiler/ConstProp.c"
+#include "Compiler/Peephole.c"
+#include "Compiler/RegAlloc.c"
+#include "Compiler/Promote.c"
+#include "Compiler/Link.c"
+#include "Compiler/Inline.c"
 
 #include "PVM/PVM.c"
 #include "PVM/Debugger.c"
 #include "PVM/Disassembler.c"
 #include "PVM/Chunk.c"
+#include "PVM/Decoder.c"
+#include "PVM/Jit.c"
+#include "PVM/CBackend.c"
+#include "PVM/Elf.c"
+#include "PVM/Guard.c"
+#include "PVM/Output.c"
+#include "PVM/Input.c"
+#include "PVM/File.c"
 
 
 
@@ -57,6 +57,7 @@ PascalVartab VartabPredefinedIdentifiers(PascalGPA *Allocator, ISize InitialCap)
 
     VartabSet(&Identifiers, (const U8*)"STRING", 6, 0, VarTypeInit(TYPE_STRING, sizeof(PascalStr)), NULL);
     VartabSet(&Identifiers, (const U8*)"ShortString", 11, 0, VarTypeInit(TYPE_STRING, sizeof(PascalStr)), NULL);
+    VartabSet(&Identifiers, (const U8*)"TEXT", 4, 0, VarTypeFile(NULL), NULL);
 
     VartabSet(&Identifiers, (const U8*)"int8", 4, 0, VarTypeInit(TYPE_I8, 1), NULL);
     VartabSet(&Identifiers, (const U8*)"int16", 5, 0, VarTypeInit(TYPE_I16, 2), NULL);
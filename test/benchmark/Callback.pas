@@ -0,0 +1,40 @@
+program CallbackBenchmark;
+{ pascal Callback.pas: a hot loop that calls through procedural variables, one site always sees the same callee, the other alternates between two }
+
+type Combine = function(a, b: int32): int32;
+
+function add(a, b: int32): int32;
+begin
+    exit(a + b);
+end;
+
+function sub(a, b: int32): int32;
+begin
+    exit(a - b);
+end;
+
+procedure main;
+var f, g: Combine;
+    i, h: int32;
+begin
+    f := @add;
+    h := 0;
+    i := 0;
+    while i < 10000000 do
+    begin
+        i := i + 1;
+        h := f(h, i);
+        if (i and 1) = 0
+        then g := @add
+        else g := @sub;
+        h := g(h, 3);
+    end;
+    if -2004260032 <> h
+    then writeln('failed: h = ', h)
+    else writeln('passed: h = ', h);
+end;
+
+
+begin
+    main;
+end.
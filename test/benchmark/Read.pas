@@ -0,0 +1,23 @@
+program ReadBenchmark;
+{ (echo; echo 1000000; seq 1000000) | pascal Read.pas }
+
+procedure main;
+var n, i, k: int32;
+    sum: int64;
+begin
+    readln(n);
+    i := 0;
+    sum := 0;
+    while i < n do
+    begin
+        i := i + 1;
+        read(k);
+        sum := sum + k;
+    end;
+    writeln('sum: ', sum);
+end;
+
+
+begin
+    main;
+end.
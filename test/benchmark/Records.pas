@@ -0,0 +1,63 @@
+program RecordsBenchmark;
+{ pascal Records.pas: writes a typed file bigger than one mapped window, scans it, then updates every 7th record in place }
+
+type Entry = record
+        id: int32;
+        balance: real64;
+        name: string;
+     end;
+
+procedure main;
+var f: file of Entry;
+    e: Entry;
+    i, n: int32;
+    sum: int64;
+begin
+    n := 300000;
+    assign(f, 'Records.dat');
+    rewrite(f);
+    i := 0;
+    while i < n do
+    begin
+        e.id := i;
+        e.balance := i;
+        write(f, e);
+        i := i + 1;
+    end;
+    close(f);
+
+    reset(f);
+    sum := 0;
+    while not eof(f) do
+    begin
+        read(f, e);
+        sum := sum + e.id;
+    end;
+    writeln('records: ', filesize(f), ' sum: ', sum);
+
+    i := 0;
+    while i < n do
+    begin
+        seek(f, i);
+        read(f, e);
+        e.id := e.id + 1;
+        seek(f, i);
+        write(f, e);
+        i := i + 7;
+    end;
+
+    seek(f, 0);
+    sum := 0;
+    while not eof(f) do
+    begin
+        read(f, e);
+        sum := sum + e.id;
+    end;
+    writeln('records: ', filesize(f), ' sum: ', sum);
+    close(f);
+end;
+
+
+begin
+    main;
+end.
@@ -0,0 +1,45 @@
+program TextFileBenchmark;
+{ pascal TextFile.pas: writes a million lines to a text file, then reads them back }
+
+procedure main;
+var f: text;
+    i, k, n: int32;
+    sum: int64;
+    line: string;
+begin
+    assign(f, 'TextFile.txt');
+    rewrite(f);
+    i := 0;
+    while i < 1000000 do
+    begin
+        i := i + 1;
+        writeln(f, i, ' ', i + i);
+    end;
+    close(f);
+
+    reset(f);
+    sum := 0;
+    while not eof(f) do
+    begin
+        read(f, k);
+        readln(f, n);
+        sum := sum + k + n;
+    end;
+    close(f);
+    writeln('sum: ', sum);
+
+    reset(f);
+    n := 0;
+    while not eof(f) do
+    begin
+        readln(f, line);
+        n := n + 1;
+    end;
+    close(f);
+    writeln('lines: ', n);
+end;
+
+
+begin
+    main;
+end.
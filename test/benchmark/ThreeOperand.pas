@@ -0,0 +1,32 @@
+program ThreeOperandBenchmark;
+
+
+
+{ every op reads a variable or the loop counter that is still needed after it }
+procedure main;
+var i: uint32;
+    a, b, c, h, k: uint32;
+begin
+    a := 1; b := 2; h := 0; k := 7;
+    for i := 1 to 5000000 do
+    begin
+        c := a + b;
+        h := h xor (c - a);
+        c := a * k;
+        h := h + (i mod k);
+        h := h + (i and b);
+        h := h + (i xor a);
+        h := h + (c shr k);
+        h := h + (b or i);
+        a := b;
+        b := c;
+    end;
+    if 2772713752 <> h
+    then writeln('failed: h = ', h)
+    else writeln('passed: h = ', h);
+end;
+
+
+begin
+    main;
+end.
@@ -0,0 +1,22 @@
+program WriteBenchmark;
+
+procedure main;
+var i, j: int32;
+    r: real;
+begin
+    i := 0;
+    j := 0;
+    r := 0.5;
+    while i < 200000 do
+    begin
+        i := i + 1;
+        j := j + 7;
+        writeln('line ', i, ': ', j, ' ', r);
+        r := r + 1.25;
+    end;
+end;
+
+
+begin
+    main;
+end.
@@ -0,0 +1,32 @@
+#!/bin/sh
+
+# Builds the interpreter once per dispatch strategy and runs every benchmark with each build.
+# Run from the root of the repo: ./test/benchmark/dispatch.sh gcc
+
+
+CC="${1:-gcc}"
+BENCHDIR="${PWD}/test/benchmark"
+BINDIR="${PWD}/bin"
+STRATEGIES="SWITCH THREADED TAILCALL"
+
+
+for Strategy in $STRATEGIES;
+do
+    PVM_DISPATCH=$Strategy sh ./build.sh $CC unity > /dev/null 2>&1 || exit 1
+    cp "${BINDIR}/pascal" "${BINDIR}/pascal-${Strategy}"
+done
+
+for Bench in ${BENCHDIR}/*.pas;
+do
+    echo ---------------------------------------------------
+    echo "  ${Bench##*/}"
+    echo ---------------------------------------------------
+    for Strategy in $STRATEGIES;
+    do
+        # the disassembler waits for enter before running the program,
+        # without PASCAL_NOJIT the hot code runs in the JIT and not in the interpreter
+        Elapsed=$(echo | PASCAL_NOJIT=1 "${BINDIR}/pascal-${Strategy}" "$Bench" /dev/null 2>&1 | grep "Time elapsed")
+        printf "%-10s %s\n" "$Strategy" "$Elapsed"
+    done
+done
+
@@ -0,0 +1,34 @@
+#!/bin/sh
+
+# Runs every benchmark with and without the three-operand instructions (PASCAL_NOOP3)
+# and prints how many instructions the interpreter executed and how long it took.
+# Run from the root of the repo: ./test/benchmark/op3.sh gcc [optimization level]
+
+
+CC="${1:-gcc}"
+OPT="${2:-1}"
+BENCHDIR="${PWD}/test/benchmark"
+BINDIR="${PWD}/bin"
+PROFILER="${BINDIR}/pascal-profile"
+
+
+PVM_PROFILE=1 sh ./build.sh $CC unity > /dev/null 2>&1 || exit 1
+cp "${BINDIR}/pascal" "$PROFILER"
+sh ./build.sh $CC unity > /dev/null 2>&1 || exit 1
+
+printf "%-24s %-8s %14s %s\n" "benchmark" "op3" "instructions" "time"
+for Bench in ${BENCHDIR}/*.pas;
+do
+    for NoOp3 in "" PASCAL_NOOP3=1;
+    do
+        Label=on
+        [ -n "$NoOp3" ] && Label=off
+        # the disassembler waits for enter before running the program,
+        # without PASCAL_NOJIT the hot code runs in the JIT and not in the interpreter
+        Count=$(echo | env PASCAL_NOJIT=1 PASCAL_OPT=$OPT $NoOp3 "$PROFILER" "$Bench" /dev/null 2>&1 \
+            | awk '/^Pair: / { Total += $4 } END { printf "%d", Total }')
+        Elapsed=$(echo | env PASCAL_NOJIT=1 PASCAL_OPT=$OPT $NoOp3 "${BINDIR}/pascal" "$Bench" /dev/null 2>&1 \
+            | grep "Time elapsed" | sed 's/Time elapsed: //')
+        printf "%-24s %-8s %14s %s\n" "${Bench##*/}" "$Label" "$Count" "$Elapsed"
+    done
+done
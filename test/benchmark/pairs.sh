@@ -0,0 +1,27 @@
+#!/bin/sh
+
+# Counts how often each pair of opcodes is executed across the tests and benchmarks,
+# and prints the most common ones, those are the candidates for PVM_FUSED_OPS in Isa.h.
+# Run from the root of the repo: ./test/benchmark/pairs.sh gcc [count]
+
+
+CC="${1:-gcc}"
+COUNT="${2:-20}"
+BINDIR="${PWD}/bin"
+PROFILER="${BINDIR}/pascal-profile"
+
+
+PVM_PROFILE=1 sh ./build.sh $CC unity > /dev/null 2>&1 || exit 1
+cp "${BINDIR}/pascal" "$PROFILER"
+
+for Test in $(find "${PWD}/test" -name "*.pas");
+do
+    # the disassembler waits for enter before running the program,
+    # without PASCAL_NOJIT only what runs before the JIT takes over is counted
+    echo | PASCAL_NOJIT=1 timeout 20 "$PROFILER" "$Test" /dev/null 2>&1 | grep "^Pair: "
+done | awk '
+    { Count[$2 " " $3] += $4; Total += $4 }
+    END {
+        for (Pair in Count)
+            printf "%14d %5.2f%% %s\n", Count[Pair], 100 * Count[Pair] / Total, Pair
+    }' | sort -rn | head -n "$COUNT"
@@ -0,0 +1,37 @@
+program Comparison;
+
+
+
+procedure main;
+var u: uint32;
+    b: uint8;
+    q: uint64;
+    i: int32;
+    l: int64;
+    Failed: int32;
+begin
+    u := 4000000000;
+    b := 200;
+    q := 5;
+    i := -1;
+    l := -4000000000;
+    Failed := 0;
+
+    if not (u > 5) then Failed := Failed + 1;
+    if not (5 < u) then Failed := Failed + 1;
+    if not (u < 4000000001) then Failed := Failed + 1;
+    if not (b >= 200) then Failed := Failed + 1;
+    if not (b < 256) then Failed := Failed + 1;
+    if not (q <> 4) then Failed := Failed + 1;
+    if not (i < 0) then Failed := Failed + 1;
+    if not (i < 1) then Failed := Failed + 1;
+    if i >= 0 then Failed := Failed + 1;
+    if not (l < i) then Failed := Failed + 1;
+    if not (l <= -4000000000) then Failed := Failed + 1;
+
+    if Failed = 0
+    then writeln('passed')
+    else writeln('failed: ', Failed);
+end;
+
+begin main end.
@@ -0,0 +1,41 @@
+program ConstantFolding;
+
+
+var
+    a, b, c: int32;
+    d: int64;
+    flag: boolean;
+
+function Adjust(x: int32): int32;
+var k: int32;
+begin
+    k := 10;
+    if k > 5
+    then x := x + k
+    else x := x - k;
+    exit(x);
+end;
+
+
+procedure Main;
+begin
+    a := 3;
+    b := a * 4 + 1;
+    flag := b = 13;
+    if flag then c := 1 else c := 2;
+    while a < 10 do
+        a := a + b;
+    d := 5;
+    d := d * d - 1;
+    if d > 100 then c := c + 100;
+    c := c + 7;
+    c := c div 2;
+
+    if (a <> 16) or (b <> 13) or (c <> 4) or (d <> 24) or (Adjust(5) <> 15)
+    then writeln('Failed: ', a, ' ', b, ' ', c, ' ', d, ' ', Adjust(5))
+    else writeln('Passed');
+end;
+
+
+begin Main end.
+
@@ -0,0 +1,22 @@
+program ForloopCounter;
+
+
+
+procedure main;
+var i, k, s, t: int32;
+begin
+    k := 3;
+    s := 0;
+    t := 0;
+    for i := -6 to 6 do
+    begin
+        s := s + (i + k);
+        t := t + i;
+    end;
+
+    if (s = 39) and (t = 0)
+    then writeln('passed')
+    else writeln('failed: ', s, ' ', t);
+end;
+
+begin main end.
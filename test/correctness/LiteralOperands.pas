@@ -0,0 +1,20 @@
+program LiteralOperands;
+
+
+
+procedure main;
+var a, b, c, d: int32;
+begin
+    a := 10;
+    a := a + 3;
+    b := 100;
+    b := b + 1000;
+    c := 7 - 2;
+    d := 6 * 7 + 12 div 4;
+
+    if (a = 13) and (b = 1100) and (c = 5) and (d = 45)
+    then writeln('passed')
+    else writeln('failed: ', a, ' ', b, ' ', c, ' ', d);
+end;
+
+begin main end.
@@ -0,0 +1,42 @@
+program PromoteAcrossCalls;
+
+
+var g0, g1, g2: integer;
+    gp: ^integer;
+
+{ its locals end up in registers other than the ones it was first emitted with }
+function Callee(a, b: integer): integer;
+var x, y, f: integer;
+    n8: int8;
+    w16: uint16;
+    p: ^integer;
+begin
+    x := a; y := b; n8 := 1; w16 := 2; p := @x; gp := @g0;
+    for f := 2 to 3 do
+    begin
+        g2 := p^ + 1;
+    end;
+    exit(x + y + a + n8 + w16);
+end;
+
+
+procedure Main;
+var m0, m1, m2: integer;
+    big: int64;
+    q: ^integer;
+begin
+    m0 := 1; m1 := 2; m2 := 3; big := 4; q := @m0; gp := @g0;
+    m1 := g1;
+    { m1 is kept in a register across the call }
+    g0 := Callee(m0, g0 div 4);
+
+    if (m0 = 1) and (m1 = 5) and (m2 = 3) and (big = 4) and (g0 = 5) and (g2 = 2)
+    then writeln('passed')
+    else writeln('failed: ', m0, ' ', m1, ' ', m2, ' ', big, ' ', g0, ' ', g2);
+end;
+
+
+begin
+    g0 := 0; g1 := 5; g2 := -3;
+    Main;
+end.
@@ -0,0 +1,37 @@
+program ReadInteger;
+{ integers read at the limits of their type, then one that does not fit:
+  the program has to stop there with "Invalid numeric format" instead of printing 'failed'
+  (echo; echo 127 -128 65535 -2147483648 4294967295; echo -9223372036854775808 18446744073709551615; echo 2147483648) | pascal ReadInteger.pas }
+
+procedure main;
+var b: int8;
+    w: uint16;
+    i: int32;
+    u: uint32;
+    q: int64;
+    uq: uint64;
+begin
+    read(b);
+    if b <> 127 then writeln('failed: ', b);
+    read(b);
+    if b <> -128 then writeln('failed: ', b);
+    read(w);
+    if w <> 65535 then writeln('failed: ', w);
+    read(i);
+    if i <> -2147483648 then writeln('failed: ', i);
+    read(u);
+    if u <> 4294967295 then writeln('failed: ', u);
+    read(q);
+    if q <> -9223372036854775808 then writeln('failed: ', q);
+    read(uq);
+    if uq + 1 <> 0 then writeln('failed: ', uq);
+    writeln('passed');
+
+    read(i);
+    writeln('failed: 2147483648 was read into an int32 as ', i);
+end;
+
+
+begin
+    main;
+end.
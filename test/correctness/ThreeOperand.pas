@@ -0,0 +1,116 @@
+program ThreeOperand;
+
+
+
+{ the for loop counter stays in its register, the result goes into another one }
+function Arith(k: int32): int32;
+var i, s: int32;
+begin
+    s := 0;
+    for i := -6 to 6 do
+    begin
+        s := s + (i + k);
+        s := s + (i - k);
+        s := s + i*k;
+        s := s + (i div k);
+    end;
+    exit(s);
+end;
+
+function Bitwise(k: int32): int32;
+var i, s: int32;
+begin
+    s := 0;
+    for i := -6 to 6 do
+    begin
+        s := s + (i and k);
+        s := s + (i or k);
+        s := s + (i xor k);
+        s := s + (i shl k);
+    end;
+    exit(s);
+end;
+
+function Wide(n: int64): int64;
+var q, r: int64;
+begin
+    r := 0;
+    for q := 5000000000 to 5000000002 do
+    begin
+        r := r + (q + 5000000000);
+        r := r + (q mod 7);
+        r := r + (q * n);
+    end;
+    for q := 5000000000 to 5000000002 do
+    begin
+        r := r + (q div 1000);
+        r := r + (q shr 32);
+    end;
+    exit(r);
+end;
+
+procedure counters;
+var u, m, um, ud, us: uint32;
+    s: int32;
+    r: int64;
+begin
+    s := Arith(3) + Bitwise(3);
+
+    { mod, div and shr are unsigned, the counter is above the signed range }
+    m := 7; um := 0; ud := 0; us := 0;
+    for u := 4000000000 to 4000000003 do
+    begin
+        um := um + u mod m;
+        ud := ud + u div m;
+        us := us + (u shr m);
+    end;
+
+    r := Wide(3);
+
+    if (s = 38) and (um = 18) and (ud = 2285714284) and (us = 125000000) and (r = 75015000024)
+    then writeln('passed')
+    else writeln('failed: ', s, ' ', um, ' ', ud, ' ', us, ' ', r);
+end;
+
+
+{ a and b stay live after the ops, at -O1 they are in registers and the ops read them in place }
+procedure locals;
+var a, b, add, sub, mul, dv, md, an, o, x, sl, sr: int32;
+begin
+    a := 17; b := 5;
+    add := a + b; sub := a - b; mul := a * b; dv := a div b; md := a mod b;
+    an := a and b; o := a or b; x := a xor b; sl := a shl b; sr := a shr b;
+
+    if (add = 22) and (sub = 12) and (mul = 85) and (dv = 3) and (md = 2)
+    and (an = 1) and (o = 21) and (x = 20) and (sl = 544) and (sr = 0) and (a = 17) and (b = 5)
+    then writeln('passed')
+    else writeln('failed: ', add, ' ', sub, ' ', mul, ' ', dv, ' ', md, ' ', an, ' ', o, ' ', x, ' ', sl, ' ', sr);
+end;
+
+procedure widelocals;
+var u, v, um, ud: uint32;
+    p, q, pd, pm: int64;
+    f, g, fa, fs, fm, fd: real;
+begin
+    u := 4000000005; v := 7;
+    um := u mod v; ud := u div v;
+
+    p := -9000000000; q := 4;
+    pd := p div q; pm := p * q;
+
+    f := 1.5; g := 0.25;
+    fa := f + g; fs := f - g; fm := f * g; fd := f / g;
+
+    if (um = 1) and (ud = 571428572) and (pd = -2250000000) and (pm = -36000000000)
+    and (fa = 1.75) and (fs = 1.25) and (fm = 0.375) and (fd = 6)
+    and (u = 4000000005) and (v = 7) and (p = -9000000000) and (q = 4) and (f = 1.5) and (g = 0.25)
+    then writeln('passed')
+    else writeln('failed: ', um, ' ', ud, ' ', pd, ' ', pm, ' ', fa, ' ', fs, ' ', fm, ' ', fd);
+end;
+
+
+begin
+    counters;
+    locals;
+    widelocals;
+end.
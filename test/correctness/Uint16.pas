@@ -0,0 +1,20 @@
+program Uint16;
+
+{ uint16 has to be loaded with all 16 bits, not only the low byte }
+procedure main;
+var w, v: uint16;
+    s: uint32;
+begin
+    w := 65535;
+    v := 300;
+    s := w;
+    s := s + v;
+    if (w = 65535) and (v = 300) and (s = 65835)
+    then writeln('passed')
+    else writeln('failed: ', w, ' ', v, ' ', s);
+end;
+
+
+begin
+    main;
+end.
@@ -0,0 +1,50 @@
+program BranchCompare;
+
+
+function IntCmp(a, b: Integer): Integer;
+var errCode: Integer;
+begin
+    errCode := 0;
+    if a = b then errCode += 1;
+    if a <> b then errCode += 2;
+    if a < b then errCode += 4;
+    if a > b then errCode += 8;
+    if a <= b then errCode += 16;
+    if a >= b then errCode += 32;
+    if a < 3 then errCode += 64;
+    if a >= 3 then errCode += 128;
+    if 3 < a then errCode += 256;
+    if 3 >= a then errCode += 512;
+    if a = 5 then errCode += 1024;
+    if 5 <> a then errCode += 2048;
+    exit(errCode);
+end;
+
+function RealCmp(a, b: Real): Integer;
+var errCode: Integer;
+begin
+    errCode := 0;
+    if a = b then errCode += 1;
+    if a <> b then errCode += 2;
+    if a < b then errCode += 4;
+    if a <= b then errCode += 16;
+    if a >= b then errCode += 32;
+    exit(errCode);
+end;
+
+var i, n: Integer;
+begin
+    writeln(IntCmp(0, 1), ' ', IntCmp(1, 1), ' ', IntCmp(2, 1));
+    writeln(IntCmp(3, 5), ' ', IntCmp(5, 3), ' ', IntCmp(4, 4));
+    writeln(RealCmp(0.5, 1.5), ' ', RealCmp(1.5, 1.5), ' ', RealCmp(2.5, 1.5));
+
+    n := 0;
+    i := 0;
+    while i < 10 do
+    begin
+        if (i < 5) and (i <> 2) then n += 1;
+        if (i = 7) or (i >= 9) then n += 10;
+        i += 1;
+    end;
+    writeln(n);
+end.
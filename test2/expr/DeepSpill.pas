@@ -0,0 +1,62 @@
+program DeepSpill;
+
+
+function one: integer; begin exit(1); end;
+
+procedure main;
+var t, u, a: integer;
+    r, q, fr: real;
+begin
+    t := 3;
+    u := 1;
+    a :=   (t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           ((t - u) + ((t - u) + ((t - u) + ((t - u) +
+           (t))))))))))))))))))))))))))))))))))))))));
+    if a = 83
+    then writeln('passed')
+    else writeln('failed:', a);
+
+    r := 0.5;
+    q := 0.25;
+    fr :=  (r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           ((r + q) + ((r + q) + ((r + q) + ((r + q) +
+           (r))))))))))))))))))))))))))))))))))))))));
+    if fr = 30.5
+    then writeln('passed')
+    else writeln('failed:', fr);
+
+    a :=   (one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           ((one + t) - ((one + t) - ((one + t) - ((one + t) -
+           (one))))))))))))))))))))))))))))))))))))))));
+    if a = 1
+    then writeln('passed')
+    else writeln('failed:', a);
+end;
+
+begin
+    main;
+end.
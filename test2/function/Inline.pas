@@ -0,0 +1,57 @@
+program Inlined;
+
+
+var Global: integer;
+
+function Square(a: integer): integer; inline;
+begin exit(a * a); end;
+
+function Clamp(a, Lo, Hi: integer): integer; inline;
+begin 
+    if a < Lo then exit(Lo);
+    if a > Hi then exit(Hi);
+    exit(a);
+end;
+
+function FnLocal(a, b: integer): integer; inline;
+var LocA, LocB: integer;
+begin 
+    LocA := a + Square(b);
+    LocB := b;
+    exit(LocA - LocB);
+end;
+
+procedure SetGlobal(a: integer); inline;
+begin Global := a; end;
+
+
+procedure main;
+var Loc, Other: integer;
+begin
+    Other := 3;
+    Loc := Square(Other) + Other;
+    if Loc <> 12 then writeln('failed square')
+    else writeln('passed');
+
+    Loc := Clamp(Other, 5, 10);
+    if Loc <> 5 then writeln('failed clamp low')
+    else writeln('passed');
+
+    Loc := Clamp(40, 0, 10);
+    if Loc <> 10 then writeln('failed clamp high')
+    else writeln('passed');
+
+    Loc := Clamp(Other, 0, 10);
+    if Loc <> 3 then writeln('failed clamp')
+    else writeln('passed');
+
+    Loc := FnLocal(Other, 2);
+    if Loc <> 5 then writeln('failed fn local')
+    else writeln('passed');
+
+    SetGlobal(Loc + Other);
+    if Global <> 8 then writeln('failed global')
+    else writeln('passed');
+end;
+
+begin main end.
@@ -0,0 +1,50 @@
+program Promote;
+
+type pint = ^int64;
+
+
+function twice(x: int64): int64;
+begin
+    exit(x * 2);
+end;
+
+procedure bump(p: pint);
+begin
+    p^ := p^ + 1;
+end;
+
+procedure main;
+var i, sum, taken: int64;
+    w: integer;
+    small: int8;
+    odd: boolean;
+    c: char;
+    r: real;
+begin
+    sum := 0;
+    w := 30000;
+    small := 100;
+    odd := false;
+    c := 'a';
+    r := 0.0;
+    taken := 0;
+    i := 0;
+    while i < 10 do
+    begin
+        sum := sum + twice(i);
+        w := w + 1000;
+        small := small + 10;
+        odd := not odd;
+        if odd then c := 'x' else c := 'y';
+        r := r + 0.5;
+        bump(@taken);
+        i := i + 1;
+    end;
+
+    if (sum = 90) and (w = -25536) and (small = -54) and not odd
+    and (c = 'y') and (r = 5.0) and (taken = 10)
+    then writeln('passed')
+    else writeln('failed: ', sum, ' ', w, ' ', small, ' ', odd, ' ', c, ' ', r, ' ', taken);
+end;
+
+begin main end.